@@ -83,6 +83,38 @@ void dt_bilateral_grid_size(dt_bilateral_t *b,
 #endif
 }
 
+// The splat is parallelized over horizontal slices of the input image.
+// If the slices are at least three grid cells high, slices two apart
+// never touch the same grid row: we then splat the even slices and the
+// odd slices in two passes directly into the final grid.  Otherwise
+// each thread gets a private slab of grid rows which is merged into
+// the final grid afterwards.  Both ways avoid any write contention,
+// the stripes need no extra memory and no merge.
+static void _splat_slices(const dt_bilateral_t *const b,
+                          const int height,
+                          const int nthreads,
+                          int *numslices,
+                          int *sliceheight,
+                          int *stripes)
+{
+  const int nstripes = 2 * nthreads;
+  const int stripeheight = (height + nstripes - 1) / nstripes;
+  *stripes = nthreads > 1 && stripeheight * b->sigma_s_inv >= 3.0f;
+  *numslices = *stripes ? nstripes : nthreads;
+  *sliceheight = *stripes ? stripeheight : (height + nthreads - 1) / nthreads;
+}
+
+// number of grid rows of size_x * size_z floats which must be allocated
+static size_t _splat_grid_rows(const dt_bilateral_t *const b,
+                               const int height,
+                               const int nthreads)
+{
+  int numslices, sliceheight, stripes;
+  _splat_slices(b, height, nthreads, &numslices, &sliceheight, &stripes);
+  return stripes ? b->size_y
+                 : (size_t)numslices * ((b->size_y + numslices - 1) / numslices + 2);
+}
+
 size_t dt_bilateral_memory_use(const int width,     // width of input image
                                const int height,    // height of input image
                                const float sigma_s, // spatial sigma (blur pixel coords)
@@ -95,7 +127,7 @@ size_t dt_bilateral_memory_use(const int width,     // width of input image
   // OpenCL path needs two buffers
   return 2 * grid_size * sizeof(float);
 #else
-  return (grid_size + 3 * dt_get_num_threads() * b.size_x * b.size_z) * sizeof(float);
+  return _splat_grid_rows(&b, height, dt_get_num_threads()) * b.size_x * b.size_z * sizeof(float);
 #endif /* HAVE_OPENCL */
 }
 
@@ -119,8 +151,7 @@ size_t dt_bilateral_singlebuffer_size
 {
   dt_bilateral_t b;
   dt_bilateral_grid_size(&b,width,height,100.0f,sigma_s,sigma_r);
-  size_t grid_size = b.size_x * b.size_y * b.size_z;
-  return (grid_size + 3 * dt_get_num_threads() * b.size_x * b.size_z) * sizeof(float);
+  return _splat_grid_rows(&b, height, dt_get_num_threads()) * b.size_x * b.size_z * sizeof(float);
 }
 
 #ifndef HAVE_OPENCL
@@ -180,10 +211,9 @@ dt_bilateral_t *dt_bilateral_init(const int width,     // width of input image
   dt_bilateral_grid_size(b,width,height,100.0f,sigma_s,sigma_r);
   b->width = width;
   b->height = height;
-  b->numslices = dt_get_num_threads();
-  b->sliceheight = (height + b->numslices - 1) / b->numslices;
-  b->slicerows = (b->size_y + b->numslices - 1) / b->numslices + 2;
-  b->buf = dt_calloc_align_float(b->size_x * b->size_z * b->numslices * b->slicerows);
+  _splat_slices(b, height, dt_get_num_threads(), &b->numslices, &b->sliceheight, &b->stripes);
+  b->slicerows = b->stripes ? b->size_y : (b->size_y + b->numslices - 1) / b->numslices + 2;
+  b->buf = dt_calloc_align_float(b->size_x * b->size_z * _splat_grid_rows(b, height, dt_get_num_threads()));
   if(!b->buf)
   {
     dt_print(DT_DEBUG_ALWAYS,
@@ -193,23 +223,24 @@ dt_bilateral_t *dt_bilateral_init(const int width,     // width of input image
     return NULL;
   }
   dt_print(DT_DEBUG_DEV,
-           "[bilateral] created grid [%ld %ld %ld] with sigma (%f %f) (%f %f)",
-           b->size_x, b->size_y, b->size_z, b->sigma_s, sigma_s, b->sigma_r, sigma_r);
+           "[bilateral] created grid [%ld %ld %ld] with sigma (%f %f) (%f %f), splat in %d %s",
+           b->size_x, b->size_y, b->size_z, b->sigma_s, sigma_s, b->sigma_r, sigma_r,
+           b->numslices, b->stripes ? "stripes" : "slabs");
   return b;
 }
 
-DT_OMP_DECLARE_SIMD(aligned(in:64))
-void dt_bilateral_splat(const dt_bilateral_t *b, const float *const in)
+// splat the image rows of one slice, grid row yi goes to row yi + row_offset of buf
+__DT_CLONE_TARGETS__
+static inline void _splat_slice(const dt_bilateral_t *const b,
+                                const float *const in,
+                                float *const buf,
+                                const int slice,
+                                const int row_offset)
 {
   const int ox = b->size_z;
   const int oy = b->size_x * b->size_z;
   const int oz = 1;
   const float sigma_s = b->sigma_s * b->sigma_s;
-  float *const buf = b->buf;
-
-  if(!buf) return;
-  // splat into downsampled grid
-  const int nthreads = dt_get_num_threads();
   const size_t offsets[8] =
   {
     0,
@@ -222,73 +253,109 @@ void dt_bilateral_splat(const dt_bilateral_t *b, const float *const in)
     oz + oy + ox
   };
 
+  const int firstrow = slice * b->sliceheight;
+  const int lastrow = MIN((slice+1)*b->sliceheight,b->height);
+  // now iterate over the rows of the current horizontal slice
+  for(int j = firstrow; j < lastrow; j++)
+  {
+    float y = CLAMPS(j * b->sigma_s_inv, 0, b->size_y - 1);
+    const int yi = MIN((int)y, b->size_y - 2);
+    const float yf = y - yi;
+    const size_t base = (size_t)(yi + row_offset) * oy;
+    for(int i = 0; i < b->width; i++)
+    {
+      size_t index = 4 * ((size_t)j * b->width + i);
+      float xf, zf;
+      const float L = in[index];
+      // nearest neighbour splatting:
+      const size_t grid_index = base + image_to_relgrid(b, i, L, &xf, &zf);
+      // sum up payload here
+      const dt_aligned_pixel_t contrib =
+      {
+        // precompute the contributions along the first two dimensions:
+        (1.0f - xf) * (1.0f - yf) * 100.0f / sigma_s,
+        xf * (1.0f - yf) * 100.0f / sigma_s,
+        (1.0f - xf) * yf * 100.0f / sigma_s,
+        xf * yf * 100.0f / sigma_s
+      };
+      DT_OMP_SIMD(aligned(buf:64))
+      for(int k = 0; k < 4; k++)
+      {
+        buf[grid_index + offsets[k]] += (contrib[k] * (1.0f - zf));
+        buf[grid_index + offsets[k+4]] += (contrib[k] * zf);
+      }
+    }
+  }
+}
+
+DT_OMP_DECLARE_SIMD(aligned(in:64))
+__DT_CLONE_TARGETS__
+void dt_bilateral_splat(const dt_bilateral_t *b, const float *const in)
+{
+  const size_t oy = b->size_x * b->size_z;
+  float *const buf = b->buf;
+
+  if(!buf) return;
+
+  if(b->stripes)
+  {
+    // slices two apart are at least one grid row apart, so all even
+    // and then all odd slices can splat into the final grid at once
+    for(int pass = 0; pass < 2; pass++)
+    {
+      DT_OMP_FOR()
+      for(int slice = pass; slice < b->numslices; slice += 2)
+        _splat_slice(b, in, buf, slice, 0);
+    }
+    return;
+  }
+
+  // splat into downsampled grid, each slice into its own slab
   DT_OMP_FOR()
   for(int slice = 0; slice < b->numslices; slice++)
   {
-    const int firstrow = slice * b->sliceheight;
-    const int lastrow = MIN((slice+1)*b->sliceheight,b->height);
     // compute the first row of the final grid which this slice
     // splats, and subtract that from the first row the current thread
     // should use to get an offset
-    const int slice_offset = slice * b->slicerows - (int)(firstrow * b->sigma_s_inv);
-    // now iterate over the rows of the current horizontal slice
-    for(int j = firstrow; j < lastrow; j++)
-    {
-      float y = CLAMPS(j * b->sigma_s_inv, 0, b->size_y - 1);
-      const int yi = MIN((int)y, b->size_y - 2);
-      const float yf = y - yi;
-      const size_t base = (size_t)(yi + slice_offset) * oy;
-      for(int i = 0; i < b->width; i++)
-      {
-        size_t index = 4 * (j * b->width + i);
-        float xf, zf;
-        const float L = in[index];
-        // nearest neighbour splatting:
-        const size_t grid_index = base + image_to_relgrid(b, i, L, &xf, &zf);
-        // sum up payload here
-        const dt_aligned_pixel_t contrib =
-        {
-          // precompute the contributions along the first two dimensions:
-          (1.0f - xf) * (1.0f - yf) * 100.0f / sigma_s,
-          xf * (1.0f - yf) * 100.0f / sigma_s,
-          (1.0f - xf) * yf * 100.0f / sigma_s,
-          xf * yf * 100.0f / sigma_s
-        };
-        DT_OMP_SIMD(aligned(buf:64))
-        for(int k = 0; k < 4; k++)
-        {
-          buf[grid_index + offsets[k]] += (contrib[k] * (1.0f - zf));
-          buf[grid_index + offsets[k+4]] += (contrib[k] * zf);
-        }
-      }
-    }
+    const int firstrow = slice * b->sliceheight;
+    _splat_slice(b, in, buf, slice, slice * b->slicerows - (int)(firstrow * b->sigma_s_inv));
   }
 
-  // merge the per-thread results into the final result
-  for(int slice = 1 ; slice < nthreads; slice++)
+  // merge the per-thread results into the final result.  The slices
+  // have to be added in order as the slabs share the buffer with the
+  // final grid, but every grid cell only depends on itself so the
+  // rows are split into chunks of columns merged in parallel.
+  const size_t chunk = 256;
+  DT_OMP_FOR()
+  for(size_t i0 = 0; i0 < oy; i0 += chunk)
   {
-    // compute the first row of the final grid which this slice splats
-    const int destrow = (int)(slice * b->sliceheight * b->sigma_s_inv);
-    float *dest = buf + destrow * oy;
-    // now iterate over the grid rows splatted for this slice
-    for(int j = slice * b->slicerows; j < (slice+1)*b->slicerows; j++)
+    const size_t i1 = MIN(i0 + chunk, oy);
+    for(int slice = 1 ; slice < b->numslices; slice++)
     {
-      float *src = buf + j * oy;
-      for(int i = 0; i < oy; i++)
+      // compute the first row of the final grid which this slice splats
+      const int destrow = (int)(slice * b->sliceheight * b->sigma_s_inv);
+      float *dest = buf + destrow * oy;
+      // now iterate over the grid rows splatted for this slice
+      for(int j = slice * b->slicerows; j < (slice+1)*b->slicerows; j++)
       {
-        dest[i] += src[i];
+        float *src = buf + j * oy;
+        for(size_t i = i0; i < i1; i++)
+        {
+          dest[i] += src[i];
+        }
+        dest += oy;
+        // clear elements in the part of the buffer which holds the
+        // final result now that we've read the partial result, since
+        // we'll be adding to those locations later
+        if(j < b->size_y)
+          memset(src + i0, '\0', sizeof(float) * (i1 - i0));
       }
-      dest += oy;
-      // clear elements in the part of the buffer which holds the
-      // final result now that we've read the partial result, since
-      // we'll be adding to those locations later
-      if(j < b->size_y)
-        memset(buf + j*oy, '\0', sizeof(float) * oy);
     }
   }
 }
 
 DT_OMP_DECLARE_SIMD(aligned(buf:64))
+__DT_CLONE_TARGETS__
 static void blur_line_z(float *buf,
                         const int offset1,
                         const int offset2,
@@ -331,6 +398,7 @@ static void blur_line_z(float *buf,
 }
 
 DT_OMP_DECLARE_SIMD(aligned(buf:64))
+__DT_CLONE_TARGETS__
 static void blur_line(float *buf,
                       const int offset1,
                       const int offset2,
@@ -395,6 +463,7 @@ void dt_bilateral_blur(const dt_bilateral_t *b)
 
 
 DT_OMP_DECLARE_SIMD(aligned(out, in :64))
+__DT_CLONE_TARGETS__
 void dt_bilateral_slice(const dt_bilateral_t *const b,
                         const float *const in,
                         float *out,
@@ -437,6 +506,7 @@ void dt_bilateral_slice(const dt_bilateral_t *const b,
 }
 
 DT_OMP_DECLARE_SIMD(aligned(out, in :64))
+__DT_CLONE_TARGETS__
 void dt_bilateral_slice_to_output(const dt_bilateral_t *const b,
                                   const float *const in,
                                   float *out,
@@ -25,6 +25,7 @@ typedef struct dt_bilateral_t
   size_t size_x, size_y, size_z;
   int width, height;
   int numslices, sliceheight, slicerows; //height--in input image, rows--in grid
+  int stripes;  // splat alternating slices straight into the grid instead of private slabs
   float sigma_s, sigma_r;
   float sigma_s_inv, sigma_r_inv;  // reciprocals of sigma_s and sigma_r to avoid divisions
   float *buf __attribute__((aligned(64)));
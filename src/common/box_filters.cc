@@ -462,6 +462,7 @@ static inline void _box_max_vert(const unsigned height,
 
 // calculate the two-dimensional moving maximum over a box of size (2*w+1) x (2*w+1)
 // does the calculation in-place if input and output images are identical
+__DT_CLONE_TARGETS__
 static void _box_max_1ch(float *const buf,
                         const size_t height,
                         const size_t width,
@@ -566,6 +567,7 @@ static inline void _box_min_vert(const unsigned height,
 
 // calculate the two-dimensional moving minimum over a box of size (2*w+1) x (2*w+1)
 // does the calculation in-place if input and output images are identical
+__DT_CLONE_TARGETS__
 static void _box_min_1ch(float *const buf,
                         const size_t height,
                         const size_t width,
@@ -599,6 +601,7 @@ static void _box_min_1ch(float *const buf,
   dt_free_align(scratch_buffers);
 }
 
+__DT_CLONE_TARGETS__
 void dt_box_mean(float *const buf,
                  const size_t height,
                  const size_t width,
@@ -630,6 +633,7 @@ void dt_box_mean(float *const buf,
     dt_unreachable_codepath();
 }
 
+__DT_CLONE_TARGETS__
 void dt_box_mean_horizontal(float *const __restrict__ buf,
     const size_t width,
     const uint32_t ch,
@@ -666,6 +670,7 @@ void dt_box_mean_horizontal(float *const __restrict__ buf,
     dt_unreachable_codepath();
 }
 
+__DT_CLONE_TARGETS__
 void dt_box_mean_vertical(float *const buf,
     const size_t height,
     const size_t width,
@@ -41,6 +41,7 @@
 #include "common/file_location.h"
 #include "common/film.h"
 #include "common/grealpath.h"
+#include "common/guided_filter_cache.h"
 #include "common/image.h"
 #include "common/image_cache.h"
 #include "common/iop_order.h"
@@ -50,6 +51,8 @@
 #include "common/opencl.h"
 #include "common/points.h"
 #include "common/resource_limits.h"
+#include "common/thread_budget.h"
+#include "common/trace.h"
 #include "common/undo.h"
 #include "common/gimp.h"
 #include "common/pfm.h"
@@ -65,6 +68,7 @@
 #include "control/signal.h"
 #include "develop/blend.h"
 #include "develop/imageop.h"
+#include "develop/masks.h"
 #include "gui/accelerators.h"
 #include "gui/workspace.h"
 #include "gui/gtk.h"
@@ -92,6 +96,11 @@
 #include <locale.h>
 #include <limits.h>
 
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
 #include <exiv2/exv_conf.h>  // for EXV_PACKAGE_VERSION
 #include <lensfun.h>  // for lensfun library version macros
 
@@ -129,6 +138,8 @@
 
 darktable_t darktable;
 
+static void _init_alloc_policy(void);
+
 static int usage(const char *argv0)
 {
 #ifdef _WIN32
@@ -276,6 +287,10 @@ static int usage(const char *argv0)
          "    nan, opencl, params, perf, pipe, print, pwstorage, signal,\n"
          "    sql, tiling, picker, undo\n"
          "\n"
+         "    trace   -> write a trace-event json file of pipeline, cache, job,\n"
+         "               mipmap and sql events to the dump directory that can\n"
+         "               be loaded into perfetto. Not included in 'all'.\n"
+         "\n"
          "    It is also possible to specify names that activate all channels\n"
          "    or a certain subset, as well as increase verbosity:\n"
          "    all     -> to debug all channels\n"
@@ -501,14 +516,58 @@ dt_imgid_t dt_load_from_string(const gchar *input,
 
 static void dt_codepaths_init()
 {
-  // we no longer do explicit runtime selection of code paths, so initialize to "none"
-  // (there are still functions where the compiler creates runtime selection due to "target_clones"
-  // directives, but those are not affected by this code)
+  // we no longer do explicit runtime selection of code paths, the hot
+  // pixel kernels are marked with __DT_CLONE_TARGETS__ and the loader
+  // picks the best clone from the cpu features. we only record the
+  // features here to report the chosen path.
 
   memset(&(darktable.codepath), 0, sizeof(darktable.codepath));
 
   // do we have any intrinsics sets enabled? (nope)
   darktable.codepath._no_intrinsics = 1;
+  darktable.codepath.clone_target = "default";
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+  __builtin_cpu_init();
+  darktable.codepath.sse2 = __builtin_cpu_supports("sse2") != 0;
+  darktable.codepath.sse4_1 = __builtin_cpu_supports("sse4.1") != 0;
+  darktable.codepath.avx = __builtin_cpu_supports("avx") != 0;
+  darktable.codepath.avx2 = __builtin_cpu_supports("avx2") != 0;
+  darktable.codepath.fma = __builtin_cpu_supports("fma") != 0;
+  darktable.codepath.avx512f = __builtin_cpu_supports("avx512f") != 0;
+#elif defined(__aarch64__) || defined(__ARM_NEON)
+  // NEON is part of the aarch64 baseline, the default build uses it
+  darktable.codepath.neon = 1;
+#endif
+
+#ifdef __DT_CLONES_ENABLED__
+  const dt_codepath_t *cp = &darktable.codepath;
+  darktable.codepath.clone_target = cp->avx512f ? "avx512f"
+                                  : cp->avx2    ? "avx2"
+                                  : cp->avx     ? "avx"
+                                  : cp->sse4_1  ? "sse4.1"
+                                  : cp->sse2    ? "sse2"
+                                  : "default";
+#elif defined(__aarch64__) || defined(__ARM_NEON)
+  darktable.codepath.clone_target = "neon";
+#endif
+
+  dt_print(DT_DEBUG_PERF | DT_DEBUG_DEV,
+           "[codepaths] cpu features:%s%s%s%s%s%s%s, pixel kernels use the '%s' path%s",
+           darktable.codepath.sse2 ? " sse2" : "",
+           darktable.codepath.sse4_1 ? " sse4.1" : "",
+           darktable.codepath.avx ? " avx" : "",
+           darktable.codepath.avx2 ? " avx2" : "",
+           darktable.codepath.fma ? " fma" : "",
+           darktable.codepath.avx512f ? " avx512f" : "",
+           darktable.codepath.neon ? " neon" : "",
+           darktable.codepath.clone_target,
+#ifdef __DT_CLONES_ENABLED__
+           ""
+#else
+           " (no function multiversioning in this build)"
+#endif
+           );
 }
 
 static inline size_t _get_total_memory()
@@ -557,6 +616,72 @@ static inline size_t _get_total_memory()
 #endif
 }
 
+#if defined(__linux__)
+// number of cpus in a list like "0-3,8-11"
+static int _count_cpus(const char *list)
+{
+  int count = 0;
+  gchar **ranges = g_strsplit(list, ",", -1);
+  for(int k = 0; ranges[k]; k++)
+  {
+    int first, last;
+    const int n = sscanf(ranges[k], "%d-%d", &first, &last);
+    if(n == 2) count += MAX(0, last - first + 1);
+    else if(n == 1) count++;
+  }
+  g_strfreev(ranges);
+  return count;
+}
+#endif
+
+// the level 2 cache a thread can use, 0 if unknown
+static size_t _get_cache_per_thread()
+{
+#if defined(__linux__)
+  for(int index = 0; index < 8; index++)
+  {
+    gchar *path = g_strdup_printf("/sys/devices/system/cpu/cpu0/cache/index%d/", index);
+    gchar *file = g_strconcat(path, "level", NULL);
+    gchar *level = NULL, *size = NULL, *shared = NULL;
+    size_t cache = 0;
+    if(g_file_get_contents(file, &level, NULL, NULL) && atoi(level) == 2)
+    {
+      g_free(file);
+      file = g_strconcat(path, "size", NULL);
+      if(g_file_get_contents(file, &size, NULL, NULL))
+      {
+        // in KiB, possibly with a K suffix
+        cache = (size_t)atol(size) * 1024lu;
+        g_free(file);
+        file = g_strconcat(path, "shared_cpu_list", NULL);
+        if(g_file_get_contents(file, &shared, NULL, NULL))
+          cache /= MAX(1, _count_cpus(g_strstrip(shared)));
+      }
+    }
+    const gboolean found = level != NULL && atoi(level) == 2;
+    g_free(shared);
+    g_free(size);
+    g_free(level);
+    g_free(file);
+    g_free(path);
+    if(found) return cache;
+  }
+#if defined(_SC_LEVEL2_CACHE_SIZE)
+  const long cache = sysconf(_SC_LEVEL2_CACHE_SIZE);
+  if(cache > 0) return cache;
+#endif
+#elif defined(__APPLE__)
+  uint64_t cache = 0, shared = 1;
+  size_t length = sizeof(uint64_t);
+  if(sysctlbyname("hw.l2cachesize", &cache, &length, NULL, 0)) return 0;
+  length = sizeof(uint64_t);
+  if(!sysctlbyname("hw.perflevel0.cpusperl2", &shared, &length, NULL, 0) && shared > 1)
+    cache /= shared;
+  return cache;
+#endif
+  return 0;
+}
+
 static size_t _get_mipmap_size()
 {
   dt_sys_resources_t *res = &darktable.dtresources;
@@ -1180,6 +1305,7 @@ int dt_init(int argc,
           !strcmp(darg, "expose") ? DT_DEBUG_EXPOSE :
           !strcmp(darg, "picker") ? DT_DEBUG_PICKER :
           !strcmp(darg, "ai") ? DT_DEBUG_AI : // AI related stuff.
+          !strcmp(darg, "trace") ? DT_DEBUG_TRACE : // trace-event json file
           0;
         if(dadd)
           darktable.unmuted |= dadd;
@@ -1488,6 +1614,8 @@ int dt_init(int argc,
              darktable.tmp_directory ? darktable.tmp_directory : "NOT AVAILABLE");
   }
 
+  dt_trace_init();
+
   // Set directories as requested or default.
   // Set a result flag so if we can't create certain directories, we can
   // later, after initializing the GUI, show the user a message and exit.
@@ -1868,6 +1996,11 @@ int dt_init(int argc,
   if(total_mb < 8192) total_mb -= 1024;
   res->total_memory = total_mb * DT_MEGA;
   res->cl_uni_memory = 0;
+  res->cache_per_thread = _get_cache_per_thread();
+  dt_print(DT_DEBUG_MEMORY | DT_DEBUG_DEV,
+    "  level 2 cache:   %luKB per thread%s",
+    (res->cache_per_thread ? res->cache_per_thread : DT_CACHE_PER_THREAD) / 1024lu,
+    res->cache_per_thread ? "" : " (assumed)");
 
   char *config_info = calloc(1, DT_PERF_INFOSIZE);
   if(last_configure_version != DT_CURRENT_PERFORMANCE_CONFIGURE_VERSION
@@ -1877,6 +2010,10 @@ int dt_init(int argc,
   }
 
   dt_get_sysresource_level();
+  _init_alloc_policy();
+  dt_thread_budget_init();
+  dt_masks_raster_cache_init();
+  dt_guided_filter_cache_init();
   res->mipmap_memory = _get_mipmap_size();
   dt_print(DT_DEBUG_MEMORY | DT_DEBUG_DEV,
     "  mipmap cache:    %luMB", res->mipmap_memory / DT_MEGA);
@@ -2262,6 +2399,8 @@ void dt_cleanup()
 
   dt_image_cache_cleanup();
   dt_mipmap_cache_cleanup();
+  dt_masks_raster_cache_cleanup();
+  dt_guided_filter_cache_cleanup();
 
   dt_colorspaces_cleanup(darktable.color_profiles);
 #ifdef HAVE_AI
@@ -2344,6 +2483,8 @@ void dt_cleanup()
 
   dt_capabilities_cleanup();
 
+  dt_trace_cleanup();
+
   if(darktable.tmp_directory)
     g_free(darktable.tmp_directory);
 
@@ -2388,6 +2529,98 @@ void dt_print_nts_ext(const char *msg, ...)
   fflush(stdout);
 }
 
+#ifdef __linux__
+#define DT_HUGEPAGE_BYTES (2lu * DT_MEGA)
+#ifndef MPOL_INTERLEAVE
+#define MPOL_INTERLEAVE 3
+#endif
+
+static void _apply_alloc_policy(void *ptr, const size_t size)
+{
+  const dt_alloc_policy_t *pol = &darktable.alloc_policy;
+#ifdef MADV_HUGEPAGE
+  if(pol->hugepages)
+    madvise(ptr, size, MADV_HUGEPAGE);
+#endif
+
+  if(pol->numa_nodes < 2) return;
+
+  if(pol->numa == DT_ALLOC_NUMA_INTERLEAVE)
+  {
+    const unsigned long mask = pol->numa_mask;
+    syscall(SYS_mbind, ptr, size, MPOL_INTERLEAVE, &mask,
+            CHAR_BIT * sizeof(mask) + 1, 0);
+  }
+  else if(pol->numa == DT_ALLOC_NUMA_FIRSTTOUCH)
+  {
+    // The pixel loops consuming these buffers are DT_OMP_FOR with
+    // static scheduling, so every thread works on one contiguous
+    // chunk of the buffer. Touching the pages with the very same
+    // partition makes the kernel place each chunk on the node of the
+    // thread that will use it.
+    const size_t pagesize = sysconf(_SC_PAGESIZE);
+    const size_t pages = size / pagesize;
+    char *const mem = (char *)ptr;
+    DT_OMP_FOR()
+    for(size_t p = 0; p < pages; p++)
+      mem[p * pagesize] = 0;
+  }
+}
+
+static void _init_alloc_policy(void)
+{
+  dt_alloc_policy_t *pol = &darktable.alloc_policy;
+  memset(pol, 0, sizeof(dt_alloc_policy_t));
+
+  // count the online nodes, the list is formatted like "0-1,3"
+  FILE *f = g_fopen("/sys/devices/system/node/online", "rb");
+  if(f)
+  {
+    char line[256] = { 0 };
+    if(fgets(line, sizeof(line), f))
+    {
+      char *c = line;
+      while(*c && *c != '\n')
+      {
+        char *end = NULL;
+        const long first = strtol(c, &end, 10);
+        if(end == c) break;
+        long last = first;
+        c = end;
+        if(*c == '-') last = strtol(c + 1, &c, 10);
+        for(long n = first; n <= last && n < (long)(CHAR_BIT * sizeof(unsigned long)); n++)
+        {
+          pol->numa_mask |= 1lu << n;
+          pol->numa_nodes++;
+        }
+        if(*c == ',') c++;
+      }
+    }
+    fclose(f);
+  }
+
+  const int threshold = dt_conf_get_int("memory_largebuffer_mb");
+  pol->threshold = threshold > 0 ? (size_t)threshold * DT_MEGA : 0;
+  pol->hugepages = dt_conf_get_bool("memory_hugepages");
+  const char *numa = dt_conf_get_string_const("memory_numa_policy");
+  pol->numa = !g_strcmp0(numa, "interleave")  ? DT_ALLOC_NUMA_INTERLEAVE
+            : !g_strcmp0(numa, "first touch") ? DT_ALLOC_NUMA_FIRSTTOUCH
+                                              : DT_ALLOC_NUMA_NONE;
+
+  dt_print(DT_DEBUG_MEMORY | DT_DEBUG_DEV,
+           "  large buffers:   from %zuMB, hugepages %s, %d numa node%s, %s",
+           pol->threshold / DT_MEGA,
+           pol->hugepages ? "on" : "off",
+           pol->numa_nodes, pol->numa_nodes == 1 ? "" : "s",
+           numa);
+}
+#else
+static void _init_alloc_policy(void)
+{
+  memset(&darktable.alloc_policy, 0, sizeof(dt_alloc_policy_t));
+}
+#endif
+
 void *dt_alloc_aligned(const size_t size)
 {
   const size_t alignment = DT_CACHELINE_BYTES;
@@ -2405,6 +2638,21 @@ void *dt_alloc_aligned(const size_t size)
   short *offset = (short*)(((char*)ptr) + alignment - sizeof(short));
   *offset = alignment;
   return ((char*)ptr) + alignment ;
+#elif defined(__linux__)
+  // large image buffers are aligned to hugepage boundaries so they can
+  // be backed by transparent hugepages and placed on numa nodes
+  const size_t threshold = darktable.alloc_policy.threshold;
+  const gboolean large = threshold && aligned_size >= threshold;
+  void *ptr = NULL;
+  if(large)
+  {
+    const size_t huge_size = dt_round_size(aligned_size, DT_HUGEPAGE_BYTES);
+    if(posix_memalign(&ptr, DT_HUGEPAGE_BYTES, huge_size)) return NULL;
+    _apply_alloc_policy(ptr, huge_size);
+    return ptr;
+  }
+  if(posix_memalign(&ptr, alignment, aligned_size)) return NULL;
+  return ptr;
 #else
   void *ptr = NULL;
   if(posix_memalign(&ptr, alignment, aligned_size)) return NULL;
@@ -148,6 +148,7 @@ G_BEGIN_DECLS
 #if __has_attribute(target_clones) && !defined(_WIN32) && !defined(NATIVE_ARCH) && !defined(__APPLE__) && defined(__GLIBC__)
 # if defined(__amd64__) || defined(__amd64) || defined(__x86_64__) || defined(__x86_64)
 #define __DT_CLONE_TARGETS__ __attribute__((target_clones("default", "sse2", "sse3", "sse4.1", "sse4.2", "popcnt", "avx", "avx2", "avx512f", "fma4")))
+#define __DT_CLONES_ENABLED__
 # elif defined(__PPC64__)
 /* __PPC64__ is the only macro tested for in is_supported_platform.h, other macros would fail there anyway. */
 #define __DT_CLONE_TARGETS__ __attribute__((target_clones("default","cpu=power9")))
@@ -267,8 +268,14 @@ char *dt_version_major_minor();
    a multiple of 8.
 
    Note: for the curious, if we calculate the tilesizes at runtime we loose the
-   performance gain as the compiler can't optimize that much.
+   performance gain as the compiler can't optimize that much. RCD is the
+   exception, its result doesn't depend on the tiles and it uses the largest
+   tile fitting the level 2 cache of a thread, DT_RCD_TILESIZE being the
+   smallest. The result of AMaZE changes slightly along its tile borders, so it
+   keeps a fixed size.
 */
+#define DT_CACHE_PER_THREAD (1024lu * 1024lu) // assumed if unknown
+
 #ifndef DT_RCD_TILESIZE
 #define DT_RCD_TILESIZE 112
 #endif
@@ -389,7 +396,8 @@ typedef enum dt_debug_thread_t
   DT_DEBUG_EXPOSE         = 1 << 26,
   DT_DEBUG_PICKER         = 1 << 27,
   DT_DEBUG_AI             = 1 << 28,
-  DT_DEBUG_ALL            = 0xffffffff & ~DT_DEBUG_VERBOSE,
+  DT_DEBUG_TRACE          = 1 << 29,
+  DT_DEBUG_ALL            = 0xffffffff & ~(DT_DEBUG_VERBOSE | DT_DEBUG_TRACE),
   DT_DEBUG_COMMON         = DT_DEBUG_OPENCL | DT_DEBUG_PARAMS | DT_DEBUG_IMAGEIO | DT_DEBUG_PIPE | DT_DEBUG_LUA | DT_DEBUG_AI,
   DT_DEBUG_RESTRICT       = DT_DEBUG_VERBOSE | DT_DEBUG_PERF,
 } dt_debug_thread_t;
@@ -397,6 +405,17 @@ typedef enum dt_debug_thread_t
 typedef struct dt_codepath_t
 {
   unsigned int _no_intrinsics : 1;
+  // cpu features as detected at startup, the functions marked with
+  // __DT_CLONE_TARGETS__ are dispatched on them by the loader
+  unsigned int sse2 : 1;
+  unsigned int sse4_1 : 1;
+  unsigned int avx : 1;
+  unsigned int avx2 : 1;
+  unsigned int fma : 1;
+  unsigned int avx512f : 1;
+  unsigned int neon : 1;
+  // name of the clone selected for __DT_CLONE_TARGETS__ functions
+  const char *clone_target;
 } dt_codepath_t;
 
 typedef struct dt_sys_resources_t
@@ -404,11 +423,28 @@ typedef struct dt_sys_resources_t
   size_t total_memory;
   size_t mipmap_memory;
   size_t cl_uni_memory;
+  size_t cache_per_thread; // level 2 cache per thread, 0 if unknown
   int *fractions;   // fractions are calculated as res=input / 1024  * fraction
   int *refresource; // for the debug resource modes we use fixed settings
   int level;
 } dt_sys_resources_t;
 
+typedef enum dt_alloc_numa_t
+{
+  DT_ALLOC_NUMA_NONE = 0,       // leave page placement to the kernel
+  DT_ALLOC_NUMA_FIRSTTOUCH = 1, // touch pages by the static openmp partition
+  DT_ALLOC_NUMA_INTERLEAVE = 2  // spread pages round-robin over all nodes
+} dt_alloc_numa_t;
+
+typedef struct dt_alloc_policy_t
+{
+  size_t threshold;     // large buffer policy is applied from this size on, 0 disables it
+  gboolean hugepages;   // advise the kernel to back large buffers by transparent hugepages
+  dt_alloc_numa_t numa;
+  int numa_nodes;
+  unsigned long numa_mask;
+} dt_alloc_policy_t;
+
 typedef struct dt_backthumb_t
 {
   double time;
@@ -502,6 +538,7 @@ typedef struct darktable_t
   GTimeZone *utc_tz;
   GDateTime *origin_gdt;
   struct dt_sys_resources_t dtresources;
+  struct dt_alloc_policy_t alloc_policy;
   struct dt_backthumb_t backthumbs;
   struct dt_gimp_t gimp;
   struct dt_splash_t splash;
@@ -797,6 +834,18 @@ static inline size_t dt_get_num_threads()
 #endif
 }
 
+// size of the openmp team the calling thread starts for a parallel
+// region. This follows the thread budget of the pipe or job while
+// dt_get_num_threads() is the upper limit for per-thread buffers.
+static inline size_t dt_get_team_threads()
+{
+#ifdef _OPENMP
+  return (size_t)CLAMP(omp_get_max_threads(), 1, darktable.num_openmp_threads);
+#else
+  return 1;
+#endif
+}
+
 static inline size_t dt_get_num_procs()
 {
 #ifdef _OPENMP
@@ -806,6 +855,13 @@ static inline size_t dt_get_num_procs()
 #endif
 }
 
+// the level 2 cache a thread can use for its working set
+static inline size_t dt_get_cache_per_thread()
+{
+  const size_t cache = darktable.dtresources.cache_per_thread;
+  return cache ? cache : DT_CACHE_PER_THREAD;
+}
+
 static inline int dt_get_thread_num()
 {
 #ifdef _OPENMP
@@ -24,6 +24,7 @@
 #include "common/file_location.h"
 #include "common/iop_order.h"
 #include "common/styles.h"
+#include "common/trace.h"
 #include "common/history.h"
 #include "common/metadata.h"
 #include "common/metadata.h"
@@ -4257,6 +4258,22 @@ gchar* _get_pragma_string_val(sqlite3 *db,
   return val;
 }
 
+// sqlite reports the statement runtime in nanoseconds when it has finished
+static int _trace_sql(unsigned int type,
+                      void *ctx,
+                      void *p,
+                      void *x)
+{
+  if(type == SQLITE_TRACE_PROFILE)
+  {
+    const double duration = 1e-9 * (double)*(sqlite3_int64 *)x;
+    const char *sql = sqlite3_sql((sqlite3_stmt *)p);
+    dt_trace_complete(DT_TRACE_SQL, dt_get_wtime() - duration, duration,
+                      sql ? sql : "?");
+  }
+  return 0;
+}
+
 dt_database_t *dt_database_init(const char *alternative,
                                 const gboolean load_data,
                                 const gboolean has_gui)
@@ -4405,6 +4422,9 @@ start:
     return NULL;
   }
 
+  if(dt_trace_active())
+    sqlite3_trace_v2(db->handle, SQLITE_TRACE_PROFILE, _trace_sql, NULL);
+
   /* attach a memory database to db connection for use with temporary tables
      used during instance life time, which is discarded on exit.
   */
@@ -196,309 +196,348 @@ error:
 }
 
 
-void dt_gaussian_blur(dt_gaussian_t *g, const float *const in, float *const out)
+// The recursive filter has a long dependency chain along every column
+// and row, so we run it on GAUSS_LANES independent floats at once.  In
+// the vertical pass these are neighbouring floats of a row, which fill
+// a cache line.  For the horizontal pass tiles of up to GAUSS_LANES rows
+// are transposed into a small buffer, one column of the tile per step
+// of the filter, in chunks of GAUSS_LANES floats padded with zeros.
+#define GAUSS_LANES 16
+#define GAUSS_TILE 32
+
+typedef struct _gauss_coeffs_t
 {
-
-  const int width = g->width;
-  const int height = g->height;
-  const int ch = MIN(4, g->channels); // just to appease zealous compiler warnings about stack usage
-
   float a0, a1, a2, a3, b1, b2, coefp, coefn;
+} _gauss_coeffs_t;
 
-  _compute_gauss_params(g->sigma, g->order, &a0, &a1, &a2, &a3, &b1, &b2, &coefp, &coefn);
+// state of the forward (xp, yb, yp) or the backward (xn, xa, yn, ya) filter
+typedef float DT_ALIGNED_ARRAY _gauss_state_t[4][GAUSS_LANES];
 
-  float *temp = g->buf;
+static inline void _forward_init(const float *const x,
+                                 const float *const lmin,
+                                 const float *const lmax,
+                                 const _gauss_coeffs_t *const c,
+                                 _gauss_state_t st)
+{
+  for(int k = 0; k < GAUSS_LANES; k++)
+  {
+    const float xk = x[k];
+    st[0][k] = CLAMPF(xk, lmin[k], lmax[k]);
+    st[1][k] = st[0][k] * c->coefp;
+    st[2][k] = st[1][k];
+  }
+}
 
-  float *Labmax = g->max;
-  float *Labmin = g->min;
+static inline void _backward_init(const float *const x,
+                                  const float *const lmin,
+                                  const float *const lmax,
+                                  const _gauss_coeffs_t *const c,
+                                  _gauss_state_t st)
+{
+  for(int k = 0; k < GAUSS_LANES; k++)
+  {
+    const float xk = x[k];
+    st[0][k] = CLAMPF(xk, lmin[k], lmax[k]);
+    st[1][k] = st[0][k];
+    st[2][k] = st[0][k] * c->coefn;
+    st[3][k] = st[2][k];
+  }
+}
 
-// vertical blur column by column
-  DT_OMP_FOR()
-  for(int i = 0; i < width; i++)
+// forward filter over n steps stride floats apart, storing the result
+__DT_CLONE_TARGETS__
+static void _forward(const float *const x,
+                     float *const y,
+                     const size_t n,
+                     const size_t stride,
+                     const float *const lmin,
+                     const float *const lmax,
+                     const _gauss_coeffs_t *const c,
+                     _gauss_state_t st)
+{
+  float DT_ALIGNED_ARRAY xp[GAUSS_LANES];
+  float DT_ALIGNED_ARRAY yb[GAUSS_LANES];
+  float DT_ALIGNED_ARRAY yp[GAUSS_LANES];
+  for(int k = 0; k < GAUSS_LANES; k++)
   {
-    dt_aligned_pixel_t xp = {0.0f};
-    dt_aligned_pixel_t yb = {0.0f};
-    dt_aligned_pixel_t yp = {0.0f};
+    xp[k] = st[0][k];
+    yb[k] = st[1][k];
+    yp[k] = st[2][k];
+  }
 
-    // forward filter
-    for(int k = 0; k < ch; k++)
+  for(size_t j = 0; j < n; j++)
+  {
+    const float *const xj = x + j * stride;
+    float *const yj = y + j * stride;
+    for(int k = 0; k < GAUSS_LANES; k++)
     {
-      xp[k] = CLAMPF(in[(size_t)i * ch + k], Labmin[k], Labmax[k]);
-      yb[k] = xp[k] * coefp;
-      yp[k] = yb[k];
+      // load first, conditional loads in the clamping would keep the
+      // loop from being vectorized
+      const float xk = xj[k];
+      const float mn = lmin[k];
+      const float mx = lmax[k];
+      const float xc = CLAMPF(xk, mn, mx);
+      const float yc = (c->a0 * xc) + (c->a1 * xp[k]) - (c->b1 * yp[k]) - (c->b2 * yb[k]);
+      yj[k] = yc;
+      xp[k] = xc;
+      yb[k] = yp[k];
+      yp[k] = yc;
     }
+  }
 
-    dt_aligned_pixel_t xc = {0.0f};
-    dt_aligned_pixel_t yc = {0.0f};
-    dt_aligned_pixel_t xn = {0.0f};
-    dt_aligned_pixel_t xa = {0.0f};
-    dt_aligned_pixel_t yn = {0.0f};
-    dt_aligned_pixel_t ya = {0.0f};
-    for(int j = 0; j < height; j++)
-    {
-      size_t offset = ((size_t)j * width + i) * ch;
-
-      for(int k = 0; k < ch; k++)
-      {
-        xc[k] = CLAMPF(in[offset + k], Labmin[k], Labmax[k]);
-        yc[k] = (a0 * xc[k]) + (a1 * xp[k]) - (b1 * yp[k]) - (b2 * yb[k]);
-
-        temp[offset + k] = yc[k];
+  for(int k = 0; k < GAUSS_LANES; k++)
+  {
+    st[0][k] = xp[k];
+    st[1][k] = yb[k];
+    st[2][k] = yp[k];
+  }
+}
 
-        xp[k] = xc[k];
-        yb[k] = yp[k];
-        yp[k] = yc[k];
-      }
-    }
+// backward filter over n steps stride floats apart, starting from the
+// last one and adding to the result of the forward filter
+__DT_CLONE_TARGETS__
+static void _backward(const float *const x,
+                      float *const y,
+                      const size_t n,
+                      const size_t stride,
+                      const float *const lmin,
+                      const float *const lmax,
+                      const _gauss_coeffs_t *const c,
+                      _gauss_state_t st)
+{
+  float DT_ALIGNED_ARRAY xn[GAUSS_LANES];
+  float DT_ALIGNED_ARRAY xa[GAUSS_LANES];
+  float DT_ALIGNED_ARRAY yn[GAUSS_LANES];
+  float DT_ALIGNED_ARRAY ya[GAUSS_LANES];
+  for(int k = 0; k < GAUSS_LANES; k++)
+  {
+    xn[k] = st[0][k];
+    xa[k] = st[1][k];
+    yn[k] = st[2][k];
+    ya[k] = st[3][k];
+  }
 
-    // backward filter
-    for(int k = 0; k < ch; k++)
+  for(size_t j = n; j > 0; j--)
+  {
+    const float *const xj = x + (j - 1) * stride;
+    float *const yj = y + (j - 1) * stride;
+    for(int k = 0; k < GAUSS_LANES; k++)
     {
-      xn[k] = CLAMPF(in[((size_t)(height - 1) * width + i) * ch + k], Labmin[k], Labmax[k]);
+      const float xk = xj[k];
+      const float mn = lmin[k];
+      const float mx = lmax[k];
+      const float xc = CLAMPF(xk, mn, mx);
+      const float yc = (c->a2 * xn[k]) + (c->a3 * xa[k]) - (c->b1 * yn[k]) - (c->b2 * ya[k]);
       xa[k] = xn[k];
-      yn[k] = xn[k] * coefn;
+      xn[k] = xc;
       ya[k] = yn[k];
-    }
-
-    for(int j = height - 1; j > -1; j--)
-    {
-      size_t offset = ((size_t)j * width + i) * ch;
-
-      for(int k = 0; k < ch; k++)
-      {
-        xc[k] = CLAMPF(in[offset + k], Labmin[k], Labmax[k]);
-
-        yc[k] = (a2 * xn[k]) + (a3 * xa[k]) - (b1 * yn[k]) - (b2 * ya[k]);
-
-        xa[k] = xn[k];
-        xn[k] = xc[k];
-        ya[k] = yn[k];
-        yn[k] = yc[k];
-
-        temp[offset + k] += yc[k];
-      }
+      yn[k] = yc;
+      yj[k] += yc;
     }
   }
 
-// horizontal blur line by line
-  DT_OMP_FOR()
-  for(int j = 0; j < height; j++)
+  for(int k = 0; k < GAUSS_LANES; k++)
   {
-    dt_aligned_pixel_t xp = {0.0f};
-    dt_aligned_pixel_t yb = {0.0f};
-    dt_aligned_pixel_t yp = {0.0f};
-
-    // forward filter
-    for(int k = 0; k < ch; k++)
-    {
-      xp[k] = CLAMPF(temp[(size_t)j * width * ch + k], Labmin[k], Labmax[k]);
-      yb[k] = xp[k] * coefp;
-      yp[k] = yb[k];
-    }
-
-    dt_aligned_pixel_t xc = {0.0f};
-    dt_aligned_pixel_t yc = {0.0f};
-    dt_aligned_pixel_t xn = {0.0f};
-    dt_aligned_pixel_t xa = {0.0f};
-    dt_aligned_pixel_t yn = {0.0f};
-    dt_aligned_pixel_t ya = {0.0f};
+    st[0][k] = xn[k];
+    st[1][k] = xa[k];
+    st[2][k] = yn[k];
+    st[3][k] = ya[k];
+  }
+}
 
-    for(int i = 0; i < width; i++)
-    {
-      size_t offset = ((size_t)j * width + i) * ch;
+// copy n runs of glen floats, sstep floats apart in src and dstep in dst
+static inline void _copy_runs(const float *const src,
+                              float *const dst,
+                              const size_t sstep,
+                              const size_t dstep,
+                              const int n,
+                              const int glen)
+{
+  for(int i = 0; i < n; i++)
+    for(int k = 0; k < glen; k++)
+      dst[i * dstep + k] = src[i * sstep + k];
+}
 
-      for(int k = 0; k < ch; k++)
-      {
-        xc[k] = CLAMPF(temp[offset + k], Labmin[k], Labmax[k]);
-        yc[k] = (a0 * xc[k]) + (a1 * xp[k]) - (b1 * yp[k]) - (b2 * yb[k]);
+// the runs are a pixel or less in the horizontal pass, spell out these
+// lengths so that the copies don't go through a generic loop
+static inline void _copy_pixels(const float *const src,
+                                float *const dst,
+                                const size_t sstep,
+                                const size_t dstep,
+                                const int n,
+                                const int glen)
+{
+  switch(glen)
+  {
+    case 1:
+      _copy_runs(src, dst, sstep, dstep, n, 1);
+      break;
+    case 2:
+      _copy_runs(src, dst, sstep, dstep, n, 2);
+      break;
+    case 3:
+      _copy_runs(src, dst, sstep, dstep, n, 3);
+      break;
+    case 4:
+      _copy_runs(src, dst, sstep, dstep, n, 4);
+      break;
+    default:
+      _copy_runs(src, dst, sstep, dstep, n, glen);
+      break;
+  }
+}
 
-        out[offset + k] = yc[k];
+// Copy steps t0..t0+tc of ng groups of glen floats into the tile, the
+// groups gstride floats and the steps sstride floats apart.  Step i of
+// the tile starts at i * tstride.
+static inline void _tile_load(const float *const in,
+                              float *const tile,
+                              const int ng,
+                              const int glen,
+                              const size_t gstride,
+                              const size_t sstride,
+                              const int tstride,
+                              const size_t t0,
+                              const int tc)
+{
+  for(int g = 0; g < ng; g++)
+    _copy_pixels(in + g * gstride + t0 * sstride, tile + g * glen, sstride, tstride, tc, glen);
+}
 
-        xp[k] = xc[k];
-        yb[k] = yp[k];
-        yp[k] = yc[k];
-      }
-    }
+static inline void _tile_store(const float *const tile,
+                               float *const out,
+                               const int ng,
+                               const int glen,
+                               const size_t gstride,
+                               const size_t sstride,
+                               const int tstride,
+                               const size_t t0,
+                               const int tc)
+{
+  for(int g = 0; g < ng; g++)
+    _copy_pixels(tile + g * glen, out + g * gstride + t0 * sstride, tstride, sstride, tc, glen);
+}
 
-    // backward filter
-    for(int k = 0; k < ch; k++)
+// Filter n steps of ng groups of glen floats through transposed tiles,
+// see _tile_load() for the layout.  Lane k of the tile is clamped by
+// lmin[k % ch] and lmax[k % ch].
+__DT_CLONE_TARGETS__
+static void _blur_tiled(const float *const in,
+                        float *const out,
+                        const size_t n,
+                        const int ng,
+                        const int glen,
+                        const size_t gstride,
+                        const size_t sstride,
+                        const int ch,
+                        const float *const lmin,
+                        const float *const lmax,
+                        const _gauss_coeffs_t *const c)
+{
+  // the output tile is offset by a cache line from the input tile, loads
+  // 4 KiB apart from stores are serialized by many CPUs
+  float DT_ALIGNED_ARRAY buf[2 * GAUSS_TILE * GAUSS_LANES * 4 + GAUSS_LANES];
+  float *const x = buf;
+  float *const y = buf + GAUSS_TILE * GAUSS_LANES * 4 + GAUSS_LANES;
+  _gauss_state_t st[4];
+  const int nchunks = (ng * glen + GAUSS_LANES - 1) / GAUSS_LANES;
+  const int tstride = nchunks * GAUSS_LANES;
+
+  // the padding lanes are filtered as well, keep them finite.  Those of
+  // the output are set by the forward filter before they are read.
+  if(ng * glen < tstride)
+    memset(x, 0, sizeof(float) * GAUSS_TILE * tstride);
+
+  for(size_t t0 = 0; t0 < n; t0 += GAUSS_TILE)
+  {
+    const int tc = MIN(GAUSS_TILE, n - t0);
+    _tile_load(in, x, ng, glen, gstride, sstride, tstride, t0, tc);
+    for(int k = 0; k < nchunks; k++)
     {
-      xn[k] = CLAMPF(temp[((size_t)(j + 1) * width - 1) * ch + k], Labmin[k], Labmax[k]);
-      xa[k] = xn[k];
-      yn[k] = xn[k] * coefn;
-      ya[k] = yn[k];
+      const int k0 = k * GAUSS_LANES;
+      if(t0 == 0) _forward_init(x + k0, lmin + k0 % ch, lmax + k0 % ch, c, st[k]);
+      _forward(x + k0, y + k0, tc, tstride, lmin + k0 % ch, lmax + k0 % ch, c, st[k]);
     }
+    _tile_store(y, out, ng, glen, gstride, sstride, tstride, t0, tc);
+  }
 
-    for(int i = width - 1; i > -1; i--)
+  const size_t last = ((n - 1) / GAUSS_TILE) * GAUSS_TILE;
+  for(size_t t1 = last + GAUSS_TILE; t1 > 0; t1 -= GAUSS_TILE)
+  {
+    const size_t t0 = t1 - GAUSS_TILE;
+    const int tc = MIN(GAUSS_TILE, n - t0);
+    _tile_load(in, x, ng, glen, gstride, sstride, tstride, t0, tc);
+    _tile_load(out, y, ng, glen, gstride, sstride, tstride, t0, tc);
+    for(int k = 0; k < nchunks; k++)
     {
-      size_t offset = ((size_t)j * width + i) * ch;
-
-      for(int k = 0; k < ch; k++)
-      {
-        xc[k] = CLAMPF(temp[offset + k], Labmin[k], Labmax[k]);
-
-        yc[k] = (a2 * xn[k]) + (a3 * xa[k]) - (b1 * yn[k]) - (b2 * ya[k]);
-
-        xa[k] = xn[k];
-        xn[k] = xc[k];
-        ya[k] = yn[k];
-        yn[k] = yc[k];
-
-        out[offset + k] += yc[k];
-      }
+      const int k0 = k * GAUSS_LANES;
+      if(t0 == last)
+        _backward_init(x + (tc - 1) * tstride + k0, lmin + k0 % ch, lmax + k0 % ch, c, st[k]);
+      _backward(x + k0, y + k0, tc, tstride, lmin + k0 % ch, lmax + k0 % ch, c, st[k]);
     }
+    _tile_store(y, out, ng, glen, gstride, sstride, tstride, t0, tc);
   }
 }
 
-void dt_gaussian_blur_4c(dt_gaussian_t *g, const float *const in, float *const out)
+static void _gaussian_blur(const dt_gaussian_t *const g,
+                           const float *const in,
+                           float *const out,
+                           const int ch)
 {
-  assert(g->channels == 4);
   const size_t width = g->width;
   const size_t height = g->height;
 
-  float a0, a1, a2, a3, b1, b2, coefp, coefn;
+  _gauss_coeffs_t c;
+  _compute_gauss_params(g->sigma, g->order, &c.a0, &c.a1, &c.a2, &c.a3, &c.b1, &c.b2,
+                        &c.coefp, &c.coefn);
 
-  _compute_gauss_params(g->sigma, g->order, &a0, &a1, &a2, &a3, &b1, &b2, &coefp, &coefn);
+  // clamping bounds of GAUSS_LANES lanes starting at any channel
+  float DT_ALIGNED_ARRAY lmin[GAUSS_LANES + 4];
+  float DT_ALIGNED_ARRAY lmax[GAUSS_LANES + 4];
+  for(int k = 0; k < GAUSS_LANES + 4; k++)
+  {
+    lmin[k] = g->min[k % ch];
+    lmax[k] = g->max[k % ch];
+  }
 
   float *const temp = g->buf;
+  const size_t stride = width * ch;
+  const size_t full = stride - stride % GAUSS_LANES;
 
-  dt_aligned_pixel_t Labmin, Labmax;
-  copy_pixel(Labmin, g->min);
-  copy_pixel(Labmax, g->max);
-
-// vertical blur column by column
+  // vertical blur, GAUSS_LANES floats of the rows at once, the few
+  // remaining ones through a tile
   DT_OMP_FOR()
-  for(size_t i = 0; i < width; i++)
+  for(size_t i = 0; i < stride; i += GAUSS_LANES)
   {
-    // forward filter
-    dt_aligned_pixel_t xp;
-    dt_aligned_pixel_t yb;
-    dt_aligned_pixel_t yp;
-    for_four_channels(k)
-    {
-      xp[k] = CLAMPF(in[4*i + k], Labmin[k], Labmax[k]);
-      yb[k] = xp[k] * coefp;
-      yp[k] = yb[k];
-    }
-
-    dt_aligned_pixel_t xc;
-    dt_aligned_pixel_t xn;
-    dt_aligned_pixel_t xa;
-    for(size_t j = 0; j < height; j++)
+    if(i < full)
     {
-      size_t offset = 4 * (j * width + i);
-
-      dt_aligned_pixel_t yc;
-      for_four_channels(k)
-      {
-        xc[k] = CLAMPF(in[offset + k], Labmin[k], Labmax[k]);
-        yc[k] = (a0 * xc[k]) + (a1 * xp[k]) - (b1 * yp[k]) - (b2 * yb[k]);
-
-        xp[k] = xc[k];
-        yb[k] = yp[k];
-        yp[k] = yc[k];
-      }
-      copy_pixel(temp + offset, yc);
-    }
-
-    // backward filter
-    dt_aligned_pixel_t yn;
-    dt_aligned_pixel_t ya;
-    for_four_channels(k)
-    {
-      xn[k] = CLAMPF(in[4*((height - 1) * width + i) + k], Labmin[k], Labmax[k]);
-      xa[k] = xn[k];
-      yn[k] = xn[k] * coefn;
-      ya[k] = yn[k];
-    }
-
-    for(size_t j = height; j > 0; j--)
-    {
-      size_t offset = 4 * ((j-1) * width + i);
-
-      dt_aligned_pixel_t yc;
-      for_four_channels(k)
-      {
-        xc[k] = CLAMPF(in[offset + k], Labmin[k], Labmax[k]);
-
-        yc[k] = (a2 * xn[k]) + (a3 * xa[k]) - (b1 * yn[k]) - (b2 * ya[k]);
-
-        xa[k] = xn[k];
-        xn[k] = xc[k];
-        ya[k] = yn[k];
-        yn[k] = yc[k];
-        temp[offset + k] += yc[k];
-      }
+      _gauss_state_t st;
+      _forward_init(in + i, lmin + i % ch, lmax + i % ch, &c, st);
+      _forward(in + i, temp + i, height, stride, lmin + i % ch, lmax + i % ch, &c, st);
+      _backward_init(in + i + (height - 1) * stride, lmin + i % ch, lmax + i % ch, &c, st);
+      _backward(in + i, temp + i, height, stride, lmin + i % ch, lmax + i % ch, &c, st);
     }
+    else
+      _blur_tiled(in + i, temp + i, height, 1, stride - i, 0, stride, ch,
+                  lmin + i % ch, lmax + i % ch, &c);
   }
 
-// horizontal blur line by line
+  // horizontal blur, GAUSS_LANES rows at once
   DT_OMP_FOR()
-  for(size_t j = 0; j < height; j++)
-  {
-    // forward filter
-    dt_aligned_pixel_t xp;
-    dt_aligned_pixel_t yb;
-    dt_aligned_pixel_t yp;
-    dt_aligned_pixel_t xc;
-    for_four_channels(k)
-    {
-      xp[k] = CLAMPF(temp[4*(j * width) + k], Labmin[k], Labmax[k]);
-      yb[k] = xp[k] * coefp;
-      yp[k] = yb[k];
-    }
-
-    for(size_t i = 0; i < width; i++)
-    {
-      size_t offset = 4 * (j * width + i);
-      dt_aligned_pixel_t yc;
-
-      for_four_channels(k)
-      {
-        xc[k] = CLAMPF(temp[offset + k], Labmin[k], Labmax[k]);
-        yc[k] = (a0 * xc[k]) + (a1 * xp[k]) - (b1 * yp[k]) - (b2 * yb[k]);
-
-        out[offset + k] = yc[k];
-
-        xp[k] = xc[k];
-        yb[k] = yp[k];
-        yp[k] = yc[k];
-      }
-    }
-
-    // backward filter
-    dt_aligned_pixel_t xn;
-    dt_aligned_pixel_t xa;
-    dt_aligned_pixel_t ya;
-    dt_aligned_pixel_t yn;
-    for_four_channels(k)
-    {
-      xn[k] = CLAMPF(temp[4*((j + 1) * width - 1) + k], Labmin[k], Labmax[k]);
-      xa[k] = xn[k];
-      yn[k] = xn[k] * coefn;
-      ya[k] = yn[k];
-    }
-
-    for(int i = width - 1; i > -1; i--)
-    {
-      size_t offset = 4 * (j * width + i);
-
-      dt_aligned_pixel_t yc;
-      for_four_channels(k)
-      {
-        xc[k] = CLAMPF(temp[offset + k], Labmin[k], Labmax[k]);
-
-        yc[k] = (a2 * xn[k]) + (a3 * xa[k]) - (b1 * yn[k]) - (b2 * ya[k]);
+  for(size_t j = 0; j < height; j += GAUSS_LANES)
+    _blur_tiled(temp + j * stride, out + j * stride, width, MIN(GAUSS_LANES, height - j), ch,
+                stride, ch, ch, lmin, lmax, &c);
+}
 
-        xa[k] = xn[k];
-        xn[k] = xc[k];
-        ya[k] = yn[k];
-        yn[k] = yc[k];
+void dt_gaussian_blur(dt_gaussian_t *g, const float *const in, float *const out)
+{
+  _gaussian_blur(g, in, out, MIN(4, g->channels));
+}
 
-        out[offset + k] += yc[k];
-      }
-    }
-  }
+void dt_gaussian_blur_4c(dt_gaussian_t *g, const float *const in, float *const out)
+{
+  assert(g->channels == 4);
+  _gaussian_blur(g, in, out, 4);
 }
 
 void dt_gaussian_free(dt_gaussian_t *g)
@@ -0,0 +1,179 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+  Cache of guided filter results, shared by all pipes.
+
+  Modules like tone equalizer and color equalizer smooth a guide derived
+  from their input with a guided filter before applying their corrections.
+  The guide only depends on the module input and a few of the module
+  parameters, so changing the corrections, as when dragging a slider,
+  would compute the same result again and again.
+
+  An entry is keyed by the hash of the modules in front of the module,
+  which describes its input independent of the pipe, the pipe input
+  size and scale, the roi and the parameters passed by the module.
+  Both canvas pipes share their entries, the preview pipe keeps its own
+  as it might process its input differently.
+
+  Only the darkroom pipes use the cache. Entries are dropped least
+  recently used first once the memory set with the guided_filter_cache
+  config key (in MB) is used up.
+*/
+
+#include "common/darktable.h"
+#include "common/debug.h"
+#include "common/guided_filter_cache.h"
+#include "control/conf.h"
+#include "develop/imageop.h"
+#include "develop/pixelpipe.h"
+
+typedef struct _result_t
+{
+  dt_hash_t key;
+  size_t nfloats;
+  float *buf;
+  size_t size;
+} _result_t;
+
+static GList *_results = NULL; // most recently used first
+static size_t _used = 0;
+static size_t _budget = 0;
+static dt_pthread_mutex_t _lock;
+
+void dt_guided_filter_cache_init(void)
+{
+  dt_pthread_mutex_init(&_lock, NULL);
+  _budget = (size_t)MAX(0, dt_conf_get_int("guided_filter_cache")) * DT_MEGA;
+}
+
+static void _result_free(gpointer data)
+{
+  _result_t *r = data;
+  dt_free_align(r->buf);
+  free(r);
+}
+
+void dt_guided_filter_cache_cleanup(void)
+{
+  g_list_free_full(_results, _result_free);
+  _results = NULL;
+  _used = 0;
+  dt_pthread_mutex_destroy(&_lock);
+}
+
+dt_hash_t dt_guided_filter_cache_key(dt_dev_pixelpipe_iop_t *piece,
+                                     const dt_iop_roi_t *const roi,
+                                     const void *const params,
+                                     const size_t size)
+{
+  dt_dev_pixelpipe_t *pipe = piece->pipe;
+  if(!_budget || !dt_pipe_is_screen(pipe)) return DT_INVALID_HASH;
+
+  const uint32_t type = (pipe->type & DT_DEV_PIXELPIPE_CANVAS
+                         ? DT_DEV_PIXELPIPE_CANVAS
+                         : pipe->type & DT_DEV_PIXELPIPE_PREVIEW)
+                        | (pipe->type & DT_DEV_PIXELPIPE_FAST);
+
+  dt_hash_t hash = dt_dev_pixelpipe_piece_hash(piece, NULL, FALSE);
+  hash = dt_hash(hash, &type, sizeof(type));
+  hash = dt_hash(hash, &piece->module->iop_order, sizeof(piece->module->iop_order));
+  hash = dt_hash(hash, &pipe->iwidth, sizeof(pipe->iwidth));
+  hash = dt_hash(hash, &pipe->iheight, sizeof(pipe->iheight));
+  hash = dt_hash(hash, &pipe->iscale, sizeof(pipe->iscale));
+  hash = dt_hash(hash, roi, sizeof(dt_iop_roi_t));
+  hash = dt_hash(hash, params, size);
+  return hash;
+}
+
+gboolean dt_guided_filter_cache_get(const dt_hash_t key,
+                                    float *const buffer,
+                                    const size_t nfloats)
+{
+  if(key == DT_INVALID_HASH) return FALSE;
+
+  gboolean found = FALSE;
+  dt_pthread_mutex_lock(&_lock);
+  for(GList *l = _results; l; l = g_list_next(l))
+  {
+    const _result_t *r = l->data;
+    if(r->key != key || r->nfloats != nfloats) continue;
+    memcpy(buffer, r->buf, sizeof(float) * nfloats);
+    _results = g_list_remove_link(_results, l);
+    _results = g_list_concat(l, _results);
+    found = TRUE;
+    break;
+  }
+  dt_pthread_mutex_unlock(&_lock);
+
+  if(found)
+    dt_print(DT_DEBUG_PIPE | DT_DEBUG_PERF, "[guided filter cache] hit for %zu values", nfloats);
+  return found;
+}
+
+void dt_guided_filter_cache_put(const dt_hash_t key,
+                                const float *const buffer,
+                                const size_t nfloats)
+{
+  const size_t size = sizeof(_result_t) + sizeof(float) * nfloats;
+  if(key == DT_INVALID_HASH || size > _budget) return;
+
+  _result_t *r = calloc(1, sizeof(_result_t));
+  if(!r) return;
+  r->buf = dt_alloc_align_float(nfloats);
+  if(!r->buf)
+  {
+    free(r);
+    return;
+  }
+  memcpy(r->buf, buffer, sizeof(float) * nfloats);
+  r->key = key;
+  r->nfloats = nfloats;
+  r->size = size;
+
+  dt_pthread_mutex_lock(&_lock);
+  // another pipe might have computed the same in the meantime
+  for(GList *l = _results; l; l = g_list_next(l))
+  {
+    _result_t *old = l->data;
+    if(old->key == key)
+    {
+      _used -= old->size;
+      _result_free(old);
+      _results = g_list_delete_link(_results, l);
+      break;
+    }
+  }
+  _results = g_list_prepend(_results, r);
+  _used += r->size;
+  while(_used > _budget)
+  {
+    GList *last = g_list_last(_results);
+    _result_t *old = last->data;
+    _used -= old->size;
+    _result_free(old);
+    _results = g_list_delete_link(_results, last);
+  }
+  dt_pthread_mutex_unlock(&_lock);
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
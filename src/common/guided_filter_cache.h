@@ -0,0 +1,54 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "common/darktable.h"
+#include "develop/pixelpipe.h"
+
+G_BEGIN_DECLS
+
+/** cache of guided filter results shared by all pipes, see common/guided_filter_cache.c */
+void dt_guided_filter_cache_init(void);
+void dt_guided_filter_cache_cleanup(void);
+
+/** key of a filter result computed by the module of piece from its input
+ * in roi, params holds everything else the result depends on. returns
+ * DT_INVALID_HASH if the result should not be cached */
+dt_hash_t dt_guided_filter_cache_key(dt_dev_pixelpipe_iop_t *piece,
+                                     const dt_iop_roi_t *const roi,
+                                     const void *const params,
+                                     const size_t size);
+
+/** copy the cached result of key into buffer, FALSE if there is none of nfloats */
+gboolean dt_guided_filter_cache_get(const dt_hash_t key,
+                                    float *const buffer,
+                                    const size_t nfloats);
+
+/** keep a copy of the result of key */
+void dt_guided_filter_cache_put(const dt_hash_t key,
+                                const float *const buffer,
+                                const size_t nfloats);
+
+G_END_DECLS
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -19,12 +19,27 @@
 #ifndef DT_DEVELOP_HEAL_H
 #define DT_DEVELOP_HEAL_H
 
+typedef enum dt_heal_solver_t
+{
+  DT_HEAL_SOLVER_SOR = 0,       // red/black Gauss-Seidel with over-relaxation
+  DT_HEAL_SOLVER_MULTIGRID = 1, // multigrid V-cycles with red/black Gauss-Seidel smoothing
+} dt_heal_solver_t;
+
 /* heals dest_buffer using src_buffer as a reference and mask_buffer to define the area to be healed
  * the 3 buffers must have the same size, but mask_buffer is 1 channel and is tested for != 0.f
+ * uses the solver set in plugins/darkroom/retouch/heal_solver
  */
 void dt_heal(const float *const src_buffer, float *dest_buffer, const float *const mask_buffer, const int width,
              const int height, const int ch, const int max_iter);
 
+/* same as dt_heal() with the given solver, max_iter counts sweeps for SOR and V-cycles for multigrid */
+void dt_heal_solve(const float *const src_buffer, float *dest_buffer, const float *const mask_buffer,
+                   const int width, const int height, const int ch, const int max_iter,
+                   const dt_heal_solver_t solver);
+
+/* the solver used by dt_heal() */
+dt_heal_solver_t dt_heal_get_solver(void);
+
 #ifdef HAVE_OPENCL
 
 typedef struct dt_heal_cl_global_t
@@ -159,7 +159,7 @@ void dt_iop_image_copy(float *const __restrict__ out,
     // (basically, each core can saturate a memory channel, so a
     // system with quad-channel memory won't be able to take advantage
     // of more than four cores).
-    const int nthreads = MIN(dt_get_num_threads(), parallel_imgop_maxthreads);
+    const int nthreads = MIN(dt_get_team_threads(), parallel_imgop_maxthreads);
     // determine the number of 4-float vectors to be processed by each thread
     const size_t chunksize = (((nfloats + nthreads - 1) / nthreads) + 3) / 4;
     DT_OMP_FOR(num_threads(nthreads))
@@ -253,7 +253,7 @@ void dt_iop_image_scaled_copy(float *const restrict buf,
     // (basically, each core can saturate a memory channel, so a
     // system with quad-channel memory won't be able to take advantage
     // of more than four cores).
-    const int nthreads = MIN(dt_get_num_threads(), parallel_imgop_maxthreads);
+    const int nthreads = MIN(dt_get_team_threads(), parallel_imgop_maxthreads);
     DT_OMP_FOR_SIMD(num_threads(nthreads) aligned(buf, src : 16))
     for(size_t k = 0; k < nfloats; k++)
       buf[k] = scale * src[k];
@@ -276,7 +276,7 @@ void dt_iop_image_fill(float *const buf,
 #ifdef _OPENMP
   if(nfloats > parallel_imgop_minimum)	// is the copy big enough to outweigh threading overhead?
   {
-    const size_t nthreads = MIN(16, dt_get_num_threads());
+    const size_t nthreads = MIN(16, dt_get_team_threads());
     // determine the number of 4-float vectors to be processed by each thread
     const size_t chunksize = (((nfloats + nthreads - 1) / nthreads) + 3) / 4;
     DT_OMP_FOR(num_threads(nthreads))
@@ -323,7 +323,7 @@ void dt_iop_image_add_const(float *const buf,
     // (basically, each core can saturate a memory channel, so a
     // system with quad-channel memory won't be able to take advantage
     // of more than four cores).
-    const int nthreads = MIN(dt_get_num_threads(), parallel_imgop_maxthreads);
+    const int nthreads = MIN(dt_get_team_threads(), parallel_imgop_maxthreads);
     DT_OMP_FOR_SIMD(num_threads(nthreads))
     for(size_t k = 0; k < nfloats; k++)
       buf[k] += add_value;
@@ -351,7 +351,7 @@ void dt_iop_image_add_image(float *const buf,
     // (basically, each core can saturate a memory channel, so a
     // system with quad-channel memory won't be able to take advantage
     // of more than four cores).
-    const int nthreads = MIN(dt_get_num_threads(), parallel_imgop_maxthreads);
+    const int nthreads = MIN(dt_get_team_threads(), parallel_imgop_maxthreads);
     DT_OMP_FOR_SIMD(num_threads(nthreads) aligned(buf, other_image : 16))
     for(size_t k = 0; k < nfloats; k++)
       buf[k] += other_image[k];
@@ -379,7 +379,7 @@ void dt_iop_image_sub_image(float *const buf,
     // (basically, each core can saturate a memory channel, so a
     // system with quad-channel memory won't be able to take advantage
     // of more than four cores).
-    const int nthreads = MIN(dt_get_num_threads(), parallel_imgop_maxthreads);
+    const int nthreads = MIN(dt_get_team_threads(), parallel_imgop_maxthreads);
     DT_OMP_FOR_SIMD(num_threads(nthreads) aligned(buf, other_image : 16))
     for(size_t k = 0; k < nfloats; k++)
       buf[k] -= other_image[k];
@@ -407,7 +407,7 @@ void dt_iop_image_invert(float *const buf,
     // (basically, each core can saturate a memory channel, so a
     // system with quad-channel memory won't be able to take advantage
     // of more than four cores).
-    const int nthreads = MIN(dt_get_num_threads(), parallel_imgop_maxthreads);
+    const int nthreads = MIN(dt_get_team_threads(), parallel_imgop_maxthreads);
     DT_OMP_FOR_SIMD(num_threads(nthreads) aligned(buf:16))
     for(size_t k = 0; k < nfloats; k++)
       buf[k] = max_value - buf[k];
@@ -435,7 +435,7 @@ void dt_iop_image_mul_const(float *const buf,
     // (basically, each core can saturate a memory channel, so a
     // system with quad-channel memory won't be able to take advantage
     // of more than four cores).
-    const int nthreads = MIN(dt_get_num_threads(), parallel_imgop_maxthreads);
+    const int nthreads = MIN(dt_get_team_threads(), parallel_imgop_maxthreads);
     DT_OMP_FOR_SIMD(num_threads(nthreads) aligned(buf:16))
     for(size_t k = 0; k < nfloats; k++)
       buf[k] *= mul_value;
@@ -466,7 +466,7 @@ void dt_iop_image_linear_blend(float *const restrict buf,
     // (basically, each core can saturate a memory channel, so a
     // system with quad-channel memory won't be able to take advantage
     // of more than four cores).
-    const int nthreads = MIN(dt_get_num_threads(), parallel_imgop_maxthreads);
+    const int nthreads = MIN(dt_get_team_threads(), parallel_imgop_maxthreads);
     DT_OMP_FOR_SIMD(num_threads(nthreads) aligned(buf:16))
     for(size_t k = 0; k < nfloats; k++)
       buf[k] = lambda*buf[k] + lambda_1*other[k];
@@ -979,6 +979,7 @@ static gboolean _prepare_resampling_plan(const dt_interpolation_t *itor,
 /** Applies resampling (re-scaling) on *full* input and output buffers.
  *  roi_in and roi_out define the part of the buffers that is affected.
  */
+__DT_CLONE_TARGETS__
 void dt_interpolation_resample(const dt_interpolation_t *itor,
                                float *out,
                                const dt_iop_roi_t *const roi_out,
@@ -1054,72 +1055,102 @@ void dt_interpolation_resample(const dt_interpolation_t *itor,
                               &vlength, &vkernel, &vindex, &vmeta))
     goto exit;
 
+  // The filter is separable: every input line is resampled horizontally
+  // once into a ring of lines per thread, then the output lines are
+  // combined from the ring.  Output lines of a thread are consecutive
+  // and need overlapping input lines, a line is only recomputed when
+  // its slot in the ring has been reused in the meantime.  The ring
+  // must hold all input lines of one output line at once.
+  int ringlines = 1;
+  for(int oy = 0; oy < roi_out->height; oy++)
+  {
+    const int *const vi = vindex + vmeta[3 * oy + 2];
+    const int vl = vlength[vmeta[3 * oy + 0]];
+    int lo = vi[0], hi = vi[0];
+    for(int iy = 1; iy < vl; iy++)
+    {
+      lo = MIN(lo, vi[iy]);
+      hi = MAX(hi, vi[iy]);
+    }
+    ringlines = MAX(ringlines, hi - lo + 1);
+  }
+
+  size_t ringsize, tagsize;
+  float *const ring = dt_alloc_perthread_float((size_t)ringlines * out_stride_floats, &ringsize);
+  int *const tags = dt_alloc_perthread(ringlines, sizeof(int), &tagsize);
+  if(!ring || !tags)
+  {
+    dt_print(DT_DEBUG_ALWAYS, "[dt_interpolation_resample] unable to allocate %d lines of %d pixels",
+             ringlines, roi_out->width);
+    dt_free_align(ring);
+    dt_free_align(tags);
+    goto exit;
+  }
+  for(size_t k = 0; k < tagsize * dt_get_num_threads(); k++)
+    tags[k] = -1;
+
   dt_get_perf_times(&mid);
 
   // Process each output line
   DT_OMP_FOR()
   for(size_t oy = 0; oy < (size_t)roi_out->height; oy++)
   {
-    // Initialize column resampling indexes
-    int vlidx = vmeta[3 * oy + 0]; // V(ertical) L(ength) I(n)d(e)x
-    int vkidx = vmeta[3 * oy + 1]; // V(ertical) K(ernel) I(n)d(e)x
-    int viidx = vmeta[3 * oy + 2]; // V(ertical) I(ndex) I(n)d(e)x
+    float *const lines = dt_get_perthread(ring, ringsize);
+    int *const linetag = dt_get_perthread(tags, tagsize);
 
-    // Initialize row resampling indexes
-    int hlidx = 0; // H(orizontal) L(ength) I(n)d(e)x
-    int hkidx = 0; // H(orizontal) K(ernel) I(n)d(e)x
+    // Initialize column resampling indexes
+    const int vlidx = vmeta[3 * oy + 0]; // V(ertical) L(ength) I(n)d(e)x
+    const int vkidx = vmeta[3 * oy + 1]; // V(ertical) K(ernel) I(n)d(e)x
+    const int viidx = vmeta[3 * oy + 2]; // V(ertical) I(ndex) I(n)d(e)x
 
     // Number of lines contributing to the output line
-    const int vl = vlength[vlidx++]; // V(ertical) L(ength)
+    const int vl = vlength[vlidx];
 
-    // Process each output column
-    for(size_t ox = 0; ox < (size_t)roi_out->width; ox++)
+    // Make sure all contributing lines have been resampled horizontally
+    for(int iy = 0; iy < vl; iy++)
     {
-      // This will hold the resulting pixel
-      dt_aligned_pixel_t vs = { 0.0f, 0.0f, 0.0f, 0.0f };
-
-      // Number of horizontal samples contributing to the output
-      const int hl = hlength[hlidx++]; // H(orizontal) L(ength)
-
-      for(size_t iy = 0; iy < vl; iy++)
+      const int line = vindex[viidx + iy];
+      const int slot = line % ringlines;
+      if(linetag[slot] == line) continue;
+      linetag[slot] = line;
+
+      const float *const inrow = in + (size_t)line * in_stride_floats;
+      float *const hrow = lines + (size_t)slot * out_stride_floats;
+      int hkidx = 0; // H(orizontal) K(ernel) I(n)d(e)x
+      for(size_t ox = 0; ox < (size_t)roi_out->width; ox++)
       {
-        // This is our input line
-        const size_t baseidx_vindex = (size_t)vindex[viidx++] * in_stride_floats;
+        // Number of horizontal samples contributing to the output
+        const int hl = hlength[ox]; // H(orizontal) L(ength)
 
         dt_aligned_pixel_t vhs = { 0.0f, 0.0f, 0.0f, 0.0f };
-
-        for(size_t ix = 0; ix < hl; ix++)
+        for(int ix = 0; ix < hl; ix++, hkidx++)
         {
           // Apply the precomputed filter kernel
-          const size_t baseidx = baseidx_vindex + (size_t)hindex[hkidx] * 4;
-          const float htap = hkernel[hkidx++];
+          const float htap = hkernel[hkidx];
           dt_aligned_pixel_t tmp;
-          copy_pixel(tmp, in + baseidx);
+          copy_pixel(tmp, inrow + (size_t)hindex[hkidx] * 4);
           for_each_channel(c, aligned(tmp,vhs:16))
             vhs[c] += tmp[c] * htap;
         }
-
-        // Accumulate contribution from this line
-        const float vtap = vkernel[vkidx++];
-        for_each_channel(c, aligned(vhs,vs:16)) vs[c] += vhs[c] * vtap;
-
-        // Reset horizontal resampling context
-        hkidx -= hl;
+        copy_pixel(hrow + 4 * ox, vhs);
       }
+    }
 
-      // Output pixel is ready
-      const size_t baseidx = (size_t)oy * out_stride_floats + (size_t)ox * 4;
-      copy_pixel_nontemporal(out + baseidx, vs);
-
-      // Reset vertical resampling context
-      viidx -= vl;
-      vkidx -= vl;
-
-      // Progress in horizontal context
-      hkidx += hl;
+    // Accumulate the contributions of the lines, a whole line at a time
+    float *const orow = out + oy * out_stride_floats;
+    memset(orow, 0, sizeof(float) * out_stride_floats);
+    for(int iy = 0; iy < vl; iy++)
+    {
+      const float vtap = vkernel[vkidx + iy];
+      const float *const hrow = lines + (size_t)(vindex[viidx + iy] % ringlines) * out_stride_floats;
+      DT_OMP_SIMD(aligned(orow, hrow:16))
+      for(size_t k = 0; k < out_stride_floats; k++)
+        orow[k] += hrow[k] * vtap;
     }
   }
-  dt_omploop_sfence();
+
+  dt_free_align(ring);
+  dt_free_align(tags);
 
 exit:
   /* Free the resampling plans. It's nasty to optimize allocs like that, but
@@ -1398,6 +1429,7 @@ int dt_interpolation_resample_roi_cl(const dt_interpolation_t *itor,
 /** Applies resampling (re-scaling) on *full* input and output buffers.
  *  roi_in and roi_out define the part of the buffers that is affected.
  */
+__DT_CLONE_TARGETS__
 void dt_interpolation_resample_mask(const dt_interpolation_t *itor,
                                   float *out,
                                   const dt_iop_roi_t *const roi_out,
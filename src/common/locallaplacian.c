@@ -30,6 +30,10 @@
 #define max_levels 30
 // the number of segments for the piecewise linear interpolation
 #define num_gamma 6
+// the number of finer pyramid levels which local_laplacian_banded() processes in bands
+#define ll_band_levels 3
+// the height of these bands, in rows of the finest level
+#define ll_band_height 128
 
 // downsample width/height to given level
 static inline int dl(int size, const int level)
@@ -160,6 +164,48 @@ static inline void _convolve_14641_vert(dt_aligned_pixel_t conv, const float *in
   }
 }
 
+// blur one row of the coarse scale: computes coarse[1..cw-2] from the five
+// fine rows starting at base (fine row 2*(j-1) for coarse row j)
+static inline void gauss_reduce_row(
+    const float *base,        // first of the five fine input rows
+    float *const coarse,      // coarse output row
+    const size_t wd,          // fine res
+    const size_t cw)          // coarse res
+{
+  float *const out = coarse + 1;
+  // prime the vertical axis
+  static const dt_aligned_pixel_t kernel = { 1.0f, 4.0f, 6.0f, 4.0f };
+  dt_aligned_pixel_t left;
+  _convolve_14641_vert(left,base,wd);
+  for(size_t col=0; col<cw-3; col += 2)
+  {
+    // convolve the next four pixel wide vertical slice
+    base += 4;
+    dt_aligned_pixel_t right;
+    _convolve_14641_vert(right,base,wd);
+    // horizontal pass, generate two output values from convolving with 1 4 6 4 1
+    // the first uses pixels 0-4, the second uses 2-6
+    dt_aligned_pixel_t conv;
+    for_four_channels(c)
+      conv[c] = left[c] * kernel[c];
+    out[col] = (conv[0] + conv[1] + conv[2] + conv[3] + right[0]) / 256.0f;
+    out[col+1] = (left[2] + 4*(left[3]+right[1]) + 6.0f*right[0] + right[2]) / 256.0f;
+    // shift to next pair of output columns (four input columns)
+    copy_pixel(left, right);
+  }
+  // handle the left-over pixel if the output size is odd
+  if(cw % 2)
+  {
+    base += 4;
+    // convolve the right-most column
+    float right = base[0] + 4.0f*(base[wd]+base[3*wd]) + 6.0f*base[2*wd] + base[4*wd];
+    dt_aligned_pixel_t conv;
+    for_four_channels(c)
+      conv[c] = left[c] * kernel[c];
+    out[cw-3] = (conv[0] + conv[1] + conv[2] + conv[3] + right) / 256.0f;
+  }
+}
+
 static inline void gauss_reduce(
     const float *const input, // fine input buffer
     float *const coarse,      // coarse scale, blurred input buf
@@ -172,41 +218,7 @@ static inline void gauss_reduce(
   // is greater than the time needed to do it sequentially
   DT_OMP_FOR(if(ch*cw>2000))
   for(size_t j=1;j<ch-1;j++)
-  {
-    const float *base = input + 2*(j-1)*wd;
-    float *const out = coarse + j*cw + 1;
-    // prime the vertical axis
-    static const dt_aligned_pixel_t kernel = { 1.0f, 4.0f, 6.0f, 4.0f };
-    dt_aligned_pixel_t left;
-    _convolve_14641_vert(left,base,wd);
-    for(size_t col=0; col<cw-3; col += 2)
-    {
-      // convolve the next four pixel wide vertical slice
-      base += 4;
-      dt_aligned_pixel_t right;
-      _convolve_14641_vert(right,base,wd);
-      // horizontal pass, generate two output values from convolving with 1 4 6 4 1
-      // the first uses pixels 0-4, the second uses 2-6
-      dt_aligned_pixel_t conv;
-      for_four_channels(c)
-        conv[c] = left[c] * kernel[c];
-      out[col] = (conv[0] + conv[1] + conv[2] + conv[3] + right[0]) / 256.0f;
-      out[col+1] = (left[2] + 4*(left[3]+right[1]) + 6.0f*right[0] + right[2]) / 256.0f;
-      // shift to next pair of output columns (four input columns)
-      copy_pixel(left, right);
-    }
-    // handle the left-over pixel if the output size is odd
-    if(cw % 2)
-    {
-      base += 4;
-      // convolve the right-most column
-      float right = base[0] + 4.0f*(base[wd]+base[3*wd]) + 6.0f*base[2*wd] + base[4*wd];
-      dt_aligned_pixel_t conv;
-      for_four_channels(c)
-        conv[c] = left[c] * kernel[c];
-      out[cw-3] = (conv[0] + conv[1] + conv[2] + conv[3] + right) / 256.0f;
-    }
-  }
+    gauss_reduce_row(input + 2*(j-1)*wd, coarse + j*cw, wd, cw);
   dt_omploop_sfence();
   ll_fill_boundary1(coarse, cw, ch);
 }
@@ -310,6 +322,27 @@ static inline float ll_laplacian(
   return fine[j*wd+i] - c;
 }
 
+// the remapped laplacian coefficient at fine pixel i,j: interpolate between
+// the laplacian pyramids of the two curves whose gamma bracket the brightness v
+static inline float ll_blend_laplacians(
+    const float v,                     // brightness at fine pixel i,j
+    const float *const gamma,          // gamma of the curves
+    const float *const *const coarse,  // per curve: coarse res gaussian
+    const float *const *const fine,    // per curve: fine res gaussian
+    const int i,                       // fine index
+    const int j,
+    const int wd,                      // fine width
+    const int ht)                      // fine height
+{
+  int hi = 1;
+  for(;hi<num_gamma-1 && gamma[hi] <= v;hi++);
+  int lo = hi-1;
+  const float a = CLAMPS((v - gamma[lo])/(gamma[hi]-gamma[lo]), 0.0f, 1.0f);
+  const float l0 = ll_laplacian(coarse[lo], fine[lo], i, j, wd, ht);
+  const float l1 = ll_laplacian(coarse[hi], fine[hi], i, j, wd, ht);
+  return l0 * (1.0f-a) + l1 * a;
+}
+
 static inline float curve_scalar(
     const float x,
     const float g,
@@ -539,18 +572,17 @@ void local_laplacian_internal(
     const int pw = dl(w,l), ph = dl(h,l);
 
     gauss_expand(output[l+1], output[l], pw, ph);
+    const float *coarse[num_gamma], *fine[num_gamma];
+    for(int k=0;k<num_gamma;k++)
+    {
+      coarse[k] = buf[k][l+1];
+      fine[k] = buf[k][l];
+    }
     // go through all coefficients in the upsampled gauss buffer:
     DT_OMP_FOR(collapse(2))
     for(int j=0;j<ph;j++) for(int i=0;i<pw;i++)
     {
-      const float v = padded[l][j*pw+i];
-      int hi = 1;
-      for(;hi<num_gamma-1 && gamma[hi] <= v;hi++);
-      int lo = hi-1;
-      const float a = CLAMPS((v - gamma[lo])/(gamma[hi]-gamma[lo]), 0.0f, 1.0f);
-      const float l0 = ll_laplacian(buf[lo][l+1], buf[lo][l], i, j, pw, ph);
-      const float l1 = ll_laplacian(buf[hi][l+1], buf[hi][l], i, j, pw, ph);
-      output[l][j*pw+i] += l0 * (1.0f-a) + l1 * a;
+      output[l][j*pw+i] += ll_blend_laplacians(padded[l][j*pw+i], gamma, coarse, fine, i, j, pw, ph);
       // we could do this to save on memory (no need for finest buf[][]).
       // unfortunately it results in a quite noticeable loss of sharpness, i think
       // the extra level is worth it.
@@ -586,6 +618,349 @@ cleanup:
 }
 
 
+/*
+ * Banded local laplacian
+ *
+ * Same result as local_laplacian_internal() without boundary buffer, but
+ * only the pyramid levels from ll_band_levels on, 1/64 of the finest level
+ * each, are kept in memory as a whole. The finer levels of the padded input,
+ * of the remapped images and of the output are computed in horizontal bands
+ * of about ll_band_height rows of the finest level with a few rows of
+ * overlap: once on the way down to fill the coarse levels, and again on the
+ * way up to assemble the output, where only the rows of the roi are needed.
+ */
+
+// level 0 of one of the pyramids, generated row by row from the input
+typedef struct ll_source_t
+{
+  const float *input;  // input buffer in some Labx or yuvx format
+  int wd;              // width and
+  int ht;              // height of the input buffer
+  int w;               // padded width
+  int max_supp;        // padding on all four sides
+  gboolean curve;      // remap with the curve for gamma g, or plain padded brightness
+  float g, sigma, shadows, highlights, clarity;
+} ll_source_t;
+
+// row j of the padded input as ll_pad_input() without boundary buffer,
+// remapped as in apply_curve() if requested
+static inline void ll_source_row(
+    const ll_source_t *const s,
+    const int j,
+    float *const row)
+{
+  const int max_supp = s->max_supp;
+  const int w = s->w;
+  const float *const in = s->input + (size_t)4 * s->wd * CLAMP(j - max_supp, 0, s->ht - 1);
+  for(int i=0;i<w;i++)
+    row[i] = in[4*CLAMP(i - max_supp, 0, s->wd - 1)] * 0.01f; // L -> [0,1]
+  if(s->curve)
+  {
+    for(int i=max_supp;i<w-max_supp;i++)
+      row[i] = curve_scalar(row[i], s->g, s->sigma, s->shadows, s->highlights, s->clarity);
+    for(int i=0;i<max_supp;i++)   row[i] = row[max_supp];
+    for(int i=w-max_supp;i<w;i++) row[i] = row[w-max_supp-1];
+  }
+}
+
+// fine rows [*f0,*f1) needed by gauss_reduce() for the coarse rows [c0,c1) of a level with ch rows
+static inline void ll_reduce_rows(
+    const int c0,
+    const int c1,
+    const int ch,
+    int *f0,
+    int *f1)
+{
+  *f0 = 2*CLAMP(c0, 1, ch-2) - 2;
+  *f1 = 2*CLAMP(c1-1, 1, ch-2) + 3;
+}
+
+// coarse rows [*c0,*c1) needed by gauss_expand() for the fine rows [f0,f1) of a level with fh rows
+static inline void ll_expand_rows(
+    const int f0,
+    const int f1,
+    const int fh,
+    int *c0,
+    int *c1)
+{
+  const int last = ((fh-1)&~1)-1;
+  *c0 = CLAMPS(f0, 1, last)/2 - 1;
+  *c1 = CLAMPS(f1-1, 1, last)/2 + 2;
+}
+
+// on the way down: rows [c0[l],c1[l]) of the levels 0..top needed for
+// the rows [r0,r1) of level top
+static void ll_band_down(
+    const int h,
+    const int top,
+    const int r0,
+    const int r1,
+    int *c0,
+    int *c1)
+{
+  c0[top] = r0;
+  c1[top] = r1;
+  for(int l=top-1;l>=0;l--)
+    ll_reduce_rows(c0[l+1], c1[l+1], dl(h,l+1), c0+l, c1+l);
+}
+
+// on the way up: rows [n0[l],n1[l]) of the levels 0..top needed to assemble
+// the rows [r0,r1) of level 0, and the rows [c0[l],c1[l]) of the levels
+// 0..top-1 of the gaussian pyramids to compute for it
+static void ll_band_up(
+    const int h,
+    const int top,
+    const int r0,
+    const int r1,
+    int *n0,
+    int *n1,
+    int *c0,
+    int *c1)
+{
+  n0[0] = r0;
+  n1[0] = r1;
+  for(int l=0;l<top;l++)
+    ll_expand_rows(n0[l], n1[l], dl(h,l), n0+l+1, n1+l+1);
+  c0[top-1] = n0[top-1];
+  c1[top-1] = n1[top-1];
+  for(int l=top-2;l>=0;l--)
+  {
+    int f0, f1;
+    ll_reduce_rows(c0[l+1], c1[l+1], dl(h,l+1), &f0, &f1);
+    c0[l] = MIN(n0[l], f0);
+    c1[l] = MAX(n1[l], f1);
+  }
+}
+
+// largest number of rows of the levels 0..top-1 in any band
+static void ll_band_rows(
+    const int h,        // padded height
+    const int ht,       // input height
+    const int max_supp,
+    const int top,
+    int *rows)
+{
+  int n0[max_levels], n1[max_levels], c0[max_levels], c1[max_levels];
+  for(int l=0;l<top;l++) rows[l] = 0;
+  if(top < 1) return;
+  const int hs = dl(h,top);
+  const int bs = MAX(1, ll_band_height >> top);
+  for(int r0=0;r0<hs;r0+=bs)
+  {
+    ll_band_down(h, top, r0, MIN(r0+bs, hs), c0, c1);
+    for(int l=0;l<top;l++) rows[l] = MAX(rows[l], c1[l]-c0[l]);
+  }
+  for(int r0=max_supp;r0<max_supp+ht;r0+=ll_band_height)
+  {
+    ll_band_up(h, top, r0, MIN(r0+ll_band_height, max_supp+ht), n0, n1, c0, c1);
+    for(int l=0;l<top;l++) rows[l] = MAX(rows[l], c1[l]-c0[l]);
+  }
+}
+
+// rows [c0[l],c1[l]) of the levels 0..top of the gaussian pyramid of a
+// source, level l is stored from rows[l] on. The rows must come from
+// ll_band_down() or ll_band_up() so that each level has what the next needs.
+static void ll_band_pyramid(
+    const ll_source_t *const s,
+    const int h,
+    const int top,
+    const int *const c0,
+    const int *const c1,
+    float *const *const rows)
+{
+  const int w = s->w;
+  DT_OMP_FOR()
+  for(int r=c0[0];r<c1[0];r++)
+    ll_source_row(s, r, rows[0] + (size_t)(r-c0[0])*w);
+  for(int l=1;l<=top;l++)
+  {
+    const int fw = dl(w,l-1), cw = dl(w,l), ch = dl(h,l);
+    const int f0 = c0[l-1];
+    const float *const fine = rows[l-1];
+    float *const coarse = rows[l];
+    DT_OMP_FOR(if((c1[l]-c0[l])*cw>2000))
+    for(int r=c0[l];r<c1[l];r++)
+    {
+      // first and last row are copies of their neighbours, see ll_fill_boundary1()
+      const int rr = CLAMP(r, 1, ch-2);
+      float *const out = coarse + (size_t)(r-c0[l])*cw;
+      gauss_reduce_row(fine + (size_t)(2*(rr-1)-f0)*fw, out, fw, cw);
+      out[0] = out[1];
+      out[cw-1] = out[cw-2];
+    }
+  }
+}
+
+void local_laplacian_banded(
+    const float *const input,   // input buffer in some Labx or yuvx format
+    float *const out,           // output buffer with colour
+    const int wd,               // width and
+    const int ht,               // height of the input buffer
+    const float sigma,          // user param: separate shadows/mid-tones/highlights
+    const float shadows,        // user param: lift shadows
+    const float highlights,     // user param: compress highlights
+    const float clarity)        // user param: increase clarity/local contrast
+{
+  if(wd <= 1 || ht <= 1) return;
+
+  const int num_levels = MIN(max_levels, 31-__builtin_clz(MIN(wd,ht)));
+  const int last_level = num_levels-1;
+  if(last_level < 1)
+  {
+    // nothing to band
+    local_laplacian_internal(input, out, wd, ht, sigma, shadows, highlights, clarity, NULL);
+    return;
+  }
+  const int max_supp = 1<<last_level;
+  const int w = 2*max_supp + wd;
+  const int h = 2*max_supp + ht;
+  // first level kept as a whole
+  const int top = MIN(ll_band_levels, last_level);
+
+  // evenly sample brightness [0,1]:
+  float gamma[num_gamma] = {0.0f};
+  for(int k=0;k<num_gamma;k++) gamma[k] = (k+.5f)/(float)num_gamma;
+
+  // sources of the pyramids: the padded input and the remapped images
+  ll_source_t src[num_gamma+1];
+  for(int p=0;p<=num_gamma;p++)
+    src[p] = (ll_source_t){ .input = input, .wd = wd, .ht = ht, .w = w, .max_supp = max_supp,
+                            .curve = p > 0, .g = p > 0 ? gamma[p-1] : 0.0f, .sigma = sigma,
+                            .shadows = shadows, .highlights = highlights, .clarity = clarity };
+
+  // levels top.. as a whole, indexed like in local_laplacian_internal()
+  float *padded[max_levels] = {0};
+  float *output[max_levels] = {0};
+  float *buf[num_gamma][max_levels] = {{0}};
+  // bands of the levels 0..top-1: band[0] padded input, band[1+k] remapped with gamma[k]
+  float *band[num_gamma+1][ll_band_levels] = {{0}};
+  float *band_out[ll_band_levels] = {0};
+
+  gboolean success = TRUE;
+  for(int l=top;l<=last_level;l++)
+  {
+    const size_t size = (size_t)dl(w,l) * dl(h,l);
+    if(l < last_level) success &= (padded[l] = dt_alloc_align_float(size)) != NULL;
+    success &= (output[l] = dt_alloc_align_float(size)) != NULL;
+    for(int k=0;k<num_gamma;k++)
+      success &= (buf[k][l] = dt_alloc_align_float(size)) != NULL;
+  }
+  int rows[ll_band_levels];
+  ll_band_rows(h, ht, max_supp, top, rows);
+  for(int l=0;l<top;l++)
+  {
+    const size_t size = (size_t)rows[l] * dl(w,l);
+    success &= (band_out[l] = dt_alloc_align_float(size)) != NULL;
+    for(int p=0;p<=num_gamma;p++)
+      success &= (band[p][l] = dt_alloc_align_float(size)) != NULL;
+  }
+  if(!success)
+  {
+    // copy the input buffer to the output so that we at least get a
+    // valid result
+    for(size_t k = 0; k < (size_t)4 * wd * ht; k++)
+      out[k] = input[k];
+    goto cleanup;
+  }
+
+  // on the way down: run the finer levels of all pyramids in bands to fill level top
+  const int hs = dl(h,top), ws = dl(w,top);
+  const int bs = MAX(1, ll_band_height >> top);
+  for(int r0=0;r0<hs;r0+=bs)
+  {
+    int c0[max_levels], c1[max_levels];
+    ll_band_down(h, top, r0, MIN(r0+bs, hs), c0, c1);
+    for(int p=0;p<=num_gamma;p++)
+    {
+      float *level[max_levels];
+      for(int l=0;l<top;l++) level[l] = band[0][l];
+      float *const whole = p ? buf[p-1][top] : (top < last_level ? padded[top] : output[last_level]);
+      level[top] = whole + (size_t)r0*ws;
+      ll_band_pyramid(&src[p], h, top, c0, c1, level);
+    }
+  }
+
+  // the coarse levels as a whole, as in local_laplacian_internal()
+  for(int l=top+1;l<last_level;l++)
+    gauss_reduce(padded[l-1], padded[l], dl(w,l-1), dl(h,l-1));
+  if(top < last_level)
+    gauss_reduce(padded[last_level-1], output[last_level], dl(w,last_level-1), dl(h,last_level-1));
+  for(int k=0;k<num_gamma;k++)
+    for(int l=top+1;l<=last_level;l++)
+      gauss_reduce(buf[k][l-1], buf[k][l], dl(w,l-1), dl(h,l-1));
+
+  for(int l=last_level-1;l >= top; l--)
+  {
+    const int pw = dl(w,l), ph = dl(h,l);
+
+    gauss_expand(output[l+1], output[l], pw, ph);
+    const float *coarse[num_gamma], *fine[num_gamma];
+    for(int k=0;k<num_gamma;k++)
+    {
+      coarse[k] = buf[k][l+1];
+      fine[k] = buf[k][l];
+    }
+    DT_OMP_FOR(collapse(2))
+    for(int j=0;j<ph;j++) for(int i=0;i<pw;i++)
+      output[l][j*pw+i] += ll_blend_laplacians(padded[l][j*pw+i], gamma, coarse, fine, i, j, pw, ph);
+  }
+
+  // on the way up: assemble the finer levels in bands of the roi rows of level 0
+  for(int r0=max_supp;r0<max_supp+ht;r0+=ll_band_height)
+  {
+    const int r1 = MIN(r0+ll_band_height, max_supp+ht);
+    int n0[max_levels], n1[max_levels], c0[max_levels], c1[max_levels];
+    ll_band_up(h, top, r0, r1, n0, n1, c0, c1);
+    for(int p=0;p<=num_gamma;p++)
+      ll_band_pyramid(&src[p], h, top-1, c0, c1, band[p]);
+
+    for(int l=top-1;l>=0;l--)
+    {
+      const int pw = dl(w,l), ph = dl(h,l), cw = dl(w,l+1);
+      // shift the bands so that they can be indexed with absolute rows
+      const float *coarse[num_gamma], *fine[num_gamma];
+      for(int k=0;k<num_gamma;k++)
+      {
+        fine[k] = band[1+k][l] - (ptrdiff_t)c0[l]*pw;
+        coarse[k] = l+1 < top ? band[1+k][l+1] - (ptrdiff_t)c0[l+1]*cw : buf[k][top];
+      }
+      const float *const v = band[0][l] - (ptrdiff_t)c0[l]*pw;
+      const float *const up = l+1 < top ? band_out[l+1] - (ptrdiff_t)n0[l+1]*cw : output[top];
+      float *const outl = band_out[l] - (ptrdiff_t)n0[l]*pw;
+      // gauss_expand() including its boundary handling
+      const int last_i = ((pw-1)&~1)-1, last_j = ((ph-1)&~1)-1;
+      DT_OMP_FOR(collapse(2))
+      for(int j=n0[l];j<n1[l];j++) for(int i=0;i<pw;i++)
+      {
+        outl[j*pw+i] = ll_expand_gaussian(up, CLAMPS(i, 1, last_i), CLAMPS(j, 1, last_j), pw, ph);
+        outl[j*pw+i] += ll_blend_laplacians(v[j*pw+i], gamma, coarse, fine, i, j, pw, ph);
+      }
+    }
+
+    DT_OMP_FOR(collapse(2))
+    for(int j=r0-max_supp;j<r1-max_supp;j++) for(int i=0;i<wd;i++)
+    {
+      out[4*(j*wd+i)+0] = 100.0f * band_out[0][(size_t)(j+max_supp-r0)*w+max_supp+i]; // [0,1] -> L
+      out[4*(j*wd+i)+1] = input[4*(j*wd+i)+1]; // copy original colour channels
+      out[4*(j*wd+i)+2] = input[4*(j*wd+i)+2];
+    }
+  }
+
+cleanup:
+  for(int l=0;l<max_levels;l++)
+  {
+    dt_free_align(padded[l]);
+    dt_free_align(output[l]);
+    for(int k=0;k<num_gamma;k++) dt_free_align(buf[k][l]);
+  }
+  for(int l=0;l<ll_band_levels;l++)
+  {
+    dt_free_align(band_out[l]);
+    for(int p=0;p<=num_gamma;p++) dt_free_align(band[p][l]);
+  }
+}
+
+// memory of local_laplacian_banded(), the levels kept as a whole plus the bands
 size_t local_laplacian_memory_use(const int width,     // width of input image
                                   const int height)    // height of input image
 {
@@ -593,12 +968,18 @@ size_t local_laplacian_memory_use(const int width,     // width of input image
   const int max_supp = 1<<(num_levels-1);
   const int paddwd = width  + 2*max_supp;
   const int paddht = height + 2*max_supp;
+  const int top = num_levels > 1 ? MIN(ll_band_levels, num_levels-1) : 0;
 
   size_t memory_use = 0;
 
-  for(int l=0;l<num_levels;l++)
+  for(int l=top;l<num_levels;l++)
     memory_use += sizeof(float) * (2 + num_gamma) * dl(paddwd, l) * dl(paddht, l);
 
+  int rows[ll_band_levels];
+  ll_band_rows(paddht, height, max_supp, top, rows);
+  for(int l=0;l<top;l++)
+    memory_use += sizeof(float) * (2 + num_gamma) * rows[l] * dl(paddwd, l);
+
   return memory_use;
 }
 
@@ -609,8 +990,13 @@ size_t local_laplacian_singlebuffer_size(const int width,     // width of input
   const int max_supp = 1<<(num_levels-1);
   const int paddwd = width  + 2*max_supp;
   const int paddht = height + 2*max_supp;
+  const int top = num_levels > 1 ? MIN(ll_band_levels, num_levels-1) : 0;
 
-  return sizeof(float) * dl(paddwd, 0) * dl(paddht, 0);
+  int rows[ll_band_levels];
+  ll_band_rows(paddht, height, max_supp, top, rows);
+  const size_t whole = (size_t)dl(paddwd, top) * dl(paddht, top);
+  const size_t band = top ? (size_t)rows[0] * paddwd : 0;
+  return sizeof(float) * MAX(whole, band);
 }
 // clang-format off
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
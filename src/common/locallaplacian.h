@@ -57,6 +57,19 @@ void local_laplacian_internal(
     // the following is just needed for clipped roi with boundary conditions from coarse buffer (can be 0)
     local_laplacian_boundary_t *b);
 
+// same result as local_laplacian_internal() without boundary buffer, but only
+// the coarse pyramid levels are kept as a whole, the finer ones are processed in
+// horizontal bands. needs a fraction of the memory, see local_laplacian_memory_use().
+void local_laplacian_banded(
+    const float *const input,   // input buffer in some Labx or yuvx format
+    float *const out,           // output buffer with colour
+    const int wd,               // width and
+    const int ht,               // height of the input buffer
+    const float sigma,          // user param: separate shadows/mid-tones/highlights
+    const float shadows,        // user param: lift shadows
+    const float highlights,     // user param: compress highlights
+    const float clarity);       // user param: increase clarity/local contrast
+
 void local_laplacian(
     const float *const input,   // input buffer in some Labx or yuvx format
     float *const out,           // output buffer with colour
@@ -68,9 +81,14 @@ void local_laplacian(
     const float clarity,        // user param: increase clarity/local contrast
     local_laplacian_boundary_t *b) // can be 0
 {
-  local_laplacian_internal(input, out, wd, ht, sigma, shadows, highlights, clarity, b);
+  // the boundary modes need the full pyramids
+  if(b && b->mode != 0)
+    local_laplacian_internal(input, out, wd, ht, sigma, shadows, highlights, clarity, b);
+  else
+    local_laplacian_banded(input, out, wd, ht, sigma, shadows, highlights, clarity);
 }
 
+// memory needed by local_laplacian() without boundary buffer
 size_t local_laplacian_memory_use(const int width,      // width of input image
                                   const int height);    // height of input image
 
@@ -23,6 +23,7 @@
 #include "common/file_location.h"
 #include "common/grealpath.h"
 #include "common/image_cache.h"
+#include "common/trace.h"
 #include "control/conf.h"
 #include "control/jobs.h"
 #include "develop/imageop_math.h"
@@ -1040,15 +1041,19 @@ void dt_mipmap_cache_get_with_caller(dt_mipmap_buffer_t *buf,
       else if(mip == DT_MIPMAP_F)
       {
         ASAN_UNPOISON_MEMORY_REGION(dsc + 1, dsc->size - sizeof(dt_mipmap_buffer_dsc_t));
+        const double tstart = dt_trace_begin();
         _init_f(buf, (float *)(dsc + 1),
                 &dsc->width, &dsc->height, &dsc->iscale, imgid);
+        dt_trace_end(tstart, DT_TRACE_MIPMAP, "load float ID=%i", imgid);
       }
       else
       {
         // 8-bit thumbs
         ASAN_UNPOISON_MEMORY_REGION(dsc + 1, dsc->size - sizeof(dt_mipmap_buffer_dsc_t));
+        const double tstart = dt_trace_begin();
         _init_8((uint8_t *)(dsc + 1),
                 &dsc->width, &dsc->height, &dsc->iscale, &buf->color_space, imgid, mip);
+        dt_trace_end(tstart, DT_TRACE_MIPMAP, "load mip%d ID=%i", (int)mip, imgid);
       }
       dsc->color_space = buf->color_space;
       dsc->flags &= ~DT_MIPMAP_BUFFER_DSC_FLAG_GENERATE;
@@ -44,6 +44,11 @@
 #define SLICE_WIDTH 72
 #define SLICE_HEIGHT 60
 
+// number of consecutive patches (search offsets) processed together by the grouped engine in chunks
+//   which are far enough from the RoI borders that no patch needs clipping.  Their column sums are
+//   interleaved so that the sliding-window updates and the weights vectorize across the offsets.
+#define PATCH_GROUP 8
+
 // try to speed up processing by caching pixel differences?  If cached, they won't need to be computed a
 // second time when sliding the patch window away from the pixel.  Testing shows it to be slower than
 // recomputing for both scalar and SSE on a Threadripper due to increased memory writes; this may differ on
@@ -273,6 +278,202 @@ static void init_column_sums(
 }
 
 
+// pixel_difference() and diff_of_pixels_diff() for the PATCH_GROUP patches of a group, computed lane by
+//   lane with the same operations as the single-patch versions.  If the patches of the group are adjacent
+//   on the same row ('adjacent'), the partner pixels are at a constant stride which lets the compiler
+//   vectorize across the patches without gathers.
+static inline int group_offset(
+        const int *const offset,
+        const gboolean adjacent,
+        const int k)
+{
+  return adjacent ? offset[0] + 4*k : offset[k];
+}
+
+static inline void group_pixel_difference(
+        const float *const pix,
+        const int *const offset,
+        const gboolean adjacent,
+        const float *const norm,
+        float diff[PATCH_GROUP])
+{
+  DT_OMP_SIMD()
+  for(int k = 0; k < PATCH_GROUP; k++)
+  {
+    const float *const pix2 = pix + group_offset(offset, adjacent, k);
+    const float d0 = pix[0] - pix2[0];
+    const float d1 = pix[1] - pix2[1];
+    const float d2 = pix[2] - pix2[2];
+    const float s0 = d0 * d0 * norm[0];
+    const float s1 = d1 * d1 * norm[1];
+    const float s2 = d2 * d2 * norm[2];
+    diff[k] = s0 + s1 + s2;
+  }
+}
+
+static inline void group_diff_of_pixels_diff(
+        const float *const bot_px,
+        const float *const top_px,
+        const int *const offset,
+        const gboolean adjacent,
+        const float *const norm,
+        float *const restrict sums)
+{
+  DT_OMP_SIMD()
+  for(int k = 0; k < PATCH_GROUP; k++)
+  {
+    const int off = group_offset(offset, adjacent, k);
+    const float *const bot2 = bot_px + off;
+    const float *const top2 = top_px + off;
+    const float b0 = bot_px[0] - bot2[0], t0 = top_px[0] - top2[0];
+    const float b1 = bot_px[1] - bot2[1], t1 = top_px[1] - top2[1];
+    const float b2 = bot_px[2] - bot2[2], t2 = top_px[2] - top2[2];
+    const float s0 = (b0 * b0 - t0 * t0) * norm[0];
+    const float s1 = (b1 * b1 - t1 * t1) * norm[1];
+    const float s2 = (b2 * b2 - t2 * t2) * norm[2];
+    sums[k] += s0 + s1 + s2;
+  }
+}
+
+// check whether none of the patches of a group needs any of the clipping done by the generic loop when
+//   denoising the given chunk, i.e. all patches lie entirely within the RoI
+static inline gboolean group_fits_chunk(
+        const patch_t *const patches,
+        const int radius,
+        const int chunk_top,
+        const int chunk_bot,
+        const int chunk_left,
+        const int chunk_right,
+        const int height,
+        const int width)
+{
+  for(int k = 0; k < PATCH_GROUP; k++)
+  {
+    const int rows = patches[k].rows;
+    const int cols = patches[k].cols;
+    if(chunk_top < radius + MAX(0,-rows) || chunk_bot > height - 1 - radius - MAX(0,rows)
+       || chunk_left < radius + MAX(0,-cols) || chunk_right > width - radius - MAX(0,cols))
+      return FALSE;
+  }
+  return TRUE;
+}
+
+// check whether the patches of a group are neighbours in the same row, as the strided variant of
+//   denoise_chunk_group() reads them relative to the first one.  With scattering and a scale below 1
+//   neighbouring search positions can map onto the same or non-adjacent patches.
+static inline gboolean group_is_adjacent(const patch_t *const patches)
+{
+  for(int k = 1; k < PATCH_GROUP; k++)
+    if(patches[k].rows != patches[0].rows || patches[k].cols != patches[0].cols + k)
+      return FALSE;
+  return TRUE;
+}
+
+// Denoise one chunk for PATCH_GROUP consecutive patches at once.  Only valid if group_fits_chunk(),
+//   so that all clipping done by the generic loop is a no-op.  Every patch goes through the same operations in the same order as in the generic
+//   loop, and the patches are accumulated into the output in the same order, so the result matches it.
+static inline void denoise_chunk_group(
+        const float *const inbuf,
+        float *const outbuf,
+        const patch_t *const patches,
+        float *const col_sums,
+        const int chunk_top,
+        const int chunk_bot,
+        const int chunk_left,
+        const int chunk_right,
+        const int width,
+        const size_t stride,
+        const int radius,
+        const dt_nlmeans_param_t *const params,
+        const dt_aligned_pixel_t center_norm,
+        const gboolean adjacent)
+{
+  int offset[PATCH_GROUP];
+  for(int k = 0; k < PATCH_GROUP; k++)
+    offset[k] = patches[k].offset;
+  const float *const norm = params->norm;
+  const float sharpness = params->sharpness;
+  const float center_weight = params->center_weight;
+
+  // column sums from scratch for the first row of the chunk, interleaved by patch
+  for(int k = 0; k < PATCH_GROUP; k++)
+    col_sums[PATCH_GROUP * (chunk_left-radius-1) + k] = 0.0f;
+  for(int col = chunk_left - radius; col < chunk_right + radius; col++)
+  {
+    float sum[PATCH_GROUP] = { 0.0f };
+    for(int r = chunk_top - radius; r <= chunk_top + radius; r++)
+    {
+      float diff[PATCH_GROUP];
+      group_pixel_difference(inbuf + r*stride + 4*col, offset, adjacent, norm, diff);
+      for(int k = 0; k < PATCH_GROUP; k++)
+        sum[k] += diff[k];
+    }
+    for(int k = 0; k < PATCH_GROUP; k++)
+      col_sums[PATCH_GROUP * col + k] = sum[k];
+  }
+
+  for(int row = chunk_top; row < chunk_bot; row++)
+  {
+    float distortion[PATCH_GROUP] = { 0.0f };
+    for(int i = chunk_left - radius; i < MIN(chunk_left+radius, chunk_right); i++)
+      for(int k = 0; k < PATCH_GROUP; k++)
+        distortion[k] += col_sums[PATCH_GROUP * i + k];
+    const float *in = inbuf + stride * row;
+    float *const out = outbuf + (size_t)4 * width * row;
+    for(int col = chunk_left; col < chunk_right; col++)
+    {
+      const float *const add = col_sums + PATCH_GROUP * (col+radius);
+      const float *const sub = col_sums + PATCH_GROUP * (col-radius-1);
+      const float *const inpx = in + 4*col;
+      float wt[PATCH_GROUP];
+      for(int k = 0; k < PATCH_GROUP; k++)
+        distortion[k] += (add[k] - sub[k]);
+      if(center_weight < 0.0f)
+      {
+        // computation as used by denoise(non-local) iop
+        for(int k = 0; k < PATCH_GROUP; k++)
+          wt[k] = gh(distortion[k] * sharpness);
+      }
+      else
+      {
+        // computation as used by denoiseprofiled iop with non-local means
+        for(int k = 0; k < PATCH_GROUP; k++)
+        {
+          const float *const px = inpx + group_offset(offset, adjacent, k);
+          const float dissimilarity = (distortion[k] + pixel_difference(inpx,px,center_norm))
+                                       / (1.0f + center_weight);
+          wt[k] = gh(fmaxf(0.0f, dissimilarity * sharpness - 2.0f));
+        }
+      }
+      // accumulate in patch order.  Keep the sum in a register and select the constant weight channel
+      //   instead of assembling the pixel on the stack, which stalls on store forwarding.
+      dt_aligned_pixel_t acc;
+      copy_pixel(acc, out + 4*col);
+      for(int k = 0; k < PATCH_GROUP; k++)
+      {
+        const float *const px = inpx + group_offset(offset, adjacent, k);
+        for_four_channels(c,aligned(acc:16))
+        {
+          acc[c] += (c == 3 ? 1.0f : px[c]) * wt[k];
+        }
+      }
+      copy_pixel(out + 4*col, acc);
+    }
+    if(row + 1 < chunk_bot) // don't bother updating if last iteration
+    {
+      // both prior and new positions are entirely within the RoI, so subtract the old row and add the new one
+      const float *const top_row = inbuf + (row-radius)*stride;
+      const float *const bot_row = inbuf + (row+1+radius)*stride;
+      for(int col = chunk_left - radius; col < chunk_right + radius; col++)
+      {
+        const float *const bot_px = bot_row + 4*col;
+        group_diff_of_pixels_diff(bot_px, top_row + 4*col, offset, adjacent, norm, col_sums + PATCH_GROUP * col);
+        _mm_prefetch(bot_px+stride, _MM_HINT_T0);
+      }
+    }
+  }
+}
+
 // determine the height of the horizontal slice each thread will process
 static int compute_slice_height(const int height)
 {
@@ -322,12 +523,13 @@ static int compute_slice_width(const int width)
 }
 
 __DT_CLONE_TARGETS__
-void nlmeans_denoise(
+static void _nlmeans_denoise(
         const float *const inbuf,
         float *const outbuf,
         const dt_iop_roi_t *const roi_in,
         const dt_iop_roi_t *const roi_out,
-        const dt_nlmeans_param_t *const params)
+        const dt_nlmeans_param_t *const params,
+        const gboolean group_patches)
 {
   // define the factors for applying blending between the original image and the denoised version
   // if running in RGB space, 'luma' should equal 'chroma'
@@ -353,6 +555,11 @@ void nlmeans_denoise(
 #endif /* CACHE_PIXDIFFS */
   size_t padded_scratch_size;
   float *const restrict scratch_buf = dt_alloc_perthread_float(scratch_size, &padded_scratch_size);
+  // interleaved column sums for the grouped engine
+  const size_t group_scratch_size = PATCH_GROUP * (SLICE_WIDTH + 2*radius + 1) + 48;
+  size_t padded_group_scratch_size;
+  float *const restrict group_scratch_buf =
+    group_patches ? dt_alloc_perthread_float(group_scratch_size, &padded_group_scratch_size) : NULL;
   const int chk_height = compute_slice_height(roi_out->height);
   const int chk_width = compute_slice_width(roi_out->width);
   DT_OMP_FOR(collapse(2))
@@ -376,6 +583,22 @@ void nlmeans_denoise(
       // cycle through all of the patches over our slice of the image
       for(int p = 0; p < num_patches; p++)
       {
+        if(group_scratch_buf && p + PATCH_GROUP <= num_patches
+           && group_fits_chunk(patches+p,radius,chunk_top,chunk_bot,chunk_left,chunk_right,
+                               roi_out->height,roi_out->width))
+        {
+          float *const restrict group_tmpbuf = dt_get_perthread(group_scratch_buf, padded_group_scratch_size);
+          float *const group_sums = group_tmpbuf + PATCH_GROUP * (radius + 1 - chunk_left);
+          // with scattering=0 the patches of a search row are neighbours, use the strided variant then
+          if(group_is_adjacent(patches+p))
+            denoise_chunk_group(inbuf,outbuf,patches+p,group_sums,chunk_top,chunk_bot,chunk_left,chunk_right,
+                                roi_out->width,stride,radius,params,center_norm,TRUE);
+          else
+            denoise_chunk_group(inbuf,outbuf,patches+p,group_sums,chunk_top,chunk_bot,chunk_left,chunk_right,
+                                roi_out->width,stride,radius,params,center_norm,FALSE);
+          p += PATCH_GROUP - 1;
+          continue;
+        }
         // retrieve info about the current patch
         const patch_t *patch = &patches[p];
         // skip any rows where the patch center would be above top of RoI or below bottom of RoI
@@ -539,9 +762,20 @@ void nlmeans_denoise(
   // clean up: free the work space
   dt_free_align(patches);
   dt_free_align(scratch_buf);
+  dt_free_align(group_scratch_buf);
   return;
 }
 
+void nlmeans_denoise(
+        const float *const inbuf,
+        float *const outbuf,
+        const dt_iop_roi_t *const roi_in,
+        const dt_iop_roi_t *const roi_out,
+        const dt_nlmeans_param_t *const params)
+{
+  _nlmeans_denoise(inbuf, outbuf, roi_in, roi_out, params, TRUE);
+}
+
 /**************************************************************/
 /**************************************************************/
 /*      Everything from here to end of file is OpenCL         */
@@ -0,0 +1,145 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "common/thread_budget.h"
+#include "common/atomic.h"
+#include "common/darktable.h"
+#include "control/conf.h"
+
+// relative priorities, the interactive pipes dominate everything else
+static const int _weight[DT_THREAD_CLIENT_LAST] =
+{
+  [DT_THREAD_CLIENT_FULL]       = 16,
+  [DT_THREAD_CLIENT_PREVIEW]    = 6,
+  [DT_THREAD_CLIENT_PREVIEW2]   = 6,
+  [DT_THREAD_CLIENT_EXPORT]     = 4,
+  [DT_THREAD_CLIENT_THUMBNAIL]  = 2,
+  [DT_THREAD_CLIENT_JOB]        = 4,
+  [DT_THREAD_CLIENT_BACKGROUND] = 1,
+};
+
+static const char *_name[DT_THREAD_CLIENT_LAST] =
+{
+  [DT_THREAD_CLIENT_FULL]       = "full",
+  [DT_THREAD_CLIENT_PREVIEW]    = "preview",
+  [DT_THREAD_CLIENT_PREVIEW2]   = "preview2",
+  [DT_THREAD_CLIENT_EXPORT]     = "export",
+  [DT_THREAD_CLIENT_THUMBNAIL]  = "thumbnail",
+  [DT_THREAD_CLIENT_JOB]        = "job",
+  [DT_THREAD_CLIENT_BACKGROUND] = "background",
+};
+
+static dt_atomic_int _active[DT_THREAD_CLIENT_LAST];
+static gboolean _enabled = FALSE;
+
+// the client the calling thread is currently working for, -1 if none
+static __thread int _client = -1;
+
+void dt_thread_budget_init(void)
+{
+  for(int k = 0; k < DT_THREAD_CLIENT_LAST; k++)
+    dt_atomic_set_int(&_active[k], 0);
+  _enabled = dt_conf_get_bool("thread_budget");
+}
+
+int dt_thread_budget_active(const dt_thread_client_t client)
+{
+  return dt_atomic_get_int(&_active[client]);
+}
+
+static int _share(const dt_thread_client_t client,
+                  const int self)
+{
+  const int total = dt_get_num_threads();
+  int sum = _weight[client] * self;
+  for(int k = 0; k < DT_THREAD_CLIENT_LAST; k++)
+    sum += _weight[k] * dt_atomic_get_int(&_active[k]);
+  if(sum <= 0) return total;
+  return CLAMP(total * _weight[client] / sum, 1, total);
+}
+
+int dt_thread_budget_get(const dt_thread_client_t client)
+{
+  // a client that isn't active yet competes with the others as if it was
+  return _share(client, dt_thread_budget_active(client) ? 0 : 1);
+}
+
+static int _apply(const int client)
+{
+  const int nthreads = client < 0 || !_enabled
+    ? dt_get_num_threads()
+    : _share(client, 0);
+#ifdef _OPENMP
+  omp_set_num_threads(nthreads);
+#endif
+  return nthreads;
+}
+
+static void _print(const char *what, const dt_thread_client_t client)
+{
+  if(!(darktable.unmuted & DT_DEBUG_CONTROL)) return;
+
+  char info[256] = { 0 };
+  for(int k = 0; k < DT_THREAD_CLIENT_LAST; k++)
+  {
+    const int active = dt_atomic_get_int(&_active[k]);
+    if(!active) continue;
+    char entry[40];
+    snprintf(entry, sizeof(entry), " %s=%dx%d", _name[k], active, _share(k, 0));
+    g_strlcat(info, entry, sizeof(info));
+  }
+  dt_print(DT_DEBUG_CONTROL, "[thread budget] %s %s, allocation:%s",
+           what, _name[client], info);
+}
+
+int dt_thread_budget_acquire(const dt_thread_client_t client)
+{
+  const int previous = _client;
+  if(!_enabled) return previous;
+
+  // a nested client replaces the outer one for this thread
+  if(previous >= 0) dt_atomic_sub_int(&_active[previous], 1);
+  dt_atomic_add_int(&_active[client], 1);
+  _client = client;
+  _apply(client);
+  _print("acquire", client);
+  return previous;
+}
+
+void dt_thread_budget_release(const dt_thread_client_t client,
+                              const int previous)
+{
+  if(!_enabled) return;
+
+  dt_atomic_sub_int(&_active[client], 1);
+  if(previous >= 0) dt_atomic_add_int(&_active[previous], 1);
+  _client = previous;
+  _apply(previous);
+  _print("release", client);
+}
+
+int dt_thread_budget_refresh(void)
+{
+  return _apply(_enabled ? _client : -1);
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
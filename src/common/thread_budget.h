@@ -0,0 +1,69 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <glib.h>
+
+/*
+  The cpu thread budget coordinates the openmp team sizes of everything
+  that may run in parallel: the darkroom pipes, exports, thumbnail
+  generation and the job queues.
+
+  Each client announces itself with dt_thread_budget_acquire() from the
+  thread that will open the parallel regions; the openmp team size of
+  that thread is then set to the client's share of darktable's threads.
+  Shares are weighted by priority over all currently active clients so
+  the interactive full pipe gets most of the cpu while an export runs.
+  Long running clients call dt_thread_budget_refresh() between work
+  units to follow changes of the other clients.
+*/
+
+typedef enum dt_thread_client_t
+{
+  DT_THREAD_CLIENT_FULL = 0,   // darkroom center view
+  DT_THREAD_CLIENT_PREVIEW,    // navigation preview
+  DT_THREAD_CLIENT_PREVIEW2,   // second darkroom window
+  DT_THREAD_CLIENT_EXPORT,
+  DT_THREAD_CLIENT_THUMBNAIL,
+  DT_THREAD_CLIENT_JOB,        // foreground jobs
+  DT_THREAD_CLIENT_BACKGROUND, // background jobs, thumbnail crawler and ai
+  DT_THREAD_CLIENT_LAST
+} dt_thread_client_t;
+
+void dt_thread_budget_init(void);
+
+// register the calling thread as client, set its team size and return the
+// previous client of this thread to be passed to dt_thread_budget_release()
+int dt_thread_budget_acquire(const dt_thread_client_t client);
+void dt_thread_budget_release(const dt_thread_client_t client, const int previous);
+
+// re-evaluate the share of the calling thread's client, returns the team size
+int dt_thread_budget_refresh(void);
+
+// current share of a client if it were active now
+int dt_thread_budget_get(const dt_thread_client_t client);
+
+// number of active instances of a client
+int dt_thread_budget_active(const dt_thread_client_t client);
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -0,0 +1,202 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "common/trace.h"
+#include "common/atomic.h"
+
+#include <glib/gstdio.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <unistd.h>
+
+typedef struct dt_trace_t
+{
+  FILE *f;
+  dt_pthread_mutex_t lock;
+  gboolean first;
+  double origin;
+  dt_atomic_int threads;
+} dt_trace_t;
+
+static dt_trace_t _trace = { NULL };
+
+// trace ids are small numbers handed out on first use in a thread
+static __thread int _tid = 0;
+
+static void _escape(char *dst,
+                    const size_t size,
+                    const char *src)
+{
+  size_t k = 0;
+  for(; *src && k + 7 < size; src++)
+  {
+    const unsigned char c = *src;
+    if(c == '"' || c == '\\')
+    {
+      dst[k++] = '\\';
+      dst[k++] = c;
+    }
+    else if(c < 0x20)
+      k += snprintf(dst + k, size - k, "\\u%04x", c);
+    else
+      dst[k++] = c;
+  }
+  dst[k] = '\0';
+}
+
+// must be called with the lock held
+static void _write_event(const char *json)
+{
+  fprintf(_trace.f, "%s%s", _trace.first ? "" : ",\n", json);
+  _trace.first = FALSE;
+}
+
+static int _thread_id(void)
+{
+  if(_tid) return _tid;
+
+  _tid = dt_atomic_add_int(&_trace.threads, 1) + 1;
+
+  // name the thread in the viewer
+  char name[64] = { 0 };
+#if defined(__linux__) || defined(__APPLE__)
+  pthread_getname_np(pthread_self(), name, sizeof(name));
+#endif
+  if(!name[0]) snprintf(name, sizeof(name), "thread %d", _tid);
+
+  char ename[128];
+  _escape(ename, sizeof(ename), name);
+  char json[256];
+  snprintf(json, sizeof(json),
+           "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+           "\"args\":{\"name\":\"%s\"}}", _tid, ename);
+
+  dt_pthread_mutex_lock(&_trace.lock);
+  if(_trace.f) _write_event(json);
+  dt_pthread_mutex_unlock(&_trace.lock);
+  return _tid;
+}
+
+static void _event(const char *phase,
+                   const char *category,
+                   const double start,
+                   const double duration,
+                   const char *name)
+{
+  if(!_trace.f) return;
+
+  const int tid = _thread_id();
+  char ename[512];
+  _escape(ename, sizeof(ename), name);
+
+  char dur[64] = { 0 };
+  if(duration >= 0.0)
+    snprintf(dur, sizeof(dur), ",\"dur\":%.1f", 1e6 * duration);
+
+  char json[768];
+  snprintf(json, sizeof(json),
+           "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"%s\",\"pid\":1,\"tid\":%d,"
+           "\"ts\":%.1f%s%s}",
+           ename, category, phase, tid,
+           1e6 * (start - _trace.origin), dur,
+           duration >= 0.0 ? "" : ",\"s\":\"t\"");
+
+  dt_pthread_mutex_lock(&_trace.lock);
+  if(_trace.f) _write_event(json);
+  dt_pthread_mutex_unlock(&_trace.lock);
+}
+
+void dt_trace_init(void)
+{
+  if(!dt_trace_active() || _trace.f) return;
+
+  gchar *filename = g_strdup_printf("darktable-trace-%d.json", (int)getpid());
+  gchar *path = g_build_filename(darktable.tmp_directory
+                                 ? darktable.tmp_directory
+                                 : g_get_tmp_dir(),
+                                 filename, NULL);
+  g_free(filename);
+
+  _trace.f = g_fopen(path, "wb");
+  if(!_trace.f)
+  {
+    dt_print(DT_DEBUG_ALWAYS, "[trace] can't write trace file '%s'", path);
+    darktable.unmuted &= ~DT_DEBUG_TRACE;
+    g_free(path);
+    return;
+  }
+
+  dt_pthread_mutex_init(&_trace.lock, NULL);
+  dt_atomic_set_int(&_trace.threads, 0);
+  _trace.first = TRUE;
+  _trace.origin = darktable.start_wtime;
+  fprintf(_trace.f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+  dt_print(DT_DEBUG_ALWAYS, "[trace] writing trace events to '%s'", path);
+  g_free(path);
+}
+
+void dt_trace_cleanup(void)
+{
+  if(!_trace.f) return;
+
+  dt_pthread_mutex_lock(&_trace.lock);
+  fprintf(_trace.f, "\n]}\n");
+  fclose(_trace.f);
+  _trace.f = NULL;
+  dt_pthread_mutex_unlock(&_trace.lock);
+}
+
+void dt_trace_complete(const char *category,
+                       const double start,
+                       const double duration,
+                       const char *name)
+{
+  _event("X", category, start, MAX(0.0, duration), name);
+}
+
+void dt_trace_end_ext(const double start,
+                      const char *category,
+                      const char *msg, ...)
+{
+  const double end = dt_get_wtime();
+  char name[512];
+  va_list ap;
+  va_start(ap, msg);
+  vsnprintf(name, sizeof(name), msg, ap);
+  va_end(ap);
+  _event("X", category, start, MAX(0.0, end - start), name);
+}
+
+void dt_trace_instant_ext(const char *category,
+                          const char *msg, ...)
+{
+  const double now = dt_get_wtime();
+  char name[512];
+  va_list ap;
+  va_start(ap, msg);
+  vsnprintf(name, sizeof(name), msg, ap);
+  va_end(ap);
+  _event("i", category, now, -1.0, name);
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -0,0 +1,87 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "common/darktable.h"
+
+/*
+  Structured event tracing, enabled by `-d trace`.
+
+  Events are written in the chrome trace-event json format to
+  darktable-trace-<pid>.json in the dump directory (--dumpdir) or the
+  system temp directory. The file can be loaded into perfetto
+  (ui.perfetto.dev) or chrome://tracing.
+
+  Durations are recorded as complete events:
+
+    const double start = dt_trace_begin();
+    ... work ...
+    dt_trace_end(start, "pipe", "%s %s", pipe_name, module->op);
+
+  Cache hits and similar things are recorded as instant events via
+  dt_trace_instant().
+*/
+
+#define DT_TRACE_PIPE   "pipe"
+#define DT_TRACE_CACHE  "cache"
+#define DT_TRACE_JOB    "job"
+#define DT_TRACE_MIPMAP "mipmap"
+#define DT_TRACE_SQL    "sql"
+
+void dt_trace_init(void);
+void dt_trace_cleanup(void);
+
+static inline gboolean dt_trace_active(void)
+{
+  return darktable.unmuted & DT_DEBUG_TRACE;
+}
+
+// start time of a duration event, 0 if tracing is disabled
+static inline double dt_trace_begin(void)
+{
+  return dt_trace_active() ? dt_get_wtime() : 0.0;
+}
+
+// write a complete event of known start and duration in seconds
+void dt_trace_complete(const char *category,
+                       const double start,
+                       const double duration,
+                       const char *name);
+
+void dt_trace_end_ext(const double start,
+                      const char *category,
+                      const char *msg, ...)
+  __attribute__((format(printf, 3, 4)));
+
+void dt_trace_instant_ext(const char *category,
+                          const char *msg, ...)
+  __attribute__((format(printf, 2, 3)));
+
+// finish a duration event started by dt_trace_begin()
+#define dt_trace_end(start, category, ...) \
+  do{ if(dt_trace_active()) dt_trace_end_ext(start, category, __VA_ARGS__); } while(0)
+
+#define dt_trace_instant(category, ...) \
+  do{ if(dt_trace_active()) dt_trace_instant_ext(category, __VA_ARGS__); } while(0)
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -18,6 +18,8 @@
 
 #include "control/jobs.h"
 #include "control/control.h"
+#include "common/thread_budget.h"
+#include "common/trace.h"
 
 #define DT_CONTROL_FG_PRIORITY 4
 #define DT_CONTROL_MAX_JOBS 30
@@ -238,7 +240,11 @@ static gboolean _control_run_job_res(dt_control_t *control, int32_t res)
     _control_job_set_state(job, DT_JOB_STATE_RUNNING);
 
     /* execute job */
+    const int previous_client = dt_thread_budget_acquire(DT_THREAD_CLIENT_JOB);
+    const double tstart = dt_trace_begin();
     job->result = job->execute(job);
+    dt_trace_end(tstart, DT_TRACE_JOB, "run %s", job->description);
+    dt_thread_budget_release(DT_THREAD_CLIENT_JOB, previous_client);
 
     _control_job_set_state(job, DT_JOB_STATE_FINISHED);
     _control_job_print(job, "run_job-", "", res);
@@ -311,14 +317,32 @@ static _dt_job_t *_control_schedule_job(dt_control_t *control)
   return job;
 }
 
+static inline dt_thread_client_t _thread_client(const dt_job_queue_t id)
+{
+  switch(id)
+  {
+    case DT_JOB_QUEUE_USER_EXPORT:  return DT_THREAD_CLIENT_EXPORT;
+    case DT_JOB_QUEUE_USER_BG:
+    case DT_JOB_QUEUE_SYSTEM_BG:    return DT_THREAD_CLIENT_BACKGROUND;
+    default:                        return DT_THREAD_CLIENT_JOB;
+  }
+}
+
 static void _control_job_execute(_dt_job_t *job)
 {
   _control_job_print(job, "run_job+", "", DT_CTL_WORKER_RESERVED + _control_get_threadid());
 
   _control_job_set_state(job, DT_JOB_STATE_RUNNING);
 
-  /* execute job */
+  /* execute job within the thread budget of its queue */
+  const dt_thread_client_t client = job->is_synchronous
+    ? DT_THREAD_CLIENT_JOB
+    : _thread_client(job->queue);
+  const int previous_client = dt_thread_budget_acquire(client);
+  const double tstart = dt_trace_begin();
   job->result = job->execute(job);
+  dt_trace_end(tstart, DT_TRACE_JOB, "run %s", job->description);
+  dt_thread_budget_release(client, previous_client);
 
   _control_job_set_state(job, DT_JOB_STATE_FINISHED);
   _control_job_print(job, "run_job-", "", DT_CTL_WORKER_RESERVED + _control_get_threadid());
@@ -370,6 +394,7 @@ gboolean dt_control_add_job_res(_dt_job_t *job, const int32_t res)
   }
 
   _control_job_print(job, "add_job_res", "", res);
+  dt_trace_instant(DT_TRACE_JOB, "schedule %s", job->description);
 
   _control_job_set_state(job, DT_JOB_STATE_QUEUED);
   control->job_res[res] = job;
@@ -415,6 +440,7 @@ gboolean dt_control_add_job(dt_job_queue_t queue_id, _dt_job_t *job)
   size_t length = control->queue_length[queue_id];
 
   _control_job_print(job, "add_job", "", (int32_t)length);
+  dt_trace_instant(DT_TRACE_JOB, "schedule %s", job->description);
 
   dt_atomic_add_int(&control->pending_jobs, 1);
   if(queue_id == DT_JOB_QUEUE_SYSTEM_FG)
@@ -521,7 +521,10 @@ gboolean dt_develop_blend_process_cl(dt_iop_module_t *self,
                                      const dt_iop_roi_t *roi_out);
 #endif
 
-#define _BLEND_FUNC_PROTO(align, uni) DT_OMP_DECLARE_SIMD(aligned align uniform uni) static void
+// the per-row blend operators are hot pixel kernels, let the loader pick
+// the best clone for the cpu
+#define _BLEND_FUNC_PROTO(align, uni) \
+  DT_OMP_DECLARE_SIMD(aligned align uniform uni) __DT_CLONE_TARGETS__ static void
 
 G_END_DECLS
 
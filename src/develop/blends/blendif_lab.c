@@ -62,129 +62,140 @@ static inline float _blendif_compute_factor(const float value,
                                             const unsigned int invert_mask,
                                             const float *const restrict parameters)
 {
-  float factor = 0.0f;
-  if(value <= parameters[0])
-  {
-   // we are below the keyframe
-   factor = 0.0f;
-  }
-  else if(value < parameters[1])
-  {
-   // we are on the bottom slope of the keyframe
-   factor = (value - parameters[0]) * parameters[4];
-  }
-  else if(value <= parameters[2])
-  {
-   // we are on the ramp - constant part - of the keyframe
-   factor = 1.0f;
-  }
-  else if(value < parameters[3])
-  {
-   // we are on the top slope of the keyframe
-   factor = 1.0f - (value - parameters[2]) * parameters[5];
-  }
-  else
-  {
-   // we are above the keyframe
-   factor = 0.0f;
-  }
+  // the keyframe is 0 below parameters[0], rises to 1 at parameters[1],
+  // stays there up to parameters[2] and falls back to 0 at parameters[3].
+  // All parameters are read unconditionally and the pieces are selects,
+  // so the kernels calling this vectorise.
+  const float p0 = parameters[0];
+  const float p1 = parameters[1];
+  const float p2 = parameters[2];
+  const float p3 = parameters[3];
+  const float rise_slope = parameters[4];
+  const float fall_slope = parameters[5];
+  const float rise = value <= p0 ? 0.0f : value < p1 ? (value - p0) * rise_slope : 1.0f;
+  const float fall = value <= p2 ? 1.0f : value < p3 ? 1.0f - (value - p2) * fall_slope : 0.0f;
+  const float factor = MIN(rise, fall);
   return invert_mask ? 1.0f - factor : factor; // inverted channel?
 }
 
-DT_OMP_DECLARE_SIMD(aligned(pixels: 16) uniform(parameters, invert_mask, stride))
-static inline void _blendif_lab_l(const float *const restrict pixels,
-                                  float *const restrict mask,
-                                  const size_t stride,
-                                  const float *const restrict parameters,
-                                  const unsigned int invert_mask)
-{
-  for(size_t x = 0, j = 0; x < stride; x++, j += DT_BLENDIF_LAB_CH)
-  {
-    mask[x] *= _blendif_compute_factor(pixels[j + 0] / 100.0f, invert_mask, parameters);
-  }
-}
-
-DT_OMP_DECLARE_SIMD(aligned(pixels: 16) uniform(parameters, invert_mask, stride))
-static inline void _blendif_lab_a(const float *const restrict pixels,
-                                  float *const restrict mask,
-                                  const size_t stride,
-                                  const float *const restrict parameters,
-                                  const unsigned int invert_mask)
-{
-  for(size_t x = 0, j = 0; x < stride; x++, j += DT_BLENDIF_LAB_CH)
-  {
-    mask[x] *= _blendif_compute_factor(pixels[j + 1] / 256.0f, invert_mask, parameters);
-  }
-}
-
-DT_OMP_DECLARE_SIMD(aligned(pixels: 16) uniform(parameters, invert_mask, stride))
-static inline void _blendif_lab_b(const float *const restrict pixels,
-                                  float *const restrict mask,
-                                  const size_t stride,
-                                  const float *const restrict parameters,
-                                  const unsigned int invert_mask)
+// the factor of channel ch, exactly 1 if the channel is not selected. The
+// parameters of unselected channels are open, but values like an infinite
+// saturation would still give 0 with them.
+static inline float _blendif_channel_factor(const float value,
+                                            const size_t ch,
+                                            const unsigned int *const restrict selected,
+                                            const unsigned int *const restrict invert_mask,
+                                            const float *const restrict parameters)
 {
-  for(size_t x = 0, j = 0; x < stride; x++, j += DT_BLENDIF_LAB_CH)
-  {
-    mask[x] *= _blendif_compute_factor(pixels[j + 2] / 256.0f, invert_mask, parameters);
-  }
+  const float factor = _blendif_compute_factor(value, invert_mask[ch],
+                                               parameters + DEVELOP_BLENDIF_PARAMETER_ITEMS * ch);
+  return selected[ch] ? factor : 1.0f;
 }
 
-DT_OMP_DECLARE_SIMD(aligned(pixels, invert_mask: 16) uniform(parameters, invert_mask, stride))
-static inline void _blendif_lch(const float *const restrict pixels,
-                                float *const restrict mask,
-                                const size_t stride,
-                                const float *const restrict parameters,
-                                const unsigned int *const restrict invert_mask)
+// the conditional channels of one side of the blend come in two groups:
+// Lab and LCh. Every combination of groups has its own kernel, chosen
+// once per piece and side, which reads a pixel once and multiplies the
+// factors of all channels of its groups into the mask. The channels of a
+// group that are not selected contribute a factor of exactly 1.
+typedef void(_blendif_kernel)(const float *const restrict pixels,
+                              float *const restrict mask,
+                              const size_t stride,
+                              const float *const restrict parameters,
+                              const unsigned int *const restrict selected,
+                              const unsigned int *const restrict invert_mask);
+
+static inline void _blendif_combine_channels(const float *const restrict pixels,
+                                             float *const restrict mask,
+                                             const size_t stride,
+                                             const float *const restrict parameters,
+                                             const unsigned int *const restrict selected,
+                                             const unsigned int *const restrict invert_mask,
+                                             const gboolean lab,
+                                             const gboolean lch)
 {
+  const dt_aligned_pixel_t lab_scale = { 1.0f / 100.0f, 1.0f / 256.0f, 1.0f / 256.0f, 0.0f };
   const float c_scale = 1.0f / (128.0f * M_SQRT2_F);
   for(size_t x = 0, j = 0; x < stride; x++, j += DT_BLENDIF_LAB_CH)
   {
-    dt_aligned_pixel_t LCH;
-    dt_Lab_2_LCH(pixels + j, LCH);
     float factor = 1.0f;
-    factor *= _blendif_compute_factor(LCH[1] * c_scale, invert_mask[0], parameters);
-    factor *= _blendif_compute_factor(LCH[2], invert_mask[1], parameters + DEVELOP_BLENDIF_PARAMETER_ITEMS);
+    if(lab)
+    {
+      for(size_t i = 0; i < 3; i++)
+        factor *= _blendif_channel_factor(pixels[j + i] * lab_scale[i], DEVELOP_BLENDIF_L_in + i,
+                                          selected, invert_mask, parameters);
+    }
+    if(lch)
+    {
+      dt_aligned_pixel_t LCH;
+      dt_Lab_2_LCH(pixels + j, LCH);
+      factor *= _blendif_channel_factor(LCH[1] * c_scale, DEVELOP_BLENDIF_C_in,
+                                        selected, invert_mask, parameters);
+      factor *= _blendif_channel_factor(LCH[2], DEVELOP_BLENDIF_h_in, selected, invert_mask, parameters);
+    }
     mask[x] *= factor;
   }
 }
 
-DT_OMP_DECLARE_SIMD(aligned(pixels: 16) uniform(stride, blendif, parameters))
-static void _blendif_combine_channels(const float *const restrict pixels,
-                                      float *const restrict mask,
-                                      const size_t stride,
-                                      const unsigned int blendif,
-                                      const float *const restrict parameters)
-{
-  if(blendif & (1 << DEVELOP_BLENDIF_L_in))
-  {
-    const unsigned int invert_mask = (blendif >> 16) & (1 << DEVELOP_BLENDIF_L_in);
-    _blendif_lab_l(pixels, mask, stride, parameters + DEVELOP_BLENDIF_PARAMETER_ITEMS * DEVELOP_BLENDIF_L_in,
-                   invert_mask);
+#define _BLENDIF_KERNEL(name, lab, lch)                                                            \
+  __DT_CLONE_TARGETS__                                                                             \
+  static void _blendif_kernel_##name(const float *const restrict pixels,                           \
+                                     float *const restrict mask,                                   \
+                                     const size_t stride,                                          \
+                                     const float *const restrict parameters,                       \
+                                     const unsigned int *const restrict selected,                  \
+                                     const unsigned int *const restrict invert_mask)               \
+  {                                                                                                \
+    _blendif_combine_channels(pixels, mask, stride, parameters, selected, invert_mask, lab, lch);  \
   }
 
-  if(blendif & (1 << DEVELOP_BLENDIF_A_in))
-  {
-    const unsigned int invert_mask = (blendif >> 16) & (1 << DEVELOP_BLENDIF_A_in);
-    _blendif_lab_a(pixels, mask, stride, parameters + DEVELOP_BLENDIF_PARAMETER_ITEMS * DEVELOP_BLENDIF_A_in,
-                   invert_mask);
-  }
+_BLENDIF_KERNEL(lab, TRUE, FALSE)
+_BLENDIF_KERNEL(lch, FALSE, TRUE)
+_BLENDIF_KERNEL(lab_lch, TRUE, TRUE)
+
+#undef _BLENDIF_KERNEL
+
+// kernel for the channels selected in blendif (shifted to the side), NULL if none is
+static _blendif_kernel *_choose_blendif_kernel(const unsigned int blendif)
+{
+  static _blendif_kernel *const kernels[2][2] = {
+    { NULL, _blendif_kernel_lch },
+    { _blendif_kernel_lab, _blendif_kernel_lab_lch },
+  };
+
+  const gboolean lab = (blendif & ((1 << DEVELOP_BLENDIF_L_in) | (1 << DEVELOP_BLENDIF_A_in)
+                                   | (1 << DEVELOP_BLENDIF_B_in))) != 0;
+  const gboolean lch = (blendif & ((1 << DEVELOP_BLENDIF_C_in) | (1 << DEVELOP_BLENDIF_h_in))) != 0;
+  return kernels[lab][lch];
+}
 
-  if(blendif & (1 << DEVELOP_BLENDIF_B_in))
+static inline void _blendif_apply_opacity(float *const restrict mask,
+                                          const float *const restrict temp_mask,
+                                          const size_t stride,
+                                          const unsigned int mask_inclusive,
+                                          const unsigned int mask_inversed,
+                                          const float global_opacity)
+{
+  if(mask_inclusive)
   {
-    const unsigned int invert_mask = (blendif >> 16) & (1 << DEVELOP_BLENDIF_B_in);
-    _blendif_lab_b(pixels, mask, stride, parameters + DEVELOP_BLENDIF_PARAMETER_ITEMS * DEVELOP_BLENDIF_B_in,
-                   invert_mask);
+    if(mask_inversed)
+    {
+      for(size_t x = 0; x < stride; x++) mask[x] = global_opacity * (1.0f - mask[x]) * temp_mask[x];
+    }
+    else
+    {
+      for(size_t x = 0; x < stride; x++) mask[x] = global_opacity * (1.0f - (1.0f - mask[x]) * temp_mask[x]);
+    }
   }
-
-  if(blendif & ((1 << DEVELOP_BLENDIF_C_in) | (1 << DEVELOP_BLENDIF_h_in)))
+  else
   {
-    const unsigned int invert_mask[2] DT_ALIGNED_PIXEL = {
-        (blendif >> 16) & (1 << DEVELOP_BLENDIF_C_in),
-        (blendif >> 16) & (1 << DEVELOP_BLENDIF_h_in),
-    };
-    _blendif_lch(pixels, mask, stride, parameters + DEVELOP_BLENDIF_PARAMETER_ITEMS * DEVELOP_BLENDIF_C_in,
-                 invert_mask);
+    if(mask_inversed)
+    {
+      for(size_t x = 0; x < stride; x++) mask[x] = global_opacity * (1.0f - mask[x] * temp_mask[x]);
+    }
+    else
+    {
+      for(size_t x = 0; x < stride; x++) mask[x] = global_opacity * mask[x] * temp_mask[x];
+    }
   }
 }
 
@@ -256,71 +267,64 @@ void dt_develop_blendif_lab_make_mask(dt_dev_pixelpipe_iop_t *piece,
     float parameters[DEVELOP_BLENDIF_PARAMETER_ITEMS * DEVELOP_BLENDIF_SIZE] DT_ALIGNED_ARRAY;
     dt_develop_blendif_process_parameters(parameters, d);
 
-    // allocate space for a temporary mask buffer to split the computation of every channel
-    float *const restrict temp_mask = dt_alloc_align_float(buffsize);
-    if(!temp_mask)
+    // only selected channels take part, they are inverted if their invert bit is set
+    unsigned int selected[DEVELOP_BLENDIF_SIZE] DT_ALIGNED_ARRAY;
+    unsigned int invert_mask[DEVELOP_BLENDIF_SIZE] DT_ALIGNED_ARRAY;
+    for(size_t i = 0; i < DEVELOP_BLENDIF_SIZE; i++)
+    {
+      selected[i] = (blendif & (1u << i)) != 0;
+      invert_mask[i] = (blendif & (blendif >> 16) & (1u << i)) != 0;
+    }
+
+    _blendif_kernel *const kernel_in = _choose_blendif_kernel(blendif);
+    _blendif_kernel *const kernel_out = _choose_blendif_kernel(blendif >> DEVELOP_BLENDIF_L_out);
+
+    // a row of the parametric mask per thread, combined with the mask while in cache
+    size_t padded_size;
+    float *const restrict temp_buf = dt_alloc_perthread_float(owidth, &padded_size);
+    if(!temp_buf)
     {
       return;
     }
 
     DT_OMP_PRAGMA(parallel default(none)
-                  dt_omp_firstprivate(temp_mask, mask, a, b, oheight, owidth, iwidth, yoffs, xoffs, buffsize,
-                                      blendif, parameters, mask_inclusive, mask_inversed, global_opacity))
+                  dt_omp_firstprivate(temp_buf, padded_size, mask, a, b, oheight, owidth, iwidth, yoffs, xoffs,
+                                      kernel_in, kernel_out, selected, invert_mask, parameters,
+                                      mask_inclusive, mask_inversed, global_opacity))
     {
       // flush denormals to zero to avoid performance penalty if there are a lot of zero values in the mask
       const int oldMode = dt_mm_enable_flush_zero();
+      float *const restrict temp_mask = dt_get_perthread(temp_buf, padded_size);
 
-      // initialize the parametric mask
-      DT_OMP_PRAGMA(for simd schedule(static) aligned(temp_mask:64))
-      for(size_t x = 0; x < buffsize; x++) temp_mask[x] = 1.0f;
-
-      // combine channels
-      DT_OMP_PRAGMA(for schedule(static))
-      for(size_t y = 0; y < oheight; y++)
-      {
-        const size_t start = ((y + yoffs) * iwidth + xoffs) * DT_BLENDIF_LAB_CH;
-        _blendif_combine_channels(a + start, temp_mask + (y * owidth), owidth, blendif, parameters);
-      }
       DT_OMP_PRAGMA(for schedule(static))
       for(size_t y = 0; y < oheight; y++)
       {
-        const size_t start = (y * owidth) * DT_BLENDIF_LAB_CH;
-        _blendif_combine_channels(b + start, temp_mask + (y * owidth), owidth, blendif >> DEVELOP_BLENDIF_L_out,
-                                  parameters + DEVELOP_BLENDIF_PARAMETER_ITEMS * DEVELOP_BLENDIF_L_out);
-      }
+        for(size_t x = 0; x < owidth; x++) temp_mask[x] = 1.0f;
 
-      // apply global opacity
-      if(mask_inclusive)
-      {
-        if(mask_inversed)
+        // combine channels
+        if(kernel_in)
         {
-          DT_OMP_PRAGMA(for simd schedule(static) aligned(mask, temp_mask:64))
-          for(size_t x = 0; x < buffsize; x++) mask[x] = global_opacity * (1.0f - mask[x]) * temp_mask[x];
+          const size_t start = ((y + yoffs) * iwidth + xoffs) * DT_BLENDIF_LAB_CH;
+          kernel_in(a + start, temp_mask, owidth, parameters, selected, invert_mask);
         }
-        else
+        if(kernel_out)
         {
-          DT_OMP_PRAGMA(for simd schedule(static) aligned(mask, temp_mask:64))
-          for(size_t x = 0; x < buffsize; x++) mask[x] = global_opacity * (1.0f - (1.0f - mask[x]) * temp_mask[x]);
-        }
-      }
-      else
-      {
-        if(mask_inversed)
-        {
-          DT_OMP_PRAGMA(for simd schedule(static) aligned(mask, temp_mask:64))
-          for(size_t x = 0; x < buffsize; x++) mask[x] = global_opacity * (1.0f - mask[x] * temp_mask[x]);
-        }
-        else
-        {
-          DT_OMP_PRAGMA(for simd schedule(static) aligned(mask, temp_mask:64))
-          for(size_t x = 0; x < buffsize; x++) mask[x] = global_opacity * mask[x] * temp_mask[x];
+          const size_t start = (y * owidth) * DT_BLENDIF_LAB_CH;
+          kernel_out(b + start, temp_mask, owidth,
+                     parameters + DEVELOP_BLENDIF_PARAMETER_ITEMS * DEVELOP_BLENDIF_L_out,
+                     selected + DEVELOP_BLENDIF_L_out,
+                     invert_mask + DEVELOP_BLENDIF_L_out);
         }
+
+        // apply global opacity
+        _blendif_apply_opacity(mask + y * owidth, temp_mask, owidth, mask_inclusive, mask_inversed,
+                               global_opacity);
       }
 
       dt_mm_restore_flush_zero(oldMode);
     }
 
-    dt_free_align(temp_mask);
+    dt_free_align(temp_buf);
   }
 }
 
@@ -1276,6 +1280,7 @@ static inline void _display_channel_value(dt_aligned_pixel_t out, const float va
 }
 
 DT_OMP_DECLARE_SIMD(aligned(a, b:16) uniform(channel, stride))
+__DT_CLONE_TARGETS__
 static void _display_channel(const float *const restrict a,
                              float *const restrict b,
                              const float *const restrict mask,
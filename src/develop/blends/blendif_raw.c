@@ -33,8 +33,8 @@
 #include <math.h>
 
 
-typedef void(_blend_row_func)(const float *const restrict a, const float *const restrict b,
-                              float *const restrict out, const float *const restrict mask, const size_t stride);
+typedef void(_blend_row_func)(const float *const a, const float *const b,
+                              float *const out, const float *const restrict mask, const size_t stride);
 #define _BLEND_FUNC _BLEND_FUNC_PROTO((a, b, out: 16), (stride))
 
 void dt_develop_blendif_raw_make_mask(dt_dev_pixelpipe_iop_t *piece,
@@ -70,9 +70,9 @@ void dt_develop_blendif_raw_make_mask(dt_dev_pixelpipe_iop_t *piece,
 
 
 /* normal blend with clamping */
-_BLEND_FUNC _blend_normal_bounded(const float *const restrict a,
-                                  const float *const restrict b,
-                                  float *const restrict out,
+_BLEND_FUNC _blend_normal_bounded(const float *const a,
+                                  const float *const b,
+                                  float *const out,
                                   const float *const restrict mask,
                                   const size_t stride)
 {
@@ -84,9 +84,9 @@ _BLEND_FUNC _blend_normal_bounded(const float *const restrict a,
 }
 
 /* normal blend without any clamping */
-_BLEND_FUNC _blend_normal_unbounded(const float *const restrict a,
-                                    const float *const restrict b,
-                                    float *const restrict out,
+_BLEND_FUNC _blend_normal_unbounded(const float *const a,
+                                    const float *const b,
+                                    float *const out,
                                     const float *const restrict mask,
                                     const size_t stride)
 {
@@ -98,9 +98,9 @@ _BLEND_FUNC _blend_normal_unbounded(const float *const restrict a,
 }
 
 /* lighten */
-_BLEND_FUNC _blend_lighten(const float *const restrict a,
-                           const float *const restrict b,
-                           float *const restrict out,
+_BLEND_FUNC _blend_lighten(const float *const a,
+                           const float *const b,
+                           float *const out,
                            const float *const restrict mask,
                            const size_t stride)
 {
@@ -112,9 +112,9 @@ _BLEND_FUNC _blend_lighten(const float *const restrict a,
 }
 
 /* darken */
-_BLEND_FUNC _blend_darken(const float *const restrict a,
-                          const float *const restrict b,
-                          float *const restrict out,
+_BLEND_FUNC _blend_darken(const float *const a,
+                          const float *const b,
+                          float *const out,
                           const float *const restrict mask,
                           const size_t stride)
 {
@@ -126,9 +126,9 @@ _BLEND_FUNC _blend_darken(const float *const restrict a,
 }
 
 /* multiply */
-_BLEND_FUNC _blend_multiply(const float *const restrict a,
-                            const float *const restrict b,
-                            float *const restrict out,
+_BLEND_FUNC _blend_multiply(const float *const a,
+                            const float *const b,
+                            float *const out,
                             const float *const restrict mask,
                             const size_t stride)
 {
@@ -140,9 +140,9 @@ _BLEND_FUNC _blend_multiply(const float *const restrict a,
 }
 
 /* average */
-_BLEND_FUNC _blend_average(const float *const restrict a,
-                           const float *const restrict b,
-                           float *const restrict out,
+_BLEND_FUNC _blend_average(const float *const a,
+                           const float *const b,
+                           float *const out,
                            const float *const restrict mask,
                            const size_t stride)
 {
@@ -154,9 +154,9 @@ _BLEND_FUNC _blend_average(const float *const restrict a,
 }
 
 /* add */
-_BLEND_FUNC _blend_add(const float *const restrict a,
-                       const float *const restrict b,
-                       float *const restrict out,
+_BLEND_FUNC _blend_add(const float *const a,
+                       const float *const b,
+                       float *const out,
                        const float *const restrict mask,
                        const size_t stride)
 {
@@ -168,9 +168,9 @@ _BLEND_FUNC _blend_add(const float *const restrict a,
 }
 
 /* subtract */
-_BLEND_FUNC _blend_subtract(const float *const restrict a,
-                            const float *const restrict b,
-                            float *const restrict out,
+_BLEND_FUNC _blend_subtract(const float *const a,
+                            const float *const b,
+                            float *const out,
                             const float *const restrict mask,
                             const size_t stride)
 {
@@ -182,9 +182,9 @@ _BLEND_FUNC _blend_subtract(const float *const restrict a,
 }
 
 /* difference */
-_BLEND_FUNC _blend_difference(const float *const restrict a,
-                              const float *const restrict b,
-                              float *const restrict out,
+_BLEND_FUNC _blend_difference(const float *const a,
+                              const float *const b,
+                              float *const out,
                               const float *const restrict mask,
                               const size_t stride)
 {
@@ -196,9 +196,9 @@ _BLEND_FUNC _blend_difference(const float *const restrict a,
 }
 
 /* screen */
-_BLEND_FUNC _blend_screen(const float *const restrict a,
-                          const float *const restrict b,
-                          float *const restrict out,
+_BLEND_FUNC _blend_screen(const float *const a,
+                          const float *const b,
+                          float *const out,
                           const float *const restrict mask,
                           const size_t stride)
 {
@@ -212,9 +212,9 @@ _BLEND_FUNC _blend_screen(const float *const restrict a,
 }
 
 /* overlay */
-_BLEND_FUNC _blend_overlay(const float *const restrict a,
-                           const float *const restrict b,
-                           float *const restrict out,
+_BLEND_FUNC _blend_overlay(const float *const a,
+                           const float *const b,
+                           float *const out,
                            const float *const restrict mask,
                            const size_t stride)
 {
@@ -231,9 +231,9 @@ _BLEND_FUNC _blend_overlay(const float *const restrict a,
 }
 
 /* softlight */
-_BLEND_FUNC _blend_softlight(const float *const restrict a,
-                             const float *const restrict b,
-                             float *const restrict out,
+_BLEND_FUNC _blend_softlight(const float *const a,
+                             const float *const b,
+                             float *const out,
                              const float *const restrict mask,
                              const size_t stride)
 {
@@ -250,9 +250,9 @@ _BLEND_FUNC _blend_softlight(const float *const restrict a,
 }
 
 /* hardlight */
-_BLEND_FUNC _blend_hardlight(const float *const restrict a,
-                             const float *const restrict b,
-                             float *const restrict out,
+_BLEND_FUNC _blend_hardlight(const float *const a,
+                             const float *const b,
+                             float *const out,
                              const float *const restrict mask,
                              const size_t stride)
 {
@@ -269,9 +269,9 @@ _BLEND_FUNC _blend_hardlight(const float *const restrict a,
 }
 
 /* vividlight */
-_BLEND_FUNC _blend_vividlight(const float *const restrict a,
-                              const float *const restrict b,
-                              float *const restrict out,
+_BLEND_FUNC _blend_vividlight(const float *const a,
+                              const float *const b,
+                              float *const out,
                               const float *const restrict mask,
                               const size_t stride)
 {
@@ -290,9 +290,9 @@ _BLEND_FUNC _blend_vividlight(const float *const restrict a,
 }
 
 /* linearlight */
-_BLEND_FUNC _blend_linearlight(const float *const restrict a,
-                               const float *const restrict b,
-                               float *const restrict out,
+_BLEND_FUNC _blend_linearlight(const float *const a,
+                               const float *const b,
+                               float *const out,
                                const float *const restrict mask,
                                const size_t stride)
 {
@@ -307,9 +307,9 @@ _BLEND_FUNC _blend_linearlight(const float *const restrict a,
 }
 
 /* pinlight */
-_BLEND_FUNC _blend_pinlight(const float *const restrict a,
-                            const float *const restrict b,
-                            float *const restrict out,
+_BLEND_FUNC _blend_pinlight(const float *const a,
+                            const float *const b,
+                            float *const out,
                             const float *const restrict mask,
                             const size_t stride)
 {
@@ -417,31 +417,27 @@ void dt_develop_blendif_raw_blend(dt_dev_pixelpipe_iop_t *piece,
   {
     _blend_row_func *const blend = _choose_blend_func(d->blend_mode);
 
-    float *tmp_buffer = dt_alloc_align_float((size_t)owidth * oheight);
-    if(tmp_buffer != NULL)
+    // the operators read a pixel of both inputs before writing it, so
+    // they blend in place into b
+    if((d->blend_mode & DEVELOP_BLEND_REVERSE) == DEVELOP_BLEND_REVERSE)
     {
-      dt_iop_image_copy(tmp_buffer, b, (size_t)owidth * oheight);
-      if((d->blend_mode & DEVELOP_BLEND_REVERSE) == DEVELOP_BLEND_REVERSE)
+      DT_OMP_FOR()
+      for(size_t y = 0; y < oheight; y++)
       {
-        DT_OMP_FOR()
-        for(size_t y = 0; y < oheight; y++)
-        {
-          const size_t a_start = (y + yoffs) * iwidth + xoffs;
-          const size_t bm_start = y * owidth;
-          blend(tmp_buffer + bm_start, a + a_start, b + bm_start, mask + bm_start, owidth);
-        }
+        const size_t a_start = (y + yoffs) * iwidth + xoffs;
+        const size_t bm_start = y * owidth;
+        blend(b + bm_start, a + a_start, b + bm_start, mask + bm_start, owidth);
       }
-      else
+    }
+    else
+    {
+      DT_OMP_FOR()
+      for(size_t y = 0; y < oheight; y++)
       {
-        DT_OMP_FOR()
-        for(size_t y = 0; y < oheight; y++)
-        {
-          const size_t a_start = (y + yoffs) * iwidth + xoffs;
-          const size_t bm_start = y * owidth;
-          blend(a + a_start, tmp_buffer + bm_start, b + bm_start, mask + bm_start, owidth);
-        }
+        const size_t a_start = (y + yoffs) * iwidth + xoffs;
+        const size_t bm_start = y * owidth;
+        blend(a + a_start, b + bm_start, b + bm_start, mask + bm_start, owidth);
       }
-      dt_free_align(tmp_buffer);
     }
   }
 }
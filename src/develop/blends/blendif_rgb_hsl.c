@@ -56,176 +56,180 @@ static inline float _blendif_compute_factor(const float value,
                                             const unsigned int invert_mask,
                                             const float *const restrict parameters)
 {
-  float factor = 0.0f;
-  if(value <= parameters[0])
-  {
-   // we are below the keyframe
-   factor = 0.0f;
-  }
-  else if(value < parameters[1])
-  {
-   // we are on the bottom slope of the keyframe
-   factor = (value - parameters[0]) * parameters[4];
-  }
-  else if(value <= parameters[2])
-  {
-   // we are on the ramp - constant part - of the keyframe
-   factor = 1.0f;
-  }
-  else if(value < parameters[3])
-  {
-   // we are on the top slope of the keyframe
-   factor = 1.0f - (value - parameters[2]) * parameters[5];
-  }
-  else
-  {
-   // we are above the keyframe
-   factor = 0.0f;
-  }
+  // the keyframe is 0 below parameters[0], rises to 1 at parameters[1],
+  // stays there up to parameters[2] and falls back to 0 at parameters[3].
+  // All parameters are read unconditionally and the pieces are selects,
+  // so the kernels calling this vectorise.
+  const float p0 = parameters[0];
+  const float p1 = parameters[1];
+  const float p2 = parameters[2];
+  const float p3 = parameters[3];
+  const float rise_slope = parameters[4];
+  const float fall_slope = parameters[5];
+  const float rise = value <= p0 ? 0.0f : value < p1 ? (value - p0) * rise_slope : 1.0f;
+  const float fall = value <= p2 ? 1.0f : value < p3 ? 1.0f - (value - p2) * fall_slope : 0.0f;
+  const float factor = MIN(rise, fall);
   return invert_mask ? 1.0f - factor : factor; // inverted channel?
 }
 
-DT_OMP_DECLARE_SIMD(aligned(pixels: 16) uniform(parameters, invert_mask, stride, profile))
-static inline void _blendif_gray(const float *const restrict pixels,
-                                 float *const restrict mask,
-                                 const size_t stride,
-                                 const float *const restrict parameters,
-                                 const unsigned int invert_mask,
-                                 const dt_iop_order_iccprofile_info_t *const restrict profile)
+// the factor of channel ch, exactly 1 if the channel is not selected. The
+// parameters of unselected channels are open, but values like an infinite
+// saturation would still give 0 with them.
+static inline float _blendif_channel_factor(const float value,
+                                            const size_t ch,
+                                            const unsigned int *const restrict selected,
+                                            const unsigned int *const restrict invert_mask,
+                                            const float *const restrict parameters)
 {
-  for(size_t x = 0, j = 0; x < stride; x++, j += DT_BLENDIF_RGB_CH)
-  {
-    const float value = dt_ioppr_get_rgb_matrix_luminance(pixels + j, profile->matrix_in, profile->lut_in,
-                                                          profile->unbounded_coeffs_in, profile->lutsize,
-                                                          profile->nonlinearlut);
-    mask[x] *= _blendif_compute_factor(value, invert_mask, parameters);
-  }
+  const float factor = _blendif_compute_factor(value, invert_mask[ch],
+                                               parameters + DEVELOP_BLENDIF_PARAMETER_ITEMS * ch);
+  return selected[ch] ? factor : 1.0f;
 }
 
-DT_OMP_DECLARE_SIMD(aligned(pixels: 16) uniform(parameters, invert_mask, stride))
-static inline void _blendif_gray_fb(const float *const restrict pixels,
-                                    float *const restrict mask,
-                                    const size_t stride,
-                                    const float *const restrict parameters,
-                                    const unsigned int invert_mask)
+// the conditional channels of one side of the blend come in groups: gray,
+// the rgb channels and hsl. Every combination of groups has its own
+// kernel, chosen once per piece and side, which reads a pixel once and
+// multiplies the factors of all channels of its groups into the mask.
+// The channels of a group that are not selected contribute a factor of
+// exactly 1.
+typedef void(_blendif_kernel)(const float *const restrict pixels,
+                              float *const restrict mask,
+                              const size_t stride,
+                              const float *const restrict parameters,
+                              const unsigned int *const restrict selected,
+                              const unsigned int *const restrict invert_mask,
+                              const dt_iop_order_iccprofile_info_t *const restrict profile);
+
+typedef enum _blendif_gray_t
 {
-  for(size_t x = 0, j = 0; x < stride; x++, j += DT_BLENDIF_RGB_CH)
-  {
-    const float value = 0.3f * pixels[j + 0] + 0.59f * pixels[j + 1] + 0.11f * pixels[j + 2];
-    mask[x] *= _blendif_compute_factor(value, invert_mask, parameters);
-  }
-}
-
-DT_OMP_DECLARE_SIMD(aligned(pixels: 16) uniform(parameters, invert_mask, stride))
-static inline void _blendif_rgb_red(const float *const restrict pixels,
-                                    float *const restrict mask,
-                                    const size_t stride,
-                                    const float *const restrict parameters,
-                                    const unsigned int invert_mask)
+  _GRAY_NONE = 0,
+  _GRAY_PROFILE = 1,
+  _GRAY_FALLBACK = 2
+} _blendif_gray_t;
+
+static inline void _blendif_combine_channels(const float *const restrict pixels,
+                                             float *const restrict mask,
+                                             const size_t stride,
+                                             const float *const restrict parameters,
+                                             const unsigned int *const restrict selected,
+                                             const unsigned int *const restrict invert_mask,
+                                             const dt_iop_order_iccprofile_info_t *const restrict profile,
+                                             const _blendif_gray_t gray,
+                                             const gboolean rgb,
+                                             const gboolean hsl)
 {
   for(size_t x = 0, j = 0; x < stride; x++, j += DT_BLENDIF_RGB_CH)
   {
-    mask[x] *= _blendif_compute_factor(pixels[j + 0], invert_mask, parameters);
+    const float *const restrict pixel = pixels + j;
+    float factor = 1.0f;
+    if(gray == _GRAY_PROFILE)
+    {
+      const float value = dt_ioppr_get_rgb_matrix_luminance(pixel, profile->matrix_in, profile->lut_in,
+                                                            profile->unbounded_coeffs_in, profile->lutsize,
+                                                            profile->nonlinearlut);
+      factor *= _blendif_channel_factor(value, DEVELOP_BLENDIF_GRAY_in, selected, invert_mask, parameters);
+    }
+    else if(gray == _GRAY_FALLBACK)
+    {
+      const float value = 0.3f * pixel[0] + 0.59f * pixel[1] + 0.11f * pixel[2];
+      factor *= _blendif_channel_factor(value, DEVELOP_BLENDIF_GRAY_in, selected, invert_mask, parameters);
+    }
+    if(rgb)
+    {
+      for(size_t i = 0; i < 3; i++)
+        factor *= _blendif_channel_factor(pixel[i], DEVELOP_BLENDIF_RED_in + i,
+                                          selected, invert_mask, parameters);
+    }
+    if(hsl)
+    {
+      dt_aligned_pixel_t HSL;
+      dt_RGB_2_HSL(pixel, HSL);
+      for(size_t i = 0; i < 3; i++)
+        factor *= _blendif_channel_factor(HSL[i], DEVELOP_BLENDIF_H_in + i,
+                                          selected, invert_mask, parameters);
+    }
+    mask[x] *= factor;
   }
 }
 
-DT_OMP_DECLARE_SIMD(aligned(pixels: 16) uniform(parameters, invert_mask, stride))
-static inline void _blendif_rgb_green(const float *const restrict pixels,
-                                      float *const restrict mask,
-                                      const size_t stride,
-                                      const float *const restrict parameters,
-                                      const unsigned int invert_mask)
-{
-  for(size_t x = 0, j = 0; x < stride; x++, j += DT_BLENDIF_RGB_CH)
-  {
-    mask[x] *= _blendif_compute_factor(pixels[j + 1], invert_mask, parameters);
+#define _BLENDIF_KERNEL(name, gray, rgb, hsl)                                                     \
+  __DT_CLONE_TARGETS__                                                                            \
+  static void _blendif_kernel_##name(const float *const restrict pixels,                          \
+                                     float *const restrict mask,                                  \
+                                     const size_t stride,                                         \
+                                     const float *const restrict parameters,                      \
+                                     const unsigned int *const restrict selected,                 \
+                                     const unsigned int *const restrict invert_mask,              \
+                                     const dt_iop_order_iccprofile_info_t *const restrict profile) \
+  {                                                                                               \
+    _blendif_combine_channels(pixels, mask, stride, parameters, selected, invert_mask, profile,   \
+                              gray, rgb, hsl);                                                    \
   }
-}
 
-DT_OMP_DECLARE_SIMD(aligned(pixels: 16) uniform(parameters, invert_mask, stride))
-static inline void _blendif_rgb_blue(const float *const restrict pixels,
-                                     float *const restrict mask,
-                                     const size_t stride,
-                                     const float *const restrict parameters,
-                                     const unsigned int invert_mask)
+_BLENDIF_KERNEL(hsl, _GRAY_NONE, FALSE, TRUE)
+_BLENDIF_KERNEL(rgb, _GRAY_NONE, TRUE, FALSE)
+_BLENDIF_KERNEL(rgb_hsl, _GRAY_NONE, TRUE, TRUE)
+_BLENDIF_KERNEL(gray, _GRAY_PROFILE, FALSE, FALSE)
+_BLENDIF_KERNEL(gray_hsl, _GRAY_PROFILE, FALSE, TRUE)
+_BLENDIF_KERNEL(gray_rgb, _GRAY_PROFILE, TRUE, FALSE)
+_BLENDIF_KERNEL(gray_rgb_hsl, _GRAY_PROFILE, TRUE, TRUE)
+_BLENDIF_KERNEL(gray_fb, _GRAY_FALLBACK, FALSE, FALSE)
+_BLENDIF_KERNEL(gray_fb_hsl, _GRAY_FALLBACK, FALSE, TRUE)
+_BLENDIF_KERNEL(gray_fb_rgb, _GRAY_FALLBACK, TRUE, FALSE)
+_BLENDIF_KERNEL(gray_fb_rgb_hsl, _GRAY_FALLBACK, TRUE, TRUE)
+
+#undef _BLENDIF_KERNEL
+
+// kernel for the channels selected in blendif (shifted to the side), NULL if none is
+static _blendif_kernel *_choose_blendif_kernel(const unsigned int blendif,
+                                               const gboolean use_profile)
 {
-  for(size_t x = 0, j = 0; x < stride; x++, j += DT_BLENDIF_RGB_CH)
-  {
-    mask[x] *= _blendif_compute_factor(pixels[j + 2], invert_mask, parameters);
-  }
+  static _blendif_kernel *const kernels[3][2][2] = {
+    { { NULL, _blendif_kernel_hsl },
+      { _blendif_kernel_rgb, _blendif_kernel_rgb_hsl } },
+    { { _blendif_kernel_gray, _blendif_kernel_gray_hsl },
+      { _blendif_kernel_gray_rgb, _blendif_kernel_gray_rgb_hsl } },
+    { { _blendif_kernel_gray_fb, _blendif_kernel_gray_fb_hsl },
+      { _blendif_kernel_gray_fb_rgb, _blendif_kernel_gray_fb_rgb_hsl } },
+  };
+
+  const _blendif_gray_t gray = !(blendif & (1 << DEVELOP_BLENDIF_GRAY_in)) ? _GRAY_NONE
+                               : use_profile ? _GRAY_PROFILE : _GRAY_FALLBACK;
+  const gboolean rgb = (blendif & ((1 << DEVELOP_BLENDIF_RED_in) | (1 << DEVELOP_BLENDIF_GREEN_in)
+                                   | (1 << DEVELOP_BLENDIF_BLUE_in))) != 0;
+  const gboolean hsl = (blendif & ((1 << DEVELOP_BLENDIF_H_in) | (1 << DEVELOP_BLENDIF_S_in)
+                                   | (1 << DEVELOP_BLENDIF_l_in))) != 0;
+  return kernels[gray][rgb][hsl];
 }
 
-DT_OMP_DECLARE_SIMD(aligned(pixels, invert_mask: 16) uniform(parameters, invert_mask, stride))
-static inline void _blendif_hsl(const float *const restrict pixels,
-                                float *const restrict mask,
-                                const size_t stride,
-                                const float *const restrict parameters,
-                                const unsigned int *const restrict invert_mask)
+static inline void _blendif_apply_opacity(float *const restrict mask,
+                                          const float *const restrict temp_mask,
+                                          const size_t stride,
+                                          const unsigned int mask_inclusive,
+                                          const unsigned int mask_inversed,
+                                          const float global_opacity)
 {
-  for(size_t x = 0, j = 0; x < stride; x++, j += DT_BLENDIF_RGB_CH)
+  if(mask_inclusive)
   {
-    dt_aligned_pixel_t HSL;
-    dt_RGB_2_HSL(pixels + j, HSL);
-    float factor = 1.0f;
-    for(size_t i = 0; i < 3; i++)
-      factor *= _blendif_compute_factor(HSL[i], invert_mask[i], parameters + DEVELOP_BLENDIF_PARAMETER_ITEMS * i);
-    mask[x] *= factor;
-  }
-}
-
-DT_OMP_DECLARE_SIMD(aligned(pixels: 16) uniform(stride, blendif, parameters, profile))
-static void _blendif_combine_channels(const float *const restrict pixels,
-                                      float *const restrict mask,
-                                      const size_t stride,
-                                      const unsigned int blendif,
-                                      const float *const restrict parameters,
-                                      const dt_iop_order_iccprofile_info_t *const restrict profile)
-{
-  if(blendif & (1 << DEVELOP_BLENDIF_GRAY_in))
-  {
-    const unsigned int invert_mask = (blendif >> 16) & (1 << DEVELOP_BLENDIF_GRAY_in);
-    if(profile)
+    if(mask_inversed)
     {
-      _blendif_gray(pixels, mask, stride, parameters + DEVELOP_BLENDIF_PARAMETER_ITEMS * DEVELOP_BLENDIF_GRAY_in,
-                    invert_mask, profile);
+      for(size_t x = 0; x < stride; x++) mask[x] = global_opacity * (1.0f - mask[x]) * temp_mask[x];
     }
     else
     {
-      _blendif_gray_fb(pixels, mask, stride,
-                       parameters + DEVELOP_BLENDIF_PARAMETER_ITEMS * DEVELOP_BLENDIF_GRAY_in, invert_mask);
+      for(size_t x = 0; x < stride; x++) mask[x] = global_opacity * (1.0f - (1.0f - mask[x]) * temp_mask[x]);
     }
   }
-
-  if(blendif & (1 << DEVELOP_BLENDIF_RED_in))
-  {
-    const unsigned int invert_mask = (blendif >> 16) & (1 << DEVELOP_BLENDIF_RED_in);
-    _blendif_rgb_red(pixels, mask, stride, parameters + DEVELOP_BLENDIF_PARAMETER_ITEMS * DEVELOP_BLENDIF_RED_in,
-                     invert_mask);
-  }
-
-  if(blendif & (1 << DEVELOP_BLENDIF_GREEN_in))
-  {
-    const unsigned int invert_mask = (blendif >> 16) & (1 << DEVELOP_BLENDIF_GREEN_in);
-    _blendif_rgb_green(pixels, mask, stride,
-                       parameters + DEVELOP_BLENDIF_PARAMETER_ITEMS * DEVELOP_BLENDIF_GREEN_in, invert_mask);
-  }
-
-  if(blendif & (1 << DEVELOP_BLENDIF_BLUE_in))
-  {
-    const unsigned int invert_mask = (blendif >> 16) & (1 << DEVELOP_BLENDIF_BLUE_in);
-    _blendif_rgb_blue(pixels, mask, stride, parameters + DEVELOP_BLENDIF_PARAMETER_ITEMS * DEVELOP_BLENDIF_BLUE_in,
-                      invert_mask);
-  }
-
-  if(blendif & ((1 << DEVELOP_BLENDIF_H_in) | (1 << DEVELOP_BLENDIF_S_in) | (1 << DEVELOP_BLENDIF_l_in)))
+  else
   {
-    const unsigned int invert_mask[3] DT_ALIGNED_PIXEL = {
-        (blendif >> 16) & (1 << DEVELOP_BLENDIF_H_in),
-        (blendif >> 16) & (1 << DEVELOP_BLENDIF_S_in),
-        (blendif >> 16) & (1 << DEVELOP_BLENDIF_l_in),
-    };
-    _blendif_hsl(pixels, mask, stride, parameters + DEVELOP_BLENDIF_PARAMETER_ITEMS * DEVELOP_BLENDIF_H_in,
-                 invert_mask);
+    if(mask_inversed)
+    {
+      for(size_t x = 0; x < stride; x++) mask[x] = global_opacity * (1.0f - mask[x] * temp_mask[x]);
+    }
+    else
+    {
+      for(size_t x = 0; x < stride; x++) mask[x] = global_opacity * mask[x] * temp_mask[x];
+    }
   }
 }
 
@@ -296,72 +300,64 @@ void dt_develop_blendif_rgb_hsl_make_mask(dt_dev_pixelpipe_iop_t *piece,
                                                                     DEVELOP_BLEND_CS_RGB_DISPLAY);
     const dt_iop_order_iccprofile_info_t *profile = use_profile ? &blend_profile : NULL;
 
-    // allocate space for a temporary mask buffer to split the computation of every channel
-    float *const restrict temp_mask = dt_alloc_align_float(buffsize);
-    if(!temp_mask)
+    // only selected channels take part, they are inverted if their invert bit is set
+    unsigned int selected[DEVELOP_BLENDIF_SIZE] DT_ALIGNED_ARRAY;
+    unsigned int invert_mask[DEVELOP_BLENDIF_SIZE] DT_ALIGNED_ARRAY;
+    for(size_t i = 0; i < DEVELOP_BLENDIF_SIZE; i++)
+    {
+      selected[i] = (blendif & (1u << i)) != 0;
+      invert_mask[i] = (blendif & (blendif >> 16) & (1u << i)) != 0;
+    }
+
+    _blendif_kernel *const kernel_in = _choose_blendif_kernel(blendif, use_profile);
+    _blendif_kernel *const kernel_out = _choose_blendif_kernel(blendif >> DEVELOP_BLENDIF_GRAY_out, use_profile);
+
+    // a row of the parametric mask per thread, combined with the mask while in cache
+    size_t padded_size;
+    float *const restrict temp_buf = dt_alloc_perthread_float(owidth, &padded_size);
+    if(!temp_buf)
     {
       return;
     }
 
     DT_OMP_PRAGMA(parallel default(none)
-                  dt_omp_firstprivate(temp_mask, mask, a, b, oheight, owidth, iwidth, yoffs, xoffs, buffsize,
-                                      blendif, profile, parameters, mask_inclusive, mask_inversed, global_opacity))
+                  dt_omp_firstprivate(temp_buf, padded_size, mask, a, b, oheight, owidth, iwidth, yoffs, xoffs,
+                                      kernel_in, kernel_out, selected, invert_mask, profile, parameters,
+                                      mask_inclusive, mask_inversed, global_opacity))
     {
       // flush denormals to zero to avoid performance penalty if there are a lot of zero values in the mask
       const int oldMode = dt_mm_enable_flush_zero();
+      float *const restrict temp_mask = dt_get_perthread(temp_buf, padded_size);
 
-      // initialize the parametric mask
-      DT_OMP_PRAGMA(for simd schedule(static) aligned(temp_mask:64))
-      for(size_t x = 0; x < buffsize; x++) temp_mask[x] = 1.0f;
-
-      // combine channels
-      DT_OMP_PRAGMA(for schedule(static))
-      for(size_t y = 0; y < oheight; y++)
-      {
-        const size_t start = ((y + yoffs) * iwidth + xoffs) * DT_BLENDIF_RGB_CH;
-        _blendif_combine_channels(a + start, temp_mask + (y * owidth), owidth, blendif, parameters, profile);
-      }
       DT_OMP_PRAGMA(for schedule(static))
       for(size_t y = 0; y < oheight; y++)
       {
-        const size_t start = (y * owidth) * DT_BLENDIF_RGB_CH;
-        _blendif_combine_channels(b + start, temp_mask + (y * owidth), owidth, blendif >> DEVELOP_BLENDIF_GRAY_out,
-                                  parameters + DEVELOP_BLENDIF_PARAMETER_ITEMS * DEVELOP_BLENDIF_GRAY_out,
-                                  profile);
-      }
+        for(size_t x = 0; x < owidth; x++) temp_mask[x] = 1.0f;
 
-      // apply global opacity
-      if(mask_inclusive)
-      {
-        if(mask_inversed)
-        {
-          DT_OMP_PRAGMA(for simd schedule(static) aligned(mask, temp_mask:64))
-          for(size_t x = 0; x < buffsize; x++) mask[x] = global_opacity * (1.0f - mask[x]) * temp_mask[x];
-        }
-        else
+        // combine channels
+        if(kernel_in)
         {
-          DT_OMP_PRAGMA(for simd schedule(static) aligned(mask, temp_mask:64))
-          for(size_t x = 0; x < buffsize; x++) mask[x] = global_opacity * (1.0f - (1.0f - mask[x]) * temp_mask[x]);
+          const size_t start = ((y + yoffs) * iwidth + xoffs) * DT_BLENDIF_RGB_CH;
+          kernel_in(a + start, temp_mask, owidth, parameters, selected, invert_mask, profile);
         }
-      }
-      else
-      {
-        if(mask_inversed)
+        if(kernel_out)
         {
-          DT_OMP_PRAGMA(for simd schedule(static) aligned(mask, temp_mask:64))
-          for(size_t x = 0; x < buffsize; x++) mask[x] = global_opacity * (1.0f - mask[x] * temp_mask[x]);
-        }
-        else
-        {
-          DT_OMP_PRAGMA(for simd schedule(static) aligned(mask, temp_mask:64))
-          for(size_t x = 0; x < buffsize; x++) mask[x] = global_opacity * mask[x] * temp_mask[x];
+          const size_t start = (y * owidth) * DT_BLENDIF_RGB_CH;
+          kernel_out(b + start, temp_mask, owidth,
+                     parameters + DEVELOP_BLENDIF_PARAMETER_ITEMS * DEVELOP_BLENDIF_GRAY_out,
+                     selected + DEVELOP_BLENDIF_GRAY_out,
+                     invert_mask + DEVELOP_BLENDIF_GRAY_out, profile);
         }
+
+        // apply global opacity
+        _blendif_apply_opacity(mask + y * owidth, temp_mask, owidth, mask_inclusive, mask_inversed,
+                               global_opacity);
       }
 
       dt_mm_restore_flush_zero(oldMode);
     }
 
-    dt_free_align(temp_mask);
+    dt_free_align(temp_buf);
   }
 }
 
@@ -1096,6 +1092,7 @@ static inline float _rgb_luminance(const float *const restrict rgb,
 }
 
 DT_OMP_DECLARE_SIMD(aligned(a, b:16) uniform(channel, profile, stride))
+__DT_CLONE_TARGETS__
 static void _display_channel(const float *const restrict a,
                              float *const restrict b,
                              const float *const restrict mask,
@@ -49,206 +49,198 @@ static inline float _blendif_compute_factor(const float value,
                                             const unsigned int invert_mask,
                                             const float *const restrict parameters)
 {
-  float factor = 0.0f;
-  if(value <= parameters[0])
-  {
-   // we are below the keyframe
-   factor = 0.0f;
-  }
-  else if(value < parameters[1])
-  {
-   // we are on the bottom slope of the keyframe
-   factor = (value - parameters[0]) * parameters[4];
-  }
-  else if(value <= parameters[2])
-  {
-   // we are on the ramp - constant part - of the keyframe
-   factor = 1.0f;
-  }
-  else if(value < parameters[3])
-  {
-   // we are on the top slope of the keyframe
-   factor = 1.0f - (value - parameters[2]) * parameters[5];
-  }
-  else
-  {
-   // we are above the keyframe
-   factor = 0.0f;
-  }
+  // the keyframe is 0 below parameters[0], rises to 1 at parameters[1],
+  // stays there up to parameters[2] and falls back to 0 at parameters[3].
+  // All parameters are read unconditionally and the pieces are selects,
+  // so the kernels calling this vectorise.
+  const float p0 = parameters[0];
+  const float p1 = parameters[1];
+  const float p2 = parameters[2];
+  const float p3 = parameters[3];
+  const float rise_slope = parameters[4];
+  const float fall_slope = parameters[5];
+  const float rise = value <= p0 ? 0.0f : value < p1 ? (value - p0) * rise_slope : 1.0f;
+  const float fall = value <= p2 ? 1.0f : value < p3 ? 1.0f - (value - p2) * fall_slope : 0.0f;
+  const float factor = MIN(rise, fall);
   return invert_mask ? 1.0f - factor : factor; // inverted channel?
 }
 
-DT_OMP_DECLARE_SIMD(aligned(pixels: 16) uniform(parameters, invert_mask, stride, profile))
-static inline void _blendif_gray(const float *const restrict pixels,
-                                 float *const restrict mask,
-                                 const size_t stride,
-                                 const float *const restrict parameters,
-                                 const unsigned int invert_mask,
-                                 const dt_iop_order_iccprofile_info_t *const restrict profile)
-{
-  for(size_t x = 0, j = 0; x < stride; x++, j += DT_BLENDIF_RGB_CH)
-  {
-    const float value = dt_ioppr_get_rgb_matrix_luminance(pixels + j, profile->matrix_in, profile->lut_in,
-                                                          profile->unbounded_coeffs_in, profile->lutsize,
-                                                          profile->nonlinearlut);
-    mask[x] *= _blendif_compute_factor(value, invert_mask, parameters);
-  }
-}
-
-DT_OMP_DECLARE_SIMD(aligned(pixels: 16) uniform(parameters, invert_mask, stride))
-static inline void _blendif_rgb_red(const float *const restrict pixels,
-                                    float *const restrict mask,
-                                    const size_t stride,
-                                    const float *const restrict parameters,
-                                    const unsigned int invert_mask)
+// the factor of channel ch, exactly 1 if the channel is not selected. The
+// parameters of unselected channels are open, but values like an infinite
+// saturation would still give 0 with them.
+static inline float _blendif_channel_factor(const float value,
+                                            const size_t ch,
+                                            const unsigned int *const restrict selected,
+                                            const unsigned int *const restrict invert_mask,
+                                            const float *const restrict parameters)
 {
-  for(size_t x = 0, j = 0; x < stride; x++, j += DT_BLENDIF_RGB_CH)
-  {
-    mask[x] *= _blendif_compute_factor(pixels[j + 0], invert_mask, parameters);
-  }
+  const float factor = _blendif_compute_factor(value, invert_mask[ch],
+                                               parameters + DEVELOP_BLENDIF_PARAMETER_ITEMS * ch);
+  return selected[ch] ? factor : 1.0f;
 }
 
-DT_OMP_DECLARE_SIMD(aligned(pixels: 16) uniform(parameters, invert_mask, stride))
-static inline void _blendif_rgb_green(const float *const restrict pixels,
-                                      float *const restrict mask,
-                                      const size_t stride,
-                                      const float *const restrict parameters,
-                                      const unsigned int invert_mask)
+// the conditional channels of one side of the blend come in groups: gray,
+// the rgb channels and JzCzhz. Every combination of groups has its own
+// kernel, chosen once per piece and side, which reads a pixel once and
+// multiplies the factors of all channels of its groups into the mask.
+// The channels of a group that are not selected contribute a factor of
+// exactly 1.
+typedef void(_blendif_kernel)(const float *const restrict pixels,
+                              float *const restrict mask,
+                              const size_t stride,
+                              const float *const restrict parameters,
+                              const unsigned int *const restrict selected,
+                              const unsigned int *const restrict invert_mask,
+                              const dt_iop_order_iccprofile_info_t *const restrict profile,
+                              cmsHTRANSFORM xform);
+
+typedef enum _blendif_jzczhz_t
 {
-  for(size_t x = 0, j = 0; x < stride; x++, j += DT_BLENDIF_RGB_CH)
-  {
-    mask[x] *= _blendif_compute_factor(pixels[j + 1], invert_mask, parameters);
-  }
-}
-
-DT_OMP_DECLARE_SIMD(aligned(pixels: 16) uniform(parameters, invert_mask, stride))
-static inline void _blendif_rgb_blue(const float *const restrict pixels,
-                                     float *const restrict mask,
-                                     const size_t stride,
-                                     const float *const restrict parameters,
-                                     const unsigned int invert_mask)
+  _JZCZHZ_NONE = 0,
+  _JZCZHZ_MATRIX = 1, // from the matrix of the profile
+  _JZCZHZ_LAB = 2     // through Lab with lcms, for profiles without a matrix
+} _blendif_jzczhz_t;
+
+static inline void _blendif_combine_channels(const float *const restrict pixels,
+                                             float *const restrict mask,
+                                             const size_t stride,
+                                             const float *const restrict parameters,
+                                             const unsigned int *const restrict selected,
+                                             const unsigned int *const restrict invert_mask,
+                                             const dt_iop_order_iccprofile_info_t *const restrict profile,
+                                             cmsHTRANSFORM xform,
+                                             const gboolean gray,
+                                             const gboolean rgb,
+                                             const _blendif_jzczhz_t jzczhz)
 {
   for(size_t x = 0, j = 0; x < stride; x++, j += DT_BLENDIF_RGB_CH)
   {
-    mask[x] *= _blendif_compute_factor(pixels[j + 2], invert_mask, parameters);
-  }
-}
-
-DT_OMP_DECLARE_SIMD(aligned(pixels, invert_mask: 16) uniform(parameters, invert_mask, stride, profile))
-static inline void _blendif_jzczhz(const float *const restrict pixels,
-                                   float *const restrict mask,
-                                   const size_t stride,
-                                   const float *const restrict parameters,
-                                   const unsigned int *const restrict invert_mask,
-                                   const dt_iop_order_iccprofile_info_t *const restrict profile)
-{
-  for(size_t x = 0, j = 0; x < stride; x++, j += DT_BLENDIF_RGB_CH)
-  {
-    dt_aligned_pixel_t XYZ_D65;
-    dt_aligned_pixel_t JzAzBz;
-    dt_aligned_pixel_t JzCzhz;
+    float factor = 1.0f;
+    if(gray)
+    {
+      const float value = dt_ioppr_get_rgb_matrix_luminance(pixels + j, profile->matrix_in, profile->lut_in,
+                                                            profile->unbounded_coeffs_in, profile->lutsize,
+                                                            profile->nonlinearlut);
+      factor *= _blendif_channel_factor(value, DEVELOP_BLENDIF_GRAY_in, selected, invert_mask, parameters);
+    }
+    if(rgb)
+    {
+      for(size_t i = 0; i < 3; i++)
+        factor *= _blendif_channel_factor(pixels[j + i], DEVELOP_BLENDIF_RED_in + i,
+                                          selected, invert_mask, parameters);
+    }
+    if(jzczhz != _JZCZHZ_NONE)
+    {
+      dt_aligned_pixel_t XYZ_D65;
+      dt_aligned_pixel_t JzAzBz;
+      dt_aligned_pixel_t JzCzhz;
 
-    // use the matrix_out of the hacked profile for blending to use the
-    // conversion from RGB to XYZ D65 (instead of XYZ D50)
-    dt_ioppr_rgb_matrix_to_xyz(pixels + j, XYZ_D65, profile->matrix_out_transposed, profile->lut_in,
-                               profile->unbounded_coeffs_in, profile->lutsize, profile->nonlinearlut);
+      if(jzczhz == _JZCZHZ_MATRIX)
+      {
+        // use the matrix_out of the hacked profile for blending to use the
+        // conversion from RGB to XYZ D65 (instead of XYZ D50)
+        dt_ioppr_rgb_matrix_to_xyz(pixels + j, XYZ_D65, profile->matrix_out_transposed, profile->lut_in,
+                                   profile->unbounded_coeffs_in, profile->lutsize, profile->nonlinearlut);
+      }
+      else
+      {
+        dt_aligned_pixel_t XYZ_D50;
+        dt_aligned_pixel_t pLAB;
+        cmsDoTransform(xform, pixels + j, pLAB, 1);
+        dt_Lab_to_XYZ(pLAB, XYZ_D50);
+        dt_XYZ_D50_2_XYZ_D65(XYZ_D50, XYZ_D65);
+      }
 
-    dt_XYZ_2_JzAzBz(XYZ_D65, JzAzBz);
-    dt_JzAzBz_2_JzCzhz(JzAzBz, JzCzhz);
+      dt_XYZ_2_JzAzBz(XYZ_D65, JzAzBz);
+      dt_JzAzBz_2_JzCzhz(JzAzBz, JzCzhz);
 
-    float factor = 1.0f;
-    for(size_t i = 0; i < 3; i++)
-      factor *= _blendif_compute_factor(JzCzhz[i], invert_mask[i],
-                                        parameters + DEVELOP_BLENDIF_PARAMETER_ITEMS * i);
+      for(size_t i = 0; i < 3; i++)
+        factor *= _blendif_channel_factor(JzCzhz[i], DEVELOP_BLENDIF_Jz_in + i,
+                                          selected, invert_mask, parameters);
+    }
     mask[x] *= factor;
   }
 }
 
-DT_OMP_DECLARE_SIMD(aligned(pixels, invert_mask: 16) uniform(parameters, invert_mask, stride))
-static inline void _blendif_jzczhz_lab(const float *const restrict pixels,
-                                       float *const restrict mask,
-                                       const size_t stride,
-                                       const float *const restrict parameters,
-                                       const unsigned int *const restrict invert_mask,
-                                       cmsHTRANSFORM *const xform)
-{
-  for(size_t x = 0, j = 0; x < stride; x++, j += DT_BLENDIF_RGB_CH)
-  {
-    dt_aligned_pixel_t XYZ_D65;
-    dt_aligned_pixel_t XYZ_D50;
-    dt_aligned_pixel_t JzAzBz;
-    dt_aligned_pixel_t JzCzhz;
-    dt_aligned_pixel_t pLAB;
-
-    cmsDoTransform(xform, pixels+j, pLAB, 1);
-    dt_Lab_to_XYZ(pLAB, XYZ_D50);
-    dt_XYZ_D50_2_XYZ_D65(XYZ_D50, XYZ_D65);
-    dt_XYZ_2_JzAzBz(XYZ_D65, JzAzBz);
-    dt_JzAzBz_2_JzCzhz(JzAzBz, JzCzhz);
-
-    float factor = 1.0f;
-    for(size_t i = 0; i < 3; i++)
-      factor *= _blendif_compute_factor(JzCzhz[i], invert_mask[i],
-                                        parameters + DEVELOP_BLENDIF_PARAMETER_ITEMS * i);
-    mask[x] *= factor;
+#define _BLENDIF_KERNEL(name, gray, rgb, jzczhz)                                                   \
+  __DT_CLONE_TARGETS__                                                                             \
+  static void _blendif_kernel_##name(const float *const restrict pixels,                           \
+                                     float *const restrict mask,                                   \
+                                     const size_t stride,                                          \
+                                     const float *const restrict parameters,                       \
+                                     const unsigned int *const restrict selected,                  \
+                                     const unsigned int *const restrict invert_mask,               \
+                                     const dt_iop_order_iccprofile_info_t *const restrict profile, \
+                                     cmsHTRANSFORM xform)                                          \
+  {                                                                                                \
+    _blendif_combine_channels(pixels, mask, stride, parameters, selected, invert_mask, profile,    \
+                              xform, gray, rgb, jzczhz);                                           \
   }
-}
 
-DT_OMP_DECLARE_SIMD(aligned(pixels: 16) uniform(stride, blendif, parameters, profile))
-static void _blendif_combine_channels(const float *const restrict pixels,
-                                      float *const restrict mask,
-                                      const size_t stride,
-                                      const unsigned int blendif,
-                                      const float *const restrict parameters,
-                                      const dt_iop_order_iccprofile_info_t *const restrict profile)
+_BLENDIF_KERNEL(gray, TRUE, FALSE, _JZCZHZ_NONE)
+_BLENDIF_KERNEL(rgb, FALSE, TRUE, _JZCZHZ_NONE)
+_BLENDIF_KERNEL(gray_rgb, TRUE, TRUE, _JZCZHZ_NONE)
+_BLENDIF_KERNEL(jz, FALSE, FALSE, _JZCZHZ_MATRIX)
+_BLENDIF_KERNEL(gray_jz, TRUE, FALSE, _JZCZHZ_MATRIX)
+_BLENDIF_KERNEL(rgb_jz, FALSE, TRUE, _JZCZHZ_MATRIX)
+_BLENDIF_KERNEL(gray_rgb_jz, TRUE, TRUE, _JZCZHZ_MATRIX)
+_BLENDIF_KERNEL(jz_lab, FALSE, FALSE, _JZCZHZ_LAB)
+_BLENDIF_KERNEL(gray_jz_lab, TRUE, FALSE, _JZCZHZ_LAB)
+_BLENDIF_KERNEL(rgb_jz_lab, FALSE, TRUE, _JZCZHZ_LAB)
+_BLENDIF_KERNEL(gray_rgb_jz_lab, TRUE, TRUE, _JZCZHZ_LAB)
+
+#undef _BLENDIF_KERNEL
+
+// kernel for the channels selected in blendif (shifted to the side), NULL if none is
+static _blendif_kernel *_choose_blendif_kernel(const unsigned int blendif,
+                                               const gboolean use_matrix)
 {
-  if(blendif & (1 << DEVELOP_BLENDIF_GRAY_in))
-  {
-    const unsigned int invert_mask = (blendif >> 16) & (1 << DEVELOP_BLENDIF_GRAY_in);
-    _blendif_gray(pixels, mask, stride, parameters + DEVELOP_BLENDIF_PARAMETER_ITEMS * DEVELOP_BLENDIF_GRAY_in,
-                  invert_mask, profile);
-  }
-
-  if(blendif & (1 << DEVELOP_BLENDIF_RED_in))
-  {
-    const unsigned int invert_mask = (blendif >> 16) & (1 << DEVELOP_BLENDIF_RED_in);
-    _blendif_rgb_red(pixels, mask, stride, parameters + DEVELOP_BLENDIF_PARAMETER_ITEMS * DEVELOP_BLENDIF_RED_in,
-                     invert_mask);
-  }
-
-  if(blendif & (1 << DEVELOP_BLENDIF_GREEN_in))
-  {
-    const unsigned int invert_mask = (blendif >> 16) & (1 << DEVELOP_BLENDIF_GREEN_in);
-    _blendif_rgb_green(pixels, mask, stride,
-                       parameters + DEVELOP_BLENDIF_PARAMETER_ITEMS * DEVELOP_BLENDIF_GREEN_in, invert_mask);
-  }
+  static _blendif_kernel *const kernels[3][2][2] = {
+    { { NULL, _blendif_kernel_gray },
+      { _blendif_kernel_rgb, _blendif_kernel_gray_rgb } },
+    { { _blendif_kernel_jz, _blendif_kernel_gray_jz },
+      { _blendif_kernel_rgb_jz, _blendif_kernel_gray_rgb_jz } },
+    { { _blendif_kernel_jz_lab, _blendif_kernel_gray_jz_lab },
+      { _blendif_kernel_rgb_jz_lab, _blendif_kernel_gray_rgb_jz_lab } },
+  };
+
+  const gboolean gray = (blendif & (1 << DEVELOP_BLENDIF_GRAY_in)) != 0;
+  const gboolean rgb = (blendif & ((1 << DEVELOP_BLENDIF_RED_in) | (1 << DEVELOP_BLENDIF_GREEN_in)
+                                   | (1 << DEVELOP_BLENDIF_BLUE_in))) != 0;
+  const _blendif_jzczhz_t jzczhz = !(blendif & ((1 << DEVELOP_BLENDIF_Jz_in) | (1 << DEVELOP_BLENDIF_Cz_in)
+                                                | (1 << DEVELOP_BLENDIF_hz_in)))
+                                   ? _JZCZHZ_NONE
+                                   : use_matrix ? _JZCZHZ_MATRIX : _JZCZHZ_LAB;
+  return kernels[jzczhz][rgb][gray];
+}
 
-  if(blendif & (1 << DEVELOP_BLENDIF_BLUE_in))
+static inline void _blendif_apply_opacity(float *const restrict mask,
+                                          const float *const restrict temp_mask,
+                                          const size_t stride,
+                                          const unsigned int mask_inclusive,
+                                          const unsigned int mask_inversed,
+                                          const float global_opacity)
+{
+  if(mask_inclusive)
   {
-    const unsigned int invert_mask = (blendif >> 16) & (1 << DEVELOP_BLENDIF_BLUE_in);
-    _blendif_rgb_blue(pixels, mask, stride, parameters + DEVELOP_BLENDIF_PARAMETER_ITEMS * DEVELOP_BLENDIF_BLUE_in,
-                      invert_mask);
+    if(mask_inversed)
+    {
+      for(size_t x = 0; x < stride; x++) mask[x] = global_opacity * (1.0f - mask[x]) * temp_mask[x];
+    }
+    else
+    {
+      for(size_t x = 0; x < stride; x++) mask[x] = global_opacity * (1.0f - (1.0f - mask[x]) * temp_mask[x]);
+    }
   }
-
-  if(blendif & ((1 << DEVELOP_BLENDIF_Jz_in) | (1 << DEVELOP_BLENDIF_Cz_in) | (1 << DEVELOP_BLENDIF_hz_in)))
+  else
   {
-    const unsigned int invert_mask[3] DT_ALIGNED_PIXEL = {
-        (blendif >> 16) & (1 << DEVELOP_BLENDIF_Jz_in),
-        (blendif >> 16) & (1 << DEVELOP_BLENDIF_Cz_in),
-        (blendif >> 16) & (1 << DEVELOP_BLENDIF_hz_in) };
-
-    if(dt_is_valid_colormatrix(profile->matrix_out_transposed[0][0]))
-      _blendif_jzczhz(pixels, mask, stride, parameters + DEVELOP_BLENDIF_PARAMETER_ITEMS * DEVELOP_BLENDIF_Jz_in,
-                    invert_mask, profile);
+    if(mask_inversed)
+    {
+      for(size_t x = 0; x < stride; x++) mask[x] = global_opacity * (1.0f - mask[x] * temp_mask[x]);
+    }
     else
     {
-      cmsHPROFILE *input = dt_colorspaces_get_profile(profile->type, profile->filename, DT_PROFILE_DIRECTION_IN)->profile;
-      cmsHPROFILE *Lab = dt_colorspaces_get_profile(DT_COLORSPACE_LAB, "", DT_PROFILE_DIRECTION_ANY)->profile;
-      cmsHTRANSFORM *xform = cmsCreateTransform(input, TYPE_RGBA_FLT, Lab, TYPE_LabA_FLT, profile->intent, 0);
-
-      _blendif_jzczhz_lab(pixels, mask, stride, parameters + DEVELOP_BLENDIF_PARAMETER_ITEMS * DEVELOP_BLENDIF_Jz_in,
-                    invert_mask, xform);
-      cmsDeleteTransform(xform);
+      for(size_t x = 0; x < stride; x++) mask[x] = global_opacity * mask[x] * temp_mask[x];
     }
   }
 }
@@ -322,72 +314,79 @@ void dt_develop_blendif_rgb_jzczhz_make_mask(dt_dev_pixelpipe_iop_t *piece,
     }
     const dt_iop_order_iccprofile_info_t *profile = &blend_profile;
 
-    // allocate space for a temporary mask buffer to split the computation of every channel
-    float *const restrict temp_mask = dt_alloc_align_float(buffsize);
-    if(!temp_mask)
+    // only selected channels take part, they are inverted if their invert bit is set
+    unsigned int selected[DEVELOP_BLENDIF_SIZE] DT_ALIGNED_ARRAY;
+    unsigned int invert_mask[DEVELOP_BLENDIF_SIZE] DT_ALIGNED_ARRAY;
+    for(size_t i = 0; i < DEVELOP_BLENDIF_SIZE; i++)
     {
+      selected[i] = (blendif & (1u << i)) != 0;
+      invert_mask[i] = (blendif & (blendif >> 16) & (1u << i)) != 0;
+    }
+
+    const gboolean use_matrix = dt_is_valid_colormatrix(profile->matrix_out_transposed[0][0]);
+    _blendif_kernel *const kernel_in = _choose_blendif_kernel(blendif, use_matrix);
+    _blendif_kernel *const kernel_out = _choose_blendif_kernel(blendif >> DEVELOP_BLENDIF_GRAY_out, use_matrix);
+
+    // profiles without a matrix go through Lab, set up the transform once for all rows
+    cmsHTRANSFORM xform = NULL;
+    if(!use_matrix
+       && (blendif & ((1 << DEVELOP_BLENDIF_Jz_in) | (1 << DEVELOP_BLENDIF_Cz_in) | (1 << DEVELOP_BLENDIF_hz_in)
+                      | (1 << DEVELOP_BLENDIF_Jz_out) | (1 << DEVELOP_BLENDIF_Cz_out)
+                      | (1 << DEVELOP_BLENDIF_hz_out))))
+    {
+      cmsHPROFILE *input = dt_colorspaces_get_profile(profile->type, profile->filename, DT_PROFILE_DIRECTION_IN)->profile;
+      cmsHPROFILE *Lab = dt_colorspaces_get_profile(DT_COLORSPACE_LAB, "", DT_PROFILE_DIRECTION_ANY)->profile;
+      xform = cmsCreateTransform(input, TYPE_RGBA_FLT, Lab, TYPE_LabA_FLT, profile->intent, 0);
+    }
+
+    // a row of the parametric mask per thread, combined with the mask while in cache
+    size_t padded_size;
+    float *const restrict temp_buf = dt_alloc_perthread_float(owidth, &padded_size);
+    if(!temp_buf)
+    {
+      if(xform) cmsDeleteTransform(xform);
       return;
     }
 
     DT_OMP_PRAGMA(parallel default(none)
-                  dt_omp_firstprivate(temp_mask, mask, a, b, oheight, owidth, iwidth, yoffs, xoffs, buffsize,
-                                      blendif, profile, parameters, mask_inclusive, mask_inversed, global_opacity))
+                  dt_omp_firstprivate(temp_buf, padded_size, mask, a, b, oheight, owidth, iwidth, yoffs, xoffs,
+                                      kernel_in, kernel_out, selected, invert_mask, profile, xform,
+                                      parameters, mask_inclusive, mask_inversed, global_opacity))
     {
       // flush denormals to zero to avoid performance penalty if there are a lot of zero values in the mask
       const int oldMode = dt_mm_enable_flush_zero();
+      float *const restrict temp_mask = dt_get_perthread(temp_buf, padded_size);
 
-      // initialize the parametric mask
-      DT_OMP_PRAGMA(for simd schedule(static) aligned(temp_mask:64))
-      for(size_t x = 0; x < buffsize; x++) temp_mask[x] = 1.0f;
-
-      // combine channels
-      DT_OMP_PRAGMA(for schedule(static))
-      for(size_t y = 0; y < oheight; y++)
-      {
-        const size_t start = ((y + yoffs) * iwidth + xoffs) * DT_BLENDIF_RGB_CH;
-        _blendif_combine_channels(a + start, temp_mask + (y * owidth), owidth, blendif, parameters, profile);
-      }
       DT_OMP_PRAGMA(for schedule(static))
       for(size_t y = 0; y < oheight; y++)
       {
-        const size_t start = (y * owidth) * DT_BLENDIF_RGB_CH;
-        _blendif_combine_channels(b + start, temp_mask + (y * owidth), owidth, blendif >> DEVELOP_BLENDIF_GRAY_out,
-                                  parameters + DEVELOP_BLENDIF_PARAMETER_ITEMS * DEVELOP_BLENDIF_GRAY_out,
-                                  profile);
-      }
+        for(size_t x = 0; x < owidth; x++) temp_mask[x] = 1.0f;
 
-      // apply global opacity
-      if(mask_inclusive)
-      {
-        if(mask_inversed)
+        // combine channels
+        if(kernel_in)
         {
-          DT_OMP_PRAGMA(for simd schedule(static) aligned(mask, temp_mask:64))
-          for(size_t x = 0; x < buffsize; x++) mask[x] = global_opacity * (1.0f - mask[x]) * temp_mask[x];
+          const size_t start = ((y + yoffs) * iwidth + xoffs) * DT_BLENDIF_RGB_CH;
+          kernel_in(a + start, temp_mask, owidth, parameters, selected, invert_mask, profile, xform);
         }
-        else
+        if(kernel_out)
         {
-          DT_OMP_PRAGMA(for simd schedule(static) aligned(mask, temp_mask:64))
-          for(size_t x = 0; x < buffsize; x++) mask[x] = global_opacity * (1.0f - (1.0f - mask[x]) * temp_mask[x]);
-        }
-      }
-      else
-      {
-        if(mask_inversed)
-        {
-          DT_OMP_PRAGMA(for simd schedule(static) aligned(mask, temp_mask:64))
-          for(size_t x = 0; x < buffsize; x++) mask[x] = global_opacity * (1.0f - mask[x] * temp_mask[x]);
-        }
-        else
-        {
-          DT_OMP_PRAGMA(for simd schedule(static) aligned(mask, temp_mask:64))
-          for(size_t x = 0; x < buffsize; x++) mask[x] = global_opacity * mask[x] * temp_mask[x];
+          const size_t start = (y * owidth) * DT_BLENDIF_RGB_CH;
+          kernel_out(b + start, temp_mask, owidth,
+                     parameters + DEVELOP_BLENDIF_PARAMETER_ITEMS * DEVELOP_BLENDIF_GRAY_out,
+                     selected + DEVELOP_BLENDIF_GRAY_out,
+                     invert_mask + DEVELOP_BLENDIF_GRAY_out, profile, xform);
         }
+
+        // apply global opacity
+        _blendif_apply_opacity(mask + y * owidth, temp_mask, owidth, mask_inclusive, mask_inversed,
+                               global_opacity);
       }
 
       dt_mm_restore_flush_zero(oldMode);
     }
 
-    dt_free_align(temp_mask);
+    if(xform) cmsDeleteTransform(xform);
+    dt_free_align(temp_buf);
   }
 }
 
@@ -805,6 +804,7 @@ static inline void _rgb_to_JzCzhz(const dt_aligned_pixel_t rgb,
 
 
 DT_OMP_DECLARE_SIMD(aligned(a, b:16) uniform(channel, profile, stride))
+__DT_CLONE_TARGETS__
 static void _display_channel(const float *const restrict a,
                              float *const restrict b,
                              const float *const restrict mask,
@@ -488,6 +488,17 @@ extern const dt_masks_functions_t dt_masks_functions_object;
 gboolean dt_masks_object_available(void);
 #endif
 
+/** render the falloff of a stroke into buffer (see masks/falloff.c),
+ * keeping the larger value. samples holds x, y, radius, hardness and
+ * density of count points along the center line, in buffer coordinates.
+ * They are overwritten. */
+void dt_masks_stroke_falloff(float *const buffer,
+                             const int width,
+                             const int height,
+                             float *const samples,
+                             const int count,
+                             const gboolean closed);
+
 /** init dt_masks_form_gui_t struct with default values */
 void dt_masks_init_form_gui(dt_masks_form_gui_t *gui);
 
@@ -555,6 +566,17 @@ int dt_masks_group_render_roi(dt_iop_module_t *module,
                               const dt_iop_roi_t *roi,
                               float *buffer);
 
+/** cache of rasterised shapes shared by all pipes, see masks/cache.c */
+void dt_masks_raster_cache_init(void);
+void dt_masks_raster_cache_cleanup(void);
+/** like dt_masks_get_mask_roi() for a single shape but reusing earlier
+ * renderings, the buffer doesn't need to be zeroed */
+int dt_masks_raster_cache_get_mask_roi(const dt_iop_module_t *const module,
+                                       const dt_dev_pixelpipe_iop_t *const piece,
+                                       dt_masks_form_t *const form,
+                                       const dt_iop_roi_t *const roi,
+                                       float *const buffer);
+
 // returns current masks version
 int dt_masks_version(void);
 
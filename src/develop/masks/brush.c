@@ -727,6 +727,7 @@ static int _brush_get_pts_border(dt_develop_t *dev,
                                  int *border_count,
                                  float **payload,
                                  int *payload_count,
+                                 int *upward_count,
                                  const int source)
 {
   double start2 = dt_get_debug_wtime();
@@ -740,6 +741,7 @@ static int _brush_get_pts_border(dt_develop_t *dev,
   if(border) *border_count = 0;
   if(payload) *payload = NULL;
   if(payload) *payload_count = 0;
+  if(upward_count) *upward_count = 0;
 
   dt_masks_dynbuf_t *dpoints = NULL, *dborder = NULL, *dpayload = NULL;
 
@@ -971,6 +973,10 @@ static int _brush_get_pts_border(dt_develop_t *dev,
         }
       }
 
+      // the far end of the stroke, from here on we go back along the same line
+      if(upward_count && n == nb - 1)
+        *upward_count = dt_masks_dynbuf_position(dpoints) / 2;
+
       cw *= -1;
       continue;
     }
@@ -1042,6 +1048,7 @@ static int _brush_get_pts_border(dt_develop_t *dev,
 
   *points_count = dt_masks_dynbuf_position(dpoints) / 2;
   *points = dt_masks_dynbuf_harvest(dpoints);
+  if(upward_count && *upward_count == 0) *upward_count = *points_count;
   dt_masks_dynbuf_free(dpoints);
 
   if(dborder)
@@ -1167,6 +1174,7 @@ fail:
     *payload = NULL;
     *payload_count = 0;
   }
+  if(upward_count) *upward_count = 0;
   return 0;
 }
 
@@ -1316,7 +1324,7 @@ static int _brush_get_points_border(dt_develop_t *dev,
   const double ioporder = (module) ? module->iop_order : 0.0f;
   return _brush_get_pts_border(dev, form, ioporder,
                                DT_DEV_TRANSFORM_DIR_ALL, dev->preview_pipe, points,
-                               points_count, border, border_count, NULL, NULL, source);
+                               points_count, border, border_count, NULL, NULL, NULL, source);
 }
 
 /** find relative position within a brush segment that is closest to
@@ -3094,7 +3102,7 @@ static int _get_area(const dt_iop_module_t *const module,
   if(!_brush_get_pts_border(module->dev, form, module->iop_order,
                             DT_DEV_TRANSFORM_DIR_BACK_INCL,
                             piece->pipe, &points, &points_count,
-                            &border, &border_count, NULL, NULL, get_source))
+                            &border, &border_count, NULL, NULL, NULL, get_source))
   {
     dt_free_align(points);
     dt_free_align(border);
@@ -3131,46 +3139,29 @@ static int _brush_get_area(const dt_iop_module_t *const module,
   return _get_area(module, piece, form, width, height, posx, posy, 0);
 }
 
-/** we write a falloff segment */
-static void _brush_falloff(float *const restrict buffer,
-                           int p0[2],
-                           int p1[2],
-                           const int posx,
-                           const int posy,
-                           const int bw,
-                           const float hardness,
-                           const float density)
+/** the samples of the stroke for dt_masks_stroke_falloff(): center,
+ * radius, hardness and density, shifted by the origin of the buffer */
+static float *_brush_falloff_samples(const float *const points,
+                                     const float *const border,
+                                     const float *const payload,
+                                     const int first,
+                                     const int count,
+                                     const float offx,
+                                     const float offy)
 {
-  // segment length
-  const int l = sqrt((p1[0] - p0[0])
-                     * (p1[0] - p0[0]) + (p1[1] - p0[1]) * (p1[1] - p0[1])) + 1;
-  const int solid = (int)l * hardness;
-  const int soft = l - solid;
-
-  const float lx = p1[0] - p0[0];
-  const float ly = p1[1] - p0[1];
-
-  for(int i = 0; i < l; i++)
-  {
-    // position
-    const int x = (int)((float)i * lx / (float)l) + p0[0] - posx;
-    const int y = (int)((float)i * ly / (float)l) + p0[1] - posy;
-    const float op = density * ((i <= solid)
-                                ? 1.0f
-                                : 1.0 - (float)(i - solid) / (float)soft);
-
-    buffer[y * bw + x] = MAX(buffer[y * bw + x], op);
-    if(x > 0)
-      buffer[y * bw + x - 1]
-          = MAX(buffer[y * bw + x - 1], op); // this one is to avoid
-                                             // gap due to int
-                                             // rounding
-    if(y > 0)
-      buffer[(y - 1) * bw + x]
-          = MAX(buffer[(y - 1) * bw + x], op); // this one is to avoid
-                                               // gap due to int
-                                               // rounding
+  float *samples = dt_alloc_align_float((size_t)5 * MAX(1, count - first));
+  if(!samples) return NULL;
+
+  for(int i = first; i < count; i++)
+  {
+    float *const s = samples + 5 * (i - first);
+    s[0] = points[i * 2] - offx;
+    s[1] = points[i * 2 + 1] - offy;
+    s[2] = dt_fast_hypotf(border[i * 2] - points[i * 2], border[i * 2 + 1] - points[i * 2 + 1]);
+    s[3] = payload[i * 2];
+    s[4] = payload[i * 2 + 1];
   }
+  return samples;
 }
 
 static int _brush_get_mask(const dt_iop_module_t *const module,
@@ -3188,11 +3179,12 @@ static int _brush_get_mask(const dt_iop_module_t *const module,
 
   // we get buffers for all points
   float *points = NULL, *border = NULL, *payload = NULL;
-  int points_count, border_count, payload_count;
+  int points_count, border_count, payload_count, upward_count;
   if(!_brush_get_pts_border(module->dev, form, module->iop_order,
                             DT_DEV_TRANSFORM_DIR_BACK_INCL,
                             piece->pipe,&points, &points_count,
-                            &border, &border_count, &payload, &payload_count, 0))
+                            &border, &border_count, &payload, &payload_count,
+                            &upward_count, 0))
   {
     dt_free_align(points);
     dt_free_align(border);
@@ -3225,22 +3217,23 @@ static int _brush_get_mask(const dt_iop_module_t *const module,
   }
 
   // now we fill the falloff
-  int p0[2], p1[2];
-
-  for(int i = _nb_ctrl_point(nb_corner); i < border_count; i++)
-  {
-    p0[0] = points[i * 2];
-    p0[1] = points[i * 2 + 1];
-    p1[0] = border[i * 2];
-    p1[1] = border[i * 2 + 1];
-
-    _brush_falloff(*buffer, p0, p1, *posx, *posy, *width,
-                   payload[i * 2], payload[i * 2 + 1]);
-  }
-
+  // the falloff is symmetric around the center line, so the way back
+  // down the stroke would only render the same pixels again
+  float *samples = _brush_falloff_samples(points, border, payload, _nb_ctrl_point(nb_corner),
+                                          upward_count, *posx, *posy);
   dt_free_align(points);
   dt_free_align(border);
   dt_free_align(payload);
+  if(!samples)
+  {
+    dt_free_align(*buffer);
+    *buffer = NULL;
+    return 0;
+  }
+
+  dt_masks_stroke_falloff(*buffer, *width, *height, samples,
+                          upward_count - _nb_ctrl_point(nb_corner), FALSE);
+  dt_free_align(samples);
 
   dt_print(DT_DEBUG_MASKS | DT_DEBUG_PERF,
            "[masks %s] brush fill buffer took %0.04f sec", form->name,
@@ -3249,56 +3242,6 @@ static int _brush_get_mask(const dt_iop_module_t *const module,
   return 1;
 }
 
-/** we write a falloff segment respecting limits of buffer */
-static inline void _brush_falloff_roi(float *buffer,
-                                      const int *p0,
-                                      const int *p1,
-                                      const int bw,
-                                      const int bh,
-                                      const float hardness,
-                                      const float density)
-{
-  // segment length (increase by 1 to avoid division-by-zero special
-  // case handling)
-  const int l = sqrt((p1[0] - p0[0])
-                     * (p1[0] - p0[0]) + (p1[1] - p0[1]) * (p1[1] - p0[1])) + 1;
-  const int solid = hardness * l;
-
-  const float lx = (float)(p1[0] - p0[0]) / (float)l;
-  const float ly = (float)(p1[1] - p0[1]) / (float)l;
-
-  const int dx = lx <= 0 ? -1 : 1;
-  const int dy = ly <= 0 ? -1 : 1;
-  const int dpx = dx;
-  const int dpy = dy * bw;
-
-  float fx = p0[0];
-  float fy = p0[1];
-
-  float op = density;
-  const float dop = density / (float)(l - solid);
-
-  for(int i = 0; i < l; i++)
-  {
-    const int x = fx;
-    const int y = fy;
-
-    fx += lx;
-    fy += ly;
-    if(i > solid) op -= dop;
-
-    if(x < 0 || x >= bw || y < 0 || y >= bh) continue;
-
-    float *buf = buffer + (size_t)y * bw + x;
-
-    *buf = MAX(*buf, op);
-    if(x + dx >= 0 && x + dx < bw)
-      buf[dpx] = MAX(buf[dpx], op); // this one is to avoid gaps due to int rounding
-    if(y + dy >= 0 && y + dy < bh)
-      buf[dpy] = MAX(buf[dpy], op); // this one is to avoid gaps due to int rounding
-  }
-}
-
 // build a stamp which can be combined with other shapes in the same group
 // prerequisite: 'buffer' is all zeros
 static int _brush_get_mask_roi(const dt_iop_module_t *const module,
@@ -3320,12 +3263,13 @@ static int _brush_get_mask_roi(const dt_iop_module_t *const module,
   // we get buffers for all points
   float *points = NULL, *border = NULL, *payload = NULL;
 
-  int points_count, border_count, payload_count;
+  int points_count, border_count, payload_count, upward_count;
 
   if(!_brush_get_pts_border(module->dev, form, module->iop_order,
                             DT_DEV_TRANSFORM_DIR_BACK_INCL,
                             piece->pipe,&points, &points_count,
-                            &border, &border_count, &payload, &payload_count, 0))
+                            &border, &border_count, &payload, &payload_count,
+                            &upward_count, 0))
   {
     dt_free_align(points);
     dt_free_align(border);
@@ -3375,22 +3319,18 @@ static int _brush_get_mask_roi(const dt_iop_module_t *const module,
   }
 
   // now we fill the falloff
-  DT_OMP_FOR()
-  for(int i = _nb_ctrl_point(nb_corner); i < border_count; i++)
-  {
-    const int p0[] = { points[i * 2], points[i * 2 + 1] };
-    const int p1[] = { border[i * 2], border[i * 2 + 1] };
-
-    if(MAX(p0[0], p1[0]) < 0 || MIN(p0[0], p1[0]) >= width || MAX(p0[1], p1[1]) < 0
-       || MIN(p0[1], p1[1]) >= height)
-      continue;
-
-    _brush_falloff_roi(buffer, p0, p1, width, height, payload[i * 2], payload[i * 2 + 1]);
-  }
-
+  // the falloff is symmetric around the center line, so the way back
+  // down the stroke would only render the same pixels again
+  float *samples = _brush_falloff_samples(points, border, payload, _nb_ctrl_point(nb_corner),
+                                          upward_count, 0.0f, 0.0f);
   dt_free_align(points);
   dt_free_align(border);
   dt_free_align(payload);
+  if(!samples) return 0;
+
+  dt_masks_stroke_falloff(buffer, width, height, samples,
+                          upward_count - _nb_ctrl_point(nb_corner), FALSE);
+  dt_free_align(samples);
 
   dt_print(DT_DEBUG_MASKS | DT_DEBUG_PERF,
            "[masks %s] brush set falloff took %0.04f sec", form->name,
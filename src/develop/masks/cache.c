@@ -0,0 +1,353 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+  Cache of rasterised shapes, shared by all pipes.
+
+  The shapes of a mask group are rendered one by one for every roi the
+  blending of a module asks for. Most of the time neither the shapes nor
+  the distortions in front of the module have changed since the last
+  run, so the rendered shapes are kept and reused.
+
+  An entry is keyed by the hash of the shape itself, the distorting
+  modules up to the module, the pipe input and the scale. Only the
+  bounding box of the non-zero part of the roi is stored, strokes of a
+  retouch are small compared to the image.
+
+  If only the position of the roi changed, as when panning in the
+  darkroom, the overlap with the best cached roi is reused and only the
+  uncovered bands are rendered, like the tiling code renders a mask per
+  tile.
+
+  Entries are dropped least recently used first once the memory set with
+  the masks_raster_cache config key (in MB) is used up. The entries of a
+  key are found through a hash table, the queue only keeps their order.
+*/
+
+#include "common/darktable.h"
+#include "common/debug.h"
+#include "control/conf.h"
+#include "develop/develop.h"
+#include "develop/masks.h"
+#include "develop/pixelpipe.h"
+
+typedef struct _raster_t
+{
+  dt_hash_t key;
+  dt_iop_roi_t roi;      // the roi the shape was rendered for
+  int bx, by, bw, bh;    // non-zero part, relative to roi
+  float *buf;            // bw x bh values
+  size_t size;
+  GList *lru;            // link in _lru
+} _raster_t;
+
+// all rasters of a key, for the different rois
+typedef struct _bucket_t
+{
+  dt_hash_t key;
+  GList *rasters;
+} _bucket_t;
+
+static GHashTable *_buckets = NULL;  // key -> bucket
+static GQueue _lru = G_QUEUE_INIT;   // most recently used first
+static size_t _used = 0;
+static size_t _budget = 0;
+static dt_pthread_mutex_t _lock;
+
+void dt_masks_raster_cache_init(void)
+{
+  dt_pthread_mutex_init(&_lock, NULL);
+  _buckets = g_hash_table_new_full(g_int64_hash, g_int64_equal, NULL, free);
+  _budget = (size_t)MAX(0, dt_conf_get_int("masks_raster_cache")) * DT_MEGA;
+}
+
+static void _raster_free(gpointer data)
+{
+  _raster_t *r = data;
+  dt_free_align(r->buf);
+  free(r);
+}
+
+// remove a stored raster from the queue and its bucket and free it
+static void _raster_drop(_raster_t *r)
+{
+  _bucket_t *b = g_hash_table_lookup(_buckets, &r->key);
+  b->rasters = g_list_remove(b->rasters, r);
+  if(!b->rasters) g_hash_table_remove(_buckets, &r->key);
+  g_queue_delete_link(&_lru, r->lru);
+  _used -= r->size;
+  _raster_free(r);
+}
+
+void dt_masks_raster_cache_cleanup(void)
+{
+  while(!g_queue_is_empty(&_lru))
+    _raster_drop(g_queue_peek_head(&_lru));
+  g_hash_table_destroy(_buckets);
+  _buckets = NULL;
+  dt_pthread_mutex_destroy(&_lock);
+}
+
+static dt_hash_t _raster_key(const dt_iop_module_t *const module,
+                             const dt_dev_pixelpipe_iop_t *const piece,
+                             dt_masks_form_t *const form,
+                             const dt_iop_roi_t *const roi)
+{
+  dt_dev_pixelpipe_t *pipe = piece->pipe;
+  const dt_hash_t distort = dt_dev_hash_distort_plus(module->dev, pipe, module->iop_order,
+                                                     DT_DEV_TRANSFORM_DIR_BACK_INCL);
+  if(distort == DT_INVALID_HASH) return DT_INVALID_HASH;
+
+  dt_hash_t hash = dt_masks_group_hash(DT_INITHASH, form);
+  hash = dt_hash(hash, &distort, sizeof(distort));
+  hash = dt_hash(hash, &module->iop_order, sizeof(module->iop_order));
+  hash = dt_hash(hash, &pipe->image.id, sizeof(pipe->image.id));
+  hash = dt_hash(hash, &pipe->iwidth, sizeof(pipe->iwidth));
+  hash = dt_hash(hash, &pipe->iheight, sizeof(pipe->iheight));
+  hash = dt_hash(hash, &pipe->iscale, sizeof(pipe->iscale));
+  hash = dt_hash(hash, &roi->scale, sizeof(roi->scale));
+  return hash;
+}
+
+static int _overlap(const dt_iop_roi_t *const a,
+                    const dt_iop_roi_t *const b,
+                    int *x0, int *y0, int *x1, int *y1)
+{
+  *x0 = MAX(a->x, b->x);
+  *y0 = MAX(a->y, b->y);
+  *x1 = MIN(a->x + a->width, b->x + b->width);
+  *y1 = MIN(a->y + a->height, b->y + b->height);
+  return *x1 > *x0 && *y1 > *y0;
+}
+
+// copy the part of a cached raster inside the overlap [x0,x1)x[y0,y1)
+// into the zeroed buffer of roi
+static void _raster_copy(const _raster_t *const r,
+                         const dt_iop_roi_t *const roi,
+                         float *const buffer,
+                         const int x0, const int y0, const int x1, const int y1)
+{
+  // absolute coordinates of the stored part, clipped to the overlap
+  const int bx0 = MAX(x0, r->roi.x + r->bx);
+  const int by0 = MAX(y0, r->roi.y + r->by);
+  const int bx1 = MIN(x1, r->roi.x + r->bx + r->bw);
+  const int by1 = MIN(y1, r->roi.y + r->by + r->bh);
+  if(bx1 <= bx0 || by1 <= by0) return;
+
+  for(int y = by0; y < by1; y++)
+    memcpy(buffer + (size_t)(y - roi->y) * roi->width + (bx0 - roi->x),
+           r->buf + (size_t)(y - r->roi.y - r->by) * r->bw + (bx0 - r->roi.x - r->bx),
+           sizeof(float) * (bx1 - bx0));
+}
+
+// render the shape into the absolute rectangle [x0,x1)x[y0,y1) of roi
+static int _render_rect(const dt_iop_module_t *const module,
+                        const dt_dev_pixelpipe_iop_t *const piece,
+                        dt_masks_form_t *const form,
+                        const dt_iop_roi_t *const roi,
+                        float *const buffer,
+                        const int x0, const int y0, const int x1, const int y1)
+{
+  if(x1 <= x0 || y1 <= y0) return 1;
+
+  const dt_iop_roi_t rect = { .x = x0, .y = y0, .width = x1 - x0, .height = y1 - y0,
+                              .scale = roi->scale };
+  float *tmp = dt_calloc_align_float((size_t)rect.width * rect.height);
+  if(!tmp) return 0;
+
+  const int ok = dt_masks_get_mask_roi(module, piece, form, &rect, tmp);
+  if(ok)
+    for(int y = 0; y < rect.height; y++)
+      memcpy(buffer + (size_t)(y + y0 - roi->y) * roi->width + (x0 - roi->x),
+             tmp + (size_t)y * rect.width, sizeof(float) * rect.width);
+
+  dt_free_align(tmp);
+  return ok;
+}
+
+static void _raster_store(const dt_hash_t key,
+                          const dt_iop_roi_t *const roi,
+                          const float *const buffer)
+{
+  // find the non-zero part
+  int bx0 = roi->width, by0 = roi->height, bx1 = 0, by1 = 0;
+  DT_OMP_FOR(reduction(min : bx0, by0) reduction(max : bx1, by1))
+  for(int y = 0; y < roi->height; y++)
+  {
+    const float *const row = buffer + (size_t)y * roi->width;
+    int first = -1, last = -1;
+    for(int x = 0; x < roi->width; x++)
+      if(row[x] != 0.0f)
+      {
+        if(first < 0) first = x;
+        last = x;
+      }
+    if(first < 0) continue;
+    bx0 = MIN(bx0, first);
+    bx1 = MAX(bx1, last + 1);
+    by0 = MIN(by0, y);
+    by1 = MAX(by1, y + 1);
+  }
+
+  _raster_t *r = calloc(1, sizeof(_raster_t));
+  if(!r) return;
+  r->key = key;
+  r->roi = *roi;
+  if(bx1 > bx0)
+  {
+    r->bx = bx0;
+    r->by = by0;
+    r->bw = bx1 - bx0;
+    r->bh = by1 - by0;
+    r->buf = dt_alloc_align_float((size_t)r->bw * r->bh);
+    if(!r->buf)
+    {
+      free(r);
+      return;
+    }
+    for(int y = 0; y < r->bh; y++)
+      memcpy(r->buf + (size_t)y * r->bw, buffer + (size_t)(y + by0) * roi->width + bx0,
+             sizeof(float) * r->bw);
+  }
+  r->size = sizeof(_raster_t) + sizeof(float) * r->bw * r->bh;
+
+  if(r->size > _budget)
+  {
+    _raster_free(r);
+    return;
+  }
+
+  dt_pthread_mutex_lock(&_lock);
+  // another pipe might have rendered the same in the meantime
+  _bucket_t *b = g_hash_table_lookup(_buckets, &key);
+  for(GList *l = b ? b->rasters : NULL; l; l = g_list_next(l))
+  {
+    _raster_t *old = l->data;
+    if(!memcmp(&old->roi, roi, sizeof(dt_iop_roi_t)))
+    {
+      _raster_drop(old);
+      // the bucket is gone if that was its only raster
+      b = g_hash_table_lookup(_buckets, &key);
+      break;
+    }
+  }
+  if(!b)
+  {
+    b = calloc(1, sizeof(_bucket_t));
+    if(!b)
+    {
+      dt_pthread_mutex_unlock(&_lock);
+      _raster_free(r);
+      return;
+    }
+    b->key = key;
+    g_hash_table_insert(_buckets, &b->key, b);
+  }
+  b->rasters = g_list_prepend(b->rasters, r);
+  g_queue_push_head(&_lru, r);
+  r->lru = _lru.head;
+  _used += r->size;
+  while(_used > _budget)
+    _raster_drop(g_queue_peek_tail(&_lru));
+  dt_pthread_mutex_unlock(&_lock);
+}
+
+int dt_masks_raster_cache_get_mask_roi(const dt_iop_module_t *const module,
+                                       const dt_dev_pixelpipe_iop_t *const piece,
+                                       dt_masks_form_t *const form,
+                                       const dt_iop_roi_t *const roi,
+                                       float *const buffer)
+{
+  const size_t npixels = (size_t)roi->width * roi->height;
+  memset(buffer, 0, sizeof(float) * npixels);
+
+  // nested groups are hashed from the gui forms, not those of the pipe
+  const dt_hash_t key = (_budget && module && !(form->type & DT_MASKS_GROUP))
+    ? _raster_key(module, piece, form, roi)
+    : DT_INVALID_HASH;
+  if(key == DT_INVALID_HASH)
+    return dt_masks_get_mask_roi(module, piece, form, roi, buffer);
+
+  // find the cached raster with the largest overlap
+  int x0 = 0, y0 = 0, x1 = 0, y1 = 0;
+  size_t best_area = 0;
+  dt_pthread_mutex_lock(&_lock);
+  _raster_t *best = NULL;
+  const _bucket_t *b = g_hash_table_lookup(_buckets, &key);
+  for(GList *l = b ? b->rasters : NULL; l; l = g_list_next(l))
+  {
+    _raster_t *r = l->data;
+    int ox0, oy0, ox1, oy1;
+    if(!_overlap(&r->roi, roi, &ox0, &oy0, &ox1, &oy1)) continue;
+    const size_t area = (size_t)(ox1 - ox0) * (oy1 - oy0);
+    if(area > best_area)
+    {
+      best_area = area;
+      best = r;
+      x0 = ox0;
+      y0 = oy0;
+      x1 = ox1;
+      y1 = oy1;
+    }
+  }
+  if(best)
+  {
+    _raster_copy(best, roi, buffer, x0, y0, x1, y1);
+    g_queue_unlink(&_lru, best->lru);
+    g_queue_push_head_link(&_lru, best->lru);
+  }
+  dt_pthread_mutex_unlock(&_lock);
+
+  if(best_area == npixels)
+  {
+    dt_print(DT_DEBUG_MASKS | DT_DEBUG_PERF, "[masks %s] raster cache hit", form->name);
+    return 1;
+  }
+
+  int ok;
+  if(best)
+  {
+    // render the bands above and below the overlap and the parts left
+    // and right of it
+    const int rx1 = roi->x + roi->width;
+    const int ry1 = roi->y + roi->height;
+    ok = _render_rect(module, piece, form, roi, buffer, roi->x, roi->y, rx1, y0)
+      && _render_rect(module, piece, form, roi, buffer, roi->x, y1, rx1, ry1)
+      && _render_rect(module, piece, form, roi, buffer, roi->x, y0, x0, y1)
+      && _render_rect(module, piece, form, roi, buffer, x1, y0, rx1, y1);
+    dt_print(DT_DEBUG_MASKS | DT_DEBUG_PERF,
+             "[masks %s] raster cache reused %.0f%% of the roi", form->name,
+             100.0 * best_area / npixels);
+    if(!ok)
+    {
+      memset(buffer, 0, sizeof(float) * npixels);
+      ok = dt_masks_get_mask_roi(module, piece, form, roi, buffer);
+    }
+  }
+  else
+    ok = dt_masks_get_mask_roi(module, piece, form, roi, buffer);
+
+  if(ok) _raster_store(key, roi, buffer);
+  return ok;
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -0,0 +1,495 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+  Scanline rasteriser for the falloff of strokes (brush strokes and the
+  feather of paths).
+
+  A stroke is given as a sequence of samples along its center line, each
+  with the radius of the stroke, the hardness and the density there. The
+  stroke is the union of the discs along the center line, the mask value
+  of a pixel is the largest falloff of all of them:
+
+     density * clamp((radius - d) / (radius * (1 - hardness)), 0, 1)
+
+  with d the distance from the pixel to the center of the disc, and
+  radius, hardness and density interpolated along the center line.
+
+  Consecutive samples which lie on a straight line within a fraction of a
+  pixel are merged into one piece first, the shapes deliver about a
+  sample per pixel. Each piece renders the band of pixels whose falloff
+  comes from inside it, the discs at the ends of the stroke and the
+  sectors at the corners between two bands are rendered on their own, so
+  most pixels are computed once or twice whatever the radius.
+
+  The regions are sorted into bands of rows and the bands are rendered in
+  parallel, one row of a region at a time, so there are no concurrent
+  writes to the buffer.
+*/
+
+#include "common/darktable.h"
+#include "common/math.h"
+#include "develop/masks.h"
+
+// rows per band of the bucket sort
+#define FALLOFF_BAND 16
+
+// tolerances when merging samples, in pixels and for hardness / density
+#define MERGE_DIST 0.25f
+#define MERGE_ATTR 0.01f
+#define MERGE_RUN 64
+
+// corners of the region rendered per piece
+#define REGION_EDGES 6
+
+typedef struct _piece_t
+{
+  float x0, y0, r0, h0, d0;
+  float dx, dy, dr, dh, dd; // differences to the end of the piece
+  float inv_len2;
+  float slope;              // change of the radius per pixel along the piece
+  // edges of the region of the buffer to render, from (ex, ey0) with
+  // slope es to y = ey1, ey0 <= ey1
+  float ex[REGION_EDGES], ey0[REGION_EDGES], ey1[REGION_EDGES], es[REGION_EDGES];
+  int nedges;
+  float xmin, xmax, fymin, fymax;
+  int ymin, ymax;
+} _piece_t;
+
+static inline float _lerp(const float a, const float b, const float t)
+{
+  return a + t * (b - a);
+}
+
+// can all samples between a and b be replaced by the straight piece a-b?
+static gboolean _mergeable(const float *const s,
+                           const int a,
+                           const int b)
+{
+  const float *const sa = s + 5 * a;
+  const float *const sb = s + 5 * b;
+  const float dx = sb[0] - sa[0];
+  const float dy = sb[1] - sa[1];
+  const float len2 = dx * dx + dy * dy;
+  if(len2 < 1e-6f) return FALSE;
+
+  for(int k = a + 1; k < b; k++)
+  {
+    const float *const sk = s + 5 * k;
+    const float px = sk[0] - sa[0];
+    const float py = sk[1] - sa[1];
+    const float t = (px * dx + py * dy) / len2;
+    if(t < 0.0f || t > 1.0f) return FALSE;
+    const float ex = px - t * dx;
+    const float ey = py - t * dy;
+    // the edge of the stroke moves by the shift of the center plus the
+    // change of the radius
+    if(sqrtf(ex * ex + ey * ey) + fabsf(sk[2] - _lerp(sa[2], sb[2], t)) > MERGE_DIST
+       || fabsf(sk[3] - _lerp(sa[3], sb[3], t)) > MERGE_ATTR
+       || fabsf(sk[4] - _lerp(sa[4], sb[4], t)) > MERGE_ATTR)
+      return FALSE;
+  }
+  return TRUE;
+}
+
+// reduce the samples to the corners of the center line, returns the new count
+static int _simplify(float *const s, const int count)
+{
+  // samples on the same spot, like the stamps at the ends of a brush
+  // stroke, become one sample with the largest radius
+  int n = 0;
+  for(int k = 0; k < count; k++)
+  {
+    float *const sk = s + 5 * k;
+    if(n > 0)
+    {
+      float *const last = s + 5 * (n - 1);
+      if(fabsf(sk[0] - last[0]) < 0.05f && fabsf(sk[1] - last[1]) < 0.05f)
+      {
+        if(sk[2] > last[2]) memcpy(last, sk, sizeof(float) * 5);
+        continue;
+      }
+    }
+    memmove(s + 5 * n, sk, sizeof(float) * 5);
+    n++;
+  }
+
+  if(n < 3) return n;
+
+  int out = 1;
+  int a = 0;
+  while(a < n - 1)
+  {
+    int b = a + 1;
+    while(b + 1 < n && b + 1 - a <= MERGE_RUN && _mergeable(s, a, b + 1))
+      b++;
+    memmove(s + 5 * out, s + 5 * b, sizeof(float) * 5);
+    out++;
+    a = b;
+  }
+  return out;
+}
+
+// the piece of the center line from a to b, or a single point if b is NULL
+static void _set_line(_piece_t *const p,
+                      const float *const a,
+                      const float *const b)
+{
+  p->x0 = a[0];
+  p->y0 = a[1];
+  p->r0 = a[2];
+  p->h0 = a[3];
+  p->d0 = a[4];
+  p->dx = b ? b[0] - a[0] : 0.0f;
+  p->dy = b ? b[1] - a[1] : 0.0f;
+  p->dr = b ? b[2] - a[2] : 0.0f;
+  p->dh = b ? b[3] - a[3] : 0.0f;
+  p->dd = b ? b[4] - a[4] : 0.0f;
+  const float len2 = p->dx * p->dx + p->dy * p->dy;
+  p->inv_len2 = len2 > 1e-6f ? 1.0f / len2 : 0.0f;
+  p->slope = CLAMPF(p->dr * sqrtf(p->inv_len2), -0.99f, 0.99f);
+}
+
+// the region to render is the outline through the n <= REGION_EDGES
+// points v, only its extent per row is used so it need not be convex
+static void _set_region(_piece_t *const p,
+                        const float v[][2],
+                        const int n)
+{
+  p->nedges = n;
+  p->xmin = p->xmax = v[0][0];
+  p->fymin = p->fymax = v[0][1];
+  for(int k = 0; k < n; k++)
+  {
+    const float *const v0 = v[k];
+    const float *const v1 = v[(k + 1) % n];
+    const gboolean up = v0[1] <= v1[1];
+    const float *const a = up ? v0 : v1;
+    const float *const b = up ? v1 : v0;
+    p->ex[k] = a[0];
+    p->ey0[k] = a[1];
+    p->ey1[k] = b[1];
+    p->es[k] = b[1] > a[1] ? (b[0] - a[0]) / (b[1] - a[1]) : 0.0f;
+    p->xmin = fminf(p->xmin, v0[0]);
+    p->xmax = fmaxf(p->xmax, v0[0]);
+    p->fymin = fminf(p->fymin, v0[1]);
+    p->fymax = fmaxf(p->fymax, v0[1]);
+  }
+  // one pixel of margin so that neighbouring regions leave no gaps
+  p->ymin = floorf(p->fymin) - 1;
+  p->ymax = ceilf(p->fymax) + 1;
+}
+
+// the whole disc around a point, for the ends and sharp corners
+static void _add_disc(_piece_t *const p,
+                      const float *const c)
+{
+  _set_line(p, c, NULL);
+  const float r = c[2];
+  const float v[4][2] = { { c[0] - r, c[1] - r }, { c[0] + r, c[1] - r },
+                          { c[0] + r, c[1] + r }, { c[0] - r, c[1] + r } };
+  _set_region(p, v, 4);
+}
+
+// the outline of the band along the piece from a to b runs from a and b
+// out along the rays ra and rb on both sides (x, y on the left, then
+// on the right), FALSE if the disc at one end holds the other.
+//
+// The pixels whose falloff comes from inside the piece lie between the
+// line touching both discs at the narrow end and the normal at the wide
+// end, up to where the normal meets the line touching both discs.
+static gboolean _band_rays(const float *const a,
+                           const float *const b,
+                           float *const ra,
+                           float *const rb)
+{
+  const float dx = b[0] - a[0];
+  const float dy = b[1] - a[1];
+  const float len = sqrtf(dx * dx + dy * dy);
+  if(len < 1e-3f) return FALSE;
+  const float k = (b[2] - a[2]) / len;
+  if(fabsf(k) >= 1.0f) return FALSE;
+  const float ux = dx / len;
+  const float uy = dy / len;
+  const float c = sqrtf(1.0f - k * k);
+  // normals of the lines touching both discs
+  const float m[4] = { -uy * c - ux * k, ux * c - uy * k,
+                       uy * c - ux * k, -ux * c - uy * k };
+  const float n[4] = { -uy, ux, uy, -ux };
+  const float *const da = k >= 0.0f ? m : n;
+  const float *const db = k >= 0.0f ? n : m;
+  const float la = k >= 0.0f ? a[2] : a[2] / c;
+  const float lb = k >= 0.0f ? b[2] / c : b[2];
+  for(int i = 0; i < 4; i++)
+  {
+    ra[i] = la * da[i];
+    rb[i] = lb * db[i];
+  }
+  return TRUE;
+}
+
+// the band along the piece from a to b
+static void _add_band(_piece_t *const p,
+                      const float *const a,
+                      const float *const b)
+{
+  float ra[4], rb[4];
+  if(!_band_rays(a, b, ra, rb))
+  {
+    _add_disc(p, a[2] > b[2] ? a : b);
+    return;
+  }
+  _set_line(p, a, b);
+  const float v[6][2] = { { a[0], a[1] },
+                          { a[0] + ra[0], a[1] + ra[1] },
+                          { b[0] + rb[0], b[1] + rb[1] },
+                          { b[0], b[1] },
+                          { b[0] + rb[2], b[1] + rb[3] },
+                          { a[0] + ra[2], a[1] + ra[3] } };
+  _set_region(p, v, 6);
+}
+
+// the gap between the bands of the pieces before and after the corner
+// c on one side, a sector of the disc around c between the rays of the
+// bands there which is covered by the kite from c to the disc along both
+// rays and the point where the tangents there meet
+static void _add_corner(_piece_t *const p,
+                        const float *const c,
+                        const float *const ray1,
+                        const float *const ray2)
+{
+  _set_line(p, c, NULL);
+  const float r = c[2];
+  const float l1 = sqrtf(ray1[0] * ray1[0] + ray1[1] * ray1[1]);
+  const float l2 = sqrtf(ray2[0] * ray2[0] + ray2[1] * ray2[1]);
+  const float n1x = ray1[0] / l1, n1y = ray1[1] / l1;
+  const float n2x = ray2[0] / l2, n2y = ray2[1] / l2;
+  const float mx = n1x + n2x;
+  const float my = n1y + n2y;
+  const float m = 2.0f * r / (mx * mx + my * my);
+  const float v[4][2] = { { c[0], c[1] },
+                          { c[0] + r * n1x, c[1] + r * n1y },
+                          { c[0] + m * mx, c[1] + m * my },
+                          { c[0] + r * n2x, c[1] + r * n2y } };
+  _set_region(p, v, 4);
+}
+
+// x range of row y inside the region of a piece, rows next to the
+// region get the range of its border
+static inline gboolean _row_range(const _piece_t *const p,
+                                  const int y,
+                                  int *xa,
+                                  int *xb)
+{
+  // the band of rows around y
+  const float ya = CLAMPF(y - 1.0f, p->fymin, p->fymax);
+  const float yb = CLAMPF(y + 1.0f, p->fymin, p->fymax);
+
+  float lo = p->xmax, hi = p->xmin;
+  for(int k = 0; k < p->nedges; k++)
+  {
+    // the part of the edge inside the band
+    const float e0 = MAX(ya, p->ey0[k]);
+    const float e1 = MIN(yb, p->ey1[k]);
+    if(e0 > e1) continue;
+    const float x0 = p->ex[k] + (e0 - p->ey0[k]) * p->es[k];
+    const float x1 = p->ex[k] + (e1 - p->ey0[k]) * p->es[k];
+    lo = MIN(lo, MIN(x0, x1));
+    hi = MAX(hi, MAX(x0, x1));
+  }
+  if(lo > hi) return FALSE;
+  *xa = floorf(lo) - 1;
+  *xb = ceilf(hi) + 1;
+  return TRUE;
+}
+
+// falloff at pixel offset (px, py) from the start of the piece, for the
+// disc at t along it
+static inline float _falloff(const _piece_t *const p,
+                             const float px,
+                             const float py,
+                             const float t)
+{
+  const float d = sqrtf(sqf(px - t * p->dx) + sqf(py - t * p->dy));
+  const float r = p->r0 + t * p->dr;
+  const float h = p->h0 + t * p->dh;
+  const float density = p->d0 + t * p->dd;
+  const float soft = MAX(r * (1.0f - h), 1e-3f);
+  return density * CLIP((r - d) / soft);
+}
+
+__DT_CLONE_TARGETS__
+static void _piece_row(float *const restrict row,
+                       const _piece_t *const piece,
+                       const int y,
+                       const int xa,
+                       const int xb)
+{
+  // a local copy, which the writes to row cannot change
+  const _piece_t local = *piece;
+  const _piece_t *const p = &local;
+  const float x0 = p->x0, dx = p->dx, dy = p->dy;
+  const float inv_len2 = p->inv_len2;
+  const float slope = p->slope;
+  const float py = y - p->y0;
+
+  if(slope == 0.0f)
+  {
+    // the disc nearest to the pixel reaches furthest
+    DT_OMP_SIMD()
+    for(int x = xa; x <= xb; x++)
+    {
+      const float px = x - x0;
+      const float t = CLIP((px * dx + py * dy) * inv_len2);
+      row[x] = MAX(row[x], _falloff(p, px, py, t));
+    }
+    return;
+  }
+
+  // where the radius changes along the piece, the disc reaching
+  // furthest out lies past the nearest point of the center line towards
+  // the wider end. The line of falloff f is the hull of the discs shrunk
+  // by 1 - (1 - hardness) * f, so its slope is smaller inside: estimate
+  // f with the full slope first, then refine.
+  const float shift = slope / sqrtf(1.0f - slope * slope);
+  DT_OMP_SIMD()
+  for(int x = xa; x <= xb; x++)
+  {
+    const float px = x - x0;
+    const float along = px * dx + py * dy;
+    const float across = fabsf(px * dy - py * dx);
+    const float t0 = CLIP((along + across * shift) * inv_len2);
+    const float f = _falloff(p, px, py, t0) / MAX(p->d0 + t0 * p->dd, 1e-6f);
+    const float k = slope * (1.0f - (1.0f - p->h0 - t0 * p->dh) * f);
+    const float t = CLIP((along + across * k / sqrtf(1.0f - k * k)) * inv_len2);
+    row[x] = MAX(row[x], _falloff(p, px, py, t));
+  }
+}
+
+void dt_masks_stroke_falloff(float *const buffer,
+                             const int width,
+                             const int height,
+                             float *const samples,
+                             const int count,
+                             const gboolean closed)
+{
+  if(count <= 0 || width <= 0 || height <= 0) return;
+
+  const int n = _simplify(samples, count);
+  const int nlines = n == 1 ? 0 : (closed ? n : n - 1);
+
+  // a band per piece of the center line, a disc or two corners per sample
+  _piece_t *pieces = malloc(sizeof(_piece_t) * (nlines + 2 * n));
+  const int nbands = (height + FALLOFF_BAND - 1) / FALLOFF_BAND;
+  int *bandstart = calloc(nbands + 1, sizeof(int));
+  if(!pieces || !bandstart)
+  {
+    free(pieces);
+    free(bandstart);
+    return;
+  }
+
+  int npieces = 0;
+  for(int k = 0; k < nlines; k++)
+    _add_band(pieces + npieces++, samples + 5 * k, samples + 5 * ((k + 1) % n));
+
+  for(int k = 0; k < n; k++)
+  {
+    const float *const c = samples + 5 * k;
+    const gboolean end = !closed && (k == 0 || k == n - 1);
+    if(n == 1 || end)
+    {
+      _add_disc(pieces + npieces++, c);
+      continue;
+    }
+    const float *const a = samples + 5 * ((k + n - 1) % n);
+    const float *const b = samples + 5 * ((k + 1) % n);
+    // the rays of the band before at its end and of the one after at its start
+    float ra[4], r1[4], r2[4], rb[4];
+    if(_band_rays(a, c, ra, r1) && _band_rays(c, b, r2, rb)
+       && r1[0] * r2[0] + r1[1] * r2[1] > 0.5f * hypotf(r1[0], r1[1]) * hypotf(r2[0], r2[1])
+       && r1[2] * r2[2] + r1[3] * r2[3] > 0.5f * hypotf(r1[2], r1[3]) * hypotf(r2[2], r2[3]))
+    {
+      _add_corner(pieces + npieces++, c, r1, r2);
+      _add_corner(pieces + npieces++, c, r1 + 2, r2 + 2);
+    }
+    else
+      _add_disc(pieces + npieces++, c);
+  }
+
+  int kept = 0;
+  for(int k = 0; k < npieces; k++)
+  {
+    _piece_t *const p = pieces + k;
+    if(p->r0 + p->dr <= 0.0f && p->r0 <= 0.0f) continue;
+    if(p->xmax < -1.0f || p->xmin > width || p->ymax < 0 || p->ymin >= height) continue;
+    p->ymin = MAX(p->ymin, 0);
+    p->ymax = MIN(p->ymax, height - 1);
+    for(int b = p->ymin / FALLOFF_BAND; b <= p->ymax / FALLOFF_BAND; b++)
+      bandstart[b + 1]++;
+    pieces[kept++] = *p;
+  }
+
+  // pieces by band
+  for(int b = 0; b < nbands; b++)
+    bandstart[b + 1] += bandstart[b];
+  int *bandpieces = malloc(sizeof(int) * MAX(1, bandstart[nbands]));
+  int *fill = malloc(sizeof(int) * nbands);
+  if(!bandpieces || !fill)
+  {
+    free(bandpieces);
+    free(fill);
+    free(pieces);
+    free(bandstart);
+    return;
+  }
+  memcpy(fill, bandstart, sizeof(int) * nbands);
+  for(int k = 0; k < kept; k++)
+    for(int b = pieces[k].ymin / FALLOFF_BAND; b <= pieces[k].ymax / FALLOFF_BAND; b++)
+      bandpieces[fill[b]++] = k;
+
+  DT_OMP_PRAGMA(parallel for default(firstprivate) schedule(dynamic))
+  for(int b = 0; b < nbands; b++)
+  {
+    const int y0 = b * FALLOFF_BAND;
+    const int y1 = MIN(height, y0 + FALLOFF_BAND);
+    for(int i = bandstart[b]; i < bandstart[b + 1]; i++)
+    {
+      const _piece_t *const p = pieces + bandpieces[i];
+      for(int y = MAX(y0, p->ymin); y < MIN(y1, p->ymax + 1); y++)
+      {
+        int xa, xb;
+        if(!_row_range(p, y, &xa, &xb)) continue;
+        xa = MAX(xa, 0);
+        xb = MIN(xb, width - 1);
+        if(xa <= xb) _piece_row(buffer + (size_t)y * width, p, y, xa, xb);
+      }
+    }
+  }
+
+  free(fill);
+  free(bandpieces);
+  free(bandstart);
+  free(pieces);
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -4518,35 +4518,39 @@ static int _path_get_area(const dt_iop_module_t *const module,
   return _get_area(module, piece, form, width, height, posx, posy, FALSE);
 }
 
-/** we write a falloff segment */
-static void _path_falloff(float *const restrict buffer,
-                          int *p0,
-                          int *p1,
-                          const int posx,
-                          const int posy,
-                          const int bw)
+/** the samples of the feather for dt_masks_stroke_falloff(): the path
+ * with the distance to its border as radius, no hardness and full
+ * density, shifted by the origin of the buffer. Where the border has been
+ * cut because it crossed itself the last radius is kept. */
+static float *_path_falloff_samples(const float *const points,
+                                    const float *const border,
+                                    const int first,
+                                    const int count,
+                                    const float offx,
+                                    const float offy)
 {
-  // segment length
-  int l = sqrtf(sqf(p1[0] - p0[0]) + sqf(p1[1] - p0[1])) + 1;
-
-  const float lx = p1[0] - p0[0];
-  const float ly = p1[1] - p0[1];
-
-  for(int i = 0; i < l; i++)
-  {
-    // position
-    const int x = (int)((float)i * lx / (float)l) + p0[0] - posx;
-    const int y = (int)((float)i * ly / (float)l) + p0[1] - posy;
-    const float op = 1.0 - (float)i / (float)l;
-    size_t idx = y * bw + x;
-    buffer[idx] = fmaxf(buffer[idx], op);
-    // this one is to avoid gap due to int rounding
-    if(x > 0)
-      buffer[idx - 1] = fmaxf(buffer[idx - 1], op);
-    // this one is to avoid gap due to int rounding
-    if(y > 0)
-      buffer[idx - bw] = fmaxf(buffer[idx - bw], op);
-  }
+  float *samples = dt_alloc_align_float((size_t)5 * MAX(1, count - first));
+  if(!samples) return NULL;
+
+  float radius = 0.0f;
+  int skip_to = first;
+  for(int i = first; i < count; i++)
+  {
+    const float bx = border[i * 2];
+    const float by = border[i * 2 + 1];
+    if(bx == DT_INVALID_COORDINATE)
+      skip_to = (by == DT_INVALID_COORDINATE) ? count : by;
+    else if(i >= skip_to)
+      radius = dt_fast_hypotf(bx - points[i * 2], by - points[i * 2 + 1]);
+
+    float *const s = samples + 5 * (i - first);
+    s[0] = points[i * 2] - offx;
+    s[1] = points[i * 2 + 1] - offy;
+    s[2] = radius;
+    s[3] = 0.0f;
+    s[4] = 1.0f;
+  }
+  return samples;
 }
 
 static int _path_get_mask(const dt_iop_module_t *const module,
@@ -4731,43 +4735,13 @@ static int _path_get_mask(const dt_iop_module_t *const module,
            dt_get_lap_time(&start2));
 
   // now we fill the falloff
-  int p0[2] = { 0 }, p1[2] = { 0 };
-  float pf1[2] = { 0.0f };
-  int last0[2] = { -100, -100 }, last1[2] = { -100, -100 };
-  int next = 0;
-  for(int i = _nb_wctrl_points(nb_corner); i < border_count; i++)
+  float *samples = _path_falloff_samples(points, border, _nb_wctrl_points(nb_corner),
+                                         border_count, *posx, *posy);
+  if(samples)
   {
-    p0[0] = points[i * 2];
-    p0[1] = points[i * 2 + 1];
-    if(next > 0)
-      p1[0] = pf1[0] = border[next * 2], p1[1] = pf1[1] = border[next * 2 + 1];
-    else
-      p1[0] = pf1[0] = border[i * 2], p1[1] = pf1[1] = border[i * 2 + 1];
-
-    // now we check p1 value to know if we have to skip a part
-    if(next == i) next = 0;
-    while(pf1[0] == DT_INVALID_COORDINATE)
-    {
-      if(pf1[1] == DT_INVALID_COORDINATE)
-        next = i - 1;
-      else
-        next = p1[1];
-      p1[0] = pf1[0] = border[next * 2];
-      p1[1] = pf1[1] = border[next * 2 + 1];
-    }
-
-    // and we draw the falloff
-    if(last0[0] != p0[0]
-       || last0[1] != p0[1]
-       || last1[0] != p1[0]
-       || last1[1] != p1[1])
-    {
-      _path_falloff(bufptr, p0, p1, *posx, *posy, *width);
-      last0[0] = p0[0];
-      last0[1] = p0[1];
-      last1[0] = p1[0];
-      last1[1] = p1[1];
-    }
+    dt_masks_stroke_falloff(bufptr, *width, *height, samples,
+                            border_count - _nb_wctrl_points(nb_corner), TRUE);
+    dt_free_align(samples);
   }
 
   dt_print(DT_DEBUG_MASKS | DT_DEBUG_PERF,
@@ -4944,41 +4918,6 @@ static int _path_crop_to_roi(float *path,
   return 1;
 }
 
-/** we write a falloff segment respecting limits of buffer */
-static void _path_falloff_roi(float *buffer,
-                              int *p0,
-                              int *p1,
-                              const int bw,
-                              const int bh)
-{
-  // segment length
-  const int l = sqrtf((p1[0] - p0[0]) * (p1[0] - p0[0])
-                      + (p1[1] - p0[1]) * (p1[1] - p0[1])) + 1;
-
-  const float lx = p1[0] - p0[0];
-  const float ly = p1[1] - p0[1];
-
-  const int dx = lx < 0 ? -1 : 1;
-  const int dy = ly < 0 ? -1 : 1;
-  const int dpy = dy * bw;
-
-  for(int i = 0; i < l; i++)
-  {
-    // position
-    const int x = (int)((float)i * lx / (float)l) + p0[0];
-    const int y = (int)((float)i * ly / (float)l) + p0[1];
-    const float op = 1.0f - (float)i / (float)l;
-    float *buf = buffer + (size_t)y * bw + x;
-
-    if(x >= 0 && x < bw && y >= 0 && y < bh)
-      buf[0] = MAX(buf[0], op);
-    if(x + dx >= 0 && x + dx < bw && y >= 0 && y < bh)
-      buf[dx] = MAX(buf[dx], op); // this one is to avoid gap due to int rounding
-    if(x >= 0 && x < bw && y + dy >= 0 && y + dy < bh)
-      buf[dpy] = MAX(buf[dpy], op); // this one is to avoid gap due to int rounding
-  }
-}
-
 // build a stamp which can be combined with other shapes in the same group
 // prerequisite: 'buffer' is all zeros
 static int _path_get_mask_roi(const dt_iop_module_t *const module,
@@ -5245,71 +5184,18 @@ static int _path_get_mask_roi(const dt_iop_module_t *const module,
   // deal with feather if it does not lie outside of roi
   if(!path_encircles_roi)
   {
-    int *dpoints = dt_alloc_align_int(4 * border_count);
-    if(dpoints == NULL)
+    float *samples = _path_falloff_samples(points, border, _nb_wctrl_points(nb_corner),
+                                           border_count, 0.0f, 0.0f);
+    if(samples == NULL)
     {
       dt_free_align(points);
       dt_free_align(border);
       return 0;
     }
 
-    int dindex = 0;
-    int p0[2], p1[2];
-    float pf1[2];
-    int last0[2] = { -100, -100 };
-    int last1[2] = { -100, -100 };
-    int next = 0;
-    for(int i = _nb_wctrl_points(nb_corner); i < border_count; i++)
-    {
-      p0[0] = floorf(points[i * 2] + 0.5f);
-      p0[1] = ceilf(points[i * 2 + 1]);
-      if(next > 0)
-      {
-        p1[0] = pf1[0] = border[next * 2];
-        p1[1] = pf1[1] = border[next * 2 + 1];
-      }
-      else
-      {
-        p1[0] = pf1[0] = border[i * 2];
-        p1[1] = pf1[1] = border[i * 2 + 1];
-      }
-
-      // now we check p1 value to know if we have to skip a part
-      if(next == i) next = 0;
-      while(pf1[0] == DT_INVALID_COORDINATE)
-      {
-        if(pf1[1] == DT_INVALID_COORDINATE)
-          next = i - 1;
-        else
-          next = p1[1];
-        p1[0] = pf1[0] = border[next * 2];
-        p1[1] = pf1[1] = border[next * 2 + 1];
-      }
-
-      // and we draw the falloff
-      if(last0[0] != p0[0]
-         || last0[1] != p0[1]
-         || last1[0] != p1[0]
-         || last1[1] != p1[1])
-      {
-        dpoints[dindex] = p0[0];
-        dpoints[dindex + 1] = p0[1];
-        dpoints[dindex + 2] = p1[0];
-        dpoints[dindex + 3] = p1[1];
-        dindex += 4;
-
-        last0[0] = p0[0];
-        last0[1] = p0[1];
-        last1[0] = p1[0];
-        last1[1] = p1[1];
-      }
-    }
-
-    DT_OMP_FOR()
-    for(int n = 0; n < dindex; n += 4)
-      _path_falloff_roi(buffer, dpoints + n, dpoints + n + 2, width, height);
-
-    dt_free_align(dpoints);
+    dt_masks_stroke_falloff(buffer, width, height, samples,
+                            border_count - _nb_wctrl_points(nb_corner), TRUE);
+    dt_free_align(samples);
 
     dt_print(DT_DEBUG_MASKS | DT_DEBUG_PERF,
              "[masks %s] path_fill fill falloff took %0.04f sec", form->name,
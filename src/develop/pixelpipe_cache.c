@@ -17,6 +17,7 @@
 */
 
 #include "develop/pixelpipe_cache.h"
+#include "common/trace.h"
 #include "develop/format.h"
 #include "develop/pixelpipe.h"
 #include "libs/lib.h"
@@ -312,6 +313,9 @@ gboolean dt_dev_pixelpipe_cache_get(dt_dev_pixelpipe_t *pipe,
           "%s %.3f %.3f %.3f, hash=%" PRIx64,
           dt_iop_colorspace_to_name(cdsc->cst), cdsc->temperature.coeffs[0], cdsc->temperature.coeffs[1], cdsc->temperature.coeffs[2],
           hash);
+    dt_trace_instant(DT_TRACE_CACHE, "%s cache hit %s",
+                     dt_dev_pixelpipe_type_to_str(pipe->type),
+                     module ? module->op : "");
     return FALSE;
   }
   // We need a fresh buffer as there was no hit.
@@ -358,6 +362,10 @@ gboolean dt_dev_pixelpipe_cache_get(dt_dev_pixelpipe_t *pipe,
      cline, cache->used[cline], cache->data[cline], cache->hash[cline],
      masking ? ". masking." : "");
 
+  dt_trace_instant(DT_TRACE_CACHE, "%s cache miss %s",
+                   dt_dev_pixelpipe_type_to_str(pipe->type),
+                   module ? module->op : "");
+
   cache->used[cline]      = !masking && important ? -cache->entries : 0;
   cache->ioporder[cline]  = module ? module->iop_order : 0;
 
@@ -22,6 +22,8 @@
 #include "common/opencl.h"
 #include "common/iop_order.h"
 #include "common/imagebuf.h"
+#include "common/thread_budget.h"
+#include "common/trace.h"
 #include "control/control.h"
 #include "control/signal.h"
 #include "develop/blend.h"
@@ -1580,6 +1582,9 @@ static gboolean _pixelpipe_process_on_CPU(dt_dev_pixelpipe_t *pipe,
       ? dt_ioppr_get_pipe_work_profile_info(pipe)
       : NULL;
 
+  // follow changes of the thread budget caused by other pipes or jobs
+  dt_thread_budget_refresh();
+
   const dt_iop_colorspace_type_t cst_from = input_format->cst;
   const dt_iop_colorspace_type_t cst_to = module->input_colorspace(module, pipe, piece);
   const dt_iop_colorspace_type_t cst_out = module->output_colorspace(module, pipe, piece);
@@ -1658,7 +1663,11 @@ static gboolean _pixelpipe_process_on_CPU(dt_dev_pixelpipe_t *pipe,
     }
     else
     {
+      const double tstart = dt_trace_begin();
       module->process_tiling(module, piece, tmp, *output, roi_in, roi_out, in_bpp);
+      dt_trace_end(tstart, DT_TRACE_PIPE, "%s %s%s tiled",
+                   dt_dev_pixelpipe_type_to_str(pipe->type),
+                   module->op, dt_iop_get_instance_id(module));
       if(want_bcache)
       {
         if(dt_pipe_no_mask_display(pipe))
@@ -1696,7 +1705,11 @@ static gboolean _pixelpipe_process_on_CPU(dt_dev_pixelpipe_t *pipe,
       if(darktable.bench_module && _is_debug_pipe(pipe) && dt_str_commasubstring(darktable.bench_module, module->op))
         _cpu_benchmark(pipe, module, piece, tmp, *output, roi_out, roi_in);
 
+      const double tstart = dt_trace_begin();
       module->process(module, piece, tmp, *output, roi_in, roi_out);
+      dt_trace_end(tstart, DT_TRACE_PIPE, "%s %s%s",
+                   dt_dev_pixelpipe_type_to_str(pipe->type),
+                   module->op, dt_iop_get_instance_id(module));
       if(want_bcache)
       {
         if(dt_pipe_no_mask_display(pipe))
@@ -3205,6 +3218,15 @@ void dt_dev_pixelpipe_disable_before(dt_dev_pixelpipe_t *pipe, const char *op)
   }
 }
 
+static dt_thread_client_t _pipe_thread_client(const dt_dev_pixelpipe_t *pipe)
+{
+  if(pipe->type & DT_DEV_PIXELPIPE_FULL)      return DT_THREAD_CLIENT_FULL;
+  if(pipe->type & DT_DEV_PIXELPIPE_PREVIEW)   return DT_THREAD_CLIENT_PREVIEW;
+  if(pipe->type & DT_DEV_PIXELPIPE_PREVIEW2)  return DT_THREAD_CLIENT_PREVIEW2;
+  if(pipe->type & DT_DEV_PIXELPIPE_THUMBNAIL) return DT_THREAD_CLIENT_THUMBNAIL;
+  return DT_THREAD_CLIENT_EXPORT;
+}
+
 // returns TRUE in case of error or early exit
 static gboolean _dev_pixelpipe_process_rec_and_backcopy(dt_dev_pixelpipe_t *pipe,
                                                         dt_develop_t *dev,
@@ -3217,9 +3239,12 @@ static gboolean _dev_pixelpipe_process_rec_and_backcopy(dt_dev_pixelpipe_t *pipe
                                                         const int pos)
 {
   dt_pthread_mutex_lock(&pipe->busy_mutex);
+  const dt_thread_client_t client = _pipe_thread_client(pipe);
+  const int previous_client = dt_thread_budget_acquire(client);
   gboolean ret = _dev_pixelpipe_process_rec(pipe, dev, output,
                                             cl_mem_output, out_format, roi_out,
                                             modules, pieces, pos);
+  dt_thread_budget_release(client, previous_client);
 #ifdef HAVE_OPENCL
   // copy back final opencl buffer (if any) to CPU
   if(ret)
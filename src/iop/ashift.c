@@ -67,6 +67,11 @@
 #define LSD_DENSITY_TH 0.7                  // LSD: minimal density of region points in rectangle
 #define LSD_N_BINS 1024                     // LSD: number of bins in pseudo-ordering of gradient modulus
 #define LSD_GAMMA 0.45                      // gamma correction to apply on raw images prior to line detection
+#define LSD_STRIPE_HEIGHT 256               // LSD: minimal height of the image stripes detected in parallel
+#define LSD_STRIPE_OVERLAP 24               // LSD: rows a stripe shares with each of its neighbours
+#define LSD_MERGE_ANGLE 2.0                 // LSD: max angle in degrees between two parts of a line
+#define LSD_COARSE_SCALE 0.5                // LSD: scaling factor for coarse line detection
+#define LSD_REFINE_RADIUS 3                 // LSD: search distance in pixels when refining coarse lines
 #define RANSAC_RUNS 400                     // how many iterations to run in ransac
 #define RANSAC_EPSILON 2                    // starting value for ransac epsilon (in -log10 units)
 #define RANSAC_EPSILON_STEP 1               // step size of epsilon optimization (log10 units)
@@ -1472,6 +1477,263 @@ static void gamma_correct(const float *const in,
   }
 }
 
+// join line b into line a if both are parts of the same straight line,
+// lines are stored as LSD does: x1, y1, x2, y2, width, p, -log10(NFA)
+static gboolean _lsd_join(double *const a, const double *const b)
+{
+  const double alen = hypot(a[2] - a[0], a[3] - a[1]);
+  const double blen = hypot(b[2] - b[0], b[3] - b[1]);
+  if(alen < 1.0 || blen < 1.0) return FALSE;
+  const double ux = (a[2] - a[0]) / alen;
+  const double uy = (a[3] - a[1]) / alen;
+
+  // same direction
+  const double sin_angle = fabs(ux * (b[3] - b[1]) - uy * (b[2] - b[0])) / blen;
+  if(sin_angle > sin(deg2radf(LSD_MERGE_ANGLE))) return FALSE;
+
+  // the end points of b on the line of a
+  const double tolerance = fmax(1.0, 0.5 * fmax(a[4], b[4]));
+  for(int k = 0; k < 4; k += 2)
+    if(fabs(ux * (b[k + 1] - a[1]) - uy * (b[k] - a[0])) > tolerance) return FALSE;
+
+  // and overlapping or touching a
+  const double t1 = ux * (b[0] - a[0]) + uy * (b[1] - a[1]);
+  const double t2 = ux * (b[2] - a[0]) + uy * (b[3] - a[1]);
+  const double tmin = fmin(0.0, fmin(t1, t2));
+  const double tmax = fmax(alen, fmax(t1, t2));
+  if(tmax - tmin > alen + blen + 1.0) return FALSE;
+
+  if(blen > alen)
+  {
+    a[4] = b[4];
+    a[5] = b[5];
+  }
+  a[6] = fmax(a[6], b[6]);
+  a[2] = a[0] + tmax * ux;
+  a[3] = a[1] + tmax * uy;
+  a[0] += tmin * ux;
+  a[1] += tmin * uy;
+  return TRUE;
+}
+
+// run LSD on horizontal stripes of the image in parallel. Each stripe
+// keeps the lines centred in its own rows, lines crossing a seam are
+// found in both stripes and joined. The stripes only depend on the image
+// size, so the lines found don't depend on the number of threads.
+static double *_lsd_stripes(int *n_out,
+                            double *img,
+                            const int width,
+                            const int height,
+                            const double scale)
+{
+  const int nstripes = height / LSD_STRIPE_HEIGHT;
+  if(nstripes < 2)
+    return LineSegmentDetection(n_out, img, width, height,
+                                scale, LSD_SIGMA_SCALE, LSD_QUANT,
+                                LSD_ANG_TH, LSD_LOG_EPS, LSD_DENSITY_TH,
+                                LSD_N_BINS, NULL, NULL, NULL, 0, 0);
+
+  double **stripe_lines = calloc(nstripes, sizeof(double *));
+  int *stripe_count = calloc(nstripes, sizeof(int));
+  if(!stripe_lines || !stripe_count)
+  {
+    free(stripe_lines);
+    free(stripe_count);
+    return NULL;
+  }
+
+  // the number of tests is the one of the whole image, so that each
+  // stripe has the same detection threshold. the stripes differ a lot
+  // in the time they take.
+  DT_OMP_PRAGMA(parallel for default(firstprivate) schedule(dynamic))
+  for(int s = 0; s < nstripes; s++)
+  {
+    const int top = MAX(0, s * height / nstripes - LSD_STRIPE_OVERLAP);
+    const int bottom = MIN(height, (s + 1) * height / nstripes + LSD_STRIPE_OVERLAP);
+    double *lines = LineSegmentDetection(&stripe_count[s], img + (size_t)top * width,
+                                         width, bottom - top,
+                                         scale, LSD_SIGMA_SCALE, LSD_QUANT,
+                                         LSD_ANG_TH, LSD_LOG_EPS, LSD_DENSITY_TH,
+                                         LSD_N_BINS, NULL, NULL, NULL, width, height);
+    if(!lines)
+    {
+      stripe_count[s] = 0;
+      continue;
+    }
+    for(int n = 0; n < stripe_count[s]; n++)
+    {
+      lines[n * 7 + 1] += top;
+      lines[n * 7 + 3] += top;
+    }
+    stripe_lines[s] = lines;
+  }
+
+  // a stripe without result fails all of it, as a single pass would
+  gboolean failed = FALSE;
+  int total = 0;
+  for(int s = 0; s < nstripes; s++)
+  {
+    failed |= !stripe_lines[s];
+    total += stripe_count[s];
+  }
+  double *lines = failed ? NULL : malloc(sizeof(double) * 7 * MAX(total, 1));
+  int *stripe = failed ? NULL : malloc(sizeof(int) * MAX(total, 1));
+  if(!lines || !stripe)
+  {
+    for(int s = 0; s < nstripes; s++) free(stripe_lines[s]);
+    free(lines);
+    free(stripe);
+    free(stripe_count);
+    free(stripe_lines);
+    return NULL;
+  }
+
+  int count = 0;
+  for(int s = 0; s < nstripes; s++)
+  {
+    const int y0 = s * height / nstripes;
+    const int y1 = (s + 1) * height / nstripes;
+    for(int n = 0; n < stripe_count[s]; n++)
+    {
+      const double *line = stripe_lines[s] + n * 7;
+      const double centre = 0.5 * (line[1] + line[3]);
+      if(centre < y0 || centre >= y1) continue;
+      memcpy(lines + count * 7, line, sizeof(double) * 7);
+      stripe[count++] = s;
+    }
+    free(stripe_lines[s]);
+  }
+
+  // a joined line belongs to the lower stripe, to be joined again at
+  // the next seam
+  for(int s = 0; s + 1 < nstripes; s++)
+  {
+    const int seam = (s + 1) * height / nstripes;
+    for(int i = 0; i < count; i++)
+    {
+      const double *a = lines + i * 7;
+      if(stripe[i] != s || fmax(a[1], a[3]) < seam - LSD_STRIPE_OVERLAP) continue;
+      for(int j = 0; j < count; j++)
+      {
+        double *b = lines + j * 7;
+        if(stripe[j] != s + 1 || fmin(b[1], b[3]) > seam + LSD_STRIPE_OVERLAP) continue;
+        if(_lsd_join(b, a))
+        {
+          stripe[i] = -1;
+          break;
+        }
+      }
+    }
+  }
+
+  int kept = 0;
+  for(int i = 0; i < count; i++)
+    if(stripe[i] >= 0)
+      memmove(lines + 7 * kept++, lines + 7 * i, sizeof(double) * 7);
+
+  free(stripe);
+  free(stripe_count);
+  free(stripe_lines);
+  *n_out = kept;
+  return lines;
+}
+
+// bilinear lookup in the greyscale image
+static inline double _lsd_sample(const double *const img,
+                                 const int width,
+                                 const int height,
+                                 const double x,
+                                 const double y)
+{
+  const double xc = CLAMP(x, 0.0, width - 1.001);
+  const double yc = CLAMP(y, 0.0, height - 1.001);
+  const int x0 = xc;
+  const int y0 = yc;
+  const double fx = xc - x0;
+  const double fy = yc - y0;
+  const double *const p = img + (size_t)y0 * width + x0;
+  return (1.0 - fy) * ((1.0 - fx) * p[0] + fx * p[1])
+         + fy * ((1.0 - fx) * p[width] + fx * p[width + 1]);
+}
+
+// refit a line found at a reduced scale to the strongest edge next to
+// it in the full resolution image, leave it as it is if there is no such
+// clear edge
+static void _lsd_refine(double *const line,
+                        const double *const img,
+                        const int width,
+                        const int height)
+{
+  const double len = hypot(line[2] - line[0], line[3] - line[1]);
+  if(len < 8.0) return;
+  const double ux = (line[2] - line[0]) / len;
+  const double uy = (line[3] - line[1]) / len;
+  const double nx = -uy;
+  const double ny = ux;
+  const int r = LSD_REFINE_RADIUS;
+
+  double sw = 0.0, sx = 0.0, sy = 0.0, sxx = 0.0, syy = 0.0, sxy = 0.0;
+  int found = 0;
+  const int steps = len;
+  for(int t = 1; t < steps; t++)
+  {
+    const double px = line[0] + t * ux;
+    const double py = line[1] + t * uy;
+
+    // edge strength across the line
+    double g[2 * LSD_REFINE_RADIUS + 1];
+    int kmax = 0;
+    for(int k = -r; k <= r; k++)
+    {
+      g[k + r] = fabs(_lsd_sample(img, width, height, px + (k + 0.5) * nx, py + (k + 0.5) * ny)
+                      - _lsd_sample(img, width, height, px + (k - 0.5) * nx, py + (k - 0.5) * ny));
+      if(g[k + r] > g[kmax + r]) kmax = k;
+    }
+    if(kmax == -r || kmax == r || g[kmax + r] < LSD_QUANT) continue;
+
+    // sub-pixel position of the maximum
+    const double gm = g[kmax + r - 1];
+    const double g0 = g[kmax + r];
+    const double gp = g[kmax + r + 1];
+    const double den = gm - 2.0 * g0 + gp;
+    const double o = kmax + (den < 0.0 ? 0.5 * (gm - gp) / den : 0.0);
+    const double qx = px + o * nx;
+    const double qy = py + o * ny;
+
+    sw += g0;
+    sx += g0 * qx;
+    sy += g0 * qy;
+    sxx += g0 * qx * qx;
+    syy += g0 * qy * qy;
+    sxy += g0 * qx * qy;
+    found++;
+  }
+  if(found < MAX(8, steps / 2)) return;
+
+  // weighted least squares line through the edge points
+  const double cx = sx / sw;
+  const double cy = sy / sw;
+  const double cxx = sxx / sw - cx * cx;
+  const double cyy = syy / sw - cy * cy;
+  const double cxy = sxy / sw - cx * cy;
+  const double theta = 0.5 * atan2(2.0 * cxy, cxx - cyy);
+  double dx = cos(theta);
+  double dy = sin(theta);
+  if(dx * ux + dy * uy < 0.0)
+  {
+    dx = -dx;
+    dy = -dy;
+  }
+  if(fabs(dx * uy - dy * ux) > sin(deg2radf(LSD_MERGE_ANGLE))) return;
+
+  for(int k = 0; k < 4; k += 2)
+  {
+    const double t = (line[k] - cx) * dx + (line[k + 1] - cy) * dy;
+    line[k] = cx + t * dx;
+    line[k + 1] = cy + t * dy;
+  }
+}
+
 // do actual line_detection based on LSD algorithm and return results according
 // to this module's conventions
 static gboolean line_detect(float *in,
@@ -1526,12 +1788,25 @@ static gboolean line_detect(float *in,
   // call the line segment detector LSD;
   // LSD stores the number of found lines in lines_count.
   // it returns structural details as vector 'double lines[7 * lines_count]'
+  // the coarse detection works on a quarter of the pixels and refits
+  // the lines at full resolution
   int lines_count;
+  const double start = dt_get_wtime();
+  const gboolean coarse = dt_conf_get_bool("plugins/darkroom/ashift/coarse_detection");
+
+  lsd_lines = _lsd_stripes(&lines_count, greyscale, width, height,
+                           coarse ? LSD_COARSE_SCALE : LSD_SCALE);
+  if(lsd_lines == NULL) goto error;
+
+  if(coarse)
+  {
+    DT_OMP_FOR()
+    for(int n = 0; n < lines_count; n++)
+      _lsd_refine(lsd_lines + n * 7, greyscale, width, height);
+  }
 
-  lsd_lines = LineSegmentDetection(&lines_count, greyscale, width, height,
-                                   LSD_SCALE, LSD_SIGMA_SCALE, LSD_QUANT,
-                                   LSD_ANG_TH, LSD_LOG_EPS, LSD_DENSITY_TH,
-                                   LSD_N_BINS, NULL, NULL, NULL);
+  dt_print(DT_DEBUG_PERF, "[ashift] line detection: %dx%d, %d lines%s in %.3fs",
+           width, height, lines_count, coarse ? " (coarse)" : "", dt_get_wtime() - start);
 
   // we count the lines that we really want to use
   int lct = 0;
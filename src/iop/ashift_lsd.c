@@ -1068,10 +1068,14 @@ static double log_gamma_windschitl(const double x)
 
 static double *inv = NULL; /* table to keep computed inverse values */
 
+// the table is filled right away, so that several detections can run in parallel
 __attribute__((constructor)) static void invConstructor()
 {
   if(inv) return;
   inv = malloc(sizeof(double) * TABSIZE);
+  if(!inv) return;
+  inv[0] = 0.0;
+  for(int i = 1; i < TABSIZE; i++) inv[i] = 1.0 / (double) i;
 }
 
 __attribute__((destructor)) static void invDestructor()
@@ -1180,9 +1184,8 @@ static double nfa(const int n, const int k, const double p, const double logNT)
          because divisions are expensive.
          p/(1-p) is computed only once and stored in 'p_term'.
        */
-      bin_term = (double) (n-i+1) * ( i<TABSIZE ?
-                   ( inv[i]!=0.0 ? inv[i] : ( inv[i] = 1.0 / (double) i ) ) :
-                   1.0 / (double) i );
+      bin_term = (double) (n-i+1) * ( i<TABSIZE && inv ?
+                   inv[i] : 1.0 / (double) i );
 
       mult_term = bin_term * p_term;
       term *= mult_term;
@@ -2077,6 +2080,10 @@ static int refine( struct point * reg, int * reg_size, const image_double modgra
 
 /*----------------------------------------------------------------------------*/
 /** LSD full interface.
+
+    When 'img' is a stripe of a larger image, 'NT_X' and 'NT_Y' give the size
+    of the whole image for the number of tests, so that the detection threshold
+    stays the same. Zero uses the size of 'img'.
  */
 static
 double * LineSegmentDetection( int * n_out,
@@ -2084,7 +2091,8 @@ double * LineSegmentDetection( int * n_out,
                                const double scale, const double sigma_scale, const double quant,
                                const double ang_th, const double log_eps, const double density_th,
                                const int n_bins,
-                               int ** reg_img, int * reg_x, int * reg_y )
+                               int ** reg_img, int * reg_x, int * reg_y,
+                               const int NT_X, const int NT_Y )
 {
   image_double image;
   const ntuple_list out = new_ntuple_list(7);
@@ -2148,8 +2156,12 @@ double * LineSegmentDetection( int * n_out,
      whose logarithm value is
        log10(11) + 5/2 * (log10(X) + log10(Y)).
   */
-  logNT = 5.0 * ( log10( (double) xsize ) + log10( (double) ysize ) ) / 2.0
-          + log10(11.0);
+  if( NT_X > 0 && NT_Y > 0 )
+    logNT = 5.0 * ( log10( ceil( NT_X * scale ) ) + log10( ceil( NT_Y * scale ) ) ) / 2.0
+            + log10(11.0);
+  else
+    logNT = 5.0 * ( log10( (double) xsize ) + log10( (double) ysize ) ) / 2.0
+            + log10(11.0);
   min_reg_size = (int) (-logNT/log10(p)); /* minimal number of points in region
                                              that can give a meaningful event */
 
@@ -62,6 +62,7 @@ None;midi:CC24=iop/colorequal/brightness/magenta
 #include "common/eigf.h"
 #include "common/interpolation.h"
 #include "common/gaussian.h"
+#include "common/guided_filter_cache.h"
 #include "common/opencl.h"
 #include "common/color_picker.h"
 #include "control/conf.h"
@@ -586,13 +587,13 @@ static void _apply_prefilter(const size_t npixels,
   }
 }
 
-static void _prefilter_chromaticity(float *const restrict UV,
-                                    const float *const restrict saturation,
-                                    const int width,
-                                    const int height,
-                                    const float sigma,
-                                    const float eps,
-                                    const float sat_shift)
+static gboolean _prefilter_chromaticity(float *const restrict UV,
+                                        const float *const restrict saturation,
+                                        const int width,
+                                        const int height,
+                                        const float sigma,
+                                        const float eps,
+                                        const float sat_shift)
 {
   // We guide the 3-channels corrections with the 2-channels
   // chromaticity coordinates UV aka we express corrections = a * UV +
@@ -619,7 +620,7 @@ static void _prefilter_chromaticity(float *const restrict UV,
   {
     ds_UV = dt_alloc_align_float(ds_pixels * 2);
     if(!ds_UV)
-      return;	//out of memory, can't run the prefilter
+      return FALSE;	//out of memory, can't run the prefilter
     interpolate_bilinear(UV, width, height, ds_UV, ds_width, ds_height, 2);
   }
 
@@ -627,7 +628,7 @@ static void _prefilter_chromaticity(float *const restrict UV,
   if(!covariance)
   {
     if(ds_UV != UV) dt_free_align(ds_UV);
-    return;
+    return FALSE;
   }
 
   // Compute the local averages of everything over the window size We
@@ -654,7 +655,7 @@ static void _prefilter_chromaticity(float *const restrict UV,
   {
     dt_free_align(ds_a);
     dt_free_align(ds_b);
-    return;
+    return FALSE;
   }
 
   // Compute the averages of a and b for each filter
@@ -680,7 +681,7 @@ static void _prefilter_chromaticity(float *const restrict UV,
     {
       dt_free_align(ds_a);
       dt_free_align(ds_b);
-      return;
+      return FALSE;
     }
   }
 
@@ -689,6 +690,7 @@ static void _prefilter_chromaticity(float *const restrict UV,
 
   dt_free_align(a);
   dt_free_align(b);
+  return TRUE;
 }
 
 static void _guide_with_chromaticity(float *const restrict UV,
@@ -1036,8 +1038,18 @@ void process(dt_iop_module_t *self,
   dt_gaussian_mean_blur(saturation, width, height, 1, sat_sigma);
 
   // STEP 2 : smoothen UV to avoid discontinuities in hue
+  // it only depends on the input and the filter parameters, all darkroom pipes
+  // share the filtered UV while the corrections are adjusted
   if(d->use_filter && !run_fast)
-    _prefilter_chromaticity(UV, saturation, width, height, hue_sigma, d->chroma_feathering, sat_shift);
+  {
+    const float prefilter_params[4] = { hue_sigma, d->chroma_feathering, sat_shift, d->contrast };
+    const dt_hash_t key = dt_guided_filter_cache_key(piece, roi_in, prefilter_params,
+                                                     sizeof(prefilter_params));
+    if(!dt_guided_filter_cache_get(key, UV, 2 * npixels)
+       && _prefilter_chromaticity(UV, saturation, width, height, hue_sigma,
+                                  d->chroma_feathering, sat_shift))
+      dt_guided_filter_cache_put(key, UV, 2 * npixels);
+  }
 
   // STEP 3 : carry-on with conversion from LUV to HSB
   DT_OMP_FOR()
@@ -43,6 +43,25 @@
 #define DT_IOP_COLOR_ICC_LEN 512
 #define LUT_SAMPLES 0x10000
 
+// lcms transforms are baked into a Lab indexed 3D lut with CLUT_LEVEL nodes per axis
+// covering L 0..100 and a, b -128..128. Pixels outside of that, and in cells
+// not interpolated well enough, are done by lcms.
+#define CLUT_LEVEL 65
+// largest output difference to lcms allowed for interpolated cells
+#define CLUT_MAXERR (1.0f / 1024.0f)
+// largest error allowed at the test points of a cell, in between them it gets up to
+// about three times as large
+#define CLUT_TESTERR (0.25f * CLUT_MAXERR)
+// number of test points per cell
+#define CLUT_POINTS 7
+// don't use the lut if more cells than that need lcms
+#define CLUT_MAXEXACT 0.5f
+// baking costs about as much as transforming that many pixels
+#define CLUT_MIN_PIXELS (CLUT_LEVEL * CLUT_LEVEL * CLUT_LEVEL \
+                         + CLUT_POINTS * (CLUT_LEVEL - 1) * (CLUT_LEVEL - 1) * (CLUT_LEVEL - 1))
+// number of luts kept in the cache, each is about 4.7MB
+#define CLUT_CACHE 4
+
 DT_MODULE_INTROSPECTION(5, dt_iop_colorout_params_t)
 
 typedef struct dt_iop_colorout_data_t
@@ -53,11 +72,26 @@ typedef struct dt_iop_colorout_data_t
   dt_colormatrix_t cmatrix;
   cmsHTRANSFORM *xform;
   float unbounded_coeffs[3][3]; // for extrapolation of shaper curves
+  dt_hash_t clut_key;           // zero if the xform must not be baked
+  struct dt_iop_colorout_clut_t *clut;
 } dt_iop_colorout_data_t;
 
+// an lcms transform baked into a lut, shared by all pipes using the same
+// profiles and intent
+typedef struct dt_iop_colorout_clut_t
+{
+  dt_hash_t key;
+  float *clut;    // CLUT_LEVEL^3 RGBA nodes, NULL if not accurate enough
+  uint8_t *exact; // cells that must be done by lcms
+  int users;
+  gboolean dropped;
+} dt_iop_colorout_clut_t;
+
 typedef struct dt_iop_colorout_global_data_t
 {
   int kernel_colorout;
+  GList *cluts;
+  dt_pthread_mutex_t clut_lock;
 } dt_iop_colorout_global_data_t;
 
 typedef struct dt_iop_colorout_params_t
@@ -231,12 +265,24 @@ void init_global(dt_iop_module_so_t *self)
   dt_iop_colorout_global_data_t *gd = malloc(sizeof(dt_iop_colorout_global_data_t));
   self->data = gd;
   gd->kernel_colorout = dt_opencl_create_kernel(program, "colorout");
+  gd->cluts = NULL;
+  dt_pthread_mutex_init(&gd->clut_lock, NULL);
+}
+
+static void _clut_free(gpointer data)
+{
+  dt_iop_colorout_clut_t *clut = data;
+  dt_free_align(clut->clut);
+  free(clut->exact);
+  free(clut);
 }
 
 void cleanup_global(dt_iop_module_so_t *self)
 {
   dt_iop_colorout_global_data_t *gd = self->data;
   dt_opencl_free_kernel(gd->kernel_colorout);
+  g_list_free_full(gd->cluts, _clut_free);
+  dt_pthread_mutex_destroy(&gd->clut_lock);
   free(self->data);
   self->data = NULL;
 }
@@ -517,13 +563,345 @@ static void _transform_lcms(const dt_iop_colorout_data_t *const d,
   dt_omploop_sfence();
 }
 
+static inline gboolean _clut_inside(const float *const lab)
+{
+  // also false for anything not finite
+  return lab[0] >= 0.0f && lab[0] <= 100.0f
+      && lab[1] >= -128.0f && lab[1] <= 128.0f
+      && lab[2] >= -128.0f && lab[2] <= 128.0f;
+}
+
+// position of lab in the lut, returns the cell index and sets the node offset and fractions
+static inline size_t _clut_cell(const float *const lab,
+                                size_t *const base,
+                                float *const f)
+{
+  const int n = CLUT_LEVEL;
+  const dt_aligned_pixel_t scale = { (n - 1) / 100.0f, (n - 1) / 256.0f, (n - 1) / 256.0f, 0.0f };
+  const dt_aligned_pixel_t offset = { 0.0f, 128.0f, 128.0f, 0.0f };
+  int i[3];
+  for(int c = 0; c < 3; c++)
+  {
+    const float pos = (lab[c] + offset[c]) * scale[c];
+    i[c] = MIN((int)pos, n - 2);
+    f[c] = pos - i[c];
+  }
+  *base = 4 * (((size_t)i[0] * n + i[1]) * n + i[2]);
+  return ((size_t)i[0] * (n - 1) + i[1]) * (n - 1) + i[2];
+}
+
+// tetrahedral interpolation, the nodes are RGBA so every node is a single aligned vector
+static inline void _clut_interpolate(const float *const restrict clut,
+                                     const size_t base,
+                                     const float *const f,
+                                     float *const out)
+{
+  const int n = CLUT_LEVEL;
+  const size_t stride[3] = { 4 * n * n, 4 * n, 4 };
+
+  // walk from p000 to p111 along the axes in the order of decreasing fractions
+  int a = 0, b = 1, c = 2;
+  if(f[a] < f[b]) { const int t = a; a = b; b = t; }
+  if(f[b] < f[c]) { const int t = b; b = c; c = t; }
+  if(f[a] < f[b]) { const int t = a; a = b; b = t; }
+
+  const float *const p0 = clut + base;
+  const float *const p1 = p0 + stride[a];
+  const float *const p2 = p1 + stride[b];
+  const float *const p3 = p2 + stride[c];
+  const float w0 = 1.0f - f[a];
+  const float w1 = f[a] - f[b];
+  const float w2 = f[b] - f[c];
+  const float w3 = f[c];
+  for_each_channel(k, aligned(p0, p1, p2, p3))
+    out[k] = w0 * p0[k] + w1 * p1[k] + w2 * p2[k] + w3 * p3[k];
+}
+
+static void _lcms_chunked(cmsHTRANSFORM xform,
+                          float *out,
+                          const float *in,
+                          const size_t npixels)
+{
+  const size_t chunksize = dt_cacheline_chunks(npixels, dt_get_num_threads());
+  DT_OMP_FOR()
+  for(size_t chunkstart = 0; chunkstart < npixels; chunkstart += chunksize)
+    cmsDoTransform(xform, in + 4 * chunkstart, out + 4 * chunkstart,
+                   MIN(chunkstart + chunksize, npixels) - chunkstart);
+}
+
+// the test points of a cell as fractions of its size, the centre and
+// one point inside each of the six tetrahedra of the interpolation
+static const float _clut_points[CLUT_POINTS][3] =
+  { { 0.5f, 0.5f, 0.5f },
+    { 0.25f, 0.5f, 0.75f }, { 0.25f, 0.75f, 0.5f }, { 0.5f, 0.25f, 0.75f },
+    { 0.5f, 0.75f, 0.25f }, { 0.75f, 0.25f, 0.5f }, { 0.75f, 0.5f, 0.25f } };
+
+static dt_iop_colorout_clut_t *_clut_build(const dt_hash_t key,
+                                           cmsHTRANSFORM xform)
+{
+  const double start = dt_get_wtime();
+  const int n = CLUT_LEVEL;
+  const int m = CLUT_LEVEL - 1;
+  const size_t nodes = (size_t)n * n * n;
+  const size_t cells = (size_t)m * m * m;
+  // the test points are transformed one slab of cells along L at a time
+  const size_t points = (size_t)m * m * CLUT_POINTS;
+
+  dt_iop_colorout_clut_t *clut = calloc(1, sizeof(dt_iop_colorout_clut_t));
+  if(!clut) return NULL;
+  clut->key = key;
+
+  float *lab = dt_alloc_align_float(4 * MAX(nodes, points));
+  float *lut = dt_alloc_align_float(4 * nodes);
+  float *ref = dt_alloc_align_float(4 * points);
+  uint8_t *exact = calloc(cells, sizeof(uint8_t));
+  if(!lab || !lut || !ref || !exact)
+  {
+    dt_free_align(lab);
+    dt_free_align(lut);
+    dt_free_align(ref);
+    free(exact);
+    free(clut);
+    return NULL;
+  }
+
+  DT_OMP_FOR(collapse(3))
+  for(int l = 0; l < n; l++)
+    for(int a = 0; a < n; a++)
+      for(int b = 0; b < n; b++)
+      {
+        float *node = lab + 4 * (((size_t)l * n + a) * n + b);
+        node[0] = 100.0f * l / m;
+        node[1] = 256.0f * a / m - 128.0f;
+        node[2] = 256.0f * b / m - 128.0f;
+        node[3] = 0.0f;
+      }
+  _lcms_chunked(xform, lut, lab, nodes);
+  for(size_t k = 0; k < nodes; k++) lut[4 * k + 3] = 0.0f;
+
+  // a cell is done by lcms if the interpolation is off at any test point, or if
+  // any channel crosses 0 or 1 as there is a kink from clipping or a steep curve.
+  // the values are compared unclipped, so cells beyond the output gamut have to
+  // be right as well.
+  const size_t corner[8] = { 0, 4, 4 * n, 4 * n + 4,
+                             4 * n * n, 4 * n * n + 4, 4 * n * n + 4 * n, 4 * n * n + 4 * n + 4 };
+  float maxerr = 0.0f;
+  double sumerr = 0.0;
+  int nexact = 0;
+  for(int l = 0; l < m; l++)
+  {
+    // the lab buffer is reused for the test points
+    DT_OMP_FOR(collapse(3))
+    for(int a = 0; a < m; a++)
+      for(int b = 0; b < m; b++)
+        for(int t = 0; t < CLUT_POINTS; t++)
+        {
+          float *p = lab + 4 * (((size_t)a * m + b) * CLUT_POINTS + t);
+          p[0] = 100.0f * (l + _clut_points[t][0]) / m;
+          p[1] = 256.0f * (a + _clut_points[t][1]) / m - 128.0f;
+          p[2] = 256.0f * (b + _clut_points[t][2]) / m - 128.0f;
+          p[3] = 0.0f;
+        }
+    _lcms_chunked(xform, ref, lab, points);
+
+    DT_OMP_FOR(reduction(max : maxerr) reduction(+ : sumerr, nexact) collapse(2))
+    for(int a = 0; a < m; a++)
+      for(int b = 0; b < m; b++)
+      {
+        const size_t base = 4 * (((size_t)l * n + a) * n + b);
+        const float *const cref = ref + 4 * ((size_t)a * m + b) * CLUT_POINTS;
+
+        float err = 0.0f;
+        for(int t = 0; t < CLUT_POINTS; t++)
+        {
+          dt_aligned_pixel_t res;
+          _clut_interpolate(lut, base, _clut_points[t], res);
+          for(int c = 0; c < 3; c++)
+          {
+            // also catches anything not finite
+            const float e = fabsf(res[c] - cref[4 * t + c]);
+            err = MAX(err, e <= 1.0f ? e : 1.0f);
+          }
+        }
+
+        gboolean kink = FALSE;
+        for(int c = 0; c < 3; c++)
+        {
+          float lo = lut[base + c];
+          float hi = lo;
+          for(int v = 1; v < 8; v++)
+          {
+            lo = MIN(lo, lut[base + corner[v] + c]);
+            hi = MAX(hi, lut[base + corner[v] + c]);
+          }
+          kink |= (lo <= 0.0f && hi > 0.0f) || (lo < 1.0f && hi > 1.0f);
+        }
+
+        sumerr += err;
+        if(kink || !(err <= CLUT_TESTERR))
+        {
+          exact[((size_t)l * m + a) * m + b] = 1;
+          nexact++;
+        }
+        else
+          maxerr = MAX(maxerr, err);
+      }
+  }
+
+  const float share = (float)nexact / cells;
+  if(share <= CLUT_MAXEXACT)
+  {
+    clut->clut = lut;
+    clut->exact = exact;
+  }
+  else
+  {
+    dt_free_align(lut);
+    free(exact);
+  }
+
+  dt_print(DT_DEBUG_PERF,
+           "[colorout] %d^3 lut baked in %.3fs, test point error mean %.6f, max %.6f"
+           " for interpolated cells, %.1f%% cells by lcms%s",
+           n, dt_get_wtime() - start, sumerr / cells, maxerr, 100.0f * share,
+           clut->clut ? "" : ", lut not used");
+
+  dt_free_align(lab);
+  dt_free_align(ref);
+  return clut;
+}
+
+// get the baked lut for key, building it if requested. the lut stays valid
+// until released, even if dropped from the cache meanwhile.
+static dt_iop_colorout_clut_t *_clut_acquire(dt_iop_colorout_global_data_t *gd,
+                                             const dt_hash_t key,
+                                             cmsHTRANSFORM xform,
+                                             const gboolean build)
+{
+  dt_pthread_mutex_lock(&gd->clut_lock);
+  for(GList *l = gd->cluts; l; l = g_list_next(l))
+  {
+    dt_iop_colorout_clut_t *clut = l->data;
+    if(clut->key != key) continue;
+    clut->users++;
+    gd->cluts = g_list_remove_link(gd->cluts, l);
+    gd->cluts = g_list_concat(l, gd->cluts);
+    dt_pthread_mutex_unlock(&gd->clut_lock);
+    return clut;
+  }
+  dt_pthread_mutex_unlock(&gd->clut_lock);
+
+  if(!build) return NULL;
+  dt_iop_colorout_clut_t *clut = _clut_build(key, xform);
+  if(!clut) return NULL;
+  clut->users = 1;
+
+  dt_pthread_mutex_lock(&gd->clut_lock);
+  // another pipe might have baked the same in the meantime
+  for(GList *l = gd->cluts; l; l = g_list_next(l))
+  {
+    dt_iop_colorout_clut_t *old = l->data;
+    if(old->key != key) continue;
+    old->users++;
+    dt_pthread_mutex_unlock(&gd->clut_lock);
+    _clut_free(clut);
+    return old;
+  }
+
+  gd->cluts = g_list_prepend(gd->cluts, clut);
+  while(g_list_length(gd->cluts) > CLUT_CACHE)
+  {
+    GList *last = g_list_last(gd->cluts);
+    dt_iop_colorout_clut_t *old = last->data;
+    gd->cluts = g_list_delete_link(gd->cluts, last);
+    if(old->users)
+      old->dropped = TRUE;
+    else
+      _clut_free(old);
+  }
+  dt_pthread_mutex_unlock(&gd->clut_lock);
+  return clut;
+}
+
+static void _clut_release(dt_iop_colorout_global_data_t *gd,
+                          dt_iop_colorout_clut_t *clut)
+{
+  if(!clut) return;
+  dt_pthread_mutex_lock(&gd->clut_lock);
+  const gboolean unused = --clut->users == 0 && clut->dropped;
+  dt_pthread_mutex_unlock(&gd->clut_lock);
+  if(unused) _clut_free(clut);
+}
+
+static gboolean _clut_hash_profile(dt_hash_t *hash,
+                                   cmsHPROFILE profile)
+{
+  if(!profile) return TRUE;
+  cmsUInt32Number size = 0;
+  if(!cmsSaveProfileToMem(profile, NULL, &size) || size == 0) return FALSE;
+  void *data = g_malloc(size);
+  const gboolean ok = cmsSaveProfileToMem(profile, data, &size);
+  if(ok) *hash = dt_hash(*hash, data, size);
+  g_free(data);
+  return ok;
+}
+
+// the cache key identifies the transform by the profiles contents, zero if that's not possible
+static dt_hash_t _clut_key(cmsHPROFILE output,
+                           cmsHPROFILE softproof,
+                           const dt_iop_color_intent_t intent,
+                           const uint32_t flags,
+                           const cmsUInt32Number format)
+{
+  dt_hash_t hash = dt_hash(DT_INITHASH, &intent, sizeof(intent));
+  hash = dt_hash(hash, &flags, sizeof(flags));
+  hash = dt_hash(hash, &format, sizeof(format));
+  if(!_clut_hash_profile(&hash, output) || !_clut_hash_profile(&hash, softproof))
+    return 0;
+  return hash;
+}
+
+static void _transform_clut(const dt_iop_colorout_data_t *const d,
+                            float *restrict out,
+                            const float *restrict in,
+                            const size_t npixels)
+{
+  const float *const clut = d->clut->clut;
+  const uint8_t *const exact = d->clut->exact;
+  const size_t chunksize = dt_cacheline_chunks(npixels, dt_get_num_threads());
+  DT_OMP_FOR()
+  for(size_t chunkstart = 0; chunkstart < npixels; chunkstart += chunksize)
+  {
+    const size_t end = MIN(chunkstart + chunksize, npixels);
+    size_t k = chunkstart;
+    while(k < end)
+    {
+      // a run of pixels done by lcms
+      size_t e = k;
+      size_t base = 0;
+      float f[3] = { 0.0f, 0.0f, 0.0f };
+      while(e < end && (!_clut_inside(in + 4 * e) || exact[_clut_cell(in + 4 * e, &base, f)]))
+        e++;
+      if(e > k)
+      {
+        cmsDoTransform(d->xform, in + 4 * k, out + 4 * k, e - k);
+        k = e;
+        continue;
+      }
+      _clut_interpolate(clut, base, f, out + 4 * k);
+      out[4 * k + 3] = in[4 * k + 3];
+      k++;
+    }
+  }
+}
+
 void process(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const void *const ivoid,
              void *const ovoid, const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out)
 {
   if(!dt_iop_have_required_input_format(4 /*we need full-color pixels*/, self, piece->colors,
                                          ivoid, ovoid, roi_in, roi_out))
     return;
-  const dt_iop_colorout_data_t *const d = piece->data;
+  dt_iop_colorout_data_t *const d = piece->data;
   const size_t width = roi_out->width;
   const size_t height = roi_out->height;
   const size_t npixels = width * height;
@@ -540,7 +918,14 @@ void process(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const void *c
   }
   else
   {
-    _transform_lcms(d, out, (float*)ivoid, npixels);
+    // bake the transform only if that's cheaper than lcms for this image
+    if(!d->clut && d->clut_key)
+      d->clut = _clut_acquire(self->global_data, d->clut_key, d->xform, npixels >= CLUT_MIN_PIXELS);
+
+    if(d->clut && d->clut->clut)
+      _transform_clut(d, out, (float*)ivoid, npixels);
+    else
+      _transform_lcms(d, out, (float*)ivoid, npixels);
   }
 }
 
@@ -574,6 +959,9 @@ void commit_params(dt_iop_module_t *self, dt_iop_params_t *p1, dt_dev_pixelpipe_
     cmsDeleteTransform(d->xform);
     d->xform = NULL;
   }
+  _clut_release(self->global_data, d->clut);
+  d->clut = NULL;
+  d->clut_key = 0;
   dt_mark_colormatrix_invalid(&d->cmatrix[0][0]);
   d->lut[0][0] = -1.0f;
   d->lut[1][0] = -1.0f;
@@ -733,6 +1121,13 @@ void commit_params(dt_iop_module_t *self, dt_iop_params_t *p1, dt_dev_pixelpipe_
     }
   }
 
+  // the gamut check marks single colors, that can't be interpolated. the lut is
+  // only used for display, exports and thumbnails get the exact lcms result.
+  if(d->xform && d->mode != DT_PROFILE_GAMUTCHECK && !force_lcms2
+     && dt_pipe_is_screen(pipe)
+     && dt_conf_get_bool("plugins/darkroom/colorout/bake_lut"))
+    d->clut_key = _clut_key(output, softproof, out_intent, transformFlags, output_format);
+
   if(out_type == DT_COLORSPACE_DISPLAY || out_type == DT_COLORSPACE_DISPLAY2)
     pthread_rwlock_unlock(&darktable.color_profiles->xprofile_lock);
 
@@ -777,6 +1172,7 @@ void cleanup_pipe(dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe, dt_dev_pixelp
     cmsDeleteTransform(d->xform);
     d->xform = NULL;
   }
+  _clut_release(self->global_data, d->clut);
 
   free(piece->data);
   piece->data = NULL;
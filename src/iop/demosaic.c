@@ -636,6 +636,42 @@ static gboolean _tiling_requirements(dt_iop_module_t *self,
   return TRUE;
 }
 
+// Thumbnail pipes scaling down by 2 or more that still do a full demosaic because of the
+// high quality thumbnail preference can demosaic into half size, capture sharpen at that
+// size and scale down from there if the reduced_thumbnails config key is set.
+// This avoids the full size demosaicer, capture sharpening and downscaling passes.
+static gboolean _demosaic_reduced(dt_iop_module_t *self,
+                                  dt_dev_pixelpipe_iop_t *const piece,
+                                  const float *const in,
+                                  float *const out,
+                                  const dt_iop_roi_t *const roi_in,
+                                  const dt_iop_roi_t *const roi_out,
+                                  const gboolean capture,
+                                  const uint32_t filters)
+{
+  dt_iop_roi_t roi_half = *roi_in;
+  roi_half.x = roi_in->x / 2;
+  roi_half.y = roi_in->y / 2;
+  roi_half.width = roi_in->width / 2;
+  roi_half.height = roi_in->height / 2;
+  roi_half.scale = 0.5f * roi_in->scale;
+
+  float *half = dt_iop_image_alloc(roi_half.width, roi_half.height, 4);
+  if(!half) return FALSE;
+
+  dt_print_pipe(DT_DEBUG_PIPE, "demosaic reduced", piece->pipe, self, DT_DEVICE_CPU, roi_in, roi_out,
+    "%s", capture ? "capture" : "");
+
+  demosaic_half_size(half, in, roi_in->width, roi_in->height, filters);
+  if(capture)
+    _capture_sharpen_half(self, piece, in, half, roi_in->width, roi_half.width, roi_half.height,
+                          roi_in->x, roi_in->y, filters);
+
+  dt_iop_clip_and_zoom_roi(out, half, roi_out, &roi_half);
+  dt_free_align(half);
+  return TRUE;
+}
+
 void process(dt_iop_module_t *self,
              dt_dev_pixelpipe_iop_t *const piece,
              const void *const i,
@@ -728,6 +764,17 @@ void process(dt_iop_module_t *self,
       _capture_radius(self, piece, in, roi_in, xtrans, filters);
   }
 
+  const gboolean reduced = is_bayer && !true_monochrome && !passthru && !demosaic_mask
+                        && method != DT_IOP_DEMOSAIC_MONO
+                        && no_masking && !pipe->want_detail_mask
+                        && dt_pipe_is_thumb(pipe)
+                        && dt_conf_get_bool("plugins/darkroom/demosaic/reduced_thumbnails")
+                        && roi_out->scale <= 0.5f && width >= 16 && height >= 16;
+  // dual demosaic, green equilibration and color smoothing deal with full size demosaic
+  // artefacts, the 2x2 block averaging of the reduced path doesn't produce them.
+  if(reduced && _demosaic_reduced(self, piece, in, (float *)o, roi_in, roi_out, do_capture, filters))
+    return;
+
   int overlap = 0;
   int tile_height = height;
   int valid_rows = height;
@@ -126,6 +126,7 @@ static inline float _xdivf(float d, int n)
 ////////////////////////////////////////////////////////////////
 
 
+__DT_CLONE_TARGETS__
 void amaze_demosaic(const float *const in,
                     float *out,
                     const int width,
@@ -235,6 +235,49 @@ static void green_equilibration_favg(float *out,
   }
 }
 
+// Half size bayer demosaic, every 2x2 cfa block makes one output pixel located at the block centre.
+// Green is the mean of both green photosites, red and blue are bilinearly interpolated from
+// their four nearest photosites so all channels are co-sited.
+// Output has (width / 2) x (height / 2) pixels.
+static void demosaic_half_size(float *out,
+                               const float *const in,
+                               const int width,
+                               const int height,
+                               const uint32_t filters)
+{
+  const int owidth = width / 2;
+  const int oheight = height / 2;
+
+  DT_OMP_FOR(collapse(2))
+  for(int row = 0; row < oheight; row++)
+  {
+    for(int col = 0; col < owidth; col++)
+    {
+      dt_aligned_pixel_t rgb = { 0.0f, 0.0f, 0.0f, 0.0f };
+      for(int y = 2 * row; y < 2 * row + 2; y++)
+      {
+        // vertical step to the next photosite of same color towards the block centre
+        const int sy = (y & 1) ? (y > 1 ? -2 : 0) : (y < height - 2 ? 2 : 0);
+        for(int x = 2 * col; x < 2 * col + 2; x++)
+        {
+          const int c = FC(y, x, filters);
+          const float *p = in + (size_t)y * width + x;
+          if(c & 1)
+            rgb[GREEN] += 0.5f * p[0];
+          else
+          {
+            const int sx = (x & 1) ? (x > 1 ? -2 : 0) : (x < width - 2 ? 2 : 0);
+            const int sw = sy * width;
+            rgb[c] += 0.5625f * p[0] + 0.1875f * (p[sx] + p[sw]) + 0.0625f * p[sw + sx];
+          }
+        }
+      }
+      copy_pixel_nontemporal(out + 4 * ((size_t)row * owidth + col), rgb);
+    }
+  }
+  dt_omploop_sfence();
+}
+
 #ifdef HAVE_OPENCL
 // color smoothing step by multiple passes of median filtering
 static int color_smoothing_cl(const dt_iop_module_t *self,
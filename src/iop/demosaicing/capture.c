@@ -104,12 +104,14 @@ static inline unsigned char _sigma_to_index(const float sigma)
   return CLAMP((int)(sigma / CAPTURE_GAUSS_FRACTION), 0, UCHAR_MAX);
 }
 
-// provide an index map so the convolution kernels can easily get the correct coeffs
+// provide an index map so the convolution kernels can easily get the correct coeffs.
+// dx/dy are sensor coordinates, scale < 1 is used for reduced size data made from 2x2 cfa blocks.
 static unsigned char *_cs_precalc_gauss_idx(dt_iop_module_t *self,
                                             const int width,
                                             const int height,
                                             const int dx,
                                             const int dy,
+                                            const float scale,
                                             const float isigma,
                                             const float boost,
                                             const float centre)
@@ -125,15 +127,18 @@ static unsigned char *_cs_precalc_gauss_idx(dt_iop_module_t *self,
   DT_OMP_FOR()
   for(int row = 0; row < height; row++)
   {
-    const float frow = row + dy - rheight;
+    const float frow = row / scale + dy - rheight;
     for(int col = 0; col < width; col++)
     {
-      const float fcol = col + dx - rwidth;
+      const float fcol = col / scale + dx - rwidth;
       const float sc = hypotf(frow, fcol) / mdim;
       const float corr = cboost * boost * sqrf(MAX(0.0f, sc - 0.5f - centre));
+      // on reduced data the sensor blur shrinks with the scale but we also have the
+      // blur of the 2x2 block averaging, a box of 1 pixel width has a variance of 1/12
+      const float rsigma = scale < 1.0f ? sqrtf(sqrf(scale * (isigma + corr)) + 1.0f / 12.0f) : isigma + corr;
 
       // also special care for the image borders
-      const float sigma = (isigma + corr) * 0.125f * (float)MIN(8, MIN(height-row-1, MIN(width-col-1, MIN(col, row))));
+      const float sigma = rsigma * 0.125f * (float)MIN(8, MIN(height-row-1, MIN(width-col-1, MIN(col, row))));
       table[row * width + col] = _sigma_to_index(sigma);
     }
   }
@@ -864,6 +869,69 @@ static inline gboolean _radius_requested(dt_iop_module_t *self,
   return FALSE;
 }
 
+static void _capture_whites(const dt_iop_buffer_dsc_t *dsc,
+                            dt_aligned_pixel_t whites)
+{
+  const gboolean wbon = dsc->temperature.enabled;
+  for_three_channels(c)
+    whites[c] = wbon ? CAPTURE_CFACLIP * dsc->temperature.coeffs[c] : CAPTURE_CFACLIP;
+  whites[3] = 0.0f;
+}
+
+// blur the blend mask in tmp2, after the blur very tiny edges will not get enough strength of
+// sharpening so we use a weighted maximum of (unblurred,blurred) values.
+static void _finish_blend(const float *const tmp2,
+                          float *blendmask,
+                          const float sigma,
+                          const int width,
+                          const int height)
+{
+  const size_t pixels = (size_t)width * height;
+  dt_gaussian_fast_blur(tmp2, blendmask, width, height, sigma, 0.0f, 1.0f, 1);
+
+  DT_OMP_FOR()
+  for(size_t k = 0; k < pixels; k++)
+  {
+    // difference between the calculated blend from modified_blend, and the blurred value
+    // if the difference is large, the local value was reduced too much as a result of the blurring
+    // use a weighted mean of the unblurred (aka tmp2) and the blurred (aka blendmask)
+    const float diff = tmp2[k] - blendmask[k];
+    const float w_tmp2 = 1.0f / (1.0f + expf(5.0f - 10.0f * diff));
+    blendmask[k] = CLIP(w_tmp2 * tmp2[k] + (1.0f - w_tmp2) * blendmask[k]);
+  }
+}
+
+// Richardson-Lucy iterations on Y in tmp1, the result is applied to all channels of out
+static void _deconvolve(const dt_iop_demosaic_global_data_t *gd,
+                        float *out,
+                        float *tmp1,
+                        float *tmp2,
+                        const float *const luminance,
+                        const float *const blendmask,
+                        const unsigned char *const gauss_idx,
+                        const int iterations,
+                        const int width,
+                        const int height)
+{
+  const size_t pixels = (size_t)width * height;
+  for(int iter = 0; iter < iterations; iter++)
+  {
+    _blur_div(tmp1, tmp2, luminance, blendmask, gd->gauss_coeffs, gauss_idx, width, height);
+    _blur_mul(tmp2, tmp1, blendmask, gd->gauss_coeffs, gauss_idx, width, height);
+  }
+
+  DT_OMP_FOR_SIMD()
+  for(size_t k = 0; k < pixels; k++)
+  {
+    if(blendmask[k] > 0.0f)
+    {
+      const float luminance_new = interpolatef(CLIP(blendmask[k]), tmp1[k], luminance[k]);
+      const float factor = luminance_new / MAX(luminance[k], CAPTURE_YMIN);
+      for_each_channel(c) out[k*4 + c] *= factor;
+    }
+  }
+}
+
 static void _capture_sharpen(dt_iop_module_t *self,
                              dt_dev_pixelpipe_iop_t *const piece,
                              const float *const in,
@@ -890,12 +958,8 @@ static void _capture_sharpen(dt_iop_module_t *self,
 
   if(!d->cs_enabled && !show_variance_mask && !show_sigma_mask) return;
 
-  const dt_iop_buffer_dsc_t *dsc = &pipe->dsc;
-  const gboolean wbon = dsc->temperature.enabled;
-  const dt_aligned_pixel_t icoeffs = { wbon ? CAPTURE_CFACLIP * dsc->temperature.coeffs[0] : CAPTURE_CFACLIP,
-                                       wbon ? CAPTURE_CFACLIP * dsc->temperature.coeffs[1] : CAPTURE_CFACLIP,
-                                       wbon ? CAPTURE_CFACLIP * dsc->temperature.coeffs[2] : CAPTURE_CFACLIP,
-                                       0.0f };
+  dt_aligned_pixel_t icoeffs;
+  _capture_whites(&pipe->dsc, icoeffs);
   unsigned char *gauss_idx = NULL;
   gboolean error = TRUE;
 
@@ -910,21 +974,7 @@ static void _capture_sharpen(dt_iop_module_t *self,
   _prepare_blend(in, out, filters, xtrans, tmp2, tmp1, icoeffs, width, height);
   // modify clipmask in tmp2 according to Y variance, also write L to luminance
   _modify_blend(tmp2, tmp1, luminance, d->cs_thrs, width, height);
-
-  dt_gaussian_fast_blur(tmp2, blendmask, width, height, 2.0f, 0.0f, 1.0f, 1);
-
-  // after the blur, very tiny edges will not get enough strength of sharpening
-  // use the maximum of (unblurred,blurred) values.
-  DT_OMP_FOR()
-  for(size_t k = 0; k < pixels; k++)
-  {
-    // difference between the calculated blend from modified_blend, and the blurred value
-    // if the difference is large, the local value was reduced too much as a result of the blurring
-    // use a weighted mean of the unblurred (aka tmp2) and the blurred (aka blendmask)
-    const float diff = tmp2[k] - blendmask[k];
-    const float w_tmp2 = 1.0f / (1.0f + expf(5.0f - 10.0f * diff));
-    blendmask[k] = CLIP(w_tmp2 * tmp2[k] + (1.0f - w_tmp2) * blendmask[k]);
-  }
+  _finish_blend(tmp2, blendmask, 2.0f, width, height);
 
   if(show_variance_mask)
   {
@@ -936,7 +986,7 @@ static void _capture_sharpen(dt_iop_module_t *self,
     goto finalize;
   }
 
-  gauss_idx = _cs_precalc_gauss_idx(self, width, height, dx, dy, d->cs_radius, d->cs_boost, d->cs_center);
+  gauss_idx = _cs_precalc_gauss_idx(self, width, height, dx, dy, 1.0f, d->cs_radius, d->cs_boost, d->cs_center);
   if(!gauss_idx) goto finalize;
 
   if(show_sigma_mask)
@@ -948,23 +998,103 @@ static void _capture_sharpen(dt_iop_module_t *self,
     goto finalize;
   }
 
-  for(int iter = 0; iter < d->cs_iter; iter++)
-  {
-    _blur_div(tmp1, tmp2, luminance, blendmask, gd->gauss_coeffs, gauss_idx, width, height);
-    _blur_mul(tmp2, tmp1, blendmask, gd->gauss_coeffs, gauss_idx, width, height);
-  }
+  _deconvolve(gd, out, tmp1, tmp2, luminance, blendmask, gauss_idx, d->cs_iter, width, height);
+  error = FALSE;
 
-  DT_OMP_FOR_SIMD()
-  for(size_t k = 0; k < pixels; k++)
+  finalize:
+  if(error)
+    dt_print_pipe(DT_DEBUG_ALWAYS, "capture sharpen failed", pipe, self, DT_DEVICE_CPU, NULL, NULL,
+      "unable to allocate memory");
+
+  dt_free_align(gauss_idx);
+  dt_free_align(tmp2);
+  dt_free_align(tmp1);
+  dt_free_align(luminance);
+  dt_free_align(blendmask);
+}
+
+// Clip mask and Y for data made by demosaic_half_size(), every output location
+// corresponds to the 2x2 cfa block at (2*row, 2*col) in cfa.
+static void _prepare_blend_half(const float *const cfa,
+                                const float *const rgb,
+                                const uint32_t filters,
+                                float *mask,
+                                float *Yold,
+                                const float *whites,
+                                const int cfa_width,
+                                const int w1,
+                                const int height)
+{
+  dt_iop_image_fill(mask, 1.0f, w1, height, 1);
+  // Photometric/digital ITU BT.709
+  const dt_aligned_pixel_t flum = { 0.212671f, 0.715160f, 0.072169f, 0.0f };
+  DT_OMP_FOR(collapse(2))
+  for(size_t row = 0; row < height; row++)
   {
-    if(blendmask[k] > 0.0f)
+    for(size_t col = 0; col < w1; col++)
     {
-      const float luminance_new = interpolatef(CLIP(blendmask[k]), tmp1[k], luminance[k]);
-      const float factor = luminance_new / MAX(luminance[k], CAPTURE_YMIN);
-      for_each_channel(c) out[k*4 + c] *= factor;
+      const size_t k = row * w1 + col;
+      dt_aligned_pixel_t yw;
+      for_each_channel(c) yw[c] = flum[c] * rgb[k*4+c];
+      Yold[k] = MAX(0.0f, yw[0] + yw[1] + yw[2]);
+      if(row > 0 && col > 0 && row < height-1 && col < w1-1)
+      {
+        gboolean heat = FALSE;
+        for(int y = 2 * row; y < 2 * row + 2; y++)
+          for(int x = 2 * col; x < 2 * col + 2; x++)
+            heat |= cfa[(size_t)y * cfa_width + x] > whites[FC(y, x, filters)];
+        if(heat || Yold[k] < CAPTURE_YMIN)
+        {
+          mask[k-w1-1] = mask[k-w1] = mask[k-w1+1] =
+          mask[k-1]    = mask[k]    = mask[k+1] =
+          mask[k+w1-1] = mask[k+w1] = mask[k+w1+1] = 0.0f;
+        }
+      }
+      else
+        mask[k] = 0.0f;
     }
   }
+}
+
+// Capture sharpening of a half size bayer demosaic, the radius is scaled down
+// so the result is close to sharpening at full size and downscaling afterwards.
+static void _capture_sharpen_half(dt_iop_module_t *self,
+                                  dt_dev_pixelpipe_iop_t *const piece,
+                                  const float *const in,
+                                  float *out,
+                                  const int cfa_width,
+                                  const int width,
+                                  const int height,
+                                  const int dx,
+                                  const int dy,
+                                  const uint32_t filters)
+{
+  dt_dev_pixelpipe_t *pipe = piece->pipe;
+  const dt_iop_demosaic_data_t *d = piece->data;
+  const dt_iop_demosaic_global_data_t *gd = self->global_data;
+
+  if(!d->cs_enabled || width < 8 || height < 8) return;
+
+  dt_aligned_pixel_t icoeffs;
+  _capture_whites(&pipe->dsc, icoeffs);
+  unsigned char *gauss_idx = NULL;
+  gboolean error = TRUE;
+
+  float *luminance = dt_iop_image_alloc(width, height, 1);
+  float *tmp2 = dt_iop_image_alloc(width, height, 1);
+  float *tmp1 = dt_iop_image_alloc(width, height, 1);
+  float *blendmask = dt_iop_image_alloc(width, height, 1);
+  if(!luminance || !tmp2 || !tmp1 || !blendmask)
+    goto finalize;
+
+  _prepare_blend_half(in, out, filters, tmp2, tmp1, icoeffs, cfa_width, width, height);
+  _modify_blend(tmp2, tmp1, luminance, d->cs_thrs, width, height);
+  _finish_blend(tmp2, blendmask, 1.0f, width, height);
+
+  gauss_idx = _cs_precalc_gauss_idx(self, width, height, dx, dy, 0.5f, d->cs_radius, d->cs_boost, d->cs_center);
+  if(!gauss_idx) goto finalize;
 
+  _deconvolve(gd, out, tmp1, tmp2, luminance, blendmask, gauss_idx, d->cs_iter, width, height);
   error = FALSE;
 
   finalize:
@@ -1089,7 +1219,7 @@ static int _capture_sharpen_cl(dt_iop_module_t *self,
     goto finish;
   }
 
-  unsigned char *f_gauss_idx = _cs_precalc_gauss_idx(self, width, height, dx, dy, d->cs_radius, d->cs_boost, d->cs_center);
+  unsigned char *f_gauss_idx = _cs_precalc_gauss_idx(self, width, height, dx, dy, 1.0f, d->cs_radius, d->cs_boost, d->cs_center);
   if(f_gauss_idx)
   {
     gcoeffs = dt_opencl_copy_host_to_device_constant(devid, sizeof(float) * (UCHAR_MAX+1) * CAPTURE_KERNEL_ALIGN, gd->gauss_coeffs);
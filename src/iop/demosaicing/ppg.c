@@ -17,6 +17,7 @@
 */
 
 DT_OMP_DECLARE_SIMD(aligned(in, out:64))
+__DT_CLONE_TARGETS__
 static void demosaic_ppg(float *const out,
                          const float *const in,
                          const int width,
@@ -67,11 +67,12 @@
 
 #define RCD_BORDER 10         // avoid tile-overlap errors
 #define RCD_MARGIN 9          // for the outermost tiles we can have a smaller outer border
-#define RCD_TILEVALID (DT_RCD_TILESIZE - 2 * RCD_BORDER)
-#define w1 DT_RCD_TILESIZE
-#define w2 (2 * DT_RCD_TILESIZE)
-#define w3 (3 * DT_RCD_TILESIZE)
-#define w4 (4 * DT_RCD_TILESIZE)
+#define RCD_TILEVALID (ts - 2 * RCD_BORDER)
+#define RCD_MAXTILE 512       // larger tiles don't reduce the overlap noticeably
+#define w1 ts
+#define w2 (2 * ts)
+#define w3 (3 * ts)
+#define w4 (4 * ts)
 
 #define eps 1e-5f              // Tolerance to avoid dividing by zero
 #define epssq 1e-10f
@@ -115,7 +116,31 @@ static void demosaic_box3(float *const restrict out,
   }
 }
 
+// The result doesn't depend on the tile size. Larger tiles spend less on
+// the overlap, the tile size is the largest one whose working set, 6.5
+// planes of floats, fits the level 2 cache of a thread while still
+// leaving a few tiles per thread.
+static int _rcd_tilesize(const int width,
+                         const int height)
+{
+  const float planes = 6.5f * sizeof(float);
+  int ts = (int)sqrtf(0.85f * dt_get_cache_per_thread() / planes) & ~7;
+  ts = CLAMP(ts, DT_RCD_TILESIZE, RCD_MAXTILE);
+
+  const int threads = dt_get_team_threads();
+  while(ts > DT_RCD_TILESIZE)
+  {
+    const int valid = ts - 2 * RCD_BORDER;
+    const int tiles = (1 + (height - 2 * RCD_BORDER - 1) / valid)
+                    * (1 + (width - 2 * RCD_BORDER - 1) / valid);
+    if(tiles >= 4 * threads) break;
+    ts -= 8;
+  }
+  return ts;
+}
+
 DT_OMP_DECLARE_SIMD(aligned(in, out : 64))
+__DT_CLONE_TARGETS__
 static void rcd_demosaic(float *const restrict out,
                          const float *const restrict in,
                          const int width,
@@ -128,20 +153,22 @@ static void rcd_demosaic(float *const restrict out,
     return;
 
   const float revscaler = 1.0f / scaler;
+  const int ts = _rcd_tilesize(width, height);
 
   const int num_vertical = 1 + (height - 2 * RCD_BORDER -1) / RCD_TILEVALID;
   const int num_horizontal = 1 + (width - 2 * RCD_BORDER -1) / RCD_TILEVALID;
 
-  DT_OMP_PRAGMA(parallel firstprivate(width, height, filters, out, in, scaler, revscaler))
+  DT_OMP_PRAGMA(parallel firstprivate(width, height, filters, out, in, scaler, revscaler, ts))
   {
     // ensure that border elements which are read but never actually set below are zeroed out so use calloc
-    float *const VH_Dir = dt_calloc_align_float((size_t) DT_RCD_TILESIZE * DT_RCD_TILESIZE);
-    float *const PQ_Dir = dt_alloc_align_float((size_t) DT_RCD_TILESIZE * DT_RCD_TILESIZE / 2);
-    float *const cfa =    dt_alloc_align_float((size_t) DT_RCD_TILESIZE * DT_RCD_TILESIZE);
-    float *const P_CDiff_Hpf = dt_alloc_align_float((size_t) DT_RCD_TILESIZE * DT_RCD_TILESIZE / 2);
-    float *const Q_CDiff_Hpf = dt_alloc_align_float((size_t) DT_RCD_TILESIZE * DT_RCD_TILESIZE / 2);
+    float *const VH_Dir = dt_calloc_align_float((size_t) ts * ts);
+    float *const PQ_Dir = dt_alloc_align_float((size_t) ts * ts / 2);
+    float *const cfa =    dt_alloc_align_float((size_t) ts * ts);
+    float *const P_CDiff_Hpf = dt_alloc_align_float((size_t) ts * ts / 2);
+    float *const Q_CDiff_Hpf = dt_alloc_align_float((size_t) ts * ts / 2);
 
-    float (*const rgb)[DT_RCD_TILESIZE * DT_RCD_TILESIZE] = (void *)dt_alloc_align_float((size_t)3 * DT_RCD_TILESIZE * DT_RCD_TILESIZE);
+    float *const rgb_buf = dt_alloc_align_float((size_t)3 * ts * ts);
+    float *const rgb[3] = { rgb_buf, rgb_buf + ts * ts, rgb_buf + 2 * ts * ts };
 
     // No overlapping use so re-use same buffer
     float *const lpf = PQ_Dir;
@@ -152,46 +179,46 @@ static void rcd_demosaic(float *const restrict out,
       for(int tile_horizontal = 0; tile_horizontal < num_horizontal; tile_horizontal++)
       {
         const int rowStart = tile_vertical * RCD_TILEVALID;
-        const int rowEnd = MIN(rowStart + DT_RCD_TILESIZE, height);
+        const int rowEnd = MIN(rowStart + ts, height);
 
         const int colStart = tile_horizontal * RCD_TILEVALID;
-        const int colEnd = MIN(colStart + DT_RCD_TILESIZE, width);
+        const int colEnd = MIN(colStart + ts, width);
 
-        const int tileRows = MIN(rowEnd - rowStart, DT_RCD_TILESIZE);
-        const int tileCols = MIN(colEnd - colStart, DT_RCD_TILESIZE);
+        const int tileRows = MIN(rowEnd - rowStart, ts);
+        const int tileCols = MIN(colEnd - colStart, ts);
 
-        if(rowStart + DT_RCD_TILESIZE > height || colStart + DT_RCD_TILESIZE > width)
+        if(rowStart + ts > height || colStart + ts > width)
         {
           // VH_Dir is only filled for(4,4)..(height-4,width-4), but the refinement code reads (3,3)...(h-3,w-3),
           // so we need to ensure that the border is zeroed for partial tiles to get consistent results
-          memset(VH_Dir, 0, sizeof(*VH_Dir) * DT_RCD_TILESIZE * DT_RCD_TILESIZE);
+          memset(VH_Dir, 0, sizeof(*VH_Dir) * ts * ts);
           // TODO: figure out what part of rgb is being accessed without initialization on partial tiles
-          memset(rgb, 0, sizeof(float) * 3 * DT_RCD_TILESIZE * DT_RCD_TILESIZE);
+          memset(rgb_buf, 0, sizeof(float) * 3 * ts * ts);
         }
         // Step 0: fill data and make sure data are not negative.
         for(int row = rowStart; row < rowEnd; row++)
         {
           const int c0 = FC(row, colStart, filters);
           const int c1 = FC(row, colStart + 1, filters);
-          for(int col = colStart, indx = (row - rowStart) * DT_RCD_TILESIZE, in_indx = row * width + colStart; col < colEnd; col++, indx++, in_indx++)
+          for(int col = colStart, indx = (row - rowStart) * ts, in_indx = row * width + colStart; col < colEnd; col++, indx++, in_indx++)
           {
             cfa[indx] = rgb[c0][indx] = rgb[c1][indx] = _safe_in(in[in_indx], revscaler);
           }
         }
 
         // STEP 1: Find vertical and horizontal interpolation directions
-        float bufferV[3][DT_RCD_TILESIZE - 8];
+        float bufferV[3][ts - 8];
         // Step 1.1: Calculate the square of the vertical and horizontal color difference high pass filter
         for(int row = 3; row < MIN(tileRows - 3, 5); row++ )
         {
-          for(int col = 4, indx = row * DT_RCD_TILESIZE + col; col < tileCols - 4; col++, indx++ )
+          for(int col = 4, indx = row * ts + col; col < tileCols - 4; col++, indx++ )
           {
             bufferV[row - 3][col - 4] = sqrf((cfa[indx - w3] - cfa[indx - w1] - cfa[indx + w1] + cfa[indx + w3]) - 3.0f * (cfa[indx - w2] + cfa[indx + w2]) + 6.0f * cfa[indx]);
           }
         }
 
         // Step 1.2: Obtain the vertical and horizontal directional discrimination strength
-        float DT_ALIGNED_PIXEL bufferH[DT_RCD_TILESIZE];
+        float DT_ALIGNED_PIXEL bufferH[ts];
         // We start with V0, V1 and V2 pointing to row -1, row and row +1
         // After row is processed V0 must point to the old V1, V1 must point to the old V2 and V2 must point to the old V0
         // because the old V0 is not used anymore and will be filled with row + 1 data in next iteration
@@ -200,15 +227,15 @@ static void rcd_demosaic(float *const restrict out,
         float* V2 = bufferV[2];
         for(int row = 4; row < tileRows - 4; row++ )
         {
-          for(int col = 3, indx = row * DT_RCD_TILESIZE + col; col < tileCols - 3; col++, indx++)
+          for(int col = 3, indx = row * ts + col; col < tileCols - 3; col++, indx++)
           {
             bufferH[col - 3] = sqrf((cfa[indx -  3] - cfa[indx -  1] - cfa[indx +  1] + cfa[indx +  3]) - 3.0f * (cfa[indx -  2] + cfa[indx +  2]) + 6.0f * cfa[indx]);
           }
-          for(int col = 4, indx = (row + 1) * DT_RCD_TILESIZE + col; col < tileCols - 4; col++, indx++)
+          for(int col = 4, indx = (row + 1) * ts + col; col < tileCols - 4; col++, indx++)
           {
             V2[col - 4] = sqrf((cfa[indx - w3] - cfa[indx - w1] - cfa[indx + w1] + cfa[indx + w3]) - 3.0f * (cfa[indx - w2] + cfa[indx + w2]) + 6.0f * cfa[indx]);
           }
-          for(int col = 4, indx = row * DT_RCD_TILESIZE + col; col < tileCols - 4; col++, indx++ )
+          for(int col = 4, indx = row * ts + col; col < tileCols - 4; col++, indx++ )
           {
             const float V_Stat = fmaxf(epssq,      V0[col - 4] +      V1[col - 4] +      V2[col - 4]);
             const float H_Stat = fmaxf(epssq, bufferH[col - 4] + bufferH[col - 3] + bufferH[col - 2]);
@@ -222,7 +249,7 @@ static void rcd_demosaic(float *const restrict out,
         // Step 2.1: Low pass filter incorporating green, red and blue local samples from the raw data
         for(int row = 2; row < tileRows - 2; row++)
         {
-          for(int col = 2 + (FC(row, 0, filters) & 1), indx = row * DT_RCD_TILESIZE + col, lp_indx = indx / 2; col < tileCols - 2; col += 2, indx +=2, lp_indx++)
+          for(int col = 2 + (FC(row, 0, filters) & 1), indx = row * ts + col, lp_indx = indx / 2; col < tileCols - 2; col += 2, indx +=2, lp_indx++)
           {
             lpf[lp_indx] = cfa[indx]
                         + 0.5f * (cfa[indx - w1]     + cfa[indx + w1] +     cfa[indx - 1] +      cfa[indx + 1])
@@ -233,7 +260,7 @@ static void rcd_demosaic(float *const restrict out,
         // STEP 3: Populate the green channel at blue and red CFA positions
         for(int row = 4; row < tileRows - 4; row++)
         {
-          for(int col = 4 + (FC(row, 0, filters) & 1), indx = row * DT_RCD_TILESIZE + col, lpindx = indx / 2; col < tileCols - 4; col += 2, indx += 2, lpindx++)
+          for(int col = 4 + (FC(row, 0, filters) & 1), indx = row * ts + col, lpindx = indx / 2; col < tileCols - 4; col += 2, indx += 2, lpindx++)
           {
             const float cfai = cfa[indx];
 
@@ -269,7 +296,7 @@ static void rcd_demosaic(float *const restrict out,
         // Step 4.0: Calculate the square of the P/Q diagonals color difference high pass filter
         for(int row = 3; row < tileRows - 3; row++)
         {
-          for(int col = 3, indx = row * DT_RCD_TILESIZE + col, indx2 = indx / 2; col < tileCols - 3; col+=2, indx+=2, indx2++)
+          for(int col = 3, indx = row * ts + col, indx2 = indx / 2; col < tileCols - 3; col+=2, indx+=2, indx2++)
           {
             P_CDiff_Hpf[indx2] = sqrf((cfa[indx - w3 - 3] - cfa[indx - w1 - 1] - cfa[indx + w1 + 1] + cfa[indx + w3 + 3]) - 3.0f * (cfa[indx - w2 - 2] + cfa[indx + w2 + 2]) + 6.0f * cfa[indx]);
             Q_CDiff_Hpf[indx2] = sqrf((cfa[indx - w3 + 3] - cfa[indx - w1 + 1] - cfa[indx + w1 - 1] + cfa[indx + w3 - 3]) - 3.0f * (cfa[indx - w2 + 2] + cfa[indx + w2 - 2]) + 6.0f * cfa[indx]);
@@ -278,7 +305,7 @@ static void rcd_demosaic(float *const restrict out,
         // Step 4.1: Obtain the P/Q diagonals directional discrimination strength
         for(int row = 4; row < tileRows - 4; row++)
         {
-          for(int col = 4 + (FC(row, 0, filters) & 1), indx = row * DT_RCD_TILESIZE + col, indx2 = indx / 2, indx3 = (indx - w1 - 1) / 2, indx4 = (indx + w1 - 1) / 2; col < tileCols - 4; col += 2, indx += 2, indx2++, indx3++, indx4++ )
+          for(int col = 4 + (FC(row, 0, filters) & 1), indx = row * ts + col, indx2 = indx / 2, indx3 = (indx - w1 - 1) / 2, indx4 = (indx + w1 - 1) / 2; col < tileCols - 4; col += 2, indx += 2, indx2++, indx3++, indx4++ )
           {
             const float P_Stat = fmaxf(epssq, P_CDiff_Hpf[indx3]     + P_CDiff_Hpf[indx2] + P_CDiff_Hpf[indx4 + 1]);
             const float Q_Stat = fmaxf(epssq, Q_CDiff_Hpf[indx3 + 1] + Q_CDiff_Hpf[indx2] + Q_CDiff_Hpf[indx4]);
@@ -289,7 +316,7 @@ static void rcd_demosaic(float *const restrict out,
         // Step 4.2: Populate the red and blue channels at blue and red CFA positions
         for(int row = 4; row < tileRows - 4; row++)
         {
-          for(int col = 4 + (FC(row, 0, filters) & 1), indx = row * DT_RCD_TILESIZE + col, c = 2 - FC(row, col, filters), pqindx = indx / 2, pqindx2 = (indx - w1 - 1) / 2, pqindx3 = (indx + w1 - 1) / 2; col < tileCols - 4; col += 2, indx += 2, pqindx++, pqindx2++, pqindx3++)
+          for(int col = 4 + (FC(row, 0, filters) & 1), indx = row * ts + col, c = 2 - FC(row, col, filters), pqindx = indx / 2, pqindx2 = (indx - w1 - 1) / 2, pqindx3 = (indx + w1 - 1) / 2; col < tileCols - 4; col += 2, indx += 2, pqindx++, pqindx2++, pqindx3++)
           {
             // Refined P/Q diagonal local discrimination
             const float PQ_Central_Value   = PQ_Dir[pqindx];
@@ -321,7 +348,7 @@ static void rcd_demosaic(float *const restrict out,
         // Step 4.3: Populate the red and blue channels at green CFA positions
         for(int row = 4; row < tileRows - 4; row++)
         {
-          for(int col = 4 + (FC(row, 1, filters) & 1), indx = row * DT_RCD_TILESIZE + col; col < tileCols - 4; col += 2, indx +=2)
+          for(int col = 4 + (FC(row, 1, filters) & 1), indx = row * ts + col; col < tileCols - 4; col += 2, indx +=2)
           {
             // Refined vertical and horizontal local discrimination
             const float VH_Central_Value = VH_Dir[indx];
@@ -372,7 +399,7 @@ static void rcd_demosaic(float *const restrict out,
         const int last_horizontal =  colEnd   - ((tile_horizontal == num_horizontal - 1) ? RCD_MARGIN : RCD_BORDER);
         for(int row = first_vertical; row < last_vertical; row++)
         {
-          for(int col = first_horizontal, idx = (row - rowStart) * DT_RCD_TILESIZE + col - colStart, o_idx = (row * width + col) * 4; col < last_horizontal; col++, o_idx += 4, idx++)
+          for(int col = first_horizontal, idx = (row - rowStart) * ts + col - colStart, o_idx = (row * width + col) * 4; col < last_horizontal; col++, o_idx += 4, idx++)
           {
             out[o_idx]   = scaler * fmaxf(0.0f, rgb[0][idx]);
             out[o_idx+1] = scaler * fmaxf(0.0f, rgb[1][idx]);
@@ -383,7 +410,7 @@ static void rcd_demosaic(float *const restrict out,
       }
     }
     dt_free_align(cfa);
-    dt_free_align(rgb);
+    dt_free_align(rgb_buf);
     dt_free_align(VH_Dir);
     dt_free_align(PQ_Dir);
     dt_free_align(P_CDiff_Hpf);
@@ -43,9 +43,16 @@
 #include "gui/presets.h"
 #include "iop/iop_api.h"
 
-DT_MODULE_INTROSPECTION(2, dt_iop_diffuse_params_t)
+DT_MODULE_INTROSPECTION(3, dt_iop_diffuse_params_t)
 
 #define MAX_NUM_SCALES 10
+
+typedef enum dt_iop_diffuse_solver_t
+{
+  DT_DIFFUSE_SOLVER_FULL = 0,           // $DESCRIPTION: "full resolution"
+  DT_DIFFUSE_SOLVER_COARSE_TO_FINE = 1, // $DESCRIPTION: "coarse to fine"
+} dt_iop_diffuse_solver_t;
+
 typedef struct dt_iop_diffuse_params_t
 {
   // global parameters
@@ -70,6 +77,9 @@ typedef struct dt_iop_diffuse_params_t
   // v2
   int radius_center;        // $MIN: 0    $MAX: 1024 $DEFAULT: 0  $DESCRIPTION: "central radius"
 
+  // v3
+  dt_iop_diffuse_solver_t solver; // $DEFAULT: DT_DIFFUSE_SOLVER_FULL $DESCRIPTION: "solver"
+
   // new versions add params mandatorily at the end, so we can memcpy old parameters at the beginning
 
 } dt_iop_diffuse_params_t;
@@ -77,7 +87,7 @@ typedef struct dt_iop_diffuse_params_t
 
 typedef struct dt_iop_diffuse_gui_data_t
 {
-  GtkWidget *iterations, *fourth, *third, *second, *radius, *radius_center, *sharpness, *threshold, *regularization, *first,
+  GtkWidget *iterations, *solver, *fourth, *third, *second, *radius, *radius_center, *sharpness, *threshold, *regularization, *first,
       *anisotropy_first, *anisotropy_second, *anisotropy_third, *anisotropy_fourth, *regularization_first, *variance_threshold;
 } dt_iop_diffuse_gui_data_t;
 
@@ -191,6 +201,34 @@ int legacy_params(dt_iop_module_t *self,
     int radius_center;
   } dt_iop_diffuse_params_v2_t;
 
+  typedef struct dt_iop_diffuse_params_v3_t
+  {
+    // global parameters
+    int iterations;
+    float sharpness;
+    int radius;
+    float regularization;
+    float variance_threshold;
+
+    float anisotropy_first;
+    float anisotropy_second;
+    float anisotropy_third;
+    float anisotropy_fourth;
+
+    float threshold;
+
+    float first;
+    float second;
+    float third;
+    float fourth;
+
+    // v2
+    int radius_center;
+
+    // v3
+    dt_iop_diffuse_solver_t solver;
+  } dt_iop_diffuse_params_v3_t;
+
   if(old_version == 1)
   {
     typedef struct dt_iop_diffuse_params_v1_t
@@ -229,6 +267,22 @@ int legacy_params(dt_iop_module_t *self,
     *new_version = 2;
     return 0;
   }
+  if(old_version == 2)
+  {
+    const dt_iop_diffuse_params_v2_t *o = (dt_iop_diffuse_params_v2_t *)old_params;
+    dt_iop_diffuse_params_v3_t *n = malloc(sizeof(dt_iop_diffuse_params_v3_t));
+
+    // copy common parameters
+    memcpy(n, o, sizeof(dt_iop_diffuse_params_v2_t));
+
+    // init only new parameters, old edits keep the exact solver
+    n->solver = DT_DIFFUSE_SOLVER_FULL;
+
+    *new_params = n;
+    *new_params_size = sizeof(dt_iop_diffuse_params_v3_t);
+    *new_version = 3;
+    return 0;
+  }
   return 1;
 }
 
@@ -791,6 +845,9 @@ void tiling_callback(dt_iop_module_t *self,
 
   // in + out + 2 * tmp + 2 * LF + s details + grey mask
   tiling->factor = 6.25f + scales;
+  // the coarse grids need about a third of that on top
+  if(data->solver == DT_DIFFUSE_SOLVER_COARSE_TO_FINE)
+    tiling->factor += (6.25f + scales) / 3.f;
   tiling->factor_cl = 6.25f + scales;
 
   tiling->maxbuf = 1.0f;
@@ -805,6 +862,10 @@ void tiling_callback(dt_iop_module_t *self,
 #define H 1         // spatial step
 #define KAPPA 0.25f // 0.25 if h = 1, 1 if h = 2
 
+// pixels per strip of the PDE sweep: 3 rows * 2 layers * 16 bytes * 1024
+// is 96 kB of neighbourhood per thread
+#define PDE_STRIP_WIDTH 1024
+
 
 DT_OMP_DECLARE_SIMD(aligned(pixels:64) aligned(xy:16) uniform(pixels))
 static inline void find_gradients(const dt_aligned_pixel_t pixels[9],
@@ -982,7 +1043,14 @@ static inline void heat_PDE_diffusion(const float *const restrict high_freq,
   const float *const restrict HF = DT_IS_ALIGNED(high_freq);
 
   const float regularization_factor = regularization * current_radius_square / 9.f;
-  DT_OMP_FOR()
+
+  // sweep the image in vertical strips so the three neighbourhood rows
+  // of HF and LF read for a strip stay in L2 while a thread walks down.
+  const size_t strip_width = MIN(width, PDE_STRIP_WIDTH);
+  const size_t strips = (width + strip_width - 1) / strip_width;
+
+  DT_OMP_FOR(collapse(2))
+  for(size_t strip = 0; strip < strips; ++strip)
   for(size_t row = 0; row < height; ++row)
   {
     // interleave the order in which we process the rows so that we minimize cache misses
@@ -992,7 +1060,8 @@ static inline void heat_PDE_diffusion(const float *const restrict high_freq,
       = { MAX((int)(i - mult * H), (int)0) * width,            // x - mult
           i * width,                                           // x
           MIN((int)(i + mult * H), (int)height - 1) * width }; // x + mult
-    for(size_t j = 0; j < width; ++j)
+    const size_t j_end = MIN(width, (strip + 1) * strip_width);
+    for(size_t j = strip * strip_width; j < j_end; ++j)
     {
       const size_t idx = (i * width + j);
       const size_t index = idx * 4;
@@ -1155,6 +1224,7 @@ static inline gboolean wavelets_process(const float *const restrict in,
                                     const dt_iop_diffuse_data_t *const data,
                                     const float final_radius,
                                     const float zoom,
+                                    const float grid,
                                     const int scales,
                                     const gboolean has_mask,
                                     float *const restrict HF[MAX_NUM_SCALES],
@@ -1271,10 +1341,12 @@ static inline gboolean wavelets_process(const float *const restrict in,
 
     if(s == 0) buffer_out = reconstructed;
 
-    // Compute wavelets low-frequency scales
+    // Compute wavelets low-frequency scales. The variance regularization
+    // uses the radius in pixels of the full resolution grid, coarse grids
+    // of the coarse to fine solver must penalize edges the same way.
     heat_PDE_diffusion(HF[s], buffer_in, mask, has_mask, buffer_out, width, height,
                        anisotropy, isotropy_type, regularization,
-                       variance_threshold, sqf(current_radius), mult, ABCD, strength);
+                       variance_threshold, sqf(current_radius * grid), mult, ABCD, strength);
 
     if(darktable.dump_pfm_module)
     {
@@ -1337,6 +1409,251 @@ static inline void inpaint_mask(float *const restrict inpainted,
   }
 }
 
+typedef struct diffuse_buffers_t
+{
+  // temp buffers for the iterations and the blurs. We will need to
+  // cycle between them for memory efficiency
+  float *temp1, *temp2;
+  float *LF_odd, *LF_even;
+  // wavelets scales buffers
+  float *HF[MAX_NUM_SCALES];
+  int scales;
+} diffuse_buffers_t;
+
+static void _free_buffers(diffuse_buffers_t *b)
+{
+  dt_free_align(b->temp1);
+  dt_free_align(b->temp2);
+  dt_free_align(b->LF_even);
+  dt_free_align(b->LF_odd);
+  for(int s = 0; s < b->scales; s++)
+    dt_free_align(b->HF[s]);
+  memset(b, 0, sizeof(diffuse_buffers_t));
+}
+
+static gboolean _alloc_buffers(diffuse_buffers_t *b,
+                               const size_t width,
+                               const size_t height,
+                               const int scales)
+{
+  memset(b, 0, sizeof(diffuse_buffers_t));
+  const size_t npixels = width * height * 4;
+  b->temp1 = dt_alloc_align_float(npixels);
+  b->temp2 = dt_alloc_align_float(npixels);
+  b->LF_odd = dt_alloc_align_float(npixels);
+  b->LF_even = dt_alloc_align_float(npixels);
+  gboolean ok = b->temp1 && b->temp2 && b->LF_odd && b->LF_even;
+  b->scales = scales;
+  for(int s = 0; s < scales; s++)
+  {
+    b->HF[s] = ok ? dt_alloc_align_float(npixels) : NULL;
+    if(!b->HF[s]) ok = FALSE;
+  }
+  if(!ok) _free_buffers(b);
+  return ok;
+}
+
+static inline int _diffusion_scales(const float final_radius)
+{
+  const int diffusion_scales = num_steps_to_reach_equivalent_sigma(B_SPLINE_SIGMA, final_radius);
+  return CLAMP(diffusion_scales, 1, MAX_NUM_SCALES);
+}
+
+static void _diffuse_iterate(dt_dev_pixelpipe_iop_t *piece,
+                             const float *const restrict in,
+                             float *const restrict out,
+                             const uint8_t *const restrict mask,
+                             const gboolean has_mask,
+                             const size_t width,
+                             const size_t height,
+                             const dt_iop_diffuse_data_t *const data,
+                             const float final_radius,
+                             const float zoom,
+                             const float grid,
+                             const int scales,
+                             const int iterations,
+                             diffuse_buffers_t *const b)
+{
+  // ping-pong between the temp buffers, never writing into the input
+  float *ping = b->temp2;
+  float *pong = b->temp1;
+  if(in == ping)
+  {
+    ping = b->temp1;
+    pong = b->temp2;
+  }
+
+  const float *temp_in = in;
+  for(int it = 0; it < iterations && !dt_dev_piece_shutdown(piece, (iterations-it) > 5); it++)
+  {
+    float *const temp_out = (it == iterations - 1) ? out : ((it % 2 == 0) ? ping : pong);
+
+    wavelets_process(temp_in, temp_out, mask, width, height,
+                     data, final_radius, zoom, grid, scales, has_mask, b->HF, b->LF_odd, b->LF_even);
+    temp_in = temp_out;
+  }
+}
+
+static inline void _downsample_2x(const float *const restrict in,
+                                  float *const restrict out,
+                                  const uint8_t *const restrict mask_in,
+                                  uint8_t *const restrict mask_out,
+                                  const size_t width,
+                                  const size_t height,
+                                  const size_t cwidth,
+                                  const size_t cheight)
+{
+  // 2×2 box average, the mask of a coarse pixel is set if any of its fine pixels is
+  DT_OMP_FOR()
+  for(size_t i = 0; i < cheight; i++)
+  {
+    const size_t i0 = 2 * i;
+    const size_t i1 = MIN(2 * i + 1, height - 1);
+    for(size_t j = 0; j < cwidth; j++)
+    {
+      const size_t j0 = 2 * j;
+      const size_t j1 = MIN(2 * j + 1, width - 1);
+      const size_t k[4] = { i0 * width + j0, i0 * width + j1, i1 * width + j0, i1 * width + j1 };
+      for_four_channels(c)
+        out[4 * (i * cwidth + j) + c] = 0.25f * (in[4 * k[0] + c] + in[4 * k[1] + c]
+                                                 + in[4 * k[2] + c] + in[4 * k[3] + c]);
+      if(mask_out)
+        mask_out[i * cwidth + j] = mask_in[k[0]] | mask_in[k[1]] | mask_in[k[2]] | mask_in[k[3]];
+    }
+  }
+}
+
+static inline void _add_upsampled_correction(const float *const restrict in,
+                                             const float *const restrict coarse_in,
+                                             const float *const restrict coarse_out,
+                                             float *const restrict out,
+                                             const size_t width,
+                                             const size_t height,
+                                             const size_t cwidth,
+                                             const size_t cheight)
+{
+  // out = in + bilinear upsampling of the coarse solution's change
+  DT_OMP_FOR()
+  for(size_t i = 0; i < height; i++)
+  {
+    const float y = CLAMP(((float)i - 0.5f) * 0.5f, 0.f, (float)(cheight - 1));
+    const size_t y0 = (size_t)y;
+    const size_t y1 = MIN(y0 + 1, cheight - 1);
+    const float wy = y - (float)y0;
+    for(size_t j = 0; j < width; j++)
+    {
+      const float x = CLAMP(((float)j - 0.5f) * 0.5f, 0.f, (float)(cwidth - 1));
+      const size_t x0 = (size_t)x;
+      const size_t x1 = MIN(x0 + 1, cwidth - 1);
+      const float wx = x - (float)x0;
+      const size_t k00 = 4 * (y0 * cwidth + x0), k01 = 4 * (y0 * cwidth + x1);
+      const size_t k10 = 4 * (y1 * cwidth + x0), k11 = 4 * (y1 * cwidth + x1);
+      for_four_channels(c)
+      {
+        const float d00 = coarse_out[k00 + c] - coarse_in[k00 + c];
+        const float d01 = coarse_out[k01 + c] - coarse_in[k01 + c];
+        const float d10 = coarse_out[k10 + c] - coarse_in[k10 + c];
+        const float d11 = coarse_out[k11 + c] - coarse_in[k11 + c];
+        const float d = (1.f - wy) * ((1.f - wx) * d00 + wx * d01)
+                        + wy * ((1.f - wx) * d10 + wx * d11);
+        const size_t index = 4 * (i * width + j) + c;
+        out[index] = fmaxf(in[index] + d, 0.f);
+      }
+    }
+  }
+}
+
+static void _diffuse_solve(dt_dev_pixelpipe_iop_t *piece,
+                           const float *const restrict in,
+                           float *const restrict out,
+                           const uint8_t *const restrict mask,
+                           const gboolean has_mask,
+                           const size_t width,
+                           const size_t height,
+                           const dt_iop_diffuse_data_t *const data,
+                           const float final_radius,
+                           const float zoom,
+                           const float grid,
+                           const int iterations,
+                           diffuse_buffers_t *const b);
+
+static gboolean _diffuse_coarse_to_fine(dt_dev_pixelpipe_iop_t *piece,
+                                        const float *const restrict in,
+                                        float *const restrict out,
+                                        const uint8_t *const restrict mask,
+                                        const gboolean has_mask,
+                                        const size_t width,
+                                        const size_t height,
+                                        const dt_iop_diffuse_data_t *const data,
+                                        const float final_radius,
+                                        const float zoom,
+                                        const float grid,
+                                        const int iterations,
+                                        diffuse_buffers_t *const b)
+{
+  // Cascadic multigrid : every wavelet scale s > 0 at full resolution
+  // is the scale s - 1 of the half-resolution image. Solve all of them
+  // there, for a quarter of the cost, and recursively so. Then add the
+  // upsampled change to the input and only run the finest scale, which
+  // the coarse grid can't represent, at full resolution.
+  const int scales = _diffusion_scales(final_radius);
+  if(scales < 2 || width < 64 || height < 64) return FALSE;
+
+  const size_t cwidth = (width + 1) / 2;
+  const size_t cheight = (height + 1) / 2;
+  const float coarse_radius = final_radius / 2.f;
+
+  float *const restrict coarse_in = dt_alloc_align_float(cwidth * cheight * 4);
+  float *const restrict coarse_out = dt_alloc_align_float(cwidth * cheight * 4);
+  uint8_t *const restrict coarse_mask = has_mask ? dt_alloc_align_uint8(cwidth * cheight) : NULL;
+  diffuse_buffers_t coarse;
+  const gboolean ok = coarse_in && coarse_out && (!has_mask || coarse_mask)
+                      && _alloc_buffers(&coarse, cwidth, cheight, _diffusion_scales(coarse_radius));
+  if(ok)
+  {
+    _downsample_2x(in, coarse_in, mask, coarse_mask, width, height, cwidth, cheight);
+    _diffuse_solve(piece, coarse_in, coarse_out, coarse_mask, has_mask, cwidth, cheight,
+                   data, coarse_radius, zoom * 2.f, grid * 2.f, iterations, &coarse);
+    _free_buffers(&coarse);
+
+    // temp2 is never the (inpainted) input
+    _add_upsampled_correction(in, coarse_in, coarse_out, b->temp2,
+                              width, height, cwidth, cheight);
+    _diffuse_iterate(piece, b->temp2, out, mask, has_mask, width, height,
+                     data, final_radius, zoom, grid, 1, iterations, b);
+  }
+
+  dt_free_align(coarse_in);
+  dt_free_align(coarse_out);
+  dt_free_align(coarse_mask);
+  return ok;
+}
+
+static void _diffuse_solve(dt_dev_pixelpipe_iop_t *piece,
+                           const float *const restrict in,
+                           float *const restrict out,
+                           const uint8_t *const restrict mask,
+                           const gboolean has_mask,
+                           const size_t width,
+                           const size_t height,
+                           const dt_iop_diffuse_data_t *const data,
+                           const float final_radius,
+                           const float zoom,
+                           const float grid,
+                           const int iterations,
+                           diffuse_buffers_t *const b)
+{
+  // fall back to the full resolution solver if the image is too small
+  // to gain anything or we are short of memory for the coarse grid
+  if(data->solver == DT_DIFFUSE_SOLVER_COARSE_TO_FINE
+     && _diffuse_coarse_to_fine(piece, in, out, mask, has_mask, width, height,
+                                data, final_radius, zoom, grid, iterations, b))
+    return;
+
+  _diffuse_iterate(piece, in, out, mask, has_mask, width, height,
+                   data, final_radius, zoom, grid, b->scales, iterations, b);
+}
+
 void process(dt_iop_module_t *self,
              dt_dev_pixelpipe_iop_t *piece,
              const void *const restrict ivoid,
@@ -1359,47 +1676,25 @@ void process(dt_iop_module_t *self,
     return;
   }
 
-  uint8_t *const restrict mask = dt_alloc_align_uint8(width * height);
-
-  float *restrict in = DT_IS_ALIGNED((float *const restrict)ivoid);
+  const float *restrict in = DT_IS_ALIGNED((const float *const restrict)ivoid);
   float *const restrict out = DT_IS_ALIGNED((float *const restrict)ovoid);
 
-  float *restrict temp1, *restrict temp2;
-  // temp buffer for blurs. We will need to cycle between them for memory efficiency
-  float *restrict LF_odd, *restrict LF_even;
-
-  float *restrict temp_in = NULL;
-  float *restrict temp_out = NULL;
-
-  gboolean out_of_memory = !mask
-    || !dt_iop_alloc_image_buffers(self, roi_in, roi_out,
-                                 4 | DT_IMGSZ_OUTPUT, &temp1,
-                                 4 | DT_IMGSZ_OUTPUT, &temp2,
-                                 4 | DT_IMGSZ_OUTPUT, &LF_odd,
-                                 4 | DT_IMGSZ_OUTPUT, &LF_even,
-                                 0, NULL); // if failing all pointers are NULL
-
   const float scale = fmaxf(piece->iscale / roi_in->scale, 1.f);
   const float final_radius = (data->radius + data->radius_center) * 2.f / scale;
 
   const int iterations = MAX(data->iterations, 1);
-  const int diffusion_scales = num_steps_to_reach_equivalent_sigma(B_SPLINE_SIGMA, final_radius);
-  const int scales = CLAMP(diffusion_scales, 1, MAX_NUM_SCALES);
+  const int scales = _diffusion_scales(final_radius);
 
-  // wavelets scales buffers
-  float *restrict HF[MAX_NUM_SCALES];
-  for(int s = 0; s < scales; s++)
-  {
-    HF[s] = out_of_memory ? NULL : dt_alloc_align_float(width * height * 4);
-    if(!HF[s]) out_of_memory = TRUE;
-  }
+  uint8_t *const restrict mask = dt_alloc_align_uint8(width * height);
+  diffuse_buffers_t buffers;
 
   // check that all buffers exist before processing because we use a lot of memory here.
-  if(out_of_memory)
+  if(!mask || !_alloc_buffers(&buffers, width, height, scales))
   {
     dt_iop_copy_image_roi(ovoid, ivoid, piece->colors, roi_in, roi_out);
     dt_control_log(_("diffuse/sharpen failed to allocate memory, check your RAM settings"));
-    goto finish;
+    dt_free_align(mask);
+    return;
   }
 
   const gboolean has_mask = (data->threshold > 0.f);
@@ -1409,45 +1704,16 @@ void process(dt_iop_module_t *self,
     build_mask(in, mask, data->threshold, roi_out->width, roi_out->height);
 
     // init the inpainting area with noise
-    inpaint_mask(temp1, in, mask, roi_out->width, roi_out->height);
+    inpaint_mask(buffers.temp1, in, mask, roi_out->width, roi_out->height);
 
-    in = temp1;
+    in = buffers.temp1;
   }
 
-  for(int it = 0; it < iterations && !dt_dev_piece_shutdown(piece, (iterations-it) > 5); it++)
-  {
-    if(it == 0)
-    {
-      temp_in = in;
-      temp_out = temp2;
-    }
-    else if(it % 2 == 0)
-    {
-      temp_in = temp1;
-      temp_out = temp2;
-    }
-    else
-    {
-      temp_in = temp2;
-      temp_out = temp1;
-    }
-
-    if(it == iterations - 1)
-      temp_out = out;
+  _diffuse_solve(piece, in, out, mask, has_mask, width, height,
+                 data, final_radius, scale, 1.f, iterations, &buffers);
 
-    wavelets_process(temp_in, temp_out, mask,
-                     roi_out->width, roi_out->height,
-                     data, final_radius, scale, scales, has_mask, HF, LF_odd, LF_even);
-  }
-
-finish:
   dt_free_align(mask);
-  dt_free_align(temp1);
-  dt_free_align(temp2);
-  dt_free_align(LF_even);
-  dt_free_align(LF_odd);
-  for(int s = 0; s < scales; s++)
-    if(HF[s]) dt_free_align(HF[s]);
+  _free_buffers(&buffers);
 }
 
 #if HAVE_OPENCL
@@ -1626,6 +1892,13 @@ int process_cl(dt_iop_module_t *self,
   if(fastmode)
     return dt_opencl_enqueue_copy_image(devid, dev_in, dev_out, CLIMG_ORIGIN, CLIMG_ORIGIN, region);
 
+  if(data->solver == DT_DIFFUSE_SOLVER_COARSE_TO_FINE)
+  {
+    dt_print(DT_DEBUG_OPENCL,
+             "[opencl_diffuse] coarse to fine solver not yet supported by opencl code");
+    return DT_OPENCL_PROCESS_CL;
+  }
+
   cl_mem in = dev_in;
   cl_mem temp_in = NULL;
   cl_mem temp_out = NULL;
@@ -1770,6 +2043,16 @@ void gui_init(dt_iop_module_t *self)
        "if you plan on sharpening or inpainting, \n"
        "more iterations help reconstruction."));
 
+  g->solver = dt_bauhaus_combobox_from_params(self, "solver");
+  gtk_widget_set_tooltip_text
+    (g->solver,
+     _("full resolution runs every iteration on every scale at full size.\n"
+       "coarse to fine solves the large scales on downscaled copies\n"
+       "of the image and only the finest one at full size.\n"
+       "it is several times faster with many iterations or large radii\n"
+       "at the price of a slightly different result.\n"
+       "it always runs on the CPU."));
+
   g->radius_center = dt_bauhaus_slider_from_params(self, "radius_center");
   dt_bauhaus_slider_set_soft_range(g->radius_center, 0., 512.);
   dt_bauhaus_slider_set_format(g->radius_center, _(" px"));
@@ -87,6 +87,7 @@ The chosen segmentation algorithm works like this:
 #define HL_SEGMENT_PLANES 4
 #define HL_FLOAT_PLANES 8
 #define HL_BORDER 8
+#define HL_LARGE_SEGMENT 65536
 
 static inline float _local_std_deviation(const float *p, const int w)
 {
@@ -118,69 +119,142 @@ static float _calc_weight(const float *s, const size_t loc, const int w, const f
   return sval * smoothness;
 }
 
+// the first location of the row with a better weight, the weight is updated
+static inline size_t _row_reference(const float *plane,
+                                    dt_iop_segmentation_t *seg,
+                                    const uint32_t id,
+                                    const int row,
+                                    const float clipval,
+                                    float *weight)
+{
+  size_t testref = 0;
+  for(int col = MAX(seg->border+2, seg->xmin[id]-2); col < MIN(seg->width - seg->border-2, seg->xmax[id]+3); col++)
+  {
+    const size_t pos = (size_t)row * seg->width + col;
+    const uint32_t sid = _get_segment_id(seg, pos);
+    if((sid == id) && (plane[pos] < clipval))
+    {
+      const float wht = _calc_weight(plane, pos, seg->width, clipval) * ((seg->data[pos] & DT_SEG_ID_MASK) ? 1.0f : 0.75f);
+      if(wht > *weight)
+      {
+        *weight = wht;
+        testref = pos;
+      }
+    }
+  }
+  return testref;
+}
+
+static inline gboolean _valid_segment(dt_iop_segmentation_t *seg, const uint32_t id)
+{
+  // avoid very small segments
+  return (seg->ymax[id] - seg->ymin[id] > 2) && (seg->xmax[id] - seg->xmin[id] > 2);
+}
+
+static inline gboolean _large_segment(dt_iop_segmentation_t *seg, const uint32_t id)
+{
+  return (size_t)(seg->ymax[id] - seg->ymin[id]) * (seg->xmax[id] - seg->xmin[id]) > HL_LARGE_SEGMENT;
+}
+
+static void _set_candidate(const float *plane,
+                           const float *refavg,
+                           dt_iop_segmentation_t *seg,
+                           const uint32_t id,
+                           const size_t testref,
+                           const float testweight,
+                           const float clipval,
+                           const float badlevel)
+{
+  if(testref && (testweight > 1.0f - badlevel)) // We have found a reference location
+  {
+    float sum  = 0.0f;
+    float pix = 0.0f;
+    const float weights[5][5] = {
+      { 1.0f,  4.0f,  6.0f,  4.0f, 1.0f },
+      { 4.0f, 16.0f, 24.0f, 16.0f, 4.0f },
+      { 6.0f, 24.0f, 36.0f, 24.0f, 6.0f },
+      { 4.0f, 16.0f, 24.0f, 16.0f, 4.0f },
+      { 1.0f,  4.0f,  6.0f,  4.0f, 1.0f }};
+    for(int y = -2; y < 3; y++)
+    {
+      for(int x = -2; x < 3; x++)
+      {
+        const size_t pos = testref + y*seg->width + x;
+        const gboolean unclipped = plane[pos] < clipval;
+        sum += (unclipped) ? plane[pos] * weights[y+2][x+2] : 0.0f;
+        pix += (unclipped) ? weights[y+2][x+2] : 0.0f;
+      }
+    }
+    const float av = sum / fmaxf(1.0f, pix);
+    if(av > 0.125f * clipval)
+    {
+      seg->val1[id] = fminf(clipval, av);
+      seg->val2[id] = refavg[testref];
+    }
+  }
+}
+
 static void _calc_plane_candidates(const float *plane,
                                    const float *refavg,
                                    dt_iop_segmentation_t *seg,
                                    const float clipval,
                                    const float badlevel)
 {
+  size_t *rowref = dt_alloc_align_type(size_t, seg->height);
+  float *rowweight = dt_alloc_align_float(seg->height);
+  const gboolean rowwise = rowref && rowweight;
+
   DT_OMP_PRAGMA(parallel for default(firstprivate) schedule(dynamic))
   for(uint32_t id = 2; id < seg->nr; id++)
   {
     seg->val1[id] = 0.0f;
     seg->val2[id] = 0.0f;
-    // avoid very small segments
-    if((seg->ymax[id] - seg->ymin[id] > 2) && (seg->xmax[id] - seg->xmin[id] > 2))
+    if(_valid_segment(seg, id) && !(rowwise && _large_segment(seg, id)))
     {
       size_t testref = 0;
       float testweight = 0.0f;
       // make sure we don't calc a candidate from duplicated border data
       for(int row = MAX(seg->border+2, seg->ymin[id]-2); row < MIN(seg->height - seg->border-2, seg->ymax[id]+3); row++)
       {
-        for(int col = MAX(seg->border+2, seg->xmin[id]-2); col < MIN(seg->width - seg->border-2, seg->xmax[id]+3); col++)
-        {
-          const size_t pos = row * seg->width + col;
-          const uint32_t sid = _get_segment_id(seg, pos);
-          if((sid == id) && (plane[pos] < clipval))
-          {
-            const float wht = _calc_weight(plane, pos, seg->width, clipval) * ((seg->data[pos] & DT_SEG_ID_MASK) ? 1.0f : 0.75f);
-            if(wht > testweight)
-            {
-              testweight = wht;
-              testref = pos;
-            }
-          }
-        }
+        const size_t ref = _row_reference(plane, seg, id, row, clipval, &testweight);
+        if(ref) testref = ref;
       }
-      if(testref && (testweight > 1.0f - badlevel)) // We have found a reference location
+      _set_candidate(plane, refavg, seg, id, testref, testweight, clipval, badlevel);
+    }
+  }
+
+  /* A large segment would keep a single thread busy, the rows are searched in parallel instead.
+     Taking the first row with the best weight we get the location found by the serial search.
+  */
+  for(uint32_t id = 2; rowwise && id < seg->nr; id++)
+  {
+    if(!_valid_segment(seg, id) || !_large_segment(seg, id))
+      continue;
+
+    const int rmin = MAX(seg->border+2, seg->ymin[id]-2);
+    const int rmax = MIN(seg->height - seg->border-2, seg->ymax[id]+3);
+    DT_OMP_FOR()
+    for(int row = rmin; row < rmax; row++)
+    {
+      rowweight[row] = 0.0f;
+      rowref[row] = _row_reference(plane, seg, id, row, clipval, &rowweight[row]);
+    }
+
+    size_t testref = 0;
+    float testweight = 0.0f;
+    for(int row = rmin; row < rmax; row++)
+    {
+      if(rowref[row] && rowweight[row] > testweight)
       {
-        float sum  = 0.0f;
-        float pix = 0.0f;
-        const float weights[5][5] = {
-          { 1.0f,  4.0f,  6.0f,  4.0f, 1.0f },
-          { 4.0f, 16.0f, 24.0f, 16.0f, 4.0f },
-          { 6.0f, 24.0f, 36.0f, 24.0f, 6.0f },
-          { 4.0f, 16.0f, 24.0f, 16.0f, 4.0f },
-          { 1.0f,  4.0f,  6.0f,  4.0f, 1.0f }};
-        for(int y = -2; y < 3; y++)
-        {
-          for(int x = -2; x < 3; x++)
-          {
-            const size_t pos = testref + y*seg->width + x;
-            const gboolean unclipped = plane[pos] < clipval;
-            sum += (unclipped) ? plane[pos] * weights[y+2][x+2] : 0.0f;
-            pix += (unclipped) ? weights[y+2][x+2] : 0.0f;
-          }
-        }
-        const float av = sum / fmaxf(1.0f, pix);
-        if(av > 0.125f * clipval)
-        {
-          seg->val1[id] = fminf(clipval, av);
-          seg->val2[id] = refavg[testref];
-        }
+        testweight = rowweight[row];
+        testref = rowref[row];
       }
     }
+    _set_candidate(plane, refavg, seg, id, testref, testweight, clipval, badlevel);
   }
+
+  dt_free_align(rowref);
+  dt_free_align(rowweight);
 }
 
 static inline float _calc_refavg(const float *in,
@@ -575,18 +649,9 @@ static void _process_segmentation(dt_dev_pixelpipe_iop_t *piece,
   for(int p = 0; p < HL_RGB_PLANES; p++)
     dt_segments_combine(&isegments[p], d->combine);
 
-  if(dt_get_num_threads() >= HL_RGB_PLANES)
-  {
-    DT_OMP_PRAGMA(parallel num_threads(HL_RGB_PLANES))
-    {
-      dt_segmentize_plane(&isegments[dt_get_thread_num()]);
-    }
-  }
-  else
-  {
-    for(int p = 0; p < HL_RGB_PLANES; p++)
-      dt_segmentize_plane(&isegments[p]);
-  }
+  // the segmentation itself works in parallel
+  for(int p = 0; p < HL_RGB_PLANES; p++)
+    dt_segmentize_plane(&isegments[p]);
 
   for(int p = 0; p < HL_RGB_PLANES; p++)
     _calc_plane_candidates(plane[p], refavg[p], &isegments[p], cube_coeffs[p], d->candidating);
@@ -24,6 +24,8 @@
    The segmentation algorithm uses a modified floodfill, while floddfilling it
    - also takes keeps track of the surrounding rectangle of every segment and
    - marks the segment border locations.
+   The same segments are found by a union-find labelling working in parallel on stripes,
+   the floodfill is kept as a fallback.
 
    Hanno Schwalm 2022/05
 */
@@ -544,8 +546,7 @@ static gboolean _floodfill_segmentize(int yin,
   return success;
 }
 
-// User interface
-void dt_segmentize_plane(dt_iop_segmentation_t *seg)
+static void _segmentize_floodfill(dt_iop_segmentation_t *seg)
 {
   dt_ff_stack_t stack;
   const int width = seg->width;
@@ -582,6 +583,472 @@ void dt_segmentize_plane(dt_iop_segmentation_t *seg)
   dt_free_align(stack.el);
 }
 
+/* Union-find segmentation
+   The rows of the segmentation area are split into stripes labelled independently, every
+   location is linked to the smallest location of its segment. Merging the stripes at their
+   seams makes the root of a segment its first location in raster order, where the floodfill
+   would start from. Most of the result follows without depending on the fill order:
+   - segments with more than 3 locations get their id's in order of their roots,
+   - a free location is marked by the lowest id of the neighbours the floodfill tests it from,
+   - the rectangle holds the root and the markings of the segment.
+   Two details of the floodfill depend on the order. Where it starts a scanline, the location
+   above is tested unless close to the left border, so it is tested close to the upper border too.
+   Segments with at most 3 locations are reverted within the rectangle of their markings only,
+   locations outside keep the id of the next segment. Segments touching the upper or left border
+   region and the small ones are "special", they are filled by the floodfill in raster order with
+   the id it would use. The markings of the other segments around a small one are put in before,
+   all others are added afterwards keeping the lowest id.
+*/
+#define DT_SEG_COMPONENT 0x80000000u
+
+static inline uint32_t _uf_root(uint32_t *parent, uint32_t p)
+{
+  while(parent[p] != p)
+  {
+    parent[p] = parent[parent[p]];
+    p = parent[p];
+  }
+  return p;
+}
+
+static inline uint32_t _uf_find(const uint32_t *parent, uint32_t p)
+{
+  while(parent[p] != p)
+    p = parent[p];
+  return p;
+}
+
+static inline void _uf_union(uint32_t *parent, const uint32_t a, const uint32_t b)
+{
+  const uint32_t ra = _uf_root(parent, a);
+  const uint32_t rb = _uf_root(parent, b);
+  if(ra < rb)
+    parent[rb] = ra;
+  else if(rb < ra)
+    parent[ra] = rb;
+}
+
+// the component of a location once the roots hold their component number
+static inline uint32_t _uf_component(const uint32_t *t, const size_t p)
+{
+  return ((t[p] & DT_SEG_COMPONENT) ? t[p] : t[t[p]]) & ~DT_SEG_COMPONENT;
+}
+
+static inline int _stripe_row(const int s, const int stripes, const int border, const int rows)
+{
+  return border + (int)((int64_t)s * rows / stripes);
+}
+
+// the lowest id of the neighbours the floodfill tests the free location p from,
+// only segments with an id in mark are taken into account
+static inline int _uf_owner(const uint32_t *t,
+                            const int *mark,
+                            const size_t p,
+                            const int row,
+                            const int col,
+                            const int width,
+                            const int height,
+                            const int border)
+{
+  // the last row of the area has no neighbour in the segmentation area below
+  const size_t nb[4] = { row > border+1 && row < height-border-1 ? p + width : 0,
+                         row < height-border-2 ? p - width : 0,
+                         col < width-border-2 ? p - 1 : 0,
+                         col > border+1 ? p + 1 : 0 };
+  int owner = INT_MAX;
+  for(int k = 0; k < 4; k++)
+  {
+    if(nb[k] && t[nb[k]])
+    {
+      const int i = mark[_uf_component(t, nb[k])];
+      if(i) owner = MIN(owner, i);
+    }
+  }
+  return owner;
+}
+
+// number of roots in raster order before location p
+static inline int _uf_roots_before(const uint32_t *croot, const int components, const size_t p)
+{
+  int lo = 0;
+  int hi = components;
+  while(lo < hi)
+  {
+    const int mid = (lo + hi) / 2;
+    if(croot[mid] < p)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+// a segment with at most 3 locations starting at row, col is close to its start. Around it the
+// floodfill would have marked the free locations already taken by segments with lower id's.
+static void _uf_mark_around(dt_iop_segmentation_t *seg,
+                            const uint32_t *t,
+                            const int *mark,
+                            const int id,
+                            const int row,
+                            const int col)
+{
+  const int width = seg->width;
+  const int height = seg->height;
+  const int border = seg->border;
+  uint32_t *d = seg->data;
+  for(int r = MAX(border, row - 1); r <= MIN(height - border - 1, row + 3); r++)
+  {
+    for(int c = MAX(border, col - 3); c <= MIN(width - border - 1, col + 3); c++)
+    {
+      const size_t p = (size_t)r * width + c;
+      if(d[p] != 0) continue;
+      const int owner = _uf_owner(t, mark, p, r, c, width, height, border);
+      if(owner < id)
+        d[p] = DT_SEG_ID_MASK | owner;
+    }
+  }
+}
+
+// fill the special segments in raster order as the floodfill does, the other segments
+// are hidden and can't be reached from them
+static void _uf_floodfill_special(dt_iop_segmentation_t *seg,
+                                  const uint32_t *t,
+                                  const uint32_t *croot,
+                                  const int components,
+                                  const int *size,
+                                  const int *mark,
+                                  const int *before,
+                                  dt_ff_stack_t *stack)
+{
+  const int width = seg->width;
+  const int height = seg->height;
+  const int border = seg->border;
+  for(int row = border; row < height - border; row++)
+  {
+    for(int col = border; col < width - border; col++)
+    {
+      const size_t p = (size_t)row * width + col;
+      if(seg->data[p] != 1) continue;
+      const uint32_t c = _uf_component(t, p);
+
+      const int id = 2 + before[_uf_roots_before(croot, components, p)];
+      if(id >= seg->slots - 2)
+        return;
+      if(size[c] <= 3)
+        _uf_mark_around(seg, t, mark, id, row, col);
+      _floodfill_segmentize(row, col, seg, width, height, id, stack);
+    }
+  }
+}
+
+// returns TRUE in case of errors, the segmentation data are unchanged then
+static gboolean _segmentize_unionfind(dt_iop_segmentation_t *seg, const int nstripes)
+{
+  const int width = seg->width;
+  const int height = seg->height;
+  const int border = seg->border;
+  const int rows = height - 2 * border;
+  if(border < 1 || rows < 1 || width - 2 * border < 1
+     || (size_t)width * height >= DT_SEG_COMPONENT)
+    return TRUE;
+
+  const int stripes = CLAMP(nstripes, 1, rows);
+  uint32_t *d = seg->data;
+  uint32_t *t = seg->tmp;
+  int *first = dt_alloc_align_int(stripes + 1);
+  uint32_t *linked = dt_alloc_align_type(uint32_t, (size_t)MAX(1, stripes - 1) * width);
+  int *size = NULL;
+  int *cid = NULL;
+  uint32_t *croot = NULL;
+  int *rect = NULL;
+  uint8_t *special = NULL;
+  int *mark = NULL;
+  int *before = NULL;
+  dt_ff_stack_t stack = { 0, 0, NULL };
+  int components = 0;
+  int segments = 0;
+  int id = 2;
+  if(!first || !linked)
+  {
+    dt_free_align(first);
+    dt_free_align(linked);
+    return TRUE;
+  }
+
+  _intimage_borderfill(t, width, height, 0, border);
+
+  // label the stripes, the parent of a location is a smaller one of the same stripe
+  DT_OMP_FOR()
+  for(int s = 0; s < stripes; s++)
+  {
+    const int r0 = _stripe_row(s, stripes, border, rows);
+    const int r1 = _stripe_row(s + 1, stripes, border, rows);
+    for(int row = r0; row < r1; row++)
+    {
+      for(int col = border; col < width - border; col++)
+      {
+        const uint32_t p = (uint32_t)row * width + col;
+        if(d[p] != 1)
+        {
+          t[p] = 0;
+          continue;
+        }
+        const gboolean left = col > border && t[p-1];
+        const gboolean up = row > r0 && t[p-width];
+        t[p] = left ? t[p-1] : (up ? p - width : p);
+        // with the upper left location in the segment both are connected already
+        if(left && up && !t[p-width-1])
+          _uf_union(t, p - 1, p - width);
+      }
+    }
+  }
+
+  // merge the stripes at the seams keeping track of the linked roots
+  int links = 0;
+  for(int s = 1; s < stripes; s++)
+  {
+    const size_t row = _stripe_row(s, stripes, border, rows);
+    for(int col = border; col < width - border; col++)
+    {
+      const size_t p = row * width + col;
+      if(t[p] && t[p-width] && !(t[p-1] && t[p-width-1]))
+      {
+        const uint32_t a = _uf_find(t, p);
+        const uint32_t b = _uf_find(t, p - width);
+        if(a != b)
+        {
+          linked[links++] = MAX(a, b);
+          t[MAX(a, b)] = MIN(a, b);
+        }
+      }
+    }
+  }
+  for(int i = 0; i < links; i++)
+    t[linked[i]] = _uf_find(t, linked[i]);
+
+  // point every location to the root of its segment and count the roots for each stripe.
+  // The root's data are free to count the locations.
+  DT_OMP_FOR()
+  for(int s = 0; s < stripes; s++)
+  {
+    int roots = 0;
+    for(int row = _stripe_row(s, stripes, border, rows); row < _stripe_row(s + 1, stripes, border, rows); row++)
+    {
+      uint32_t root = 0;
+      uint32_t run = 0;
+      for(size_t p = (size_t)row * width + border; p < (size_t)(row + 1) * width - border; p++)
+      {
+        if(!t[p]) continue;
+        if(t[p] == p)
+          roots++;
+        else
+          t[p] = t[t[p]];
+        if(t[p] != root)
+        {
+          if(run)
+          {
+            DT_OMP_PRAGMA(atomic)
+            d[root] += run;
+          }
+          root = t[p];
+          run = 0;
+        }
+        run++;
+      }
+      if(run)
+      {
+        DT_OMP_PRAGMA(atomic)
+        d[root] += run;
+      }
+    }
+    first[s + 1] = roots;
+  }
+
+  first[0] = 0;
+  for(int s = 0; s < stripes; s++)
+    first[s + 1] += first[s];
+  components = first[stripes];
+
+  size = dt_alloc_align_int(components + 1);
+  cid = dt_alloc_align_int(components + 1);
+  croot = dt_alloc_align_type(uint32_t, components + 1);
+  if(!size || !cid || !croot)
+    goto error;
+
+  // the roots get their component number in raster order
+  DT_OMP_FOR()
+  for(int s = 0; s < stripes; s++)
+  {
+    int c = first[s];
+    for(size_t p = (size_t)_stripe_row(s, stripes, border, rows) * width;
+        p < (size_t)_stripe_row(s + 1, stripes, border, rows) * width; p++)
+    {
+      if(t[p] == p)
+      {
+        croot[c] = p;
+        size[c] = d[p] - 1;
+        d[p] = 1;
+        t[p] = DT_SEG_COMPONENT | c++;
+      }
+    }
+  }
+
+  // like the floodfill we stop if we run out of segment slots
+  for(int c = 0; c < components; c++)
+    cid[c] = (size[c] > 3 && id < seg->slots - 2) ? id++ : 0;
+  segments = id - 2;
+
+  special = dt_alloc_align_type(uint8_t, components + 1);
+  mark = dt_alloc_align_int(components + 1);
+  before = dt_alloc_align_int(components + 1);
+  rect = dt_alloc_align_int((size_t)4 * MAX(1, segments) * stripes);
+  stack.size = (size_t)width * height / 32;
+  stack.el = dt_alloc_align_type(dt_pos_t, stack.size);
+  if(!special || !mark || !before || !rect || !stack.el)
+    goto error;
+
+  // segments with at most 3 locations or close to the upper or left border are filled
+  // by the floodfill, the others only leave their markings
+  for(int c = 0; c < components; c++)
+    special[c] = size[c] <= 3;
+  for(int row = border; row < height - border; row++)
+  {
+    const int cols = row < border + 3 ? width - border : MIN(border + 2, width - border);
+    for(int col = border; col < cols; col++)
+    {
+      const size_t p = (size_t)row * width + col;
+      if(t[p]) special[_uf_component(t, p)] = 1;
+    }
+  }
+
+  before[0] = 0;
+  for(int c = 0; c < components; c++)
+  {
+    before[c + 1] = before[c] + (cid[c] != 0);
+    mark[c] = special[c] ? 0 : cid[c];
+  }
+
+  // hide the other segments from the floodfill
+  DT_OMP_FOR()
+  for(size_t p = (size_t)border * width; p < (size_t)(height - border) * width; p++)
+  {
+    if(t[p] && !special[_uf_component(t, p)])
+      d[p] = DT_SEG_COMPONENT;
+  }
+
+  const int nr = seg->nr;
+  _uf_floodfill_special(seg, t, croot, components, size, mark, before, &stack);
+
+  // label the other segments and add their markings, the floodfill might have marked
+  // the row above the segmentation area
+  DT_OMP_FOR()
+  for(int s = 0; s < stripes; s++)
+  {
+    int *xmin = rect + (size_t)4 * segments * s;
+    int *xmax = xmin + segments;
+    int *ymin = xmax + segments;
+    int *ymax = ymin + segments;
+    for(int i = 0; i < segments; i++)
+    {
+      xmin[i] = ymin[i] = INT_MAX;
+      xmax[i] = ymax[i] = INT_MIN;
+    }
+
+    for(int row = s ? _stripe_row(s, stripes, border, rows) : border - 1;
+        row < _stripe_row(s + 1, stripes, border, rows); row++)
+    {
+      for(int col = border; col < width - border; col++)
+      {
+        const size_t p = (size_t)row * width + col;
+        if(row >= border && t[p])
+        {
+          const uint32_t c = _uf_component(t, p);
+          if(!special[c])
+            d[p] = cid[c] ? cid[c] : 1;
+          continue;
+        }
+
+        int owner = (d[p] & DT_SEG_ID_MASK) ? (int)(d[p] & (DT_SEG_ID_MASK - 1)) : INT_MAX;
+        if(row >= border && (d[p] == 0 || owner != INT_MAX))
+          owner = MIN(owner, _uf_owner(t, mark, p, row, col, width, height, border));
+        if(owner < 2 || owner >= id) continue;
+
+        d[p] = DT_SEG_ID_MASK | owner;
+        const int i = owner - 2;
+        xmin[i] = MIN(xmin[i], col);
+        xmax[i] = MAX(xmax[i], col);
+        ymin[i] = MIN(ymin[i], row);
+        ymax[i] = MAX(ymax[i], row);
+      }
+    }
+  }
+
+  // slots are cleared and set as done by the floodfill
+  if(components)
+    for(int i = 2; i <= id; i++)
+      _clear_segment_slot(seg, i);
+
+  for(int c = 0; c < components; c++)
+  {
+    const int i = cid[c];
+    if(!i) continue;
+    seg->size[i] = size[c];
+    seg->xmin[i] = seg->xmax[i] = croot[c] % width;
+    seg->ymin[i] = seg->ymax[i] = croot[c] / width;
+    for(int s = 0; s < stripes; s++)
+    {
+      const int *r = rect + (size_t)4 * segments * s + i - 2;
+      seg->xmin[i] = MIN(seg->xmin[i], r[0]);
+      seg->xmax[i] = MAX(seg->xmax[i], r[segments]);
+      seg->ymin[i] = MIN(seg->ymin[i], r[2 * segments]);
+      seg->ymax[i] = MAX(seg->ymax[i], r[3 * segments]);
+    }
+  }
+  seg->nr = nr + segments;
+
+  if(id >= seg->slots - 2)
+    dt_print(DT_DEBUG_ALWAYS, "[segmentize_plane] %ix%i number of segments exceeds maximum=%i",
+             width, height, seg->slots);
+
+  dt_free_align(stack.el);
+  dt_free_align(rect);
+  dt_free_align(before);
+  dt_free_align(mark);
+  dt_free_align(special);
+  dt_free_align(size);
+  dt_free_align(cid);
+  dt_free_align(croot);
+  dt_free_align(linked);
+  dt_free_align(first);
+  return FALSE;
+
+error:
+  // the roots have been used for counting
+  for(size_t p = (size_t)border * width; p < (size_t)(height - border) * width; p++)
+    if(t[p]) d[p] = 1;
+
+  dt_free_align(stack.el);
+  dt_free_align(rect);
+  dt_free_align(before);
+  dt_free_align(mark);
+  dt_free_align(special);
+  dt_free_align(size);
+  dt_free_align(cid);
+  dt_free_align(croot);
+  dt_free_align(linked);
+  dt_free_align(first);
+  return TRUE;
+}
+
+// User interface
+void dt_segmentize_plane(dt_iop_segmentation_t *seg)
+{
+  // on a single thread the floodfill is faster
+  const int threads = dt_get_num_threads();
+  if(threads < 2 || _segmentize_unionfind(seg, threads))
+    _segmentize_floodfill(seg);
+}
+
 void dt_segments_combine(dt_iop_segmentation_t *seg, const int radius)
 {
   uint32_t *img = seg->data;
@@ -206,6 +206,10 @@ typedef struct dt_iop_lens_global_data_t
   int kernel_md_vignette;
   int kernel_md_correct;
   lfDatabase *db;
+  // cached distortion maps, most recently used first
+  GList *maps;
+  size_t maps_size;
+  dt_pthread_mutex_t maps_lock;
 } dt_iop_lens_global_data_t;
 
 typedef struct dt_iop_lens_data_t
@@ -1043,6 +1047,295 @@ static float _get_autoscale_lf(dt_iop_module_t *self,
   return scale;
 }
 
+/*
+  Cache of distortion coordinates, shared by all pipes.
+
+  Evaluating the lens model for every pixel on every run is expensive,
+  especially with a projection transform. The coordinates only depend on
+  the lens, the settings and the size of the image at the scale of the
+  pipe, not on the roi. So they are evaluated once on a grid every
+  LENS_MAP_STEP pixels covering the whole image and the rows of any roi
+  or tile are expanded bilinearly from it. Pipes and images of the same
+  shot with the same settings share the grid.
+
+  Cells where the expansion is off by more than LENS_MAP_TOLERANCE pixels
+  at the center, or with a corner the model can't map, are evaluated per
+  pixel as before.
+*/
+#define LENS_MAP_STEP 8
+#define LENS_MAP_TOLERANCE 0.02f
+#define LENS_MAP_BUDGET (256 * DT_MEGA)
+
+// fills 6 coordinates, x and y for red, green and blue, per pixel of
+// the row segment starting at x, y
+typedef void (*_lens_coords_t)(const void *data,
+                               const int x,
+                               const int y,
+                               const int width,
+                               float *out);
+
+typedef struct dt_iop_lens_map_t
+{
+  dt_hash_t key;
+  int gw, gh;      // grid nodes
+  float *grid;     // gw x gh x 6 coordinates
+  uint8_t *exact;  // (gw - 1) x (gh - 1) cells evaluated per pixel
+  size_t size;
+  int users;
+  gboolean dropped;
+} dt_iop_lens_map_t;
+
+static void _lens_map_free(dt_iop_lens_map_t *map)
+{
+  dt_free_align(map->grid);
+  free(map->exact);
+  free(map);
+}
+
+static dt_iop_lens_map_t *_lens_map_build(const dt_hash_t key,
+                                          const int width,
+                                          const int height,
+                                          _lens_coords_t coords,
+                                          const void *data)
+{
+  const int step = LENS_MAP_STEP;
+  const int gw = MAX(2, (width - 1 + step - 1) / step + 1);
+  const int gh = MAX(2, (height - 1 + step - 1) / step + 1);
+
+  dt_iop_lens_map_t *map = (dt_iop_lens_map_t *)calloc(1, sizeof(dt_iop_lens_map_t));
+  if(!map) return NULL;
+  map->key = key;
+  map->gw = gw;
+  map->gh = gh;
+  map->grid = dt_alloc_align_float((size_t)gw * gh * 6);
+  map->exact = (uint8_t *)calloc((size_t)(gw - 1) * (gh - 1), sizeof(uint8_t));
+  if(!map->grid || !map->exact)
+  {
+    _lens_map_free(map);
+    return NULL;
+  }
+  map->size = sizeof(dt_iop_lens_map_t)
+    + sizeof(float) * gw * gh * 6 + sizeof(uint8_t) * (gw - 1) * (gh - 1);
+
+  float *const grid = map->grid;
+  DT_OMP_FOR()
+  for(int j = 0; j < gh; j++)
+    for(int i = 0; i < gw; i++)
+      coords(data, i * step, j * step, 1, grid + 6 * ((size_t)j * gw + i));
+
+  uint8_t *const exact = map->exact;
+  int nexact = 0;
+  DT_OMP_FOR(reduction(+ : nexact))
+  for(int j = 0; j < gh - 1; j++)
+    for(int i = 0; i < gw - 1; i++)
+    {
+      const float *const g00 = grid + 6 * ((size_t)j * gw + i);
+      const float *const g01 = g00 + 6;
+      const float *const g10 = g00 + 6 * gw;
+      const float *const g11 = g10 + 6;
+      float DT_ALIGNED_ARRAY center[6];
+      coords(data, i * step + step / 2, j * step + step / 2, 1, center);
+
+      gboolean off = FALSE;
+      for(int c = 0; c < 6; c++)
+      {
+        const float mean = 0.25f * (g00[c] + g01[c] + g10[c] + g11[c]);
+        // also true for anything not finite
+        if(!(fabsf(mean - center[c]) <= LENS_MAP_TOLERANCE)) off = TRUE;
+      }
+      if(off)
+      {
+        exact[(size_t)j * (gw - 1) + i] = 1;
+        nexact++;
+      }
+    }
+
+  dt_print(DT_DEBUG_PERF,
+           "[lens] distortion map %dx%d with %dx%d nodes, %.1f%% of the cells exact",
+           width, height, gw, gh, 100.0 * nexact / ((gw - 1) * (gh - 1)));
+  return map;
+}
+
+// get the map for key, building it if needed. the map stays valid
+// until released, even if dropped from the cache meanwhile.
+static dt_iop_lens_map_t *_lens_map_acquire(dt_iop_lens_global_data_t *gd,
+                                            const dt_hash_t key,
+                                            const int width,
+                                            const int height,
+                                            _lens_coords_t coords,
+                                            const void *data)
+{
+  dt_pthread_mutex_lock(&gd->maps_lock);
+  for(GList *l = gd->maps; l; l = g_list_next(l))
+  {
+    dt_iop_lens_map_t *map = (dt_iop_lens_map_t *)l->data;
+    if(map->key != key) continue;
+    map->users++;
+    gd->maps = g_list_remove_link(gd->maps, l);
+    gd->maps = g_list_concat(l, gd->maps);
+    dt_pthread_mutex_unlock(&gd->maps_lock);
+    return map;
+  }
+  dt_pthread_mutex_unlock(&gd->maps_lock);
+
+  dt_iop_lens_map_t *map = _lens_map_build(key, width, height, coords, data);
+  if(!map) return NULL;
+  map->users = 1;
+
+  dt_pthread_mutex_lock(&gd->maps_lock);
+  // another pipe might have built the same in the meantime
+  for(GList *l = gd->maps; l; l = g_list_next(l))
+  {
+    dt_iop_lens_map_t *old = (dt_iop_lens_map_t *)l->data;
+    if(old->key != key) continue;
+    old->users++;
+    dt_pthread_mutex_unlock(&gd->maps_lock);
+    _lens_map_free(map);
+    return old;
+  }
+
+  if(map->size > LENS_MAP_BUDGET)
+    map->dropped = TRUE;
+  else
+  {
+    gd->maps = g_list_prepend(gd->maps, map);
+    gd->maps_size += map->size;
+    while(gd->maps_size > LENS_MAP_BUDGET)
+    {
+      GList *last = g_list_last(gd->maps);
+      dt_iop_lens_map_t *old = (dt_iop_lens_map_t *)last->data;
+      gd->maps = g_list_delete_link(gd->maps, last);
+      gd->maps_size -= old->size;
+      if(old->users)
+        old->dropped = TRUE;
+      else
+        _lens_map_free(old);
+    }
+  }
+  dt_pthread_mutex_unlock(&gd->maps_lock);
+  return map;
+}
+
+static void _lens_map_release(dt_iop_lens_global_data_t *gd,
+                              dt_iop_lens_map_t *map)
+{
+  if(!map) return;
+  dt_pthread_mutex_lock(&gd->maps_lock);
+  const gboolean unused = --map->users == 0 && map->dropped;
+  dt_pthread_mutex_unlock(&gd->maps_lock);
+  if(unused) _lens_map_free(map);
+}
+
+// the coordinates of the row segment starting at x, y. without a map,
+// or outside of it, they are evaluated directly.
+static void _lens_map_row(const dt_iop_lens_map_t *const map,
+                          _lens_coords_t coords,
+                          const void *data,
+                          const int x,
+                          const int y,
+                          const int width,
+                          float *const out)
+{
+  const int step = LENS_MAP_STEP;
+  if(!map || y < 0 || y > (map->gh - 1) * step)
+  {
+    coords(data, x, y, width, out);
+    return;
+  }
+
+  const int gw = map->gw;
+  const int j = MIN(y / step, map->gh - 2);
+  const float fy = (float)(y - j * step) / step;
+  const float *const row = map->grid + 6 * (size_t)j * gw;
+  const uint8_t *const exact = map->exact + (size_t)j * (gw - 1);
+  const int xmax = (gw - 1) * step;
+
+  int k = 0;
+  while(k < width)
+  {
+    // a run of pixels to evaluate directly
+    int end = k;
+    while(end < width
+          && (x + end < 0 || x + end > xmax
+              || exact[MIN((x + end) / step, gw - 2)]))
+      end++;
+    if(end > k)
+    {
+      coords(data, x + k, y, end - k, out + 6 * k);
+      k = end;
+      continue;
+    }
+
+    const int ax = x + k;
+    const int i = MIN(ax / step, gw - 2);
+    const float fx = (float)(ax - i * step) / step;
+    const float *const g00 = row + 6 * i;
+    const float *const g01 = g00 + 6;
+    const float *const g10 = g00 + 6 * gw;
+    const float *const g11 = g10 + 6;
+    float *const o = out + 6 * k;
+    for(int c = 0; c < 6; c++)
+    {
+      const float top = g00[c] + fx * (g01[c] - g00[c]);
+      const float bottom = g10[c] + fx * (g11[c] - g10[c]);
+      o[c] = top + fy * (bottom - top);
+    }
+    k++;
+  }
+}
+
+static void _lf_coords(const void *data,
+                       const int x,
+                       const int y,
+                       const int width,
+                       float *out)
+{
+  const lfModifier *modifier = (const lfModifier *)data;
+  modifier->ApplySubpixelGeometryDistortion(x, y, width, 1, out);
+}
+
+// everything the coordinates of the modifier depend on. neither
+// distortion nor TCA depend on aperture and distance, leaving them out
+// shares the map between the exposures of a shot.
+static dt_hash_t _lf_map_key(const dt_iop_lens_data_t *const d,
+                             const int modflags,
+                             const int width,
+                             const int height)
+{
+  const int geometry = modflags & (LF_MODIFY_TCA
+                                   | LF_MODIFY_DISTORTION
+                                   | LF_MODIFY_GEOMETRY
+                                   | LF_MODIFY_SCALE);
+  dt_hash_t hash = dt_hash(DT_INITHASH, "lensfun", 7);
+  if(d->lens->Maker) hash = dt_hash(hash, d->lens->Maker, strlen(d->lens->Maker));
+  if(d->lens->Model) hash = dt_hash(hash, d->lens->Model, strlen(d->lens->Model));
+  hash = dt_hash(hash, &d->lens->Type, sizeof(d->lens->Type));
+  hash = dt_hash(hash, &d->lens->CropFactor, sizeof(d->lens->CropFactor));
+  hash = dt_hash(hash, &d->crop, sizeof(d->crop));
+  hash = dt_hash(hash, &d->focal, sizeof(d->focal));
+  hash = dt_hash(hash, &d->scale, sizeof(d->scale));
+  hash = dt_hash(hash, &d->inverse, sizeof(d->inverse));
+  hash = dt_hash(hash, &d->target_geom, sizeof(d->target_geom));
+  hash = dt_hash(hash, &geometry, sizeof(geometry));
+  if(d->tca_override && (geometry & LF_MODIFY_TCA))
+    hash = dt_hash(hash, d->custom_tca.Terms, sizeof(d->custom_tca.Terms));
+  hash = dt_hash(hash, &width, sizeof(width));
+  hash = dt_hash(hash, &height, sizeof(height));
+  return hash;
+}
+
+static dt_iop_lens_map_t *_lf_map_acquire(dt_iop_module_t *self,
+                                          const dt_iop_lens_data_t *const d,
+                                          const lfModifier *modifier,
+                                          const int modflags,
+                                          const int width,
+                                          const int height)
+{
+  dt_iop_lens_global_data_t *gd = (dt_iop_lens_global_data_t *)self->global_data;
+  return _lens_map_acquire(gd, _lf_map_key(d, modflags, width, height),
+                           width, height, _lf_coords, modifier);
+}
+
 static void _process_lf(dt_iop_module_t *self,
                         dt_dev_pixelpipe_iop_t *piece,
                         const void *const ivoid,
@@ -1087,6 +1380,13 @@ static void _process_lf(dt_iop_module_t *self,
 
   const dt_interpolation_t *const interpolation = dt_interpolation_new(DT_INTERPOLATION_USERPREF_WARP);
 
+  dt_iop_lens_map_t *map = (modflags & (LF_MODIFY_TCA
+                                        | LF_MODIFY_DISTORTION
+                                        | LF_MODIFY_GEOMETRY
+                                        | LF_MODIFY_SCALE))
+    ? _lf_map_acquire(self, d, modifier, modflags, orig_w, orig_h)
+    : NULL;
+
   if(d->inverse)
   {
     // reverse direction (useful for renderings)
@@ -1105,8 +1405,8 @@ static void _process_lf(dt_iop_module_t *self,
       for(int y = 0; y < roi_out->height; y++)
       {
         float *bufptr = (float*)dt_get_perthread(buf, padded_bufsize);
-        modifier->ApplySubpixelGeometryDistortion(roi_out->x, roi_out->y + y,
-                                                  roi_out->width, 1, bufptr);
+        _lens_map_row(map, _lf_coords, modifier, roi_out->x, roi_out->y + y,
+                      roi_out->width, bufptr);
 
         // reverse transform the global coords from lf to our buffer
         float *out = ((float *)ovoid) + (size_t)y * roi_out->width * ch;
@@ -1215,10 +1515,8 @@ static void _process_lf(dt_iop_module_t *self,
       for(int y = 0; y < roi_out->height; y++)
       {
         float *buf2ptr = (float*)dt_get_perthread(buf2, padded_buf2size);
-        modifier->ApplySubpixelGeometryDistortion(roi_out->x,
-                                                  roi_out->y + y,
-                                                  roi_out->width,
-                                                  1, buf2ptr);
+        _lens_map_row(map, _lf_coords, modifier, roi_out->x, roi_out->y + y,
+                      roi_out->width, buf2ptr);
         // reverse transform the global coords from lf to our buffer
         float *out = ((float *)ovoid) + (size_t)y * roi_out->width * ch;
         for(int x = 0; x < roi_out->width; x++, buf2ptr += 6, out += ch)
@@ -1276,6 +1574,7 @@ static void _process_lf(dt_iop_module_t *self,
     }
     dt_free_align(buf);
   }
+  _lens_map_release((dt_iop_lens_global_data_t *)self->global_data, map);
   delete modifier;
 }
 
@@ -1301,6 +1600,7 @@ static int _process_cl_lf(dt_iop_module_t *self,
 
   float *tmpbuf = NULL;
   lfModifier *modifier = NULL;
+  dt_iop_lens_map_t *map = NULL;
 
   const int devid = piece->pipe->devid;
   const int iwidth = roi_in->width;
@@ -1369,6 +1669,12 @@ static int _process_cl_lf(dt_iop_module_t *self,
   modifier = _get_modifier(&modflags, orig_w, orig_h, d, used_lf_mask, FALSE);
   dt_pthread_mutex_unlock(&darktable.plugin_threadsafe);
 
+  if(modflags & (LF_MODIFY_TCA
+                 | LF_MODIFY_DISTORTION
+                 | LF_MODIFY_GEOMETRY
+                 | LF_MODIFY_SCALE))
+    map = _lf_map_acquire(self, d, modifier, modflags, orig_w, orig_h);
+
   if(d->inverse)
   {
     // reverse direction (useful for renderings)
@@ -1381,9 +1687,8 @@ static int _process_cl_lf(dt_iop_module_t *self,
       for(int y = 0; y < roi_out->height; y++)
       {
         float *pi = tmpbuf + (size_t)y * tmpbufwidth;
-        modifier->ApplySubpixelGeometryDistortion(roi_out->x,
-                                                  roi_out->y + y,
-                                                  roi_out->width, 1, pi);
+        _lens_map_row(map, _lf_coords, modifier, roi_out->x, roi_out->y + y,
+                      roi_out->width, pi);
       }
 
       err = dt_opencl_write_buffer_to_device(devid, tmpbuf,
@@ -1492,9 +1797,8 @@ static int _process_cl_lf(dt_iop_module_t *self,
       for(int y = 0; y < roi_out->height; y++)
       {
         float *pi = tmpbuf + (size_t)y * tmpbufwidth;
-        modifier->ApplySubpixelGeometryDistortion(roi_out->x,
-                                                  roi_out->y + y,
-                                                  roi_out->width, 1, pi);
+        _lens_map_row(map, _lf_coords, modifier, roi_out->x, roi_out->y + y,
+                      roi_out->width, pi);
       }
 
       err = dt_opencl_write_buffer_to_device(devid, tmpbuf,
@@ -1521,6 +1825,7 @@ error:
   dt_opencl_release_mem_object(dev_tmp);
   dt_opencl_release_mem_object(dev_tmpbuf);
   dt_free_align(tmpbuf);
+  _lens_map_release(gd, map);
   if(modifier != NULL) delete modifier;
   return err;
 }
@@ -1660,6 +1965,7 @@ static void _distort_mask_lf(dt_iop_module_t *self,
   }
 
   const dt_interpolation_t *const interpolation = dt_interpolation_new(DT_INTERPOLATION_USERPREF_WARP);
+  dt_iop_lens_map_t *map = _lf_map_acquire(self, d, modifier, modflags, orig_w, orig_h);
 
   // acquire temp memory for distorted pixel coords
   const size_t bufsize = (size_t)roi_out->width * 2 * 3;
@@ -1670,8 +1976,8 @@ static void _distort_mask_lf(dt_iop_module_t *self,
   for(int y = 0; y < roi_out->height; y++)
   {
     float *bufptr = (float*)dt_get_perthread(buf, padded_bufsize);
-    modifier->ApplySubpixelGeometryDistortion(roi_out->x, roi_out->y + y,
-                                              roi_out->width, 1, bufptr);
+    _lens_map_row(map, _lf_coords, modifier, roi_out->x, roi_out->y + y,
+                  roi_out->width, bufptr);
 
     // reverse transform the global coords from lf to our buffer
     float *_out = out + (size_t)y * roi_out->width;
@@ -1692,6 +1998,7 @@ static void _distort_mask_lf(dt_iop_module_t *self,
     }
   }
   dt_free_align(buf);
+  _lens_map_release((dt_iop_lens_global_data_t *)self->global_data, map);
   delete modifier;
 }
 
@@ -2775,6 +3082,52 @@ static void _distort_mask_md(dt_iop_module_t *self,
   }
 }
 
+typedef struct _md_coords_t
+{
+  const dt_iop_lens_data_t *d;
+  float w2, h2, r, inv_scale_md;
+  gboolean pass_mode;
+} _md_coords_t;
+
+static void _md_coords(const void *data,
+                       const int x,
+                       const int y,
+                       const int width,
+                       float *out)
+{
+  const _md_coords_t *const m = (const _md_coords_t *)data;
+  const dt_iop_lens_data_t *const d = m->d;
+  const float cy = (y - m->h2) * m->inv_scale_md;
+  for(int k = 0; k < width; k++, out += 6)
+  {
+    const float cx = (x + k - m->w2) * m->inv_scale_md;
+    const float radius = m->r * dt_fast_hypotf(cx, cy);
+    for(int c = 0; c < 3; c++)
+    {
+      const int plane = m->pass_mode ? 1 : c;
+      const float dr =
+        _interpolate_linear_spline(d->knots_dist, d->cor_rgb[plane], d->nc, radius);
+      out[2 * c] = dr * cx + m->w2;
+      out[2 * c + 1] = dr * cy + m->h2;
+    }
+  }
+}
+
+static dt_hash_t _md_map_key(const _md_coords_t *const m)
+{
+  const dt_iop_lens_data_t *const d = m->d;
+  dt_hash_t hash = dt_hash(DT_INITHASH, "metadata", 8);
+  hash = dt_hash(hash, &d->nc, sizeof(d->nc));
+  hash = dt_hash(hash, d->knots_dist, sizeof(float) * d->nc);
+  for(int c = 0; c < 3; c++)
+    hash = dt_hash(hash, d->cor_rgb[c], sizeof(float) * d->nc);
+  hash = dt_hash(hash, &m->w2, sizeof(m->w2));
+  hash = dt_hash(hash, &m->h2, sizeof(m->h2));
+  hash = dt_hash(hash, &m->inv_scale_md, sizeof(m->inv_scale_md));
+  hash = dt_hash(hash, &m->pass_mode, sizeof(m->pass_mode));
+  return hash;
+}
+
 static void _process_md(dt_iop_module_t *self,
                         dt_dev_pixelpipe_iop_t *piece,
                         const void *const ivoid,
@@ -2830,33 +3183,48 @@ static void _process_md(dt_iop_module_t *self,
   float *out = ((float *) ovoid);
   // Correct distortion and/or chromatic aberration
 
+  const _md_coords_t m = { d, w2, h2, r, inv_scale_md, pass_mode };
+  dt_iop_lens_global_data_t *gd = (dt_iop_lens_global_data_t *)self->global_data;
+  dt_iop_lens_map_t *map = _lens_map_acquire(gd, _md_map_key(&m),
+                                             (int)(2.0f * w2), (int)(2.0f * h2),
+                                             _md_coords, &m);
+
+  const size_t coordsize = (size_t)roi_out->width * 2 * 3;
+  size_t padded_coordsize;
+  float *const coords = dt_alloc_perthread_float(coordsize, &padded_coordsize);
+
   const float limw = roi_in->width - 1;
   const float limh = roi_in->height - 1;
-  DT_OMP_FOR(collapse(2))
+  DT_OMP_FOR()
   for(int y = 0; y < roi_out->height; y++)
   {
+    // without memory for a whole row the coordinates are looked up pixel by pixel
+    float pixel[6];
+    float *const xy = coords ? (float *)dt_get_perthread(coords, padded_coordsize) : NULL;
+    if(xy)
+      _lens_map_row(map, _md_coords, &m, roi_out->x, roi_out->y + y, roi_out->width, xy);
     for(int x = 0; x < roi_out->width; x++)
     {
-      const size_t odx = 4 * (y * roi_out->width + x);
-      const float cx = (roi_out->x + x - w2) * inv_scale_md;
-      const float cy = (roi_out->y + y - h2) * inv_scale_md;
-
-      const float radius = r*dt_fast_hypotf(cx, cy);
-
+      const size_t odx = 4 * ((size_t)y * roi_out->width + x);
+      const float *p = pixel;
+      if(xy)
+        p = xy + 6 * x;
+      else
+        _lens_map_row(map, _md_coords, &m, roi_out->x + x, roi_out->y + y, 1, pixel);
       for_each_channel(c)
       {
         // use green data for alpha channel
-        const int plane = (c == 3 || pass_mode) ? 1 : c;
-        const float dr =
-          _interpolate_linear_spline(d->knots_dist, d->cor_rgb[plane], d->nc, radius);
-        const float xs = CLAMP(dr*cx + w2 - roi_in->x, 0.0f, limw);
-        const float ys = CLAMP(dr*cy + h2 - roi_in->y, 0.0f, limh);
+        const int plane = c == 3 ? 1 : c;
+        const float xs = CLAMP(p[2 * plane] - roi_in->x, 0.0f, limw);
+        const float ys = CLAMP(p[2 * plane + 1] - roi_in->y, 0.0f, limh);
         out[odx+c] = dt_interpolation_compute_sample(interpolation, buf + c,
                                                      xs, ys,
                                                      roi_in->width, roi_in->height, 4, 4*roi_in->width);
       }
     }
   }
+  dt_free_align(coords);
+  _lens_map_release(gd, map);
 
   if(!backbuf)
     dt_free_align(buf);
@@ -3386,6 +3754,8 @@ void init_global(dt_iop_module_so_t *self)
   gd->kernel_md_correct =
     dt_opencl_create_kernel(program, "md_lens_correction");
 
+  dt_pthread_mutex_init(&gd->maps_lock, NULL);
+
   lfDatabase *dt_iop_lensfun_db = new lfDatabase;
   gd->db = (lfDatabase *)dt_iop_lensfun_db;
 
@@ -3626,6 +3996,11 @@ void cleanup_global(dt_iop_module_so_t *self)
   lfDatabase *dt_iop_lensfun_db = (lfDatabase *)gd->db;
   delete dt_iop_lensfun_db;
 
+  for(GList *l = gd->maps; l; l = g_list_next(l))
+    _lens_map_free((dt_iop_lens_map_t *)l->data);
+  g_list_free(gd->maps);
+  dt_pthread_mutex_destroy(&gd->maps_lock);
+
   dt_opencl_free_kernel(gd->kernel_lens_distort_bilinear);
   dt_opencl_free_kernel(gd->kernel_lens_distort_bicubic);
   dt_opencl_free_kernel(gd->kernel_lens_distort_lanczos2);
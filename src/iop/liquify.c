@@ -261,6 +261,27 @@ typedef struct
   int warp_kernel;
 } dt_iop_liquify_global_data_t;
 
+// The distortion map of the screen pipes is kept together with the
+// stamps it was built from, and the map of the stamps before the last
+// changed ones. See _cached_distortion_map().
+
+typedef struct
+{
+  dt_liquify_warp_t *warps;   // the stamps added up in map, in order
+  int num_warps;
+  cairo_rectangle_int_t extent;
+  float complex *map;
+  int num_base;               // the first num_base stamps are added up in base
+  cairo_rectangle_int_t base_extent;
+  float complex *base;
+} dt_iop_liquify_cache_t;
+
+typedef struct
+{
+  dt_iop_liquify_params_t params;
+  dt_iop_liquify_cache_t cache;
+} dt_iop_liquify_data_t;
+
 typedef struct
 {
   int node_index; // last node index inserted
@@ -1174,28 +1195,216 @@ static float complex *create_global_distortion_map(const cairo_rectangle_int_t *
   return map;
 }
 
-static void _build_global_distortion_map(const dt_iop_module_t *self,
-                                         const dt_dev_pixelpipe_iop_t *piece,
-                                         const float scale,
-                                         const dt_iop_roi_t *roi,
-                                         cairo_rectangle_int_t *map_extent,
-                                         const gboolean inverted,
-                                         float complex **map)
+static void _cache_free(dt_iop_liquify_cache_t *cache)
+{
+  free(cache->warps);
+  dt_free_align(cache->map);
+  dt_free_align(cache->base);
+  memset(cache, 0, sizeof(dt_iop_liquify_cache_t));
+}
+
+// copy a map into a new map of another extent, both extents contain all
+// of the stamps of the map so there is nothing but zeroes outside the
+// overlap
+
+static float complex *_embed_map(const float complex *const map,
+                                 const cairo_rectangle_int_t *const extent,
+                                 const cairo_rectangle_int_t *const new_extent)
+{
+  const size_t mapsize = (size_t)new_extent->width * new_extent->height;
+  float complex *const new_map = dt_alloc_align_type(float complex, mapsize);
+  if(!new_map) return NULL;
+
+  if(extent->x == new_extent->x && extent->y == new_extent->y
+     && extent->width == new_extent->width && extent->height == new_extent->height)
+  {
+    memcpy(new_map, map, sizeof(float complex) * mapsize);
+    return new_map;
+  }
+
+  memset(new_map, 0, sizeof(float complex) * mapsize);
+  const int x0 = MAX(extent->x, new_extent->x);
+  const int x1 = MIN(extent->x + extent->width, new_extent->x + new_extent->width);
+  const int y0 = MAX(extent->y, new_extent->y);
+  const int y1 = MIN(extent->y + extent->height, new_extent->y + new_extent->height);
+  if(x1 <= x0) return new_map;
+
+  DT_OMP_FOR()
+  for(int y = y0; y < y1; y++)
+    memcpy(new_map + (size_t)(y - new_extent->y) * new_extent->width + x0 - new_extent->x,
+           map + (size_t)(y - extent->y) * extent->width + x0 - extent->x,
+           sizeof(float complex) * (x1 - x0));
+  return new_map;
+}
+
+/*
+  Builds the distortion map of the stamps in roi from the cached maps.
+
+  The map is the sum of the stamps applied in order, so the map of the
+  first n stamps can be continued with the remaining ones and gives the
+  same result as a rebuild. We keep the last map and the map of the
+  stamps before the ones that changed last: adding a stroke continues
+  the last map, dragging the newest stroke around continues the map of
+  the strokes before it. Only a change of an older stroke rebuilds it
+  all, and keeps the map of the strokes before that one.
+
+  The returned map belongs to the cache.
+*/
+
+static float complex *_cached_distortion_map(dt_iop_liquify_cache_t *cache,
+                                             const cairo_rectangle_int_t *map_extent,
+                                             const GSList *stamps)
 {
+  const int num = g_slist_length((GSList *)stamps);
+  if(num == 0)
+  {
+    _cache_free(cache);
+    return NULL;
+  }
+
+  // number of unchanged stamps at the start
+  int common = 0;
+  for(const GSList *i = stamps;
+      i && common < cache->num_warps
+        && !memcmp(i->data, cache->warps + common, sizeof(dt_liquify_warp_t));
+      i = g_slist_next(i))
+    common++;
+
+  if(common == num && num == cache->num_warps)
+    return cache->map;
+
+  dt_liquify_warp_t *warps = malloc(sizeof(dt_liquify_warp_t) * num);
+  if(!warps)
+  {
+    dt_print(DT_DEBUG_ALWAYS, "[liquify] out of memory, distortion map skipped");
+    _cache_free(cache);
+    return NULL;
+  }
+  int k = 0;
+  for(const GSList *i = stamps; i; i = g_slist_next(i))
+    warps[k++] = *(dt_liquify_warp_t *)i->data;
+
+  // continue the map of the most stamps we still have
+  float complex *map = NULL;
+  int done = 0;
+  if(common == cache->num_warps)
+  {
+    map = _embed_map(cache->map, &cache->extent, map_extent);
+    done = common;
+  }
+  else if(cache->base && cache->num_base <= common)
+  {
+    map = _embed_map(cache->base, &cache->base_extent, map_extent);
+    done = cache->num_base;
+  }
+  else
+  {
+    const size_t mapsize = (size_t)map_extent->width * map_extent->height;
+    map = dt_alloc_align_type(float complex, mapsize);
+    if(map) memset(map, 0, sizeof(float complex) * mapsize);
+  }
+
+  if(!map)
+  {
+    dt_print(DT_DEBUG_ALWAYS, "[liquify] out of memory, distortion map skipped");
+    free(warps);
+    _cache_free(cache);
+    return NULL;
+  }
+
+  // the stamps up to common become the new base, the cached maps are
+  // taken over if they are just that
+  float complex *base = NULL;
+  cairo_rectangle_int_t base_extent = { 0, 0, 0, 0 };
+  int num_base = 0;
+  if(common == num)
+  {
+    if(cache->base && cache->num_base <= common)
+    {
+      base = cache->base;
+      base_extent = cache->base_extent;
+      num_base = cache->num_base;
+      cache->base = NULL;
+    }
+  }
+  else if(common > 0)
+  {
+    num_base = common;
+    if(common == cache->num_warps)
+    {
+      base = cache->map;
+      base_extent = cache->extent;
+      cache->map = NULL;
+    }
+    else if(cache->base && common == cache->num_base)
+    {
+      base = cache->base;
+      base_extent = cache->base_extent;
+      cache->base = NULL;
+    }
+  }
+
+  const int reused = done;
+  for(; done < num; done++)
+  {
+    if(done == num_base && num_base > 0 && !base)
+    {
+      base = _embed_map(map, map_extent, map_extent);
+      base_extent = *map_extent;
+      if(!base) num_base = 0;
+    }
+    apply_round_stamp(warps + done, map, map_extent);
+  }
+
+  dt_print(DT_DEBUG_PERF, "[liquify] distortion map: %d stamps, %d of them cached",
+           num, reused);
+
+  _cache_free(cache);
+  cache->warps = warps;
+  cache->num_warps = num;
+  cache->extent = *map_extent;
+  cache->map = map;
+  cache->num_base = num_base;
+  cache->base_extent = base_extent;
+  cache->base = base;
+  return map;
+}
+
+// returns TRUE if the map belongs to the piece and must not be freed,
+// only the processing of the pipe itself may use the cache
+
+static gboolean _build_global_distortion_map(const dt_iop_module_t *self,
+                                             const dt_dev_pixelpipe_iop_t *piece,
+                                             const float scale,
+                                             const dt_iop_roi_t *roi,
+                                             cairo_rectangle_int_t *map_extent,
+                                             const gboolean inverted,
+                                             const gboolean use_cache,
+                                             float complex **map)
+{
+  dt_iop_liquify_data_t *d = piece->data;
+
   // copy params
   dt_iop_liquify_params_t copy_params;
-  memcpy(&copy_params, piece->data, sizeof(dt_iop_liquify_params_t));
+  memcpy(&copy_params, &d->params, sizeof(dt_iop_liquify_params_t));
 
   distort_paths_raw_to_piece(self, piece->pipe, scale, &copy_params);
 
   GList *interpolated = interpolate_paths(&copy_params);
   GSList *interpolated_in_roi = _get_map_extent(roi, interpolated, map_extent);
 
-  if(map)
+  // the screen pipes run again and again with mostly the same strokes
+  const gboolean cached = map && use_cache && !inverted
+    && dt_pipe_is_screen(piece->pipe) && !piece->pipe->tiling;
+
+  if(cached)
+    *map = _cached_distortion_map(&d->cache, map_extent, interpolated_in_roi);
+  else if(map)
     *map = create_global_distortion_map(map_extent, interpolated_in_roi, inverted);
 
   g_slist_free(interpolated_in_roi);
   g_list_free_full(interpolated, free);
+  return cached;
 }
 
 void modify_roi_in(dt_iop_module_t *self,
@@ -1211,7 +1420,7 @@ void modify_roi_in(dt_iop_module_t *self,
 
   cairo_rectangle_int_t extent;
   _build_global_distortion_map(self, piece, roi_in->scale,
-                               roi_out, &extent, FALSE, NULL);
+                               roi_out, &extent, FALSE, FALSE, NULL);
   const cairo_rectangle_int_t pipe_rect =
     {
       0,
@@ -1285,7 +1494,7 @@ static gboolean _distort_xtransform(const dt_iop_module_t *self,
 
     float complex *map = NULL;
     _build_global_distortion_map(self, piece, scale, &roi_in,
-                                 &extent, inverted, &map);
+                                 &extent, inverted, FALSE, &map);
 
     if(map == NULL) return FALSE;
 
@@ -1370,8 +1579,8 @@ void distort_mask(dt_iop_module_t *self,
   // 2. build the distortion map
   cairo_rectangle_int_t map_extent;
   float complex *map = NULL;
-  _build_global_distortion_map(self, piece, roi_in->scale,
-                               roi_out, &map_extent, FALSE, &map);
+  const gboolean cached = _build_global_distortion_map(self, piece, roi_in->scale,
+                                                       roi_out, &map_extent, FALSE, TRUE, &map);
   if(map == NULL)
     return;
 
@@ -1384,7 +1593,7 @@ void distort_mask(dt_iop_module_t *self,
     piece->colors = ch;
   }
 
-  dt_free_align((void *) map);
+  if(!cached) dt_free_align((void *)map);
 }
 
 void process(dt_iop_module_t *self,
@@ -1403,8 +1612,8 @@ void process(dt_iop_module_t *self,
   // 2. build the distortion map
   cairo_rectangle_int_t map_extent;
   float complex *map = NULL;
-  _build_global_distortion_map(self, piece, roi_in->scale,
-                               roi_out, &map_extent, FALSE, &map);
+  const gboolean cached = _build_global_distortion_map(self, piece, roi_in->scale,
+                                                       roi_out, &map_extent, FALSE, TRUE, &map);
   if(map == NULL)
     return;
 
@@ -1412,7 +1621,7 @@ void process(dt_iop_module_t *self,
   if(map_extent.width != 0 && map_extent.height != 0)
     _apply_global_distortion_map(self, piece, in, out, roi_in, roi_out, map, &map_extent);
 
-  dt_free_align((void *)map);
+  if(!cached) dt_free_align((void *)map);
 }
 
 #ifdef HAVE_OPENCL
@@ -1567,8 +1776,8 @@ int process_cl(dt_iop_module_t *self,
   // 2. build the distortion map
   cairo_rectangle_int_t map_extent;
   float complex *map = NULL;
-  _build_global_distortion_map(self, piece, roi_in->scale,
-                               roi_out, &map_extent, FALSE, &map);
+  const gboolean cached = _build_global_distortion_map(self, piece, roi_in->scale,
+                                                       roi_out, &map_extent, FALSE, TRUE, &map);
 
   if(map == NULL)
     return CL_SUCCESS;
@@ -1577,7 +1786,7 @@ int process_cl(dt_iop_module_t *self,
   if(map_extent.width != 0 && map_extent.height != 0)
     err = _apply_global_distortion_map_cl(self, piece, dev_in,
                                           dev_out, roi_in, roi_out, map, &map_extent);
-  dt_free_align((void *) map);
+  if(!cached) dt_free_align((void *)map);
   return err;
 }
 
@@ -1601,6 +1810,32 @@ void cleanup_global(dt_iop_module_so_t *self)
   self->data = NULL;
 }
 
+void commit_params(dt_iop_module_t *self,
+                   dt_iop_params_t *p1,
+                   dt_dev_pixelpipe_t *pipe,
+                   dt_dev_pixelpipe_iop_t *piece)
+{
+  dt_iop_liquify_data_t *d = piece->data;
+  memcpy(&d->params, p1, sizeof(dt_iop_liquify_params_t));
+}
+
+void init_pipe(dt_iop_module_t *self,
+               dt_dev_pixelpipe_t *pipe,
+               dt_dev_pixelpipe_iop_t *piece)
+{
+  piece->data = calloc(1, sizeof(dt_iop_liquify_data_t));
+}
+
+void cleanup_pipe(dt_iop_module_t *self,
+                  dt_dev_pixelpipe_t *pipe,
+                  dt_dev_pixelpipe_iop_t *piece)
+{
+  dt_iop_liquify_data_t *d = piece->data;
+  _cache_free(&d->cache);
+  free(piece->data);
+  piece->data = NULL;
+}
+
 // calculate the dot product of 2 vectors.
 
 static float cdot(const float complex p0, const float complex p1)
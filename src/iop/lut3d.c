@@ -50,6 +50,8 @@ DT_MODULE_INTROSPECTION(3, dt_iop_lut3d_params_t)
 #define DT_IOP_LUT3D_MAX_LUTNAME 128
 #define DT_IOP_LUT3D_CLUT_LEVEL 48
 #define DT_IOP_LUT3D_MAX_KEYPOINTS 2048
+// parsed luts are kept for all pipes while their total size is below this
+#define DT_IOP_LUT3D_CACHE_SIZE ((size_t)256 << 20)
 
 typedef enum dt_iop_lut3d_colorspace_t
 {
@@ -101,9 +103,21 @@ typedef enum dt_lut3d_cols_t
 
 const char invalid_filepath_prefix[] = "INVALID >> ";
 
+// a parsed lut shared by all pipes, see _clut_acquire()
+typedef struct dt_iop_lut3d_clut_t
+{
+  dt_hash_t key;  // lut file path and mtime, or compressed lut contents
+  float *clut;
+  uint16_t level;
+  int users;
+  gboolean dropped; // no longer in the cache, freed by the last user
+} dt_iop_lut3d_clut_t;
+
 typedef struct dt_iop_lut3d_data_t
 {
   dt_iop_lut3d_params_t params;
+  dt_hash_t clut_key;
+  dt_iop_lut3d_clut_t *shared;
   float *clut;  // cube lut pointer
   uint16_t level; // cube_size
 } dt_iop_lut3d_data_t;
@@ -114,6 +128,8 @@ typedef struct dt_iop_lut3d_global_data_t
   int kernel_lut3d_trilinear;
   int kernel_lut3d_pyramid;
   int kernel_lut3d_none;
+  GList *cluts; // most recently used first
+  dt_pthread_mutex_t clut_lock;
 } dt_iop_lut3d_global_data_t;
 
 #ifdef HAVE_GMIC
@@ -226,6 +242,11 @@ int legacy_params(dt_iop_module_t *self,
   return 1;
 }
 
+// the interpolations work on blocks of pixels: the grid cells, weights and node
+// offsets of a whole block are computed first in branchless simd loops, then
+// the nodes are gathered. in and out may be the same buffer.
+#define LUT3D_BLOCK 16
+
 // From `HaldCLUT_correct.c' by Eskil Steenberg (http://www.quelsolaar.com) (BSD licensed)
 static void _correct_pixel_trilinear(const float *const in,
                                      float *const out,
@@ -233,66 +254,73 @@ static void _correct_pixel_trilinear(const float *const in,
                                      const float *const restrict clut,
                                      const uint16_t level)
 {
-  const int level_minus_2 = (level - 2);
-  const size_t level2 = level * level;
+  const int level2 = level * level;
+  const int level1_stride = 3 * level;
+  const int level2_stride = 3 * level2;
+  const int level12_stride = 3 * (level + level2);
   const float flevel_1 = (float)(level - 1);
-  const size_t level1_stride = 3 * level;
-  const size_t level2_stride = 3 * level2;
-  const size_t level12_stride = 3 * (level + level2);
+  const size_t nblocks = (pixel_nb + LUT3D_BLOCK - 1) / LUT3D_BLOCK;
 
   DT_OMP_FOR()
-  for(size_t k = 0; k < (size_t)(pixel_nb * 4); k+=4)
+  for(size_t blk = 0; blk < nblocks; blk++)
   {
-    const float *const input = in + k;
-    float *const output = ((float *const)out) + k;
-
-    DT_ALIGNED_PIXEL int rgbi[4];
-    dt_aligned_pixel_t rgbd;
-    dt_aligned_pixel_t tmp1, tmp2, tmp3;
-
-    // scale the input according to grid size
-    for_each_channel(c, aligned(input))
-      rgbd[c] = CLIP(input[c]) * flevel_1;
-    // quantize to grid
-    for_each_channel(c)
-      rgbi[c] = (int)rgbd[c];
-    for_each_channel(c)
-      rgbi[c] = CLAMP(rgbi[c], 0, level_minus_2);
-    // compute deltas for each channel
-    for_each_channel(c)
-      rgbd[c] -= rgbi[c]; // delta red/green/blue
+    const size_t start = blk * LUT3D_BLOCK;
+    const int n = MIN(LUT3D_BLOCK, pixel_nb - start);
+    const float *const input = in + 4 * start;
+    float *const output = out + 4 * start;
 
-    size_t color = rgbi[0] + level * rgbi[1] + level2 * rgbi[2];
+    int i000[LUT3D_BLOCK];
+    float dr[LUT3D_BLOCK], dg[LUT3D_BLOCK], db[LUT3D_BLOCK];
 
-    const size_t i = color * 3;  // P000
+    DT_OMP_SIMD()
+    for(int j = 0; j < n; j++)
+    {
+      // scale the input according to grid size
+      const float r = CLIP(input[4*j]) * flevel_1;
+      const float g = CLIP(input[4*j+1]) * flevel_1;
+      const float b = CLIP(input[4*j+2]) * flevel_1;
+      // quantize to grid
+      const int ri = CLAMP((int)r, 0, level - 2);
+      const int gi = CLAMP((int)g, 0, level - 2);
+      const int bi = CLAMP((int)b, 0, level - 2);
+      // compute deltas for each channel
+      dr[j] = r - ri;
+      dg[j] = g - gi;
+      db[j] = b - bi;
+      i000[j] = 3 * (ri + gi * level + bi * level2); // P000
+    }
 
-    const float one_minus_rgbd0 = 1.0f - rgbd[0];
-    const float one_minus_rgbd1 = 1.0f - rgbd[1];
+    for(int j = 0; j < n; j++)
+    {
+      const float *const P = clut + i000[j];
+      const float one_minus_dr = 1.0f - dr[j];
+      const float one_minus_dg = 1.0f - dg[j];
+      dt_aligned_pixel_t tmp1, tmp2, tmp3;
 
-    // process indexes of P000 to P111 in clut
-    for_each_channel(c) // P000 and P100
-      tmp1[c] = clut[i+c] * one_minus_rgbd0 + clut[i+3+c] * rgbd[0];
+      for_each_channel(c) // P000 and P100
+        tmp1[c] = P[c] * one_minus_dr + P[3+c] * dr[j];
 
-    for_each_channel(c) // P010 and P110
-      tmp2[c] = clut[i+level1_stride+c] * one_minus_rgbd0 + clut[i+level1_stride+3+c] * rgbd[0];
+      for_each_channel(c) // P010 and P110
+        tmp2[c] = P[level1_stride+c] * one_minus_dr + P[level1_stride+3+c] * dr[j];
 
-    for_each_channel(c) // blend P000/P100 with P010/P110
-      tmp3[c] = tmp1[c] * one_minus_rgbd1 + tmp2[c] * rgbd[1];
+      for_each_channel(c) // blend P000/P100 with P010/P110
+        tmp3[c] = tmp1[c] * one_minus_dg + tmp2[c] * dg[j];
 
-    for_each_channel(c) // P001 and P101
-      tmp1[c] = clut[i+level2_stride+c] * one_minus_rgbd0 + clut[i+level2_stride+3+c] * rgbd[0];
+      for_each_channel(c) // P001 and P101
+        tmp1[c] = P[level2_stride+c] * one_minus_dr + P[level2_stride+3+c] * dr[j];
 
-    for_each_channel(c) // P011 and P111
-      tmp2[c] = clut[i+level12_stride+c] * one_minus_rgbd0 + clut[i+level12_stride+3+c] * rgbd[0];
+      for_each_channel(c) // P011 and P111
+        tmp2[c] = P[level12_stride+c] * one_minus_dr + P[level12_stride+3+c] * dr[j];
 
-    for_each_channel(c) // blend P001/P101 and P011/P111
-      tmp1[c] = tmp1[c] * one_minus_rgbd1 + tmp2[c] * rgbd[1];
+      for_each_channel(c) // blend P001/P101 and P011/P111
+        tmp1[c] = tmp1[c] * one_minus_dg + tmp2[c] * dg[j];
 
-    for_each_channel(c, aligned(output))
-      output[c] = tmp3[c] * (1.0f - rgbd[2]) + tmp1[c] * rgbd[2];
+      for_each_channel(c)
+        output[4*j+c] = tmp3[c] * (1.0f - db[j]) + tmp1[c] * db[j];
+    }
     // not using non-temporal writes here, as those are substantially slower when in==out....
     // (which is the case when performing a colorspace conversion)
- }
+  }
 }
 
 // from OpenColorIO
@@ -303,87 +331,59 @@ static void _correct_pixel_tetrahedral(const float *const in,
                                        const float *const restrict clut,
                                        const uint16_t level)
 {
-  const size_t level2 = level * level;
-  const size_t level1_stride = 3 * level;
-  const size_t level2_stride = 3 * level2;
-  const size_t level12_stride = 3 * (level + level2);
+  const int level2 = level * level;
+  const int sr = 3, sg = 3 * level, sb = 3 * level2; // steps to the next node along r, g and b
+  const int i111 = sr + sg + sb;
   const float flevel_1 = (float)(level - 1);
+  const size_t nblocks = (pixel_nb + LUT3D_BLOCK - 1) / LUT3D_BLOCK;
 
   DT_OMP_FOR()
-  for(size_t k = 0; k < (size_t)(pixel_nb * 4); k+=4)
+  for(size_t blk = 0; blk < nblocks; blk++)
   {
-    const float *const input = in + k;
-    float *const output = ((float *const)out) + k;
+    const size_t start = blk * LUT3D_BLOCK;
+    const int n = MIN(LUT3D_BLOCK, pixel_nb - start);
+    const float *const input = in + 4 * start;
+    float *const output = out + 4 * start;
 
-    dt_aligned_pixel_t rgbi;
-    dt_aligned_pixel_t rgbd;
-    for_each_channel(c)
-      rgbd[c] = CLIP(input[c]) * flevel_1;
+    int i000[LUT3D_BLOCK], i1[LUT3D_BLOCK], i2[LUT3D_BLOCK];
+    float w0[LUT3D_BLOCK], w1[LUT3D_BLOCK], w2[LUT3D_BLOCK], w3[LUT3D_BLOCK];
 
-    for_each_channel(c)
+    DT_OMP_SIMD()
+    for(int j = 0; j < n; j++)
     {
-      rgbi[c] = CLAMP((int)rgbd[c], 0, level - 2);
-      rgbd[c] = rgbd[c] - rgbi[c]; // delta red/green/blue
+      float r = CLIP(input[4*j]) * flevel_1;
+      float g = CLIP(input[4*j+1]) * flevel_1;
+      float b = CLIP(input[4*j+2]) * flevel_1;
+      const int ri = CLAMP((int)r, 0, level - 2);
+      const int gi = CLAMP((int)g, 0, level - 2);
+      const int bi = CLAMP((int)b, 0, level - 2);
+      r -= ri; // delta red/green/blue
+      g -= gi;
+      b -= bi;
+      i000[j] = 3 * (ri + gi * level + bi * level2);
+
+      // the tetrahedron walks from P000 to P111 along the largest, then the
+      // middle delta. the selects follow the tie breaking of the six cases
+      //   r > g > b, r > b >= g, b >= r > g, b > g >= r, g >= b > r, g >= r >= b
+      const gboolean rg = r > g, gb = g > b, rb = r > b, bg = b > g, br = b > r;
+      const float dmax = rg ? (gb || rb ? r : b) : (bg ? b : g);
+      const float dmid = rg ? (gb ? g : (rb ? b : r)) : (bg ? g : (br ? b : r));
+      const float dmin = rg ? (gb ? b : g) : (bg || br ? r : b);
+      const int smax = rg ? (gb || rb ? sr : sb) : (bg ? sb : sg);
+      const int smid = rg ? (gb ? sg : (rb ? sb : sr)) : (bg ? sg : (br ? sb : sr));
+      i1[j] = smax;
+      i2[j] = smax + smid;
+      w0[j] = 1.0f - dmax;
+      w1[j] = dmax - dmid;
+      w2[j] = dmid - dmin;
+      w3[j] = dmin;
     }
 
-    // indexes of P000 to P111 in clut
-    const size_t color = rgbi[0] + rgbi[1] * level + rgbi[2] * level2;
-    const size_t i000 = color * 3;                     // P000
-    const size_t i100 = i000 + 3;                      // P100
-    const size_t i010 = i000 + level1_stride;          // P010
-    const size_t i110 = i010 + 3;                      // P110
-    const size_t i001 = i000 + level2_stride;          // P001
-    const size_t i101 = i001 + 3;                      // P101
-    const size_t i011 = i000 + level12_stride;         // P011
-    const size_t i111 = i011 + 3;                      // P111
-
-    if(rgbd[0] > rgbd[1])
+    for(int j = 0; j < n; j++)
     {
-      if(rgbd[1] > rgbd[2])
-      {
-        // rgbd[0] > rgbd[1] > rgbd[2]
-        for_each_channel(c, aligned(output))
-          output[c] = ((1-rgbd[0])*clut[i000+c] + (rgbd[0]-rgbd[1])*clut[i100+c]
-                      + (rgbd[1]-rgbd[2])*clut[i110+c] + rgbd[2]*clut[i111+c]);
-      }
-      else if(rgbd[0] > rgbd[2])
-      {
-        // rgbd[0] > rgbd[2] >= rgbd[1]
-        for_each_channel(c, aligned(output))
-          output[c] = ((1-rgbd[0])*clut[i000+c] + (rgbd[0]-rgbd[2])*clut[i100+c]
-                      + (rgbd[2]-rgbd[1])*clut[i101+c] + rgbd[1]*clut[i111+c]);
-      }
-      else
-      {
-        // rgbd[2] >= rgbd[0] > rgbd[2]
-        for_each_channel(c, aligned(output))
-          output[c] = ((1-rgbd[2])*clut[i000+c] + (rgbd[2]-rgbd[0])*clut[i001+c]
-                      + (rgbd[0]-rgbd[1])*clut[i101+c] + rgbd[1]*clut[i111+c]);
-      }
-    }
-    else
-    {
-      if(rgbd[2] > rgbd[1])
-      {
-        // rgbd[2] > rgbd[1] >= rgbd[0]
-        for_each_channel(c, aligned(output))
-          output[c] = ((1-rgbd[2])*clut[i000+c] + (rgbd[2]-rgbd[1])*clut[i001+c]
-                      + (rgbd[1]-rgbd[0])*clut[i011+c] + rgbd[0]*clut[i111+c]);
-      }
-      else if(rgbd[2] > rgbd[0])
-      {
-        // rgbd[1] >= rgbd[2] > rgbd[0]
-        for_each_channel(c, aligned(output))
-          output[c] = ((1-rgbd[1])*clut[i000+c] + (rgbd[1]-rgbd[2])*clut[i010+c]
-                      + (rgbd[2]-rgbd[0])*clut[i011+c] + rgbd[0]*clut[i111+c]);
-      }
-      else
-      {
-        // rgbd[1] >= rgbd[0] >= rgbd[2]
-        for_each_channel(c, aligned(output))
-          output[c] = ((1-rgbd[1])*clut[i000+c] + (rgbd[1]-rgbd[0])*clut[i010+c]
-                      + (rgbd[0]-rgbd[2])*clut[i110+c] + rgbd[2]*clut[i111+c]);
-      }
+      const float *const P = clut + i000[j];
+      for_each_channel(c)
+        output[4*j+c] = w0[j] * P[c] + w1[j] * P[i1[j]+c] + w2[j] * P[i2[j]+c] + w3[j] * P[i111+c];
     }
     // not using non-temporal writes here, as those are substantially slower when in==out....
     // (which is the case when performing a colorspace conversion)
@@ -399,64 +399,69 @@ static void _correct_pixel_pyramid(const float *const in,
                                    const uint16_t level)
 {
   const int level2 = level * level;
+  const int sr = 3, sg = 3 * level, sb = 3 * level2; // steps to the next node along r, g and b
+  const int i111 = sr + sg + sb;
   const float flevel_1 = (float)(level - 1);
+  const size_t nblocks = (pixel_nb + LUT3D_BLOCK - 1) / LUT3D_BLOCK;
 
   DT_OMP_FOR()
-  for(size_t k = 0; k < (size_t)(pixel_nb * 4); k+=4)
+  for(size_t blk = 0; blk < nblocks; blk++)
   {
-    const float *const input = in + k;
-    float *const output = ((float *const)out) + k;
-
-    DT_ALIGNED_PIXEL int rgbi[4];
-    dt_aligned_pixel_t rgbd;
-    // scale the input according to grid size
-    for_each_channel(c)
-      rgbd[c] = CLIP(input[c]) * flevel_1;
-    // clip coordinates to LUT grid
-    for_each_channel(c)
-      rgbi[c] = (int)rgbd[c];
-    for_each_channel(c)
-      rgbi[c] = CLAMP(rgbi[c], 0, level - 2);
-    // compute deltas for each channel
-    for_each_channel(c)
-      rgbd[c] -= rgbi[c];
-
-  // indexes of P000 to P111 in clut
-    const int color = rgbi[0] + rgbi[1] * level + rgbi[2] * level2;
-    const size_t i000 = color * 3;                     // P000
-    const size_t i100 = i000 + 3;                      // P100
-    const size_t i010 = (color + level) * 3;           // P010
-    const size_t i110 = i010 + 3;                      // P110
-    const size_t i001 = (color + level2) * 3;          // P001
-    const size_t i101 = i001 + 3;                      // P101
-    const size_t i011 = (color + level + level2) * 3;  // P011
-    const size_t i111 = i011 + 3;                      // P111
-
-    dt_aligned_pixel_t outpx;
-    if(rgbd[1] > rgbd[0] && rgbd[2] > rgbd[0])
-    {
-      for_each_channel(c)
-        outpx[c] = (clut[i000+c] + (clut[i111+c]-clut[i011+c])*rgbd[0]
-                    + (clut[i010+c]-clut[i000+c])*rgbd[1] + (clut[i001+c]-clut[i000+c])*rgbd[2]
-                    + (clut[i011+c]-clut[i001+c]-clut[i010+c]+clut[i000+c])*rgbd[1]*rgbd[2]);
-    }
-    else if(rgbd[0] > rgbd[1] && rgbd[2] > rgbd[1])
+    const size_t start = blk * LUT3D_BLOCK;
+    const int n = MIN(LUT3D_BLOCK, pixel_nb - start);
+    const float *const input = in + 4 * start;
+    float *const output = out + 4 * start;
+
+    int i000[LUT3D_BLOCK], ihr[LUT3D_BLOCK], ilr[LUT3D_BLOCK], ihg[LUT3D_BLOCK], ilg[LUT3D_BLOCK];
+    int ihb[LUT3D_BLOCK], ilb[LUT3D_BLOCK], ixy[LUT3D_BLOCK], ix[LUT3D_BLOCK], iy[LUT3D_BLOCK];
+    float dr[LUT3D_BLOCK], dg[LUT3D_BLOCK], db[LUT3D_BLOCK], d1[LUT3D_BLOCK], d2[LUT3D_BLOCK];
+
+    DT_OMP_SIMD()
+    for(int j = 0; j < n; j++)
     {
-      for_each_channel(c)
-        outpx[c] = (clut[i000+c] + (clut[i100+c]-clut[i000+c])*rgbd[0]
-                    + (clut[i111+c]-clut[i101+c])*rgbd[1] + (clut[i001+c]-clut[i000+c])*rgbd[2]
-                    + (clut[i101+c]-clut[i001+c]-clut[i100+c]+clut[i000+c])*rgbd[0]*rgbd[2]);
+      float r = CLIP(input[4*j]) * flevel_1;
+      float g = CLIP(input[4*j+1]) * flevel_1;
+      float b = CLIP(input[4*j+2]) * flevel_1;
+      const int ri = CLAMP((int)r, 0, level - 2);
+      const int gi = CLAMP((int)g, 0, level - 2);
+      const int bi = CLAMP((int)b, 0, level - 2);
+      r -= ri;
+      g -= gi;
+      b -= bi;
+      i000[j] = 3 * (ri + gi * level + bi * level2);
+
+      // the cube is split in three pyramids, picked by the smallest delta: along
+      // that axis the slope is taken on the far face (P111 - Pxy) instead of from
+      // P000, and the bilinear term spans the face of the two other axes.
+      const gboolean rmin = g > r && b > r;
+      const gboolean gmin = !rmin && r > g && b > g;
+      const gboolean bmin = !rmin && !gmin;
+      ihr[j] = rmin ? i111 : sr;
+      ilr[j] = rmin ? sg + sb : 0;
+      ihg[j] = gmin ? i111 : sg;
+      ilg[j] = gmin ? sr + sb : 0;
+      ihb[j] = bmin ? i111 : sb;
+      ilb[j] = bmin ? sr + sg : 0;
+      ixy[j] = rmin ? sg + sb : (gmin ? sr + sb : sr + sg);
+      ix[j] = bmin ? sr : sb;
+      iy[j] = gmin ? sr : sg;
+      d1[j] = rmin ? g : r;
+      d2[j] = bmin ? g : b;
+      dr[j] = r;
+      dg[j] = g;
+      db[j] = b;
     }
-    else
+
+    for(int j = 0; j < n; j++)
     {
+      const float *const P = clut + i000[j];
       for_each_channel(c)
-         outpx[c] = clut[i000+c] + (clut[i100+c]-clut[i000+c])*rgbd[0]
-                  + (clut[i010+c]-clut[i000+c])*rgbd[1] + (clut[i111+c]-clut[i110+c])*rgbd[2]
-                  + (clut[i110+c]-clut[i100+c]-clut[i010+c]+clut[i000+c])*rgbd[0]*rgbd[1];
+        output[4*j+c] = P[c] + (P[ihr[j]+c] - P[ilr[j]+c]) * dr[j]
+                        + (P[ihg[j]+c] - P[ilg[j]+c]) * dg[j] + (P[ihb[j]+c] - P[ilb[j]+c]) * db[j]
+                        + (P[ixy[j]+c] - P[ix[j]+c] - P[iy[j]+c] + P[c]) * d1[j] * d2[j];
     }
     // not using non-temporal writes here, as those are substantially slower when in==out....
     // (which is the case when performing a colorspace conversion)
-    copy_pixel(output, outpx);
   }
 }
 
@@ -1150,6 +1155,8 @@ void init_global(dt_iop_module_so_t *self)
   gd->kernel_lut3d_trilinear = dt_opencl_create_kernel(program, "lut3d_trilinear");
   gd->kernel_lut3d_pyramid = dt_opencl_create_kernel(program, "lut3d_pyramid");
   gd->kernel_lut3d_none = dt_opencl_create_kernel(program, "lut3d_none");
+  gd->cluts = NULL;
+  dt_pthread_mutex_init(&gd->clut_lock, NULL);
 
 #ifdef HAVE_GMIC
   // make sure the cache dir exists
@@ -1160,6 +1167,13 @@ void init_global(dt_iop_module_so_t *self)
 #endif // HAVE_GMIC
 }
 
+static void _clut_free(gpointer data)
+{
+  dt_iop_lut3d_clut_t *clut = data;
+  dt_free_align(clut->clut);
+  free(clut);
+}
+
 void cleanup_global(dt_iop_module_so_t *self)
 {
   dt_iop_lut3d_global_data_t *gd = self->data;
@@ -1167,6 +1181,8 @@ void cleanup_global(dt_iop_module_so_t *self)
   dt_opencl_free_kernel(gd->kernel_lut3d_trilinear);
   dt_opencl_free_kernel(gd->kernel_lut3d_pyramid);
   dt_opencl_free_kernel(gd->kernel_lut3d_none);
+  g_list_free_full(gd->cluts, _clut_free);
+  dt_pthread_mutex_destroy(&gd->clut_lock);
   free(self->data);
   self->data = NULL;
 }
@@ -1209,6 +1225,129 @@ static int _calculate_clut(dt_iop_lut3d_params_t *const p, float **clut)
   return level;
 }
 
+// the cache key of the lut p refers to, zero if there is nothing to load.
+// files are identified by full path and modification time so an edited lut
+// gets reloaded, compressed luts by their keypoints.
+static dt_hash_t _clut_key(const dt_iop_lut3d_params_t *const p)
+{
+  const char *filepath = p->filepath;
+  if(!filepath[0]) return 0;
+  dt_hash_t hash = DT_INITHASH;
+#ifdef HAVE_GMIC
+  if(p->nb_keypoints)
+  {
+    hash = dt_hash(hash, p->lutname, strlen(p->lutname));
+    hash = dt_hash(hash, &p->nb_keypoints, sizeof(p->nb_keypoints));
+    return dt_hash(hash, p->c_clut,
+                   MIN(sizeof(p->c_clut), (size_t)p->nb_keypoints * 2 * 3));
+  }
+#endif // HAVE_GMIC
+  gchar *lutfolder = dt_conf_get_string("plugins/darkroom/lut3d/def_path");
+  char *fullpath = g_build_filename(lutfolder, filepath, NULL);
+  hash = dt_hash(hash, fullpath, strlen(fullpath));
+  GStatBuf st;
+  if(lutfolder[0] && g_stat(fullpath, &st) == 0)
+  {
+    const int64_t mtime = st.st_mtime;
+    const int64_t size = st.st_size;
+    hash = dt_hash(hash, &mtime, sizeof(mtime));
+    hash = dt_hash(hash, &size, sizeof(size));
+  }
+  else
+  {
+    // still a key of its own, so loading is tried and reports the error
+    static const char missing[] = "missing";
+    hash = dt_hash(hash, missing, sizeof(missing));
+  }
+  g_free(fullpath);
+  g_free(lutfolder);
+  return hash;
+}
+
+// get the parsed lut for p, loading it if it's not cached. the lut stays
+// valid until released, even if dropped from the cache meanwhile.
+static dt_iop_lut3d_clut_t *_clut_acquire(dt_iop_lut3d_global_data_t *gd,
+                                          dt_iop_lut3d_params_t *const p,
+                                          const dt_hash_t key)
+{
+  if(!key) return NULL;
+
+  dt_pthread_mutex_lock(&gd->clut_lock);
+  for(GList *l = gd->cluts; l; l = g_list_next(l))
+  {
+    dt_iop_lut3d_clut_t *clut = l->data;
+    if(clut->key != key) continue;
+    clut->users++;
+    gd->cluts = g_list_remove_link(gd->cluts, l);
+    gd->cluts = g_list_concat(l, gd->cluts);
+    dt_pthread_mutex_unlock(&gd->clut_lock);
+    return clut;
+  }
+  dt_pthread_mutex_unlock(&gd->clut_lock);
+
+  const double start = dt_get_wtime();
+  float *buf = NULL;
+  const uint16_t level = _calculate_clut(p, &buf);
+  if(!level || !buf)
+  {
+    dt_free_align(buf);
+    return NULL;
+  }
+  dt_print(DT_DEBUG_PERF, "[lut3d] %s: %d^3 lut loaded in %.3fs",
+           p->filepath, level, dt_get_wtime() - start);
+
+  dt_iop_lut3d_clut_t *clut = calloc(1, sizeof(dt_iop_lut3d_clut_t));
+  clut->key = key;
+  clut->clut = buf;
+  clut->level = level;
+  clut->users = 1;
+
+  dt_pthread_mutex_lock(&gd->clut_lock);
+  // another pipe might have loaded the same lut in the meantime
+  for(GList *l = gd->cluts; l; l = g_list_next(l))
+  {
+    dt_iop_lut3d_clut_t *old = l->data;
+    if(old->key != key) continue;
+    old->users++;
+    dt_pthread_mutex_unlock(&gd->clut_lock);
+    _clut_free(clut);
+    return old;
+  }
+
+  gd->cluts = g_list_prepend(gd->cluts, clut);
+  // keep at least the lut just loaded, whatever its size
+  size_t total = 0;
+  for(GList *l = gd->cluts; l; )
+  {
+    dt_iop_lut3d_clut_t *old = l->data;
+    GList *next = g_list_next(l);
+    const size_t size = sizeof(float) * 3 * old->level * old->level * old->level;
+    if(old == clut || total + size <= DT_IOP_LUT3D_CACHE_SIZE)
+      total += size;
+    else
+    {
+      gd->cluts = g_list_delete_link(gd->cluts, l);
+      if(old->users)
+        old->dropped = TRUE;
+      else
+        _clut_free(old);
+    }
+    l = next;
+  }
+  dt_pthread_mutex_unlock(&gd->clut_lock);
+  return clut;
+}
+
+static void _clut_release(dt_iop_lut3d_global_data_t *gd,
+                          dt_iop_lut3d_clut_t *clut)
+{
+  if(!clut) return;
+  dt_pthread_mutex_lock(&gd->clut_lock);
+  const gboolean unused = --clut->users == 0 && clut->dropped;
+  dt_pthread_mutex_unlock(&gd->clut_lock);
+  if(unused) _clut_free(clut);
+}
+
 #ifdef HAVE_GMIC
 static gboolean _list_match_string(GtkTreeModel *model,
                                    GtkTreePath *path,
@@ -1382,15 +1521,15 @@ void commit_params(dt_iop_module_t *self, dt_iop_params_t *p1, dt_dev_pixelpipe_
   dt_iop_lut3d_params_t *p = (dt_iop_lut3d_params_t *)p1;
   dt_iop_lut3d_data_t *d = piece->data;
 
-  if(strcmp(p->filepath, d->params.filepath) != 0 || strcmp(p->lutname, d->params.lutname) != 0 )
+  // also catches the lut file being changed on disk
+  const dt_hash_t key = _clut_key(p);
+  if(key != d->clut_key)
   { // new clut file
-    if(d->clut)
-    { // reset current clut if any
-      dt_free_align(d->clut);
-      d->clut = NULL;
-      d->level = 0;
-    }
-    d->level = _calculate_clut(p, &d->clut);
+    d->clut_key = key;
+    _clut_release(self->global_data, d->shared);
+    d->shared = _clut_acquire(self->global_data, p, key);
+    d->clut = d->shared ? d->shared->clut : NULL;
+    d->level = d->shared ? d->shared->level : 0;
   }
   memcpy(&d->params, p, sizeof(dt_iop_lut3d_params_t));
 }
@@ -1400,6 +1539,8 @@ void init_pipe(dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe, dt_dev_pixelpipe
   piece->data = malloc(sizeof(dt_iop_lut3d_data_t));
   dt_iop_lut3d_data_t *d = piece->data;
   memcpy(&d->params, self->default_params, sizeof(dt_iop_lut3d_params_t));
+  d->clut_key = 0;
+  d->shared = NULL;
   d->clut = NULL;
   d->level = 0;
   d->params.filepath[0] = '\0';
@@ -1407,9 +1548,9 @@ void init_pipe(dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe, dt_dev_pixelpipe
 
 void cleanup_pipe(dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe, dt_dev_pixelpipe_iop_t *piece)
 {
-  dt_iop_lut3d_data_t *d = piece->data;;
-  if(d->clut)
-    dt_free_align(d->clut);
+  dt_iop_lut3d_data_t *d = piece->data;
+  _clut_release(self->global_data, d->shared);
+  d->shared = NULL;
   d->clut = NULL;
   d->level = 0;
   free(piece->data);
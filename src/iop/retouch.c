@@ -94,6 +94,10 @@ typedef struct retouch_user_data_t
   int display_scale;
   gboolean mask_display;
   gboolean suppress_mask;
+  struct dt_iop_retouch_cache_t *cache; // filled while decomposing, see rt_decompose_cached()
+  const dt_hash_t *forms;               // shapes hash of each scale, zero if it has none
+  gboolean cache_failed;
+  gboolean residual_cached;             // the last scale got into the cache
 } retouch_user_data_t;
 
 typedef struct dt_iop_retouch_params_t
@@ -172,7 +176,25 @@ typedef struct dt_iop_retouch_gui_data_t
   GtkWidget *sl_mask_opacity; // draw mask opacity
 } dt_iop_retouch_gui_data_t;
 
-typedef struct dt_iop_retouch_params_t dt_iop_retouch_data_t;
+// wavelet scales of the last input of an interactive pipe. scales without
+// shapes are only kept summed up, scales with shapes both as decomposed and
+// with the shapes applied, so editing the shapes of one scale only
+// reprocesses that scale.
+typedef struct dt_iop_retouch_cache_t
+{
+  dt_hash_t hash; // input, roi, scales, shapes on the image and which scales have shapes
+  int scales;     // scales actually decomposed
+  float *rest;    // sum of the scales without shapes
+  float *layer[RETOUCH_NO_SCALES];
+  float *edited[RETOUCH_NO_SCALES];
+  dt_hash_t forms[RETOUCH_NO_SCALES]; // shapes applied to edited
+} dt_iop_retouch_cache_t;
+
+typedef struct dt_iop_retouch_data_t
+{
+  dt_iop_retouch_params_t params;
+  dt_iop_retouch_cache_t cache;
+} dt_iop_retouch_data_t;
 
 typedef struct dt_iop_retouch_global_data_t
 {
@@ -2273,17 +2295,39 @@ void tiling_callback(dt_iop_module_t *self,
   tiling->align = 1;
 }
 
+void commit_params(dt_iop_module_t *self,
+                   dt_iop_params_t *p1,
+                   dt_dev_pixelpipe_t *pipe,
+                   dt_dev_pixelpipe_iop_t *piece)
+{
+  dt_iop_retouch_data_t *d = piece->data;
+  memcpy(&d->params, p1, sizeof(dt_iop_retouch_params_t));
+}
+
 void init_pipe(dt_iop_module_t *self,
                dt_dev_pixelpipe_t *pipe,
                dt_dev_pixelpipe_iop_t *piece)
 {
-  piece->data = malloc(sizeof(dt_iop_retouch_data_t));
+  piece->data = calloc(1, sizeof(dt_iop_retouch_data_t));
+}
+
+static void rt_cache_free(dt_iop_retouch_cache_t *cache)
+{
+  dt_free_align(cache->rest);
+  for(int s = 0; s < RETOUCH_NO_SCALES; s++)
+  {
+    dt_free_align(cache->layer[s]);
+    dt_free_align(cache->edited[s]);
+  }
+  memset(cache, 0, sizeof(dt_iop_retouch_cache_t));
 }
 
 void cleanup_pipe(dt_iop_module_t *self,
                   dt_dev_pixelpipe_t *pipe,
                   dt_dev_pixelpipe_iop_t *piece)
 {
+  dt_iop_retouch_data_t *d = piece->data;
+  rt_cache_free(&d->cache);
   free(piece->data);
   piece->data = NULL;
 }
@@ -2715,7 +2759,8 @@ static void rt_compute_roi_in(dt_iop_module_t *self,
                               int *_roix,
                               int *_roiy)
 {
-  dt_iop_retouch_params_t *p = piece->data;
+  dt_iop_retouch_data_t *d = piece->data;
+  dt_iop_retouch_params_t *p = &d->params;
   dt_develop_blend_params_t *bp = piece->blendop_data;
 
   int roir = *_roir;
@@ -2852,7 +2897,8 @@ static void rt_extend_roi_in_from_source_clones(dt_iop_module_t *self,
                                                 int *_roix,
                                                 int *_roiy)
 {
-  dt_iop_retouch_params_t *p = piece->data;
+  dt_iop_retouch_data_t *d = piece->data;
+  dt_iop_retouch_params_t *p = &d->params;
   dt_develop_blend_params_t *bp = piece->blendop_data;
 
   int roir = *_roir;
@@ -2951,7 +2997,8 @@ static void rt_extend_roi_in_for_clone(dt_iop_module_t *self,
                                        int *_roix,
                                        int *_roiy)
 {
-  dt_iop_retouch_params_t *p = piece->data;
+  dt_iop_retouch_data_t *d = piece->data;
+  dt_iop_retouch_params_t *p = &d->params;
   dt_develop_blend_params_t *bp = piece->blendop_data;
 
   int roir = *_roir;
@@ -3709,7 +3756,8 @@ static void rt_process_forms(float *layer, dwt_params_t *const wt_p, const int s
   if(scale > wt_p->scales + 1) return;
 
   dt_develop_blend_params_t *bp = piece->blendop_data;
-  dt_iop_retouch_params_t *p = piece->data;
+  dt_iop_retouch_data_t *d = piece->data;
+  dt_iop_retouch_params_t *p = &d->params;
   dt_iop_roi_t *roi_layer = &usr_d->roi;
   const gboolean mask_display = usr_d->mask_display && (scale == usr_d->display_scale);
 
@@ -3890,6 +3938,171 @@ static void rt_process_forms(float *layer, dwt_params_t *const wt_p, const int s
   }
 }
 
+// hash of everything rt_process_forms() applies on scale, zero if there are no shapes
+static dt_hash_t rt_forms_hash(dt_dev_pixelpipe_iop_t *piece,
+                               const dt_iop_retouch_params_t *p,
+                               const int scale)
+{
+  const dt_develop_blend_params_t *bp = piece->blendop_data;
+  const dt_masks_form_t *grp = dt_masks_get_from_id_ext(piece->pipe->forms, bp->mask_id);
+  if(!grp || !(grp->type & DT_MASKS_GROUP)) return 0;
+
+  dt_hash_t hash = DT_INITHASH;
+  gboolean found = FALSE;
+  for(const GList *forms = grp->points; forms; forms = g_list_next(forms))
+  {
+    const dt_masks_point_group_t *grpt = forms->data;
+    if(grpt == NULL) continue;
+    const int index = rt_get_index_from_formid(p, grpt->formid);
+    if(index == -1 || p->rt_forms[index].scale != scale) continue;
+    dt_masks_form_t *form = dt_masks_get_from_id_ext(piece->pipe->forms, grpt->formid);
+    if(form == NULL) continue;
+
+    hash = dt_hash(hash, &grpt->opacity, sizeof(grpt->opacity));
+    hash = dt_hash(hash, &p->rt_forms[index], sizeof(dt_iop_retouch_form_data_t));
+    hash = dt_masks_group_hash(hash, form);
+    found = TRUE;
+  }
+  if(!found) return 0;
+  const dt_heal_solver_t solver = dt_heal_get_solver();
+  hash = dt_hash(hash, &solver, sizeof(solver));
+  return dt_hash(hash, &p->max_heal_iter, sizeof(p->max_heal_iter));
+}
+
+// layer_func filling the cache: shapes on the image are applied as usual, the
+// scales are stored without their shapes
+static void rt_cache_layer(float *layer, dwt_params_t *const wt_p, const int scale)
+{
+  retouch_user_data_t *usr_d = wt_p->user_data;
+  dt_iop_retouch_cache_t *cache = usr_d->cache;
+  const dt_iop_retouch_data_t *d = usr_d->piece->data;
+
+  if(scale == 0)
+  {
+    rt_process_forms(layer, wt_p, scale);
+    return;
+  }
+  // nothing to do with the recomposed image
+  if(scale > wt_p->scales + 1 || usr_d->cache_failed) return;
+
+  // see the residual image index in rt_process_forms()
+  const int rt_scale = scale == wt_p->scales + 1 ? d->params.num_scales + 1 : scale;
+  if(usr_d->forms[rt_scale])
+  {
+    cache->layer[scale] = dt_iop_image_alloc(wt_p->width, wt_p->height, 4);
+    if(cache->layer[scale])
+      dt_iop_image_copy_by_size(cache->layer[scale], layer, wt_p->width, wt_p->height, 4);
+    else
+      usr_d->cache_failed = TRUE;
+  }
+  else
+    dt_iop_image_add_image(cache->rest, layer, wt_p->width, wt_p->height, 4);
+
+  if(scale == wt_p->scales + 1 && !usr_d->cache_failed)
+    usr_d->residual_cached = TRUE;
+}
+
+// decompose and recompose the image using the cache, reprocessing only the
+// scales whose shapes changed. returns FALSE if the cache can't be used,
+// img is then restored from the input.
+static gboolean rt_decompose_cached(dt_iop_module_t *self,
+                                    dt_dev_pixelpipe_iop_t *piece,
+                                    dwt_params_t *dwt_p,
+                                    float *const img,
+                                    const void *const ivoid,
+                                    const dt_iop_roi_t *const roi_in)
+{
+  dt_iop_retouch_data_t *d = piece->data;
+  const dt_iop_retouch_params_t *p = &d->params;
+  dt_iop_retouch_cache_t *cache = &d->cache;
+  retouch_user_data_t *usr_d = dwt_p->user_data;
+  const int width = roi_in->width;
+  const int height = roi_in->height;
+  const double start = dt_get_wtime();
+
+  dt_hash_t forms[RETOUCH_NO_SCALES] = { 0 };
+  for(int s = 0; s <= p->num_scales + 1; s++)
+    forms[s] = rt_forms_hash(piece, p, s);
+
+  dt_hash_t hash = dt_dev_pixelpipe_piece_hash(piece, roi_in, FALSE);
+  hash = dt_hash(hash, &dwt_p->preview_scale, sizeof(dwt_p->preview_scale));
+  hash = dt_hash(hash, &p->num_scales, sizeof(p->num_scales));
+  hash = dt_hash(hash, &forms[0], sizeof(dt_hash_t));
+  for(int s = 1; s <= p->num_scales + 1; s++)
+  {
+    const gboolean shapes = forms[s] != 0;
+    hash = dt_hash(hash, &shapes, sizeof(shapes));
+  }
+
+  const size_t npixels = (size_t)width * height;
+  int reprocessed = 0;
+  if(hash != cache->hash)
+  {
+    rt_cache_free(cache);
+
+    // the scales dwt_decompose() will use and how much we keep of them
+    const int scales = MIN(p->num_scales, dwt_get_max_scale(dwt_p));
+    int with_shapes = 0;
+    for(int s = 1; s <= scales + 1; s++)
+      if(forms[s == scales + 1 ? p->num_scales + 1 : s]) with_shapes++;
+    const size_t needed = sizeof(float) * 4 * npixels * (1 + 2 * with_shapes);
+    if(scales == 0 || needed > dt_get_available_mem() / 4) return FALSE;
+
+    cache->rest = dt_iop_image_alloc(width, height, 4);
+    if(!cache->rest) return FALSE;
+    dt_iop_image_fill(cache->rest, 0.0f, width, height, 4);
+
+    usr_d->cache = cache;
+    usr_d->forms = forms;
+    usr_d->cache_failed = FALSE;
+    usr_d->residual_cached = FALSE;
+    dwt_decompose(dwt_p, rt_cache_layer);
+    // dwt_decompose() stops early if it runs out of memory
+    if(usr_d->cache_failed || !usr_d->residual_cached || dwt_p->scales != scales)
+    {
+      rt_cache_free(cache);
+      dt_iop_image_copy_by_size(img, ivoid, width, height, 4);
+      return FALSE;
+    }
+    cache->hash = hash;
+    cache->scales = scales;
+  }
+  else
+  {
+    // as set by dwt_decompose()
+    dwt_p->scales = cache->scales;
+  }
+
+  dt_iop_image_copy_by_size(img, cache->rest, width, height, 4);
+  for(int s = 1; s <= cache->scales + 1; s++)
+  {
+    if(!cache->layer[s]) continue;
+
+    const int rt_scale = s == cache->scales + 1 ? p->num_scales + 1 : s;
+    if(!cache->edited[s] || cache->forms[s] != forms[rt_scale])
+    {
+      if(!cache->edited[s])
+        cache->edited[s] = dt_iop_image_alloc(width, height, 4);
+      if(!cache->edited[s])
+      {
+        rt_cache_free(cache);
+        dt_iop_image_copy_by_size(img, ivoid, width, height, 4);
+        return FALSE;
+      }
+      dt_iop_image_copy_by_size(cache->edited[s], cache->layer[s], width, height, 4);
+      rt_process_forms(cache->edited[s], dwt_p, s);
+      cache->forms[s] = forms[rt_scale];
+      reprocessed++;
+    }
+    dt_iop_image_add_image(img, cache->edited[s], width, height, 4);
+  }
+
+  dt_print_pipe(DT_DEBUG_PIPE | DT_DEBUG_PERF, "retouch cache", piece->pipe, self, DT_DEVICE_CPU,
+                roi_in, NULL, "%d of %d scales reprocessed in %.3fs",
+                reprocessed, cache->scales + 1, dt_get_wtime() - start);
+  return TRUE;
+}
+
 void process(dt_iop_module_t *self,
              dt_dev_pixelpipe_iop_t *piece,
              const void *const ivoid,
@@ -3902,7 +4115,8 @@ void process(dt_iop_module_t *self,
                                         ivoid, ovoid, roi_in, roi_out))
     return;
 
-  dt_iop_retouch_params_t *p = piece->data;
+  dt_iop_retouch_data_t *d = piece->data;
+  dt_iop_retouch_params_t *p = &d->params;
   dt_iop_retouch_gui_data_t *g = self->gui_data;
 
   float *in_retouch = NULL;
@@ -3975,8 +4189,19 @@ void process(dt_iop_module_t *self,
     if(g) g->first_scale_visible = dt_dwt_first_scale_visible(dwt_p);
   }
 
+  // interactive pipes keep the scales for the next run if the image is
+  // recomposed without any special display
+  const gboolean cached = dt_pipe_is_screen(piece->pipe)
+    && !piece->pipe->tiling
+    && !usr_data.mask_display
+    && !usr_data.suppress_mask
+    && dwt_p->return_layer == 0
+    && p->merge_from_scale == 0
+    && p->num_scales > 0;
+
   // decompose it
-  dwt_decompose(dwt_p, rt_process_forms);
+  if(!cached || !rt_decompose_cached(self, piece, dwt_p, in_retouch, ivoid, roi_in))
+    dwt_decompose(dwt_p, rt_process_forms);
 
   dt_aligned_pixel_t levels = { p->preview_levels[0],
                                 p->preview_levels[1],
@@ -4502,7 +4727,8 @@ static cl_int rt_process_forms_cl(cl_mem dev_layer,
   if(scale > wt_p->scales + 1) return err;
 
   dt_develop_blend_params_t *bp = piece->blendop_data;
-  dt_iop_retouch_params_t *p = piece->data;
+  dt_iop_retouch_data_t *d = piece->data;
+  dt_iop_retouch_params_t *p = &d->params;
   dt_iop_retouch_global_data_t *gd = self->global_data;
   const int devid = piece->pipe->devid;
   dt_iop_roi_t *roi_layer = &usr_d->roi;
@@ -4719,7 +4945,8 @@ int process_cl(dt_iop_module_t *self,
                const dt_iop_roi_t *const roi_in,
                const dt_iop_roi_t *const roi_out)
 {
-  dt_iop_retouch_params_t *p = piece->data;
+  dt_iop_retouch_data_t *d = piece->data;
+  dt_iop_retouch_params_t *p = &d->params;
   dt_iop_retouch_global_data_t *gd = self->global_data;
   dt_iop_retouch_gui_data_t *g = self->gui_data;
 
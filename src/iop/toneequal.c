@@ -96,6 +96,7 @@
 #include "bauhaus/bauhaus.h"
 #include "common/darktable.h"
 #include "common/fast_guided_filter.h"
+#include "common/guided_filter_cache.h"
 #include "common/eigf.h"
 #include "common/interpolation.h"
 #include "common/luminance_mask.h"
@@ -939,6 +940,37 @@ static inline void compute_luminance_mask(const float *const restrict in,
   }
 }
 
+
+// The mask doesn't depend on the correction nodes so keep the filtered one
+// while they are adjusted, all darkroom pipes share it.
+static void _get_luminance_mask(dt_dev_pixelpipe_iop_t *piece,
+                                const dt_iop_roi_t *const roi_in,
+                                const float *const restrict in,
+                                float *const restrict luminance,
+                                const size_t width,
+                                const size_t height,
+                                const dt_iop_toneequalizer_data_t *const d)
+{
+  if(d->details == DT_TONEEQ_NONE)
+  {
+    compute_luminance_mask(in, luminance, width, height, d);
+    return;
+  }
+
+  const struct
+  {
+    float feathering, contrast_boost, exposure_boost, quantization, scale;
+    int radius, iterations, method, details;
+  } mask_params = { d->feathering, d->contrast_boost, d->exposure_boost, d->quantization,
+                    d->scale, d->radius, d->iterations, d->method, d->details };
+
+  const dt_hash_t key = dt_guided_filter_cache_key(piece, roi_in, &mask_params, sizeof(mask_params));
+  if(dt_guided_filter_cache_get(key, luminance, width * height)) return;
+
+  compute_luminance_mask(in, luminance, width, height, d);
+  dt_guided_filter_cache_put(key, luminance, width * height);
+}
+
 /***
  * Actual transfer functions
  **/
@@ -1110,7 +1142,7 @@ void toneeq_process(dt_iop_module_t *self,
       if(hash != saved_hash || !luminance_valid)
       {
         /* compute only if upstream pipe state has changed */
-        compute_luminance_mask(in, luminance, width, height, d);
+        _get_luminance_mask(piece, roi_in, in, luminance, width, height, d);
         hash_set_get(&hash, &g->ui_preview_hash, &self->gui_lock);
       }
     }
@@ -1129,7 +1161,7 @@ void toneeq_process(dt_iop_module_t *self,
         dt_iop_gui_enter_critical_section(self);
         g->thumb_preview_hash = hash;
         g->histogram_valid = FALSE;
-        compute_luminance_mask(in, luminance, width, height, d);
+        _get_luminance_mask(piece, roi_in, in, luminance, width, height, d);
         g->luminance_valid = TRUE;
         dt_iop_gui_leave_critical_section(self);
         dt_dev_pixelpipe_cache_invalidate_later(piece->pipe, self->iop_order, "toneequal: ");
@@ -1137,13 +1169,13 @@ void toneeq_process(dt_iop_module_t *self,
     }
     else // make it dummy-proof
     {
-      compute_luminance_mask(in, luminance, width, height, d);
+      _get_luminance_mask(piece, roi_in, in, luminance, width, height, d);
     }
   }
   else
   {
-    // no caching path : compute no matter what
-    compute_luminance_mask(in, luminance, width, height, d);
+    // no gui buffers : compute unless the shared cache has it
+    _get_luminance_mask(piece, roi_in, in, luminance, width, height, d);
   }
 
   // Display output
@@ -0,0 +1,424 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * darktable-bench-iop: time the process() function of a single module.
+ *
+ * The module is instantiated on its own, outside of any history, with
+ * either its default parameters or the ones of a preset. It is fed with a
+ * synthetic test image (see ../unittests/util/testimg.h) or a PFM file and
+ * process() is run repeatedly for each requested thread count. Results are
+ * written as JSON with median and 95th percentile time and throughput.
+ *
+ * Please see README.txt for usage.
+ */
+
+#include "common/darktable.h"
+#include "common/database.h"
+#include "common/debug.h"
+#include "common/iop_profile.h"
+#include "common/pfm.h"
+#include "develop/develop.h"
+#include "develop/imageop.h"
+#include "develop/imageop_math.h"
+#include "develop/pixelpipe.h"
+
+#include "../unittests/util/testimg.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+#define BENCH_MAX_THREADCOUNTS 32
+#define BENCH_MAX_PARAMS 16
+
+typedef struct bench_opts_t
+{
+  const char *op;
+  const char *preset;
+  const char *input;
+  const char *output;
+  int width;
+  int height;
+  int runs;
+  int threads[BENCH_MAX_THREADCOUNTS];
+  int nthreads;
+  const char *params[BENCH_MAX_PARAMS];
+  int nparams;
+} bench_opts_t;
+
+static int _usage(const char *argv0)
+{
+  fprintf(stderr,
+          "usage: %s MODULE [options] [-- darktable options]\n\n"
+          "  --preset NAME       use the parameters of a preset instead of the defaults\n"
+          "  --param NAME=VALUE  set a single parameter, may be repeated\n"
+          "  --size WxH          size of the synthetic input (default 4000x3000)\n"
+          "  --input FILE.pfm    use a PFM image as input\n"
+          "  --threads N[,N...]  thread counts to benchmark (default all threads)\n"
+          "  --runs N            timed repetitions per thread count (default 20)\n"
+          "  --output FILE       write JSON to FILE instead of stdout\n",
+          argv0);
+  return 1;
+}
+
+static int _compare_double(const void *a, const void *b)
+{
+  const double da = *(const double *)a;
+  const double db = *(const double *)b;
+  return (da > db) - (da < db);
+}
+
+static gboolean _load_preset(dt_iop_module_t *module,
+                             const char *preset)
+{
+  sqlite3_stmt *stmt;
+  gboolean found = FALSE;
+  // clang-format off
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "SELECT op_params, op_version"
+                              " FROM data.presets"
+                              " WHERE operation = ?1 AND name = ?2",
+                              -1, &stmt, NULL);
+  // clang-format on
+  DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 1, module->op, -1, SQLITE_TRANSIENT);
+  DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 2, preset, -1, SQLITE_TRANSIENT);
+  if(sqlite3_step(stmt) == SQLITE_ROW)
+  {
+    const void *params = sqlite3_column_blob(stmt, 0);
+    const int size = sqlite3_column_bytes(stmt, 0);
+    const int version = sqlite3_column_int(stmt, 1);
+    if(version == module->version() && size == module->params_size)
+    {
+      memcpy(module->params, params, size);
+      found = TRUE;
+    }
+    else
+      fprintf(stderr, "[bench] preset '%s' of '%s' has outdated params\n",
+              preset, module->op);
+  }
+  sqlite3_finalize(stmt);
+  return found;
+}
+
+// set a parameter by its introspection name. enums take the name or
+// description of a value as well as a number.
+static gboolean _set_param(dt_iop_module_t *module,
+                           const char *assignment)
+{
+  gchar **kv = g_strsplit(assignment, "=", 2);
+  gboolean ok = FALSE;
+  dt_introspection_field_t *f = kv[0] && kv[1] ? module->so->get_f(kv[0]) : NULL;
+  void *p = f ? module->so->get_p(module->params, kv[0]) : NULL;
+  if(p)
+  {
+    const char *value = kv[1];
+    ok = TRUE;
+    switch(f->header.type)
+    {
+      case DT_INTROSPECTION_TYPE_FLOAT:
+        *(float *)p = g_ascii_strtod(value, NULL);
+        break;
+      case DT_INTROSPECTION_TYPE_INT:
+        *(int *)p = atoi(value);
+        break;
+      case DT_INTROSPECTION_TYPE_UINT:
+        *(unsigned int *)p = strtoul(value, NULL, 0);
+        break;
+      case DT_INTROSPECTION_TYPE_BOOL:
+        *(gboolean *)p = !g_ascii_strcasecmp(value, "true") || atoi(value);
+        break;
+      case DT_INTROSPECTION_TYPE_ENUM:
+      {
+        char *end;
+        int v = strtol(value, &end, 0);
+        if(*end)
+        {
+          ok = FALSE;
+          for(dt_introspection_type_enum_tuple_t *e = f->Enum.values; e && e->name; e++)
+            if(!g_ascii_strcasecmp(value, e->name)
+               || (e->description && !g_ascii_strcasecmp(value, e->description)))
+            {
+              v = e->value;
+              ok = TRUE;
+              break;
+            }
+        }
+        if(ok) *(int *)p = v;
+        break;
+      }
+      default:
+        ok = FALSE;
+    }
+  }
+  if(!ok)
+    fprintf(stderr, "[bench] can't set parameter '%s' of '%s'\n", assignment, module->op);
+  g_strfreev(kv);
+  return ok;
+}
+
+static int _run(const bench_opts_t *opts, FILE *out)
+{
+  dt_iop_module_so_t *so = dt_iop_get_module_so(opts->op);
+  if(!so)
+  {
+    fprintf(stderr, "[bench] unknown module '%s'\n", opts->op);
+    return 1;
+  }
+
+  // input image, either synthetic or from file
+  int width = opts->width;
+  int height = opts->height;
+  float *rgba = NULL;
+  if(opts->input)
+  {
+    int err = 0, ch = 0;
+    rgba = dt_read_pfm(opts->input, &err, &width, &height, &ch, 4);
+    if(!rgba)
+    {
+      fprintf(stderr, "[bench] can't read '%s'\n", opts->input);
+      return 1;
+    }
+  }
+  else
+  {
+    Testimg *ti = testimg_gen_bench(width, height);
+    rgba = dt_alloc_align_float((size_t)4 * width * height);
+    if(rgba) memcpy(rgba, ti->pixels, sizeof(float) * 4 * width * height);
+    testimg_free(ti);
+    if(!rgba) return 1;
+  }
+
+  dt_develop_t dev;
+  dt_dev_init(&dev, FALSE);
+
+  dt_dev_pixelpipe_t pipe;
+  dt_dev_pixelpipe_init_dummy(&pipe, width, height);
+  pipe.type = DT_DEV_PIXELPIPE_EXPORT;
+  pipe.iwidth = width;
+  pipe.iheight = height;
+  pipe.work_profile_info =
+    dt_ioppr_set_pipe_work_profile_info(&dev, &pipe, DT_COLORSPACE_LIN_REC2020,
+                                        "", DT_INTENT_PERCEPTUAL);
+
+  dt_iop_module_t *module = calloc(1, sizeof(dt_iop_module_t));
+  if(dt_iop_load_module(module, so, &dev))
+  {
+    fprintf(stderr, "[bench] can't load module '%s'\n", opts->op);
+    dt_dev_pixelpipe_cleanup(&pipe);
+    dt_dev_cleanup(&dev);
+    dt_free_align(rgba);
+    return 1;
+  }
+  if(opts->preset && !_load_preset(module, opts->preset))
+    fprintf(stderr, "[bench] preset '%s' not found, using defaults\n", opts->preset);
+  for(int k = 0; k < opts->nparams; k++)
+    _set_param(module, opts->params[k]);
+
+  dt_dev_pixelpipe_iop_t piece = { 0 };
+  piece.module = module;
+  piece.pipe = &pipe;
+  piece.enabled = TRUE;
+  piece.iscale = 1.0f;
+  piece.iwidth = width;
+  piece.iheight = height;
+  dt_iop_init_pipe(module, &pipe, &piece);
+
+  // raw modules get a bayer mosaic of the test image
+  const gboolean raw = module->input_colorspace(module, &pipe, &piece) == IOP_CS_RAW;
+  pipe.dsc.channels = raw ? 1 : 4;
+  pipe.dsc.datatype = TYPE_FLOAT;
+  pipe.dsc.filters = raw ? 0x94949494u : 0u;
+  pipe.dsc.cst = module->input_colorspace(module, &pipe, &piece);
+  for_four_channels(c)
+    pipe.dsc.processed_maximum[c] = pipe.dsc.temperature.coeffs[c] = 1.0f;
+  piece.dsc_in = piece.dsc_out = pipe.dsc;
+  piece.colors = pipe.dsc.channels;
+
+  dt_iop_commit_params(module, module->params, module->default_blendop_params,
+                       &pipe, &piece);
+  piece.buf_in = (dt_iop_roi_t){ 0, 0, width, height, 1.0f };
+  if(module->output_format)
+    module->output_format(module, &pipe, &piece, &piece.dsc_out);
+
+  const dt_iop_roi_t roi_out = { 0, 0, width, height, 1.0f };
+  dt_iop_roi_t roi_in = roi_out;
+  module->modify_roi_in(module, &piece, &roi_out, &roi_in);
+
+  const size_t in_ch = pipe.dsc.channels;
+  const size_t out_ch = piece.dsc_out.channels;
+  float *in = dt_alloc_align_float(in_ch * roi_in.width * roi_in.height);
+  float *img = dt_alloc_align_float(in_ch * roi_in.width * roi_in.height);
+  float *o = dt_alloc_align_float(out_ch * roi_out.width * roi_out.height);
+  double *times = calloc(opts->runs, sizeof(double));
+  int res = 0;
+  if(!in || !img || !o || !times)
+  {
+    fprintf(stderr, "[bench] out of memory\n");
+    res = 1;
+    goto cleanup;
+  }
+
+  // the input region may differ from the output for distorting modules,
+  // sample the source image for it. raw modules get a bayer mosaic.
+  for(int row = 0; row < roi_in.height; row++)
+    for(int col = 0; col < roi_in.width; col++)
+    {
+      const size_t sr = CLAMP(row + roi_in.y, 0, height - 1);
+      const size_t sc = CLAMP(col + roi_in.x, 0, width - 1);
+      const float *const px = rgba + (sr * width + sc) * 4;
+      const size_t k = (size_t)row * roi_in.width + col;
+      if(raw)
+        img[k] = px[FC(row + roi_in.y, col + roi_in.x, pipe.dsc.filters)];
+      else
+        for_four_channels(c)
+          img[4 * k + c] = px[c];
+    }
+
+  const double mpix = (double)roi_out.width * roi_out.height / 1.0e6;
+  fprintf(out,
+          "{\n  \"module\": \"%s\",\n  \"preset\": \"%s\",\n  \"params\": [",
+          module->op, opts->preset ? opts->preset : "");
+  for(int k = 0; k < opts->nparams; k++)
+    fprintf(out, "%s\"%s\"", k ? ", " : " ", opts->params[k]);
+  fprintf(out,
+          "%s],\n  \"input\": \"%s\",\n  \"width\": %d,\n  \"height\": %d,\n"
+          "  \"runs\": %d,\n  \"results\": [\n",
+          opts->nparams ? " " : "",
+          opts->input ? opts->input : "synthetic",
+          roi_out.width, roi_out.height, opts->runs);
+
+  for(int t = 0; t < opts->nthreads; t++)
+  {
+    const int nthreads = CLAMP(opts->threads[t], 1, (int)dt_get_num_threads());
+#ifdef _OPENMP
+    omp_set_num_threads(nthreads);
+#endif
+    // one untimed run to warm up caches and lazily allocated module data
+    memcpy(in, img, sizeof(float) * in_ch * roi_in.width * roi_in.height);
+    module->process(module, &piece, in, o, &roi_in, &roi_out);
+
+    for(int r = 0; r < opts->runs; r++)
+    {
+      // some modules work in place on their input
+      memcpy(in, img, sizeof(float) * in_ch * roi_in.width * roi_in.height);
+      const double start = dt_get_wtime();
+      module->process(module, &piece, in, o, &roi_in, &roi_out);
+      times[r] = dt_get_wtime() - start;
+    }
+
+    qsort(times, opts->runs, sizeof(double), _compare_double);
+    const double median = opts->runs & 1
+      ? times[opts->runs / 2]
+      : 0.5 * (times[opts->runs / 2 - 1] + times[opts->runs / 2]);
+    const int p95 = MIN(opts->runs - 1, (int)ceil(0.95 * opts->runs) - 1);
+
+    fprintf(out,
+            "    { \"threads\": %d, \"median\": %.6f, \"p95\": %.6f,"
+            " \"min\": %.6f, \"mpix_per_s\": %.3f }%s\n",
+            nthreads, median, times[MAX(0, p95)], times[0],
+            median > 0.0 ? mpix / median : 0.0,
+            t < opts->nthreads - 1 ? "," : "");
+  }
+  fprintf(out, "  ]\n}\n");
+
+cleanup:
+  free(times);
+  dt_free_align(o);
+  dt_free_align(img);
+  dt_free_align(in);
+  dt_free_align(rgba);
+  module->cleanup_pipe(module, &pipe, &piece);
+  free(piece.blendop_data);
+  dt_iop_cleanup_module(module);
+  free(module);
+  dt_dev_pixelpipe_cleanup(&pipe);
+  dt_dev_cleanup(&dev);
+  return res;
+}
+
+int main(int argc, char *argv[])
+{
+  if(argc < 2 || argv[1][0] == '-') return _usage(argv[0]);
+
+  bench_opts_t opts = { .op = argv[1], .width = 4000, .height = 3000, .runs = 20 };
+
+  int k = 2;
+  for(; k < argc; k++)
+  {
+    if(!strcmp(argv[k], "--")) { k++; break; }
+    else if(!strcmp(argv[k], "--preset") && k + 1 < argc)
+      opts.preset = argv[++k];
+    else if(!strcmp(argv[k], "--param") && k + 1 < argc && opts.nparams < BENCH_MAX_PARAMS)
+      opts.params[opts.nparams++] = argv[++k];
+    else if(!strcmp(argv[k], "--input") && k + 1 < argc)
+      opts.input = argv[++k];
+    else if(!strcmp(argv[k], "--output") && k + 1 < argc)
+      opts.output = argv[++k];
+    else if(!strcmp(argv[k], "--runs") && k + 1 < argc)
+      opts.runs = MAX(1, atoi(argv[++k]));
+    else if(!strcmp(argv[k], "--size") && k + 1 < argc)
+    {
+      if(sscanf(argv[++k], "%dx%d", &opts.width, &opts.height) != 2
+         || opts.width < 8 || opts.height < 8)
+        return _usage(argv[0]);
+    }
+    else if(!strcmp(argv[k], "--threads") && k + 1 < argc)
+    {
+      gchar **list = g_strsplit(argv[++k], ",", BENCH_MAX_THREADCOUNTS);
+      for(int i = 0; list[i]; i++)
+        opts.threads[opts.nthreads++] = MAX(1, atoi(list[i]));
+      g_strfreev(list);
+    }
+    else
+      return _usage(argv[0]);
+  }
+
+  // run darktable without gui and without touching the user's library
+  char *m_arg[64];
+  int m_argc = 0;
+  m_arg[m_argc++] = argv[0];
+  m_arg[m_argc++] = "--library";
+  m_arg[m_argc++] = ":memory:";
+  m_arg[m_argc++] = "--conf";
+  m_arg[m_argc++] = "write_sidecar_files=never";
+  for(; k < argc && m_argc < 63; k++) m_arg[m_argc++] = argv[k];
+  m_arg[m_argc] = NULL;
+
+  if(dt_init(m_argc, m_arg, FALSE, TRUE, NULL)) exit(1);
+
+  if(!opts.nthreads)
+    opts.threads[opts.nthreads++] = dt_get_num_threads();
+
+  FILE *out = opts.output ? g_fopen(opts.output, "w") : stdout;
+  const int res = out ? _run(&opts, out) : 1;
+  if(out && out != stdout) fclose(out);
+
+  dt_cleanup();
+  return res;
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -0,0 +1,149 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * The bilateral grid is splatted either in alternating stripes straight
+ * into the grid or into private slabs merged afterwards, depending on the
+ * number of threads and the grid row height. Compare both to the plain
+ * pixel by pixel splat for several thread counts, with slices that don't
+ * divide the image height evenly.
+ */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <math.h>
+
+#include <cmocka.h>
+
+#include "../util/assert.h"
+#include "../util/tracing.h"
+#include "../util/testimg.h"
+
+#include "common/bilateral.c"
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+// the same contributions are added in a different order
+#define E 1e-5f
+
+// every pixel in raster order into the final grid
+static void _reference_splat(const dt_bilateral_t *const b,
+                             const float *const in,
+                             float *const grid)
+{
+  const size_t ox = b->size_z;
+  const size_t oy = b->size_x * b->size_z;
+  const size_t oz = 1;
+  const size_t offsets[8] = { 0, ox, oy, oy + ox, oz, oz + ox, oz + oy, oz + oy + ox };
+  const float sigma_s = b->sigma_s * b->sigma_s;
+
+  for(int j = 0; j < b->height; j++)
+  {
+    for(int i = 0; i < b->width; i++)
+    {
+      float xf, yf, zf;
+      const size_t index = 4 * ((size_t)j * b->width + i);
+      const size_t grid_index = image_to_grid(b, i, j, in[index], &xf, &yf, &zf);
+      const float contrib[4] = { (1.0f - xf) * (1.0f - yf) * 100.0f / sigma_s,
+                                 xf * (1.0f - yf) * 100.0f / sigma_s,
+                                 (1.0f - xf) * yf * 100.0f / sigma_s,
+                                 xf * yf * 100.0f / sigma_s };
+      for(int k = 0; k < 4; k++)
+      {
+        grid[grid_index + offsets[k]] += contrib[k] * (1.0f - zf);
+        grid[grid_index + offsets[k + 4]] += contrib[k] * zf;
+      }
+    }
+  }
+}
+
+static void _compare_splat(const int width,
+                           const int height,
+                           const float sigma_s,
+                           const int nthreads,
+                           const gboolean stripes)
+{
+  Testimg *ti = testimg_gen_bench(width, height);
+  // L in the first channel, beyond the grid range too
+  for(size_t k = 0; k < (size_t)width * height; k++)
+    ti->pixels[4 * k] = 110.0f * ti->pixels[4 * k] - 5.0f;
+
+  dt_bilateral_t *b = dt_bilateral_init(width, height, sigma_s, 10.0f);
+  assert_non_null(b);
+
+  // lay out the slices as for nthreads threads, the splat runs on as many as there are
+  dt_free_align(b->buf);
+  _splat_slices(b, height, nthreads, &b->numslices, &b->sliceheight, &b->stripes);
+  b->slicerows = b->stripes ? b->size_y : (b->size_y + b->numslices - 1) / b->numslices + 2;
+  b->buf = dt_calloc_align_float(b->size_x * b->size_z * _splat_grid_rows(b, height, nthreads));
+  assert_non_null(b->buf);
+  assert_int_equal(b->stripes, stripes);
+
+  const size_t size = b->size_x * b->size_y * b->size_z;
+  float *ref = dt_calloc_align_float(size);
+  assert_non_null(ref);
+  _reference_splat(b, ti->pixels, ref);
+
+  const double start = dt_get_wtime();
+  dt_bilateral_splat(b, ti->pixels);
+  TR_DEBUG("%dx%d, sigma %.1f, %d %s: %.4fs", width, height, b->sigma_s,
+           b->numslices, b->stripes ? "stripes" : "slabs", dt_get_wtime() - start);
+
+  for(size_t k = 0; k < size; k++)
+    assert_float_equal(b->buf[k], ref[k], E * fmaxf(1.0f, fabsf(ref[k])));
+
+  dt_free_align(ref);
+  dt_bilateral_free(b);
+  testimg_free(ti);
+}
+
+static void test_splat_stripes(void **state)
+{
+  _compare_splat(400, 300, 8.0f, 4, TRUE);
+  _compare_splat(333, 301, 4.0f, 7, TRUE);
+  _compare_splat(97, 500, 2.5f, 16, TRUE);
+}
+
+static void test_splat_slabs(void **state)
+{
+  _compare_splat(400, 300, 32.0f, 4, FALSE);
+  _compare_splat(333, 301, 8.0f, 7, FALSE);
+  _compare_splat(400, 300, 8.0f, 1, FALSE);
+  _compare_splat(64, 20, 2.0f, 16, FALSE);
+}
+
+/*
+ * MAIN FUNCTION
+ */
+int main(int argc, char* argv[])
+{
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_splat_stripes),
+    cmocka_unit_test(test_splat_slabs)
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
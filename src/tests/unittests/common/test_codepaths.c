@@ -0,0 +1,220 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * The hot pixel kernels are built for several instruction sets and the
+ * best one is picked at load time (see __DT_CLONE_TARGETS__). These tests
+ * make sure the paths agree:
+ *
+ *  - the inline colorspace conversions are instantiated here once per
+ *    instruction set available on the test machine and compared to the
+ *    baseline build,
+ *  - the dispatched box filter is compared to a plain scalar reference.
+ */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <math.h>
+
+#include <cmocka.h>
+
+#include "../util/assert.h"
+#include "../util/tracing.h"
+
+#include "common/box_filters.h"
+#include "common/colorspaces_inline_conversions.h"
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+#define NPIX 4096
+
+// relative tolerance between paths, fma contraction and different
+// reduction orders may change the last bits
+#define E 2e-5f
+
+static void _fill(float *const buf, const size_t n, uint32_t seed)
+{
+  for(size_t k = 0; k < n; k++)
+  {
+    seed = seed * 1664525u + 1013904223u;
+    buf[k] = (float)(seed >> 8) / (float)(1 << 24);
+  }
+}
+
+static void _assert_close(const float *const a, const float *const b, const size_t n)
+{
+  for(size_t k = 0; k < n; k++)
+  {
+    const float tol = E * fmaxf(1.0f, fabsf(b[k]));
+    if(fabsf(a[k] - b[k]) > tol)
+      TR_DEBUG("mismatch at %zu: %e vs %e", k, a[k], b[k]);
+    assert_float_equal(a[k], b[k], tol);
+  }
+}
+
+#define CONVERSIONS(suffix, attr)                                             \
+  attr static void _conversions_##suffix(const float *const in,               \
+                                         float *const out)                    \
+  {                                                                           \
+    for(size_t k = 0; k < NPIX; k++)                                          \
+    {                                                                         \
+      dt_aligned_pixel_t px, tmp, Lab, XYZ, Jz, HSL;                          \
+      for_four_channels(c) px[c] = in[4 * k + c];                             \
+      dt_XYZ_to_Lab(px, Lab);                                                 \
+      dt_Lab_to_XYZ(Lab, XYZ);                                                \
+      dt_XYZ_2_JzAzBz(px, Jz);                                                \
+      dt_XYZ_to_sRGB(px, tmp);                                                \
+      dt_RGB_2_HSL(px, HSL);                                                  \
+      for(int c = 0; c < 3; c++)                                              \
+      {                                                                       \
+        out[16 * k + c] = Lab[c];                                             \
+        out[16 * k + 3 + c] = XYZ[c];                                         \
+        out[16 * k + 6 + c] = Jz[c];                                          \
+        out[16 * k + 9 + c] = tmp[c];                                         \
+        out[16 * k + 12 + c] = HSL[c];                                        \
+      }                                                                       \
+      out[16 * k + 15] = 0.0f;                                                \
+    }                                                                         \
+  }
+
+CONVERSIONS(default, )
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define HAVE_X86_PATHS
+CONVERSIONS(sse41, __attribute__((target("sse4.1"))))
+CONVERSIONS(avx2, __attribute__((target("avx2,fma"))))
+CONVERSIONS(avx512, __attribute__((target("avx512f,avx2,fma"))))
+#endif
+
+static void test_colorspace_paths(void **state)
+{
+  float *in = dt_alloc_align_float(4 * NPIX);
+  float *ref = dt_alloc_align_float(16 * NPIX);
+  float *out = dt_alloc_align_float(16 * NPIX);
+  assert_non_null(in);
+  assert_non_null(ref);
+  assert_non_null(out);
+
+  _fill(in, 4 * NPIX, 4711);
+  _conversions_default(in, ref);
+
+#ifdef HAVE_X86_PATHS
+  __builtin_cpu_init();
+  if(__builtin_cpu_supports("sse4.1"))
+  {
+    TR_DEBUG("comparing sse4.1 path");
+    _conversions_sse41(in, out);
+    _assert_close(out, ref, 16 * NPIX);
+  }
+  if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+  {
+    TR_DEBUG("comparing avx2 path");
+    _conversions_avx2(in, out);
+    _assert_close(out, ref, 16 * NPIX);
+  }
+  if(__builtin_cpu_supports("avx512f"))
+  {
+    TR_DEBUG("comparing avx512f path");
+    _conversions_avx512(in, out);
+    _assert_close(out, ref, 16 * NPIX);
+  }
+#endif
+
+  dt_free_align(out);
+  dt_free_align(ref);
+  dt_free_align(in);
+}
+
+// one iteration of a box mean with the window clipped at the borders
+static void _box_mean_reference(const float *const in,
+                                float *const out,
+                                const int height,
+                                const int width,
+                                const int ch,
+                                const int radius)
+{
+  float *tmp = dt_alloc_align_float((size_t)height * width * ch);
+  for(int y = 0; y < height; y++)
+    for(int x = 0; x < width; x++)
+      for(int c = 0; c < ch; c++)
+      {
+        double sum = 0.0;
+        int hits = 0;
+        for(int i = MAX(0, x - radius); i <= MIN(width - 1, x + radius); i++, hits++)
+          sum += in[((size_t)y * width + i) * ch + c];
+        tmp[((size_t)y * width + x) * ch + c] = sum / hits;
+      }
+  for(int y = 0; y < height; y++)
+    for(int x = 0; x < width; x++)
+      for(int c = 0; c < ch; c++)
+      {
+        double sum = 0.0;
+        int hits = 0;
+        for(int j = MAX(0, y - radius); j <= MIN(height - 1, y + radius); j++, hits++)
+          sum += tmp[((size_t)j * width + x) * ch + c];
+        out[((size_t)y * width + x) * ch + c] = sum / hits;
+      }
+  dt_free_align(tmp);
+}
+
+static void test_box_mean_dispatched(void **state)
+{
+  const int width = 97, height = 61, radius = 5;
+  const int channels[] = { 1, 4 };
+
+  for(int n = 0; n < 2; n++)
+  {
+    const int ch = channels[n];
+    const size_t size = (size_t)width * height * ch;
+    float *buf = dt_alloc_align_float(size);
+    float *ref = dt_alloc_align_float(size);
+    assert_non_null(buf);
+    assert_non_null(ref);
+
+    _fill(buf, size, 42 + ch);
+    _box_mean_reference(buf, ref, height, width, ch, radius);
+    dt_box_mean(buf, height, width, ch, radius, 1);
+    _assert_close(buf, ref, size);
+
+    dt_free_align(ref);
+    dt_free_align(buf);
+  }
+}
+
+/*
+ * MAIN FUNCTION
+ */
+int main(int argc, char* argv[])
+{
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_colorspace_paths),
+    cmocka_unit_test(test_box_mean_dispatched)
+  };
+
+  TR_DEBUG("epsilon = %e", E);
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
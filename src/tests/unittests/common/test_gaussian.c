@@ -0,0 +1,200 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * The recursive gaussian runs on several columns and rows at once and
+ * transposes tiles of rows for the horizontal pass. Compare it to the
+ * plain pixel by pixel filter for every channel count and order, with
+ * sizes which leave partial blocks and tiles, clamping included.
+ */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <math.h>
+
+#include <cmocka.h>
+
+#include "../util/assert.h"
+#include "../util/tracing.h"
+#include "../util/testimg.h"
+
+#include "common/gaussian.c"
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+// same operations in the same order, only fma contraction may differ
+#define E 1e-5f
+
+// one pass of the filter along n values stride floats apart
+static void _reference_line(const float *const in,
+                            float *const out,
+                            const int n,
+                            const size_t stride,
+                            const float mn,
+                            const float mx,
+                            const float *const c)
+{
+  const float a0 = c[0], a1 = c[1], a2 = c[2], a3 = c[3];
+  const float b1 = c[4], b2 = c[5], coefp = c[6], coefn = c[7];
+
+  float xp = CLAMPF(in[0], mn, mx);
+  float yb = xp * coefp;
+  float yp = yb;
+  for(int j = 0; j < n; j++)
+  {
+    const float xc = CLAMPF(in[j * stride], mn, mx);
+    const float yc = (a0 * xc) + (a1 * xp) - (b1 * yp) - (b2 * yb);
+    out[j * stride] = yc;
+    xp = xc;
+    yb = yp;
+    yp = yc;
+  }
+
+  float xn = CLAMPF(in[(n - 1) * stride], mn, mx);
+  float xa = xn;
+  float yn = xn * coefn;
+  float ya = yn;
+  for(int j = n - 1; j >= 0; j--)
+  {
+    const float xc = CLAMPF(in[j * stride], mn, mx);
+    const float yc = (a2 * xn) + (a3 * xa) - (b1 * yn) - (b2 * ya);
+    xa = xn;
+    xn = xc;
+    ya = yn;
+    yn = yc;
+    out[j * stride] += yc;
+  }
+}
+
+static void _reference(const float *const in,
+                       float *const out,
+                       const int width,
+                       const int height,
+                       const int ch,
+                       const float *const min,
+                       const float *const max,
+                       const float sigma,
+                       const int order)
+{
+  float c[8];
+  _compute_gauss_params(sigma, order, &c[0], &c[1], &c[2], &c[3], &c[4], &c[5], &c[6], &c[7]);
+  float *temp = dt_alloc_align_float((size_t)width * height * ch);
+  for(int i = 0; i < width; i++)
+    for(int k = 0; k < ch; k++)
+      _reference_line(in + i * ch + k, temp + i * ch + k, height, (size_t)width * ch,
+                      min[k], max[k], c);
+  for(int j = 0; j < height; j++)
+    for(int k = 0; k < ch; k++)
+      _reference_line(temp + (size_t)j * width * ch + k, out + (size_t)j * width * ch + k,
+                      width, ch, min[k], max[k], c);
+  dt_free_align(temp);
+}
+
+static void _compare(const int width, const int height, const int ch)
+{
+  Testimg *ti = testimg_gen_bench(width, height);
+  const size_t size = (size_t)width * height * ch;
+  float *in = dt_alloc_align_float(size);
+  float *ref = dt_alloc_align_float(size);
+  float *out = dt_alloc_align_float(size);
+  assert_non_null(in);
+  assert_non_null(ref);
+  assert_non_null(out);
+
+  // take the first ch channels of the test image, spread out so that
+  // the clamping bounds below cut off both ends
+  for(size_t p = 0; p < (size_t)width * height; p++)
+    for(int k = 0; k < ch; k++)
+      in[p * ch + k] = 2.0f * ti->pixels[4 * p + k] - 0.5f;
+
+  const dt_aligned_pixel_t max = { 1.0f, 1.2f, 0.9f, 1.1f };
+  const dt_aligned_pixel_t min = { 0.0f, -0.1f, 0.1f, -0.2f };
+
+  for(int order = DT_IOP_GAUSSIAN_ZERO; order <= DT_IOP_GAUSSIAN_TWO; order++)
+  {
+    const float sigma = 4.5f;
+    _reference(in, ref, width, height, ch, min, max, sigma, order);
+
+    dt_gaussian_t *g = dt_gaussian_init(width, height, ch, max, min, sigma, order);
+    assert_non_null(g);
+    const double start = dt_get_wtime();
+    if(ch == 4)
+      dt_gaussian_blur_4c(g, in, out);
+    else
+      dt_gaussian_blur(g, in, out);
+    const double elapsed = dt_get_wtime() - start;
+    dt_gaussian_free(g);
+
+    TR_DEBUG("%dx%d, %d channels, order %d: %.4fs", width, height, ch, order, elapsed);
+
+    for(size_t k = 0; k < size; k++)
+      assert_float_equal(out[k], ref[k], E * fmaxf(1.0f, fabsf(ref[k])));
+  }
+
+  dt_free_align(out);
+  dt_free_align(ref);
+  dt_free_align(in);
+  testimg_free(ti);
+}
+
+static void test_gaussian_one_channel(void **state)
+{
+  _compare(203, 131, 1);
+  _compare(7, 3, 1);
+}
+
+static void test_gaussian_two_channels(void **state)
+{
+  _compare(203, 131, 2);
+}
+
+static void test_gaussian_three_channels(void **state)
+{
+  _compare(203, 131, 3);
+  _compare(1, 40, 3);
+}
+
+static void test_gaussian_four_channels(void **state)
+{
+  _compare(203, 131, 4);
+  _compare(64, 16, 4);
+  _compare(33, 1, 4);
+}
+
+/*
+ * MAIN FUNCTION
+ */
+int main(int argc, char* argv[])
+{
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_gaussian_one_channel),
+    cmocka_unit_test(test_gaussian_two_channels),
+    cmocka_unit_test(test_gaussian_three_channels),
+    cmocka_unit_test(test_gaussian_four_channels)
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
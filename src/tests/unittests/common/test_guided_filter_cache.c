@@ -0,0 +1,216 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * The guided filter cache must give back exactly what was put in for the
+ * same input, roi and parameters, and nothing for anything else. Both
+ * canvas pipes share their results, the preview and export pipes don't.
+ */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <math.h>
+
+#include <cmocka.h>
+
+#include "../util/assert.h"
+#include "../util/tracing.h"
+
+#include "common/guided_filter_cache.c"
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+#define NFLOATS (300 * 200)
+
+typedef struct _setup_t
+{
+  dt_iop_module_t module;
+  dt_dev_pixelpipe_t pipe;
+  dt_dev_pixelpipe_iop_t piece;
+  float params[2];
+  float *result;
+  float *out;
+} _setup_t;
+
+static int _setup(void **state)
+{
+  _setup_t *s = calloc(1, sizeof(_setup_t));
+  s->module.iop_order = 10;
+  s->module.position = 1;
+  s->pipe.type = DT_DEV_PIXELPIPE_FULL;
+  s->pipe.iwidth = 1000;
+  s->pipe.iheight = 800;
+  s->pipe.iscale = 1.0f;
+  s->piece.pipe = &s->pipe;
+  s->piece.module = &s->module;
+  s->params[0] = 12.0f;
+  s->params[1] = 0.01f;
+  s->result = dt_alloc_align_float(NFLOATS);
+  s->out = dt_alloc_align_float(NFLOATS);
+  for(size_t k = 0; k < NFLOATS; k++) s->result[k] = sinf(0.01f * k);
+
+  dt_pthread_mutex_init(&_lock, NULL);
+  _budget = 64 * DT_MEGA;
+  *state = s;
+  return 0;
+}
+
+static int _teardown(void **state)
+{
+  _setup_t *s = *state;
+  dt_guided_filter_cache_cleanup();
+  dt_free_align(s->out);
+  dt_free_align(s->result);
+  free(s);
+  return 0;
+}
+
+static dt_hash_t _key(_setup_t *s, const dt_iop_roi_t *roi)
+{
+  return dt_guided_filter_cache_key(&s->piece, roi, s->params, sizeof(s->params));
+}
+
+static gboolean _get(_setup_t *s, const dt_iop_roi_t *roi)
+{
+  for(size_t k = 0; k < NFLOATS; k++) s->out[k] = 42.0f;
+  const gboolean found = dt_guided_filter_cache_get(_key(s, roi), s->out, NFLOATS);
+  if(found) assert_memory_equal(s->out, s->result, sizeof(float) * NFLOATS);
+  return found;
+}
+
+static void test_hit(void **state)
+{
+  _setup_t *s = *state;
+  const dt_iop_roi_t roi = { 50, 40, 300, 200, 0.5f };
+  assert_false(_get(s, &roi));
+  dt_guided_filter_cache_put(_key(s, &roi), s->result, NFLOATS);
+  assert_true(_get(s, &roi));
+
+  // the result is a copy
+  s->result[0] = 0.5f;
+  assert_true(dt_guided_filter_cache_get(_key(s, &roi), s->out, NFLOATS));
+  assert_float_equal(s->out[0], 0.0f, 0.0f);
+  s->result[0] = 0.0f;
+
+  // a different number of values is not the same result
+  assert_false(dt_guided_filter_cache_get(_key(s, &roi), s->out, NFLOATS / 2));
+}
+
+static void test_changes(void **state)
+{
+  _setup_t *s = *state;
+  const dt_iop_roi_t roi = { 0, 0, 300, 200, 0.5f };
+  dt_guided_filter_cache_put(_key(s, &roi), s->result, NFLOATS);
+  assert_true(_get(s, &roi));
+
+  // changed parameters, roi, pipe input or module instance
+  s->params[0] = 10.0f;
+  assert_false(_get(s, &roi));
+  s->params[0] = 12.0f;
+
+  const dt_iop_roi_t moved = { 10, 0, 300, 200, 0.5f };
+  assert_false(_get(s, &moved));
+  const dt_iop_roi_t scaled = { 0, 0, 300, 200, 0.25f };
+  assert_false(_get(s, &scaled));
+
+  s->pipe.iwidth = 900;
+  assert_false(_get(s, &roi));
+  s->pipe.iwidth = 1000;
+
+  s->module.iop_order = 11;
+  assert_false(_get(s, &roi));
+  s->module.iop_order = 10;
+
+  assert_true(_get(s, &roi));
+}
+
+static void test_pipes(void **state)
+{
+  _setup_t *s = *state;
+  const dt_iop_roi_t roi = { 0, 0, 300, 200, 0.5f };
+  dt_guided_filter_cache_put(_key(s, &roi), s->result, NFLOATS);
+
+  // the second darkroom window shares the result of the main one
+  s->pipe.type = DT_DEV_PIXELPIPE_PREVIEW2;
+  assert_true(_get(s, &roi));
+
+  s->pipe.type = DT_DEV_PIXELPIPE_FULL | DT_DEV_PIXELPIPE_FAST;
+  assert_false(_get(s, &roi));
+
+  s->pipe.type = DT_DEV_PIXELPIPE_PREVIEW;
+  assert_false(_get(s, &roi));
+
+  // nothing is kept for other pipes
+  s->pipe.type = DT_DEV_PIXELPIPE_EXPORT;
+  assert_true(_key(s, &roi) == DT_INVALID_HASH);
+  dt_guided_filter_cache_put(_key(s, &roi), s->result, NFLOATS);
+  assert_int_equal(g_list_length(_results), 1);
+}
+
+static void test_budget(void **state)
+{
+  _setup_t *s = *state;
+  const dt_iop_roi_t roi = { 0, 0, 300, 200, 0.5f };
+  const dt_iop_roi_t other = { 0, 0, 300, 200, 0.25f };
+
+  // the result doesn't fit, nothing is kept
+  _budget = sizeof(_result_t) + 100;
+  dt_guided_filter_cache_put(_key(s, &roi), s->result, NFLOATS);
+  assert_null(_results);
+
+  // room for one result only, the least recently used one is dropped
+  _budget = 64 * DT_MEGA;
+  dt_guided_filter_cache_put(_key(s, &roi), s->result, NFLOATS);
+  _budget = _used + 100;
+  dt_guided_filter_cache_put(_key(s, &other), s->result, NFLOATS);
+  assert_int_equal(g_list_length(_results), 1);
+  assert_true(_get(s, &other));
+  assert_false(_get(s, &roi));
+
+  // storing the same result again replaces it
+  dt_guided_filter_cache_put(_key(s, &other), s->result, NFLOATS);
+  assert_int_equal(g_list_length(_results), 1);
+  assert_int_equal(_used, sizeof(_result_t) + sizeof(float) * NFLOATS);
+
+  // switched off
+  _budget = 0;
+  assert_true(_key(s, &roi) == DT_INVALID_HASH);
+}
+
+/*
+ * MAIN FUNCTION
+ */
+int main(int argc, char* argv[])
+{
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test_setup_teardown(test_hit, _setup, _teardown),
+    cmocka_unit_test_setup_teardown(test_changes, _setup, _teardown),
+    cmocka_unit_test_setup_teardown(test_pipes, _setup, _teardown),
+    cmocka_unit_test_setup_teardown(test_budget, _setup, _teardown)
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -0,0 +1,159 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * The multigrid solver of the heal tool has to give the same result as the
+ * SOR loop run to convergence. Both stop at the same residual, so they only
+ * agree to a small tolerance. The shapes stay off the last column, there the
+ * SOR loop of odd widths differs from the stencil.
+ */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <math.h>
+
+#include <cmocka.h>
+
+#include "../util/assert.h"
+#include "../util/tracing.h"
+#include "../util/testimg.h"
+
+#include "common/heal.c"
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+// both solvers stop at the same residual, not at the same values
+#define E 2e-3f
+
+// an ellipse filling the given fraction of the image, with a notch cut out
+static float *_mask(const int width, const int height, const float fraction)
+{
+  float *mask = dt_alloc_align_float((size_t)width * height);
+  for(int y = 0; y < height; y++)
+    for(int x = 0; x < width; x++)
+    {
+      const float dx = (x - 0.5f * width) / (0.5f * fraction * width);
+      const float dy = (y - 0.5f * height) / (0.5f * fraction * height);
+      const gboolean notch = dx > 0.0f && fabsf(dy) < 0.1f;
+      mask[(size_t)y * width + x] = dx * dx + dy * dy < 1.0f && !notch ? 1.0f : 0.0f;
+    }
+  return mask;
+}
+
+static void _compare(const int width, const int height, const float fraction)
+{
+  Testimg *ti = testimg_gen_bench(width, height);
+  const size_t size = (size_t)4 * width * height;
+  float *src = dt_alloc_align_float(size);
+  float *sor = dt_alloc_align_float(size);
+  float *mg = dt_alloc_align_float(size);
+  float *mask = _mask(width, height, fraction);
+  assert_non_null(src);
+  assert_non_null(sor);
+  assert_non_null(mg);
+  assert_non_null(mask);
+
+  // heal the test image with a mirrored and darkened copy of itself
+  for(int y = 0; y < height; y++)
+    for(int x = 0; x < width; x++)
+      for(int c = 0; c < 4; c++)
+        src[4 * ((size_t)y * width + x) + c] =
+          0.5f * ti->pixels[4 * ((size_t)y * width + width - 1 - x) + c] + 0.1f;
+  memcpy(sor, ti->pixels, size * sizeof(float));
+  memcpy(mg, ti->pixels, size * sizeof(float));
+
+  double start = dt_get_wtime();
+  dt_heal_solve(src, sor, mask, width, height, 4, 10000, DT_HEAL_SOLVER_SOR);
+  const double sor_time = dt_get_wtime() - start;
+  start = dt_get_wtime();
+  dt_heal_solve(src, mg, mask, width, height, 4, 10000, DT_HEAL_SOLVER_MULTIGRID);
+  const double mg_time = dt_get_wtime() - start;
+
+  TR_DEBUG("%dx%d: sor %.4fs, multigrid %.4fs", width, height, sor_time, mg_time);
+
+  for(size_t k = 0; k < (size_t)width * height; k++)
+    for(int c = 0; c < 3; c++)
+    {
+      // the pixels outside of the shape are the boundary values
+      if(mask[k] == 0.0f)
+        assert_float_equal(mg[4 * k + c], ti->pixels[4 * k + c], 1e-6f);
+      assert_float_equal(mg[4 * k + c], sor[4 * k + c], E);
+    }
+
+  dt_free_align(mask);
+  dt_free_align(mg);
+  dt_free_align(sor);
+  dt_free_align(src);
+  testimg_free(ti);
+}
+
+static void test_heal_multigrid_matches_sor(void **state)
+{
+  _compare(160, 120, 0.8f);
+  _compare(201, 93, 0.6f);
+  _compare(17, 9, 0.7f);
+}
+
+static void test_heal_multigrid_constant(void **state)
+{
+  // a constant difference to the pattern is reproduced inside the shape
+  const int width = 131;
+  const int height = 77;
+  Testimg *ti = testimg_gen_bench(width, height);
+  const size_t size = (size_t)4 * width * height;
+  float *dest = dt_alloc_align_float(size);
+  float *mask = _mask(width, height, 0.9f);
+  assert_non_null(dest);
+  assert_non_null(mask);
+
+  const dt_aligned_pixel_t offset = { 0.25f, -0.1f, 0.05f, 0.0f };
+  for(size_t k = 0; k < (size_t)width * height; k++)
+    for(int c = 0; c < 4; c++)
+      dest[4 * k + c] = mask[k] != 0.0f ? 0.0f : ti->pixels[4 * k + c] + offset[c];
+
+  dt_heal_solve(ti->pixels, dest, mask, width, height, 4, 10000, DT_HEAL_SOLVER_MULTIGRID);
+
+  for(size_t k = 0; k < (size_t)width * height; k++)
+    for(int c = 0; c < 3; c++)
+      assert_float_equal(dest[4 * k + c], ti->pixels[4 * k + c] + offset[c], E);
+
+  dt_free_align(mask);
+  dt_free_align(dest);
+  testimg_free(ti);
+}
+
+/*
+ * MAIN FUNCTION
+ */
+int main(int argc, char* argv[])
+{
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_heal_multigrid_matches_sor),
+    cmocka_unit_test(test_heal_multigrid_constant)
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
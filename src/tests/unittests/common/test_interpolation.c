@@ -0,0 +1,160 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * The CPU resampler filters every input line horizontally once and then
+ * combines whole lines. Compare it to the plain pixel by pixel
+ * application of the same resampling plans, for down and upscaling with
+ * every interpolator and with output regions shifted into the input.
+ */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <math.h>
+
+#include <cmocka.h>
+
+#include "../util/assert.h"
+#include "../util/tracing.h"
+#include "../util/testimg.h"
+
+#include "common/interpolation.c"
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+// same operations in the same order, only fma contraction may differ
+#define E 1e-5f
+
+static void _reference(const dt_interpolation_t *itor,
+                       float *out,
+                       const dt_iop_roi_t *const roi_out,
+                       const float *const in,
+                       const dt_iop_roi_t *const roi_in)
+{
+  int *hindex = NULL, *hlength = NULL, *vindex = NULL, *vlength = NULL, *vmeta = NULL;
+  float *hkernel = NULL, *vkernel = NULL;
+  const int dx = MAX(0, roi_out->x);
+  const int dy = MAX(0, roi_out->y);
+
+  assert_false(_prepare_resampling_plan(itor, roi_in->width, roi_out->width, dx, roi_out->scale,
+                                        &hlength, &hkernel, &hindex, NULL));
+  assert_false(_prepare_resampling_plan(itor, roi_in->height, roi_out->height, dy, roi_out->scale,
+                                        &vlength, &vkernel, &vindex, &vmeta));
+
+  for(int oy = 0; oy < roi_out->height; oy++)
+  {
+    const int vl = vlength[vmeta[3 * oy + 0]];
+    const float *const vk = vkernel + vmeta[3 * oy + 1];
+    const int *const vi = vindex + vmeta[3 * oy + 2];
+    int hidx = 0;
+    for(int ox = 0; ox < roi_out->width; ox++)
+    {
+      const int hl = hlength[ox];
+      dt_aligned_pixel_t vs = { 0.0f, 0.0f, 0.0f, 0.0f };
+      for(int iy = 0; iy < vl; iy++)
+      {
+        dt_aligned_pixel_t hs = { 0.0f, 0.0f, 0.0f, 0.0f };
+        for(int ix = 0; ix < hl; ix++)
+          for_four_channels(c)
+            hs[c] += in[4 * ((size_t)vi[iy] * roi_in->width + hindex[hidx + ix]) + c]
+                     * hkernel[hidx + ix];
+        for_four_channels(c)
+          vs[c] += hs[c] * vk[iy];
+      }
+      copy_pixel(out + 4 * ((size_t)oy * roi_out->width + ox), vs);
+      hidx += hl;
+    }
+  }
+
+  dt_free_align(hlength);
+  dt_free_align(vlength);
+}
+
+static void _compare(const enum dt_interpolation_type type,
+                     const int iwidth,
+                     const int iheight,
+                     const float scale,
+                     const int x,
+                     const int y)
+{
+  Testimg *ti = testimg_gen_bench(iwidth, iheight);
+  const dt_iop_roi_t roi_in = { 0, 0, iwidth, iheight, 1.0f };
+  const dt_iop_roi_t roi_out = { x, y, (int)(iwidth * scale) - x, (int)(iheight * scale) - y, scale };
+  const size_t size = (size_t)roi_out.width * roi_out.height * 4;
+  float *ref = dt_alloc_align_float(size);
+  float *out = dt_alloc_align_float(size);
+  assert_non_null(ref);
+  assert_non_null(out);
+
+  const dt_interpolation_t *itor = dt_interpolation_new(type);
+  _reference(itor, ref, &roi_out, ti->pixels, &roi_in);
+
+  const double start = dt_get_wtime();
+  dt_interpolation_resample(itor, out, &roi_out, ti->pixels, &roi_in);
+  const double elapsed = dt_get_wtime() - start;
+
+  TR_DEBUG("%s %dx%d -> %dx%d: %.4fs", itor->name, iwidth, iheight,
+           roi_out.width, roi_out.height, elapsed);
+
+  for(size_t k = 0; k < size; k++)
+    assert_float_equal(out[k], ref[k], E * fmaxf(1.0f, fabsf(ref[k])));
+
+  dt_free_align(out);
+  dt_free_align(ref);
+  testimg_free(ti);
+}
+
+static void test_resample_downscale(void **state)
+{
+  for(int type = DT_INTERPOLATION_FIRST; type < DT_INTERPOLATION_LAST; type++)
+  {
+    _compare(type, 601, 401, 0.183f, 0, 0);
+    _compare(type, 601, 401, 0.5f, 3, 5);
+    _compare(type, 97, 403, 0.95f, 0, 1);
+  }
+}
+
+static void test_resample_upscale(void **state)
+{
+  for(int type = DT_INTERPOLATION_FIRST; type < DT_INTERPOLATION_LAST; type++)
+  {
+    _compare(type, 201, 151, 2.05f, 0, 0);
+    _compare(type, 33, 17, 1.5f, 2, 3);
+  }
+}
+
+/*
+ * MAIN FUNCTION
+ */
+int main(int argc, char* argv[])
+{
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_resample_downscale),
+    cmocka_unit_test(test_resample_upscale)
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -0,0 +1,105 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * The banded local laplacian only keeps the coarse pyramid levels in
+ * memory and runs the finer ones in horizontal bands. It must give the
+ * same result as the full pyramid version, for images with one band or
+ * several, and odd or even sizes at every level.
+ */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <math.h>
+
+#include <cmocka.h>
+
+#include "../util/assert.h"
+#include "../util/tracing.h"
+#include "../util/testimg.h"
+
+#include "common/locallaplacian.h"
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+// both versions do the same operations, only fma contraction may differ
+#define E 1e-5f
+
+static void _compare(const int width, const int height)
+{
+  Testimg *ti = testimg_gen_bench(width, height);
+  const size_t size = (size_t)width * height * 4;
+  // the local laplacian works on L in [0,100]
+  for(size_t k = 0; k < size; k += 4)
+    ti->pixels[k] *= 100.0f;
+  float *full = dt_alloc_align_float(size);
+  float *banded = dt_alloc_align_float(size);
+  assert_non_null(full);
+  assert_non_null(banded);
+
+  const double start = dt_get_wtime();
+  local_laplacian_internal(ti->pixels, full, width, height, 0.2f, 1.5f, 0.5f, 0.3f, NULL);
+  const double mid = dt_get_wtime();
+  local_laplacian_banded(ti->pixels, banded, width, height, 0.2f, 1.5f, 0.5f, 0.3f);
+  const double end = dt_get_wtime();
+
+  TR_DEBUG("%dx%d: full %.3fs, banded %.3fs, banded memory %.1f MB",
+           width, height, mid - start, end - mid, local_laplacian_memory_use(width, height) / 1e6);
+
+  for(size_t k = 0; k < size; k++)
+  {
+    if(k % 4 == 3) continue;
+    assert_float_equal(banded[k], full[k], E * fmaxf(1.0f, fabsf(full[k])));
+  }
+
+  dt_free_align(banded);
+  dt_free_align(full);
+  testimg_free(ti);
+}
+
+static void test_single_band(void **state)
+{
+  _compare(97, 61);
+}
+
+static void test_many_bands(void **state)
+{
+  _compare(640, 480);
+  _compare(333, 517);
+}
+
+/*
+ * MAIN FUNCTION
+ */
+int main(int argc, char* argv[])
+{
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_single_band),
+    cmocka_unit_test(test_many_bands)
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -0,0 +1,152 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * The CPU non-local means denoises the chunks away from the image borders
+ * with several patches at once. Check that it gives the same result as the
+ * generic one-patch-at-a-time loop for the parameter sets used by the
+ * denoise (non-local means) and denoise (profiled) modules, also when the
+ * latter scales its patches down.
+ */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <math.h>
+
+#include <cmocka.h>
+
+#include "../util/assert.h"
+#include "../util/tracing.h"
+#include "../util/testimg.h"
+
+#include "common/nlmeans_core.c"
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+#define WIDTH 400
+#define HEIGHT 300
+
+// the grouped and the generic loop do the same operations in the same
+// order, only fma contraction may differ between vectorized and scalar code
+#define E 1e-6f
+
+static void _compare(const dt_nlmeans_param_t *const params)
+{
+  Testimg *ti = testimg_gen_bench(WIDTH, HEIGHT);
+  const size_t size = (size_t)WIDTH * HEIGHT * 4;
+  float *generic = dt_alloc_align_float(size);
+  float *grouped = dt_alloc_align_float(size);
+  assert_non_null(generic);
+  assert_non_null(grouped);
+
+  const dt_iop_roi_t roi = { 0, 0, WIDTH, HEIGHT, 1.0f };
+  const double start = dt_get_wtime();
+  _nlmeans_denoise(ti->pixels, generic, &roi, &roi, params, FALSE);
+  const double mid = dt_get_wtime();
+  _nlmeans_denoise(ti->pixels, grouped, &roi, &roi, params, TRUE);
+  const double end = dt_get_wtime();
+
+  TR_DEBUG("generic %.2f MPix/s, grouped %.2f MPix/s",
+           WIDTH * HEIGHT / 1e6 / (mid - start), WIDTH * HEIGHT / 1e6 / (end - mid));
+
+  size_t differ = 0;
+  for(size_t k = 0; k < size; k++)
+  {
+    if(generic[k] != grouped[k]) differ++;
+    assert_float_equal(grouped[k], generic[k], E * fmaxf(1.0f, fabsf(generic[k])));
+  }
+  TR_DEBUG("%zu of %zu values not bit-identical", differ, size);
+
+  dt_free_align(grouped);
+  dt_free_align(generic);
+  testimg_free(ti);
+}
+
+static void test_nlmeans(void **state)
+{
+  // denoise (non-local means) defaults
+  const float norm[4] = { 1.0f / 100.0f, 1.0f / 20.0f, 1.0f / 20.0f, 1.0f };
+  const dt_nlmeans_param_t params = { .scattering = 0.0f,
+                                      .scale = 1.0f,
+                                      .luma = 0.5f,
+                                      .chroma = 1.0f,
+                                      .center_weight = -1.0f,
+                                      .sharpness = 3000.0f,
+                                      .patch_radius = 2,
+                                      .search_radius = 7,
+                                      .decimate = 0,
+                                      .norm = norm };
+  _compare(&params);
+}
+
+static void test_denoiseprofile(void **state)
+{
+  // denoise (profiled) non-local means with scattered and decimated patches
+  const float norm[4] = { 20.0f, 20.0f, 20.0f, 1.0f };
+  const dt_nlmeans_param_t params = { .scattering = 0.5f,
+                                      .scale = 1.0f,
+                                      .luma = 1.0f,
+                                      .chroma = 1.0f,
+                                      .center_weight = 0.1f,
+                                      .sharpness = 1.0f,
+                                      .patch_radius = 1,
+                                      .search_radius = 5,
+                                      .decimate = 1,
+                                      .norm = norm };
+  _compare(&params);
+}
+
+static void test_scaled(void **state)
+{
+  // zoomed out or downscaled export: scattered patches with a scale below 1
+  // map neighbouring search positions onto repeated or non-adjacent patches
+  const float norm[4] = { 20.0f, 20.0f, 20.0f, 1.0f };
+  const dt_nlmeans_param_t params = { .scattering = 0.3f,
+                                      .scale = 0.5f,
+                                      .luma = 1.0f,
+                                      .chroma = 1.0f,
+                                      .center_weight = 0.1f,
+                                      .sharpness = 1.0f,
+                                      .patch_radius = 1,
+                                      .search_radius = 7,
+                                      .decimate = 0,
+                                      .norm = norm };
+  _compare(&params);
+}
+
+/*
+ * MAIN FUNCTION
+ */
+int main(int argc, char* argv[])
+{
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_nlmeans),
+    cmocka_unit_test(test_denoiseprofile),
+    cmocka_unit_test(test_scaled)
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -0,0 +1,238 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * The raster cache of drawn shapes must return exactly what rendering
+ * the shape returns, and render as little as possible doing so. A fake
+ * shape, a soft disc, counts the pixels it is asked to render.
+ */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <math.h>
+
+#include <cmocka.h>
+
+#include "../util/assert.h"
+#include "../util/tracing.h"
+
+#include "develop/masks/cache.c"
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+typedef struct _disc_t
+{
+  float x, y, radius;
+} _disc_t;
+
+static size_t _rendered = 0;
+
+static int _disc_get_mask_roi(const dt_iop_module_t *const module,
+                              const dt_dev_pixelpipe_iop_t *const piece,
+                              dt_masks_form_t *const form,
+                              const dt_iop_roi_t *roi,
+                              float *buffer)
+{
+  const _disc_t *d = form->points->data;
+  for(int y = 0; y < roi->height; y++)
+    for(int x = 0; x < roi->width; x++)
+    {
+      const float dx = (x + roi->x) / roi->scale - d->x;
+      const float dy = (y + roi->y) / roi->scale - d->y;
+      buffer[(size_t)y * roi->width + x] = fmaxf(0.0f, 1.0f - sqrtf(dx * dx + dy * dy) / d->radius);
+    }
+  _rendered += (size_t)roi->width * roi->height;
+  return 1;
+}
+
+static const dt_masks_functions_t _disc_functions = {
+  .point_struct_size = sizeof(_disc_t),
+  .get_mask_roi = _disc_get_mask_roi,
+};
+
+typedef struct _setup_t
+{
+  dt_develop_t dev;
+  dt_iop_module_t module;
+  dt_dev_pixelpipe_t pipe;
+  dt_dev_pixelpipe_iop_t piece;
+  dt_masks_form_t form;
+  _disc_t disc;
+} _setup_t;
+
+static int _setup(void **state)
+{
+  _setup_t *s = calloc(1, sizeof(_setup_t));
+  dt_pthread_mutex_init(&s->dev.history_mutex, NULL);
+  s->module.dev = &s->dev;
+  s->module.iop_order = 10;
+  s->pipe.iwidth = 1000;
+  s->pipe.iheight = 800;
+  s->pipe.iscale = 1.0f;
+  s->piece.pipe = &s->pipe;
+  s->disc = (_disc_t){ 400.0f, 300.0f, 150.0f };
+  s->form.type = DT_MASKS_CIRCLE;
+  s->form.functions = &_disc_functions;
+  s->form.points = g_list_append(NULL, &s->disc);
+
+  dt_pthread_mutex_init(&_lock, NULL);
+  _buckets = g_hash_table_new_full(g_int64_hash, g_int64_equal, NULL, free);
+  _budget = 64 * DT_MEGA;
+  *state = s;
+  return 0;
+}
+
+static int _teardown(void **state)
+{
+  _setup_t *s = *state;
+  dt_masks_raster_cache_cleanup();
+  g_list_free(s->form.points);
+  dt_pthread_mutex_destroy(&s->dev.history_mutex);
+  free(s);
+  return 0;
+}
+
+// render through the cache and compare to the shape rendered directly,
+// returns the number of pixels the cache had rendered
+static size_t _check(_setup_t *s, const dt_iop_roi_t *roi)
+{
+  const size_t npixels = (size_t)roi->width * roi->height;
+  float *ref = dt_calloc_align_float(npixels);
+  float *out = dt_alloc_align_float(npixels);
+  assert_non_null(ref);
+  assert_non_null(out);
+
+  // garbage in the buffer must not matter
+  for(size_t k = 0; k < npixels; k++) out[k] = 42.0f;
+
+  _rendered = 0;
+  assert_true(dt_masks_raster_cache_get_mask_roi(&s->module, &s->piece, &s->form, roi, out));
+  const size_t rendered = _rendered;
+
+  _disc_get_mask_roi(&s->module, &s->piece, &s->form, roi, ref);
+  for(size_t k = 0; k < npixels; k++)
+    assert_float_equal(out[k], ref[k], 1e-6f);
+
+  dt_free_align(out);
+  dt_free_align(ref);
+  return rendered;
+}
+
+static void test_hit(void **state)
+{
+  _setup_t *s = *state;
+  const dt_iop_roi_t roi = { 50, 40, 300, 200, 0.5f };
+  assert_int_equal(_check(s, &roi), 300 * 200);
+  assert_int_equal(_check(s, &roi), 0);
+
+  // stored is only the part the disc covers
+  const _raster_t *r = g_queue_peek_head(&_lru);
+  assert_true(r->bw < roi.width && r->bh < roi.height);
+}
+
+static void test_pan(void **state)
+{
+  _setup_t *s = *state;
+  const dt_iop_roi_t roi = { 50, 40, 300, 200, 0.5f };
+  const dt_iop_roi_t right = { 80, 20, 300, 200, 0.5f };
+  const dt_iop_roi_t left = { 10, 90, 300, 200, 0.5f };
+  _check(s, &roi);
+
+  // only the uncovered bands are rendered
+  const size_t r1 = _check(s, &right);
+  TR_DEBUG("panning right rendered %zu pixels", r1);
+  assert_int_equal(r1, 300 * 200 - 270 * 180);
+  const size_t r2 = _check(s, &left);
+  TR_DEBUG("panning left rendered %zu pixels", r2);
+  assert_int_equal(r2, 300 * 200 - 260 * 150);
+
+  // no overlap at all
+  const dt_iop_roi_t away = { 1000, 1000, 100, 100, 0.5f };
+  assert_int_equal(_check(s, &away), 100 * 100);
+}
+
+static void test_changes(void **state)
+{
+  _setup_t *s = *state;
+  const dt_iop_roi_t roi = { 0, 0, 250, 200, 0.5f };
+  _check(s, &roi);
+  assert_int_equal(_check(s, &roi), 0);
+
+  // a changed shape, scale or distortion in front of the module must
+  // not reuse the old rendering
+  s->disc.radius = 120.0f;
+  assert_int_equal(_check(s, &roi), 250 * 200);
+
+  const dt_iop_roi_t scaled = { 0, 0, 250, 200, 0.25f };
+  assert_int_equal(_check(s, &scaled), 250 * 200);
+
+  s->pipe.iwidth = 900;
+  assert_int_equal(_check(s, &roi), 250 * 200);
+}
+
+static void test_budget(void **state)
+{
+  _setup_t *s = *state;
+  const dt_iop_roi_t roi = { 0, 0, 300, 200, 0.5f };
+
+  // the rendering doesn't fit, nothing is kept
+  _budget = sizeof(_raster_t) + 100;
+  assert_int_equal(_check(s, &roi), 300 * 200);
+  assert_int_equal(_check(s, &roi), 300 * 200);
+  assert_true(g_queue_is_empty(&_lru));
+  assert_int_equal(g_hash_table_size(_buckets), 0);
+
+  // room for one shape only, the older one is dropped
+  _budget = 64 * DT_MEGA;
+  _check(s, &roi);
+  _budget = _used + 100;
+  const dt_iop_roi_t other = { 0, 0, 300, 200, 0.25f };
+  _check(s, &other);
+  assert_int_equal(g_queue_get_length(&_lru), 1);
+  assert_int_equal(g_hash_table_size(_buckets), 1);
+  assert_int_equal(_check(s, &other), 0);
+  assert_int_equal(_check(s, &roi), 300 * 200);
+
+  // switched off
+  _budget = 0;
+  assert_int_equal(_check(s, &roi), 300 * 200);
+  assert_int_equal(_check(s, &roi), 300 * 200);
+}
+
+/*
+ * MAIN FUNCTION
+ */
+int main(int argc, char* argv[])
+{
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test_setup_teardown(test_hit, _setup, _teardown),
+    cmocka_unit_test_setup_teardown(test_pan, _setup, _teardown),
+    cmocka_unit_test_setup_teardown(test_changes, _setup, _teardown),
+    cmocka_unit_test_setup_teardown(test_budget, _setup, _teardown)
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -0,0 +1,226 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * The stroke rasteriser is compared to the falloff computed for every
+ * pixel against every segment between the samples given to it. Merging
+ * samples moves the center line by a fraction of a pixel, so the soft
+ * part of the test strokes is kept wide enough for that to stay below
+ * the tolerance.
+ */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <math.h>
+
+#include <cmocka.h>
+
+#include "../util/assert.h"
+#include "../util/tracing.h"
+
+#include "develop/masks/falloff.c"
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+#define WIDTH 320
+#define HEIGHT 240
+
+// tolerance on the mask values
+#define E 0.03f
+
+static float _segment_falloff(const float *const a,
+                              const float *const b,
+                              const float x,
+                              const float y)
+{
+  const float dx = b[0] - a[0];
+  const float dy = b[1] - a[1];
+  const float len2 = dx * dx + dy * dy;
+  const float t = len2 > 0.0f
+    ? CLAMPF(((x - a[0]) * dx + (y - a[1]) * dy) / len2, 0.0f, 1.0f)
+    : 0.0f;
+  const float d = hypotf(x - a[0] - t * dx, y - a[1] - t * dy);
+  const float r = a[2] + t * (b[2] - a[2]);
+  const float h = a[3] + t * (b[3] - a[3]);
+  const float density = a[4] + t * (b[4] - a[4]);
+  return density * CLAMPF((r - d) / MAX(r * (1.0f - h), 1e-3f), 0.0f, 1.0f);
+}
+
+// render the samples both ways and compare
+static void _compare(const float *const samples,
+                     const int count,
+                     const gboolean closed)
+{
+  float *buf = dt_calloc_align_float((size_t)WIDTH * HEIGHT);
+  float *work = dt_alloc_align_float((size_t)5 * count);
+  assert_non_null(buf);
+  assert_non_null(work);
+  memcpy(work, samples, sizeof(float) * 5 * count);
+
+  const double start = dt_get_wtime();
+  dt_masks_stroke_falloff(buf, WIDTH, HEIGHT, work, count, closed);
+  const double elapsed = dt_get_wtime() - start;
+
+  const int nseg = count == 1 ? 1 : (closed ? count : count - 1);
+  float maxerr = 0.0f;
+  size_t covered = 0;
+  for(int y = 0; y < HEIGHT; y++)
+    for(int x = 0; x < WIDTH; x++)
+    {
+      float ref = 0.0f;
+      for(int k = 0; k < nseg; k++)
+        ref = fmaxf(ref, _segment_falloff(samples + 5 * k,
+                                          samples + 5 * ((k + 1) % count), x, y));
+      const float v = buf[(size_t)y * WIDTH + x];
+      maxerr = fmaxf(maxerr, fabsf(v - ref));
+      if(ref > 0.0f) covered++;
+      if(fabsf(v - ref) > E)
+        TR_DEBUG("mismatch at %d,%d: %f vs %f", x, y, v, ref);
+      assert_float_equal(v, ref, E);
+    }
+
+  TR_DEBUG("%d samples, %zu pixels covered, max error %f, %.4fs",
+           count, covered, maxerr, elapsed);
+  assert_true(covered > 0);
+
+  dt_free_align(work);
+  dt_free_align(buf);
+}
+
+static void _set(float *const s,
+                 const float x,
+                 const float y,
+                 const float radius,
+                 const float hardness,
+                 const float density)
+{
+  s[0] = x;
+  s[1] = y;
+  s[2] = radius;
+  s[3] = hardness;
+  s[4] = density;
+}
+
+static void test_single_point(void **state)
+{
+  float s[5];
+  _set(s, 100.3f, 90.7f, 30.0f, 0.4f, 0.8f);
+  _compare(s, 1, FALSE);
+}
+
+static void test_straight_stroke(void **state)
+{
+  // a sample per pixel, as the shapes deliver them, with the radius
+  // growing along the stroke
+  const int count = 200;
+  float *s = dt_alloc_align_float((size_t)5 * count);
+  assert_non_null(s);
+  for(int k = 0; k < count; k++)
+    _set(s + 5 * k, 60.0f + k * 0.9f, 50.0f + k * 0.6f, 20.0f + 0.1f * k, 0.3f, 1.0f);
+  _compare(s, count, FALSE);
+  dt_free_align(s);
+}
+
+static void test_tapered_stroke(void **state)
+{
+  // the radius changes almost as fast as the stroke moves, the discs
+  // along the stroke reach out well beyond the nearest point of the
+  // center line
+  const int count = 120;
+  float *s = dt_alloc_align_float((size_t)5 * count);
+  assert_non_null(s);
+  for(int k = 0; k < count; k++)
+    _set(s + 5 * k, 100.0f + 0.6f * k, 60.0f + 0.8f * k, 20.0f + 0.8f * k - 0.004f * k * k,
+         0.2f, 1.0f);
+  _compare(s, count, FALSE);
+  dt_free_align(s);
+}
+
+static void test_curved_stroke(void **state)
+{
+  // a spiral with changing hardness and density, partly outside the buffer
+  const int count = 900;
+  float *s = dt_alloc_align_float((size_t)5 * count);
+  assert_non_null(s);
+  for(int k = 0; k < count; k++)
+  {
+    const float a = k * 0.01f;
+    const float r = 20.0f + 15.0f * a;
+    _set(s + 5 * k, 150.0f + r * cosf(a), 120.0f + r * sinf(a), 25.0f,
+         0.5f * k / count, 1.0f - 0.5f * k / count);
+  }
+  _compare(s, count, FALSE);
+  dt_free_align(s);
+}
+
+static void test_sharp_corner(void **state)
+{
+  // there and back again, with the stamp at the turn as the brush does it
+  const int count = 301;
+  float *s = dt_alloc_align_float((size_t)5 * count);
+  assert_non_null(s);
+  for(int k = 0; k < 150; k++)
+    _set(s + 5 * k, 40.0f + k, 100.0f + 0.3f * k, 24.0f, 0.2f, 1.0f);
+  _set(s + 5 * 150, 190.0f, 145.0f, 24.0f, 0.2f, 1.0f);
+  for(int k = 0; k < 150; k++)
+    _set(s + 5 * (151 + k), 190.0f - 0.5f * k, 145.0f - k * 0.8f, 24.0f, 0.2f, 1.0f);
+  _compare(s, count, FALSE);
+  dt_free_align(s);
+}
+
+static void test_closed_path(void **state)
+{
+  // the feather of a path: hardness 0 and density 1 along an ellipse, the
+  // segment from the last sample back to the first one closes it
+  const int count = 500;
+  float *s = dt_alloc_align_float((size_t)5 * count);
+  assert_non_null(s);
+  for(int k = 0; k < count; k++)
+  {
+    const float a = 2.0f * M_PI_F * k / count;
+    _set(s + 5 * k, 160.0f + 110.0f * cosf(a), 120.0f + 70.0f * sinf(a),
+         20.0f + 6.0f * sinf(3.0f * a), 0.0f, 1.0f);
+  }
+  _compare(s, count, TRUE);
+  dt_free_align(s);
+}
+
+/*
+ * MAIN FUNCTION
+ */
+int main(int argc, char* argv[])
+{
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_single_point),
+    cmocka_unit_test(test_straight_stroke),
+    cmocka_unit_test(test_tapered_stroke),
+    cmocka_unit_test(test_curved_stroke),
+    cmocka_unit_test(test_sharp_corner),
+    cmocka_unit_test(test_closed_path)
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
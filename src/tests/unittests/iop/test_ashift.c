@@ -0,0 +1,203 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * The line detection of the perspective correction runs on horizontal
+ * stripes of the image and joins the lines crossing the seams. On a
+ * synthetic facade it has to find the lines a single pass over the whole
+ * image finds, and no others.
+ */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <math.h>
+
+#include <cmocka.h>
+
+#include "../util/assert.h"
+#include "../util/tracing.h"
+
+#include "iop/ashift.c"
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+// lines shorter than that are left out of the comparison
+#define MINLEN 20.0
+// distance in pixels of a point to the line found by the other detection
+#define MAXDIST 1.5
+
+// a building with a grid of windows and converging verticals in front
+// of the sky, greyscale 0..256 like rgb2grey256() gives
+static double *_facade(const int width, const int height)
+{
+  double *img = malloc(sizeof(double) * width * height);
+  assert_non_null(img);
+
+  const double top = 0.1 * height;
+  const double bottom = 0.85 * height;
+  const double cx = 0.5 * width;
+  for(int y = 0; y < height; y++)
+    for(int x = 0; x < width; x++)
+    {
+      // 4x4 samples per pixel for smooth edges
+      double sum = 0.0;
+      for(int j = 0; j < 4; j++)
+        for(int i = 0; i < 4; i++)
+        {
+          const double px = x + (i + 0.5) / 4.0;
+          const double py = y + (j + 0.5) / 4.0;
+          const double v = (py - top) / (bottom - top);
+          const double halfwidth = 0.3 * width * (0.85 + 0.15 * v);
+          const double u = 0.5 + 0.5 * (px - cx) / halfwidth;
+          double value = py < bottom ? 220.0 : 90.0;
+          if(u >= 0.0 && u <= 1.0 && v >= 0.0 && v <= 1.0)
+          {
+            const double wu = 6.0 * u - floor(6.0 * u);
+            const double wv = 12.0 * v - floor(12.0 * v);
+            const gboolean window = wu > 0.25 && wu < 0.75 && wv > 0.3 && wv < 0.8;
+            value = window ? 50.0 : 140.0;
+          }
+          sum += value;
+        }
+      img[(size_t)y * width + x] = sum / 16.0;
+    }
+  return img;
+}
+
+static double _segment_distance(const double *const line,
+                                const double x,
+                                const double y)
+{
+  const double dx = line[2] - line[0];
+  const double dy = line[3] - line[1];
+  const double len2 = dx * dx + dy * dy;
+  const double t = len2 > 0.0
+    ? CLAMP(((x - line[0]) * dx + (y - line[1]) * dy) / len2, 0.0, 1.0)
+    : 0.0;
+  return hypot(x - line[0] - t * dx, y - line[1] - t * dy);
+}
+
+// the share of the length of the lines in a that lies on lines in b
+// running in the same direction
+static double _covered(const double *const a,
+                       const int na,
+                       const double *const b,
+                       const int nb)
+{
+  int points = 0;
+  int covered = 0;
+  for(int i = 0; i < na; i++)
+  {
+    const double *const la = a + 7 * i;
+    const double len = hypot(la[2] - la[0], la[3] - la[1]);
+    if(len < MINLEN) continue;
+    const double ux = (la[2] - la[0]) / len;
+    const double uy = (la[3] - la[1]) / len;
+    for(int k = 0; k <= (int)len; k++)
+    {
+      const double x = la[0] + k * ux;
+      const double y = la[1] + k * uy;
+      points++;
+      for(int j = 0; j < nb; j++)
+      {
+        const double *const lb = b + 7 * j;
+        const double lenb = hypot(lb[2] - lb[0], lb[3] - lb[1]);
+        if(lenb < 1.0) continue;
+        const double sin_angle = fabs(ux * (lb[3] - lb[1]) - uy * (lb[2] - lb[0])) / lenb;
+        if(sin_angle <= sin(deg2radf(LSD_MERGE_ANGLE)) && _segment_distance(lb, x, y) <= MAXDIST)
+        {
+          covered++;
+          break;
+        }
+      }
+    }
+  }
+  return points ? (double)covered / points : 1.0;
+}
+
+// the summed length of the lines, lines found in pieces add up to more
+static double _length(const double *const lines, const int n)
+{
+  double sum = 0.0;
+  for(int i = 0; i < n; i++)
+  {
+    const double *const l = lines + 7 * i;
+    const double len = hypot(l[2] - l[0], l[3] - l[1]);
+    if(len >= MINLEN) sum += len;
+  }
+  return sum;
+}
+
+static void _compare_stripes(const int width, const int height)
+{
+  assert_true(height / LSD_STRIPE_HEIGHT >= 2);
+  double *img = _facade(width, height);
+
+  int nsingle = 0;
+  double *single = LineSegmentDetection(&nsingle, img, width, height,
+                                        LSD_SCALE, LSD_SIGMA_SCALE, LSD_QUANT,
+                                        LSD_ANG_TH, LSD_LOG_EPS, LSD_DENSITY_TH,
+                                        LSD_N_BINS, NULL, NULL, NULL, 0, 0);
+  assert_non_null(single);
+
+  int nstriped = 0;
+  double *striped = _lsd_stripes(&nstriped, img, width, height, LSD_SCALE);
+  assert_non_null(striped);
+
+  const double found = _covered(single, nsingle, striped, nstriped);
+  const double extra = 1.0 - _covered(striped, nstriped, single, nsingle);
+  const double length = _length(striped, nstriped) / _length(single, nsingle);
+  TR_DEBUG("%dx%d, %d stripes: %d lines single, %d striped, %.2f%% found, %.2f%% extra,"
+           " %.2f%% of the length", width, height, height / LSD_STRIPE_HEIGHT, nsingle, nstriped,
+           100.0 * found, 100.0 * extra, 100.0 * length);
+  assert_true(nsingle > 50);
+  assert_true(found >= 0.99);
+  assert_true(extra <= 0.01);
+  assert_float_equal(length, 1.0, 0.01);
+
+  free(striped);
+  free(single);
+  free(img);
+}
+
+static void test_lsd_stripes(void **state)
+{
+  _compare_stripes(640, 960);
+  // seams through the windows and stripes that don't divide the height
+  _compare_stripes(500, 1300);
+}
+
+/*
+ * MAIN FUNCTION
+ */
+int main(int argc, char* argv[])
+{
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_lsd_stripes)
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -0,0 +1,158 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * The baked lut of the output color profile module has to give the lcms
+ * result. An output profile with nothing but a clut is baked and random Lab
+ * colors, inside and outside of the lut range, are transformed through the
+ * lut and directly by lcms.
+ */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <math.h>
+
+#include <cmocka.h>
+
+#include "../util/assert.h"
+#include "../util/tracing.h"
+
+#include "iop/colorout.c"
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+#define NPIXELS 200000
+
+static cmsInt32Number _sample_srgb(const cmsUInt16Number in[],
+                                   cmsUInt16Number out[],
+                                   void *cargo)
+{
+  cmsDoTransform((cmsHTRANSFORM)cargo, in, out, 1);
+  return TRUE;
+}
+
+// an output profile with a BToA0 clut sampled from sRGB, there is no matrix
+static cmsHPROFILE _clut_profile(void)
+{
+  cmsHPROFILE lab = cmsCreateLab4Profile(NULL);
+  cmsHPROFILE srgb = cmsCreate_sRGBProfile();
+  cmsHTRANSFORM xform = cmsCreateTransform(lab, TYPE_Lab_16, srgb, TYPE_RGB_16,
+                                           INTENT_RELATIVE_COLORIMETRIC, 0);
+
+  cmsHPROFILE profile = cmsCreateProfilePlaceholder(NULL);
+  cmsSetProfileVersion(profile, 4.3);
+  cmsSetDeviceClass(profile, cmsSigOutputClass);
+  cmsSetColorSpace(profile, cmsSigRgbData);
+  cmsSetPCS(profile, cmsSigLabData);
+
+  cmsPipeline *pipeline = cmsPipelineAlloc(NULL, 3, 3);
+  cmsStage *stage = cmsStageAllocCLut16bit(NULL, 33, 3, 3, NULL);
+  cmsStageSampleCLut16bit(stage, _sample_srgb, xform, 0);
+  cmsPipelineInsertStage(pipeline, cmsAT_END, stage);
+  cmsWriteTag(profile, cmsSigBToA0Tag, pipeline);
+
+  cmsPipelineFree(pipeline);
+  cmsDeleteTransform(xform);
+  cmsCloseProfile(srgb);
+  cmsCloseProfile(lab);
+  return profile;
+}
+
+static void test_clut_profile(void **state)
+{
+  cmsHPROFILE lab = cmsCreateLab4Profile(NULL);
+  cmsHPROFILE profile = _clut_profile();
+  assert_false(cmsIsMatrixShaper(profile));
+
+  dt_iop_colorout_data_t d = { 0 };
+  d.xform = cmsCreateTransform(lab, TYPE_LabA_FLT, profile, TYPE_RGBA_FLT, INTENT_PERCEPTUAL, 0);
+  assert_non_null(d.xform);
+  d.clut = _clut_build(1, d.xform);
+  assert_non_null(d.clut);
+  assert_non_null(d.clut->clut);
+
+  float *in = dt_alloc_align_float(4 * NPIXELS);
+  float *lut = dt_alloc_align_float(4 * NPIXELS);
+  float *ref = dt_alloc_align_float(4 * NPIXELS);
+  assert_non_null(in);
+  assert_non_null(lut);
+  assert_non_null(ref);
+
+  // a few percent of the colors are outside of the lut range
+  uint32_t seed = 12345;
+  for(size_t k = 0; k < 4 * NPIXELS; k++)
+  {
+    seed = seed * 1664525u + 1013904223u;
+    const float r = (seed >> 8) / 16777216.0f;
+    switch(k & 3)
+    {
+      case 0: in[k] = -2.0f + 104.0f * r; break;
+      case 3: in[k] = r; break;
+      default: in[k] = -132.0f + 264.0f * r; break;
+    }
+  }
+
+  _transform_clut(&d, lut, in, NPIXELS);
+  cmsDoTransform(d.xform, in, ref, NPIXELS);
+
+  double sum = 0.0;
+  float worst = 0.0f;
+  for(size_t k = 0; k < NPIXELS; k++)
+  {
+    for(int c = 0; c < 3; c++)
+    {
+      const float e = fabsf(lut[4 * k + c] - ref[4 * k + c]);
+      if(!_clut_inside(in + 4 * k)) assert_float_equal(e, 0.0f, 0.0f);
+      sum += e;
+      worst = MAX(worst, e);
+    }
+  }
+  const float mean = sum / (3 * NPIXELS);
+
+  TR_DEBUG("mean error %.7f, max error %.7f", mean, worst);
+  assert_true(mean < 0.1f * CLUT_MAXERR);
+  assert_true(worst <= CLUT_MAXERR);
+
+  dt_free_align(ref);
+  dt_free_align(lut);
+  dt_free_align(in);
+  _clut_free(d.clut);
+  cmsDeleteTransform(d.xform);
+  cmsCloseProfile(profile);
+  cmsCloseProfile(lab);
+}
+
+/*
+ * MAIN FUNCTION
+ */
+int main(int argc, char* argv[])
+{
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_clut_profile)
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
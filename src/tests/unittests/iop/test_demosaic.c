@@ -0,0 +1,114 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * The half size demosaic of the reduced thumbnail path puts every output
+ * pixel at the centre of its 2x2 cfa block. A flat color must come out
+ * unchanged everywhere and a linear gradient must be reproduced exactly
+ * at the block centres away from the borders, for all bayer patterns.
+ */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <math.h>
+
+#include <cmocka.h>
+
+#include "../util/assert.h"
+#include "../util/tracing.h"
+
+#include "iop/demosaic.c"
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+#define WIDTH 32
+#define HEIGHT 24
+
+static const uint32_t _patterns[] = { 0x94949494u, 0x16161616u, 0x61616161u, 0x49494949u };
+
+static void _check(const dt_aligned_pixel_t base,
+                   const dt_aligned_pixel_t gx,
+                   const dt_aligned_pixel_t gy,
+                   const int border)
+{
+  float *in = dt_alloc_align_float((size_t)WIDTH * HEIGHT);
+  float *out = dt_alloc_align_float((size_t)WIDTH * HEIGHT);
+  assert_non_null(in);
+  assert_non_null(out);
+
+  for(size_t p = 0; p < sizeof(_patterns) / sizeof(_patterns[0]); p++)
+  {
+    const uint32_t filters = _patterns[p];
+    for(int row = 0; row < HEIGHT; row++)
+      for(int col = 0; col < WIDTH; col++)
+      {
+        const int c = FC(row, col, filters) == 3 ? GREEN : FC(row, col, filters);
+        in[(size_t)row * WIDTH + col] = base[c] + gx[c] * col + gy[c] * row;
+      }
+
+    demosaic_half_size(out, in, WIDTH, HEIGHT, filters);
+
+    for(int row = border; row < HEIGHT / 2 - border; row++)
+      for(int col = border; col < WIDTH / 2 - border; col++)
+        for(int c = 0; c < 3; c++)
+        {
+          const float expected = base[c] + gx[c] * (2 * col + 0.5f) + gy[c] * (2 * row + 0.5f);
+          assert_float_equal(out[4 * ((size_t)row * WIDTH / 2 + col) + c], expected, 1e-6f);
+        }
+  }
+
+  dt_free_align(out);
+  dt_free_align(in);
+}
+
+static void test_flat(void **state)
+{
+  const dt_aligned_pixel_t base = { 0.2f, 0.5f, 0.8f, 0.0f };
+  const dt_aligned_pixel_t zero = { 0.0f, 0.0f, 0.0f, 0.0f };
+  _check(base, zero, zero, 0);
+}
+
+static void test_gradient(void **state)
+{
+  // the photosites next to the borders lack the outer neighbours
+  const dt_aligned_pixel_t base = { 0.2f, 0.5f, 0.8f, 0.0f };
+  const dt_aligned_pixel_t gx = { 0.01f, 0.004f, -0.006f, 0.0f };
+  const dt_aligned_pixel_t gy = { -0.003f, 0.007f, 0.002f, 0.0f };
+  _check(base, gx, gy, 1);
+}
+
+/*
+ * MAIN FUNCTION
+ */
+int main(int argc, char* argv[])
+{
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_flat),
+    cmocka_unit_test(test_gradient)
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -0,0 +1,217 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * The distortion map of the screen pipes is continued from cached maps
+ * as strokes are added, dragged, edited and removed. After every step
+ * it has to be the same as the map built from scratch.
+ */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <math.h>
+
+#include <cmocka.h>
+
+#include "../util/assert.h"
+#include "../util/tracing.h"
+
+#include "iop/liquify.c"
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+#define WIDTH 400
+#define HEIGHT 300
+#define STROKES 5
+#define STAMPS 4
+
+// a straight stroke of STAMPS stamps from (x, y) in direction (dx, dy)
+static void _stroke(dt_liquify_warp_t *stamps,
+                    const float x,
+                    const float y,
+                    const float dx,
+                    const float dy,
+                    const float radius,
+                    const dt_liquify_warp_type_enum_t type)
+{
+  for(int k = 0; k < STAMPS; k++)
+  {
+    const float complex point = (x + k * dx) + (y + k * dy) * I;
+    init_warp(stamps + k, point);
+    stamps[k].type = type;
+    stamps[k].radius = point + radius;
+    stamps[k].strength = point + 0.5f * radius * (dx + dy * I) / cabsf(dx + dy * I);
+    // like interpolate_paths(), all but the nodes are interpolated
+    if(k > 0 && k < STAMPS - 1) stamps[k].status = DT_LIQUIFY_STATUS_INTERPOLATED;
+  }
+}
+
+// the strokes, STAMPS each, in the order they are applied
+static void _check_map(dt_iop_liquify_cache_t *cache,
+                       const dt_liquify_warp_t *strokes,
+                       const int num)
+{
+  const dt_iop_roi_t roi = { 0, 0, WIDTH, HEIGHT, 1.0f };
+  GList *stamps = NULL;
+  for(int k = num * STAMPS - 1; k >= 0; k--)
+    stamps = g_list_prepend(stamps, (gpointer)(strokes + k));
+
+  cairo_rectangle_int_t extent;
+  GSList *in_roi = _get_map_extent(&roi, stamps, &extent);
+
+  const float complex *map = _cached_distortion_map(cache, &extent, in_roi);
+  float complex *ref = create_global_distortion_map(&extent, in_roi, FALSE);
+  TR_DEBUG("%d strokes, map %dx%d at %d,%d, %d stamps in the base map", num,
+           extent.width, extent.height, extent.x, extent.y, cache->num_base);
+
+  if(!ref)
+    assert_null(map);
+  else
+  {
+    assert_non_null(map);
+    // the same stamps are added in the same order
+    assert_memory_equal(map, ref, sizeof(float complex) * extent.width * extent.height);
+  }
+
+  dt_free_align(ref);
+  g_slist_free(in_roi);
+  g_list_free(stamps);
+}
+
+static void _init_strokes(dt_liquify_warp_t *strokes)
+{
+  _stroke(strokes, 60.f, 80.f, 12.f, 3.f, 40.f, DT_LIQUIFY_WARP_TYPE_LINEAR);
+  _stroke(strokes + STAMPS, 200.f, 150.f, -5.f, 10.f, 60.f, DT_LIQUIFY_WARP_TYPE_RADIAL_GROW);
+  // partly outside of the roi
+  _stroke(strokes + 2 * STAMPS, 380.f, 40.f, 8.f, -8.f, 35.f, DT_LIQUIFY_WARP_TYPE_LINEAR);
+  _stroke(strokes + 3 * STAMPS, 150.f, 220.f, 15.f, 0.f, 50.f, DT_LIQUIFY_WARP_TYPE_RADIAL_SHRINK);
+  _stroke(strokes + 4 * STAMPS, 100.f, 150.f, 0.f, 20.f, 45.f, DT_LIQUIFY_WARP_TYPE_LINEAR);
+}
+
+static void test_append_strokes(void **state)
+{
+  dt_liquify_warp_t strokes[STROKES * STAMPS];
+  _init_strokes(strokes);
+  dt_iop_liquify_cache_t cache = { 0 };
+
+  for(int num = 1; num <= STROKES; num++)
+    _check_map(&cache, strokes, num);
+  // nothing changed
+  _check_map(&cache, strokes, STROKES);
+
+  _cache_free(&cache);
+}
+
+static void test_drag_last_stroke(void **state)
+{
+  dt_liquify_warp_t strokes[STROKES * STAMPS];
+  _init_strokes(strokes);
+  dt_iop_liquify_cache_t cache = { 0 };
+
+  _check_map(&cache, strokes, STROKES);
+  for(int step = 1; step <= 6; step++)
+  {
+    // across the roi border and back
+    const float x = 100.f + 60.f * step;
+    const float y = 150.f - 25.f * step;
+    _stroke(strokes + (STROKES - 1) * STAMPS, x, y, 0.f, 20.f, 45.f, DT_LIQUIFY_WARP_TYPE_LINEAR);
+    _check_map(&cache, strokes, STROKES);
+  }
+
+  _cache_free(&cache);
+}
+
+static void test_edit_older_stroke(void **state)
+{
+  dt_liquify_warp_t strokes[STROKES * STAMPS];
+  _init_strokes(strokes);
+  dt_iop_liquify_cache_t cache = { 0 };
+
+  _check_map(&cache, strokes, STROKES);
+  // after a change of the last stroke the map of the ones before it is
+  // kept, which doesn't hold the stroke before any more
+  strokes[(STROKES - 1) * STAMPS].point += 5.f;
+  _check_map(&cache, strokes, STROKES);
+  strokes[(STROKES - 1) * STAMPS - 1].point += 5.f;
+  _check_map(&cache, strokes, STROKES);
+  // a stroke in the middle, several times, then the first one
+  for(int step = 1; step <= 3; step++)
+  {
+    strokes[STAMPS + 1].strength += 5.f * step;
+    _check_map(&cache, strokes, STROKES);
+  }
+  strokes[0].radius += 10.f;
+  _check_map(&cache, strokes, STROKES);
+  // and the last one again
+  strokes[STROKES * STAMPS - 1].point += 7.f * I;
+  _check_map(&cache, strokes, STROKES);
+
+  _cache_free(&cache);
+}
+
+static void test_remove_strokes(void **state)
+{
+  dt_liquify_warp_t strokes[STROKES * STAMPS];
+  _init_strokes(strokes);
+  dt_iop_liquify_cache_t cache = { 0 };
+
+  _check_map(&cache, strokes, STROKES);
+  // the last ones
+  for(int num = STROKES - 1; num >= 2; num--)
+    _check_map(&cache, strokes, num);
+
+  // the first one
+  _init_strokes(strokes);
+  _check_map(&cache, strokes, STROKES);
+  memmove(strokes, strokes + STAMPS, sizeof(dt_liquify_warp_t) * (STROKES - 1) * STAMPS);
+  _check_map(&cache, strokes, STROKES - 1);
+
+  // a middle one
+  memmove(strokes + STAMPS, strokes + 2 * STAMPS, sizeof(dt_liquify_warp_t) * (STROKES - 3) * STAMPS);
+  _check_map(&cache, strokes, STROKES - 2);
+
+  // all of them
+  _check_map(&cache, strokes, 0);
+  assert_null(cache.map);
+  assert_null(cache.base);
+
+  _cache_free(&cache);
+}
+
+/*
+ * MAIN FUNCTION
+ */
+int main(int argc, char* argv[])
+{
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_append_strokes),
+    cmocka_unit_test(test_drag_last_stroke),
+    cmocka_unit_test(test_edit_older_stroke),
+    cmocka_unit_test(test_remove_strokes)
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -0,0 +1,196 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * The union-find segmentation of the highlights module has to give exactly
+ * the floodfill result: segment id's, border markings, rectangles and sizes.
+ * Both run on noise, on smooth blobs, on a single plane filling segment and
+ * with a slot limit that is exceeded, for several stripe counts so the seams
+ * cut through the segments. Noise has plenty of small segments and segments
+ * close to the upper and left border the floodfill treats in its own way.
+ */
+#include <limits.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <math.h>
+
+#include <cmocka.h>
+
+#include "../util/assert.h"
+#include "../util/tracing.h"
+
+#include "common/darktable.h"
+#include "iop/hlreconstruct/segmentation.c"
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+typedef enum _pattern_t
+{
+  PATTERN_NOISE,
+  PATTERN_BLOBS,
+  PATTERN_FULL,
+  PATTERN_RINGS
+} _pattern_t;
+
+static void _fill(dt_iop_segmentation_t *seg, const _pattern_t pattern)
+{
+  uint32_t state = 12345;
+  for(int row = 0; row < seg->height; row++)
+  {
+    for(int col = 0; col < seg->width; col++)
+    {
+      state = state * 1664525u + 1013904223u;
+      const gboolean flip = (state >> 24) < 5;
+      uint32_t v = 0;
+      switch(pattern)
+      {
+        case PATTERN_NOISE:
+          v = (state >> 24) < 115;
+          break;
+        case PATTERN_BLOBS:
+          v = (sinf(0.11f * col) * cosf(0.09f * row) + 0.4f * sinf(0.3f * col + 0.07f * row) > 0.3f) ^ flip;
+          break;
+        case PATTERN_FULL:
+          v = 1;
+          break;
+        case PATTERN_RINGS:
+          // small specks within rings of a larger segment
+          v = (col % 9 == 0) || (row % 9 == 0) || (col % 9 == 4 && (row % 9 == 4 || (row % 9 == 5 && col % 2)));
+          break;
+      }
+      seg->data[(size_t)row * seg->width + col] = v;
+    }
+  }
+  _intimage_borderfill(seg->data, seg->width, seg->height, 0, seg->border);
+}
+
+static void _compare(const int width,
+                     const int height,
+                     const int border,
+                     const int slots,
+                     const _pattern_t pattern,
+                     const int stripes)
+{
+  dt_iop_segmentation_t ff;
+  dt_iop_segmentation_t uf;
+  assert_false(dt_segmentation_init_struct(&ff, width, height, border, slots));
+  assert_false(dt_segmentation_init_struct(&uf, width, height, border, slots));
+  _fill(&ff, pattern);
+  _fill(&uf, pattern);
+
+  // unused slots must be left alone or cleared the same way
+  for(int i = 2; i < ff.slots; i++)
+  {
+    ff.size[i] = uf.size[i] = ff.xmin[i] = uf.xmin[i] = ff.xmax[i] = uf.xmax[i] = -1;
+    ff.ymin[i] = uf.ymin[i] = ff.ymax[i] = uf.ymax[i] = -1;
+    ff.val1[i] = uf.val1[i] = ff.val2[i] = uf.val2[i] = 1.0f;
+  }
+
+  double start = dt_get_wtime();
+  _segmentize_floodfill(&ff);
+  const double ff_time = dt_get_wtime() - start;
+  start = dt_get_wtime();
+  assert_false(_segmentize_unionfind(&uf, stripes));
+  const double uf_time = dt_get_wtime() - start;
+
+  TR_DEBUG("%dx%d pattern %d, %d stripes: %d segments, floodfill %.4fs, union-find %.4fs",
+           width, height, pattern, stripes, ff.nr - 2, ff_time, uf_time);
+
+  assert_int_equal(uf.nr, ff.nr);
+  assert_memory_equal(uf.data, ff.data, sizeof(uint32_t) * width * height);
+  for(int i = 2; i < ff.slots; i++)
+  {
+    assert_int_equal(uf.size[i], ff.size[i]);
+    assert_int_equal(uf.xmin[i], ff.xmin[i]);
+    assert_int_equal(uf.xmax[i], ff.xmax[i]);
+    assert_int_equal(uf.ymin[i], ff.ymin[i]);
+    assert_int_equal(uf.ymax[i], ff.ymax[i]);
+    assert_true(uf.val1[i] == ff.val1[i]);
+    assert_true(uf.val2[i] == ff.val2[i]);
+  }
+
+  dt_segmentation_free_struct(&uf);
+  dt_segmentation_free_struct(&ff);
+}
+
+static void _compare_stripes(const int width,
+                             const int height,
+                             const int border,
+                             const int slots,
+                             const _pattern_t pattern)
+{
+  const int stripes[] = { 1, 2, 3, 7, 64, 1000 };
+  for(int s = 0; s < sizeof(stripes) / sizeof(stripes[0]); s++)
+    _compare(width, height, border, slots, pattern, stripes[s]);
+}
+
+static void test_segmentation_noise(void **state)
+{
+  _compare_stripes(203, 151, 9, 100000, PATTERN_NOISE);
+  _compare_stripes(40, 37, 9, 100000, PATTERN_NOISE);
+  // the floodfill marks the row above the area, the last row has nothing below
+  _compare_stripes(97, 61, 1, 100000, PATTERN_NOISE);
+  _compare_stripes(97, 61, 2, 100000, PATTERN_RINGS);
+}
+
+static void test_segmentation_blobs(void **state)
+{
+  _compare_stripes(203, 151, 9, 100000, PATTERN_BLOBS);
+  _compare_stripes(301, 97, 3, 100000, PATTERN_BLOBS);
+}
+
+static void test_segmentation_full(void **state)
+{
+  _compare_stripes(203, 151, 9, 100000, PATTERN_FULL);
+}
+
+static void test_segmentation_rings(void **state)
+{
+  _compare_stripes(203, 151, 9, 100000, PATTERN_RINGS);
+}
+
+static void test_segmentation_slots(void **state)
+{
+  // more segments than slots, both stop at the same location
+  _compare_stripes(300, 200, 3, 256, PATTERN_NOISE);
+}
+
+/*
+ * MAIN FUNCTION
+ */
+int main(int argc, char* argv[])
+{
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_segmentation_noise),
+    cmocka_unit_test(test_segmentation_blobs),
+    cmocka_unit_test(test_segmentation_full),
+    cmocka_unit_test(test_segmentation_rings),
+    cmocka_unit_test(test_segmentation_slots)
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
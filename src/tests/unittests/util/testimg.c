@@ -278,6 +278,27 @@ Testimg *testimg_gen_grey_with_rgb_clipping(const int width)
   }
   return ti;
 }
+Testimg *testimg_gen_bench(const int width, const int height)
+{
+  Testimg *ti = testimg_alloc(width, height);
+  ti->name = "bench";
+
+  for_testimg_pixels_p_yx(ti)
+  {
+    // exposure gradient over -8..+2 EV from left to right
+    const float val = exp2f(-8.0f + 10.0f * (float)x / (float)(width > 1 ? width - 1 : 1));
+    // hue rotating from top to bottom
+    const float hue = 2.0f * (float)M_PI * (float)y / (float)(height > 0 ? height : 1);
+    // fixed pseudo noise for fine detail, reproducible by design
+    const unsigned int h = ((unsigned int)x * 73856093u) ^ ((unsigned int)y * 19349663u);
+    const float detail = 1.0f + 0.1f * ((float)(h & 1023u) / 1023.0f - 0.5f);
+    p[0] = val * detail * (0.6f + 0.4f * cosf(hue));
+    p[1] = val * detail * (0.6f + 0.4f * cosf(hue - 2.0944f));
+    p[2] = val * detail * (0.6f + 0.4f * cosf(hue + 2.0944f));
+    p[3] = 0.0f;
+  }
+  return ti;
+}
 // clang-format off
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
 // vim: shiftwidth=2 expandtab tabstop=2 cindent
@@ -161,6 +161,15 @@ Testimg *testimg_gen_grey_max_dr_neg();
 // create 3 "grey'ish" gradients where in each one a color dominates and clips:
 // height: 3, y=0 => red clips, y=1 => green clips, y=2 => blue clips
 Testimg *testimg_gen_grey_with_rgb_clipping(const int width);
+
+
+/*
+ * Benchmark image generation
+ */
+
+// create a colorful image of arbitrary size with an exposure gradient from
+// left to right, rotating hue from top to bottom and fixed fine detail:
+Testimg *testimg_gen_bench(const int width, const int height);
 // clang-format off
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
 // vim: shiftwidth=2 expandtab tabstop=2 cindent